@@ -0,0 +1,653 @@
+/** @brief  Benchmark the cache simulators on synthetic traces.
+ *
+ *  We generate the trace in memory with a controllable number of keys,
+ *  popularity skew, object size distribution, and TTL distribution. Then
+ *  we drive every simulator (including libCacheSim's Clock and Sieve, via
+ *  'YangCache') with the same trace and report the throughput, the number
+ *  of heap allocations per access, and the heap bytes per resident object
+ *  as JSON. Since the simulators do not store values, all of the heap that
+ *  a simulator holds is metadata.
+ *
+ *  Example:
+ *      ./cache_benchmark_exe --num-keys 1000000 --trace-length 10000000 \
+ *          --size-distribution exponential --ttl-distribution uniform
+ */
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <malloc.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+#include "accurate/cachelib_ttl.hpp"
+#include "accurate/lfu_ttl_cache.hpp"
+#include "accurate/lru_ttl_cache.hpp"
+#include "accurate/memcached_ttl.hpp"
+#include "accurate/redis_ttl.hpp"
+#include "accurate/ttl_cache.hpp"
+#include "cache/clock_cache.hpp"
+#include "cache/fifo_cache.hpp"
+#include "cache/lfu_cache.hpp"
+#include "cache/lru_cache.hpp"
+#include "cache/sieve_cache.hpp"
+#include "cpp_lib/cache_access.hpp"
+#include "cpp_lib/cache_statistics.hpp"
+#include "lib/predictive_lfu_ttl_cache.hpp"
+#include "lib/predictive_lru_ttl_cache.hpp"
+#include "logger/logger.h"
+#include "ttl_cache/new_ttl_clock_cache.hpp"
+#include "ttl_cache/ttl_clock_cache.hpp"
+#include "ttl_cache/ttl_fifo_cache.hpp"
+#include "ttl_cache/ttl_lfu_cache.hpp"
+#include "ttl_cache/ttl_lru_cache.hpp"
+#include "ttl_cache/ttl_sieve_cache.hpp"
+#include "yang_cache/yang_cache.hpp"
+
+using size_t = std::size_t;
+using uint64_t = std::uint64_t;
+
+/*******************************************************************************
+ *  ALLOCATION COUNTING
+ *******************************************************************************/
+
+// NOTE We interpose glibc's allocator rather than replacing 'operator new'
+//      so that we also count libCacheSim's allocations (which go through
+//      malloc and GLib). The '__libc_*' functions are glibc's originals.
+extern "C" {
+void *
+__libc_malloc(size_t size);
+void *
+__libc_calloc(size_t nmemb, size_t size);
+void *
+__libc_realloc(void *ptr, size_t size);
+void *
+__libc_memalign(size_t alignment, size_t size);
+void *
+__libc_valloc(size_t size);
+void *
+__libc_pvalloc(size_t size);
+void
+__libc_free(void *ptr);
+}
+
+static std::atomic<uint64_t> nr_allocations = 0;
+static std::atomic<int64_t> live_bytes = 0;
+
+static inline void *
+record_allocation(void *const ptr)
+{
+    if (ptr != nullptr) {
+        nr_allocations.fetch_add(1, std::memory_order_relaxed);
+        live_bytes.fetch_add(malloc_usable_size(ptr),
+                             std::memory_order_relaxed);
+    }
+    return ptr;
+}
+
+static inline void
+record_free(void *const ptr)
+{
+    if (ptr != nullptr) {
+        live_bytes.fetch_sub(malloc_usable_size(ptr),
+                             std::memory_order_relaxed);
+    }
+}
+
+extern "C" void *
+malloc(size_t size)
+{
+    return record_allocation(__libc_malloc(size));
+}
+
+extern "C" void *
+calloc(size_t nmemb, size_t size)
+{
+    return record_allocation(__libc_calloc(nmemb, size));
+}
+
+extern "C" void *
+realloc(void *ptr, size_t size)
+{
+    record_free(ptr);
+    void *const new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr == nullptr && ptr != nullptr && size != 0) {
+        // NOTE The original allocation is untouched upon failure.
+        live_bytes.fetch_add(malloc_usable_size(ptr),
+                             std::memory_order_relaxed);
+        return nullptr;
+    }
+    return record_allocation(new_ptr);
+}
+
+extern "C" void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    return record_allocation(__libc_memalign(alignment, size));
+}
+
+extern "C" void *
+memalign(size_t alignment, size_t size)
+{
+    return record_allocation(__libc_memalign(alignment, size));
+}
+
+extern "C" void *
+valloc(size_t size)
+{
+    return record_allocation(__libc_valloc(size));
+}
+
+extern "C" void *
+pvalloc(size_t size)
+{
+    return record_allocation(__libc_pvalloc(size));
+}
+
+extern "C" int
+posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) != 0 ||
+        (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *const ptr = record_allocation(__libc_memalign(alignment, size));
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+extern "C" void
+free(void *ptr)
+{
+    record_free(ptr);
+    __libc_free(ptr);
+}
+
+/*******************************************************************************
+ *  SYNTHETIC TRACES
+ *******************************************************************************/
+
+enum class Distribution {
+    INVALID,
+    INFINITE,
+    CONSTANT,
+    UNIFORM,
+    EXPONENTIAL,
+};
+
+static Distribution
+parse_distribution(char const *const str)
+{
+    std::string const s{str == nullptr ? "" : str};
+    if (s == "infinite") {
+        return Distribution::INFINITE;
+    } else if (s == "constant") {
+        return Distribution::CONSTANT;
+    } else if (s == "uniform") {
+        return Distribution::UNIFORM;
+    } else if (s == "exponential") {
+        return Distribution::EXPONENTIAL;
+    }
+    return Distribution::INVALID;
+}
+
+/// @brief  Sample from a distribution with the given mean.
+/// @note   The uniform distribution is over [0, 2 * mean].
+static double
+sample_distribution(Distribution const distribution,
+                    double const mean,
+                    std::mt19937_64 &rng)
+{
+    switch (distribution) {
+    case Distribution::INFINITE:
+        return INFINITY;
+    case Distribution::CONSTANT:
+        return mean;
+    case Distribution::UNIFORM:
+        return std::uniform_real_distribution<double>{0.0, 2 * mean}(rng);
+    case Distribution::EXPONENTIAL:
+        return std::exponential_distribution<double>{1 / mean}(rng);
+    default:
+        assert(0 && "impossible");
+        return NAN;
+    }
+}
+
+struct CommandLineArguments {
+    gint64 num_keys = 1 << 20;
+    gint64 trace_length = 1 << 24;
+    gdouble zipf_skew = 0.99;
+    gdouble capacity_ratio = 0.1;
+    gchar *size_distribution = nullptr;
+    gdouble mean_size_b = 1024;
+    gchar *ttl_distribution = nullptr;
+    gdouble mean_ttl_s = 3600;
+    gint64 accesses_per_s = 1000;
+    gchar *output_path = nullptr;
+
+    Distribution size_dist = Distribution::CONSTANT;
+    Distribution ttl_dist = Distribution::CONSTANT;
+};
+
+/// @brief  Generate a trace where each key has a fixed size and TTL.
+/// @note   We assign the sizes and TTLs per key (rather than per access)
+///         because that is what real traces look like.
+static std::vector<CacheAccess>
+generate_trace(CommandLineArguments const &args)
+{
+    std::mt19937_64 rng{0};
+    std::vector<uint64_t> sizes;
+    std::vector<double> ttls_ms;
+    std::vector<double> weights;
+    sizes.reserve(args.num_keys);
+    ttls_ms.reserve(args.num_keys);
+    weights.reserve(args.num_keys);
+    for (gint64 i = 0; i < args.num_keys; ++i) {
+        double const sz =
+            sample_distribution(args.size_dist, args.mean_size_b, rng);
+        double const ttl_s =
+            sample_distribution(args.ttl_dist, args.mean_ttl_s, rng);
+        // NOTE Objects are at least 1 byte and TTLs are at least 1 second.
+        sizes.push_back(std::max(1.0, std::round(sz)));
+        ttls_ms.push_back(std::isinf(ttl_s)
+                              ? INFINITY
+                              : 1000 * std::max(1.0, std::round(ttl_s)));
+        weights.push_back(1 / std::pow(i + 1, args.zipf_skew));
+    }
+
+    std::discrete_distribution<uint64_t> popularity{weights.begin(),
+                                                    weights.end()};
+    std::vector<CacheAccess> trace;
+    trace.reserve(args.trace_length);
+    for (gint64 i = 0; i < args.trace_length; ++i) {
+        uint64_t const rank = popularity(rng);
+        // NOTE The byte caches assume that the time (and therefore the
+        //      TTLs) advance in whole seconds, like in the real traces.
+        uint64_t const tm_ms = i / args.accesses_per_s * 1000;
+        // NOTE We scramble the keys so that the popular keys are not
+        //      clustered together in the simulators' hash tables.
+        uint64_t const key = rank * UINT64_C(0x9E3779B97F4A7C15);
+        trace.emplace_back(tm_ms, key, sizes[rank], ttls_ms[rank]);
+    }
+    return trace;
+}
+
+/*******************************************************************************
+ *  SIMULATORS
+ *******************************************************************************/
+
+struct BenchmarkResult {
+    double seconds = 0.0;
+    uint64_t nr_allocations = 0;
+    int64_t live_bytes = 0;
+    uint64_t resident_objects = 0;
+    bool resident_objects_is_estimate = false;
+    double miss_ratio = NAN;
+};
+
+/// @brief  Run a simulator that has the BaseCache interface, i.e. it is
+///         constructed with a capacity in objects and uses 'access_item'.
+template <typename T, typename... Args>
+static BenchmarkResult
+run_object_cache(std::vector<CacheAccess> const &trace,
+                 uint64_t const num_keys,
+                 uint64_t const capacity,
+                 Args... args)
+{
+    BenchmarkResult r;
+    int64_t const start_live_bytes = live_bytes.load();
+    T cache(capacity, args...);
+    uint64_t const start_nr_allocations = nr_allocations.load();
+    auto const start = std::chrono::steady_clock::now();
+    for (auto const &access : trace) {
+        cache.access_item(access);
+    }
+    auto const end = std::chrono::steady_clock::now();
+    r.seconds = std::chrono::duration<double>(end - start).count();
+    r.nr_allocations = nr_allocations.load() - start_nr_allocations;
+    r.live_bytes = live_bytes.load() - start_live_bytes;
+    // NOTE Some simulators do not report their size (and 'BaseCache'
+    //      returns a bool), so we assume they are full in that case.
+    if constexpr (requires(T & c) {
+                      { c.size() } -> std::same_as<size_t>;
+                  }) {
+        r.resident_objects = cache.size();
+    } else {
+        r.resident_objects = std::min(capacity, num_keys);
+        r.resident_objects_is_estimate = true;
+    }
+    r.miss_ratio = cache.statistics_.miss_ratio();
+    return r;
+}
+
+/// @brief  Run a simulator that is constructed with a capacity in bytes,
+///         uses 'access', and keeps full statistics.
+template <typename T, typename... Args>
+static BenchmarkResult
+run_byte_cache(std::vector<CacheAccess> const &trace,
+               uint64_t const capacity_bytes,
+               Args... args)
+{
+    BenchmarkResult r;
+    int64_t const start_live_bytes = live_bytes.load();
+    T cache(capacity_bytes, args...);
+    uint64_t const start_nr_allocations = nr_allocations.load();
+    cache.start_simulation();
+    auto const start = std::chrono::steady_clock::now();
+    for (auto const &access : trace) {
+        cache.access(access);
+    }
+    auto const end = std::chrono::steady_clock::now();
+    cache.end_simulation();
+    r.seconds = std::chrono::duration<double>(end - start).count();
+    r.nr_allocations = nr_allocations.load() - start_nr_allocations;
+    r.live_bytes = live_bytes.load() - start_live_bytes;
+    r.resident_objects = cache.statistics().resident_objs_;
+    r.miss_ratio = cache.statistics().miss_ratio();
+    return r;
+}
+
+struct Simulator {
+    char const *name;
+    // NOTE This is the name of the libCacheSim equivalent, if any.
+    char const *baseline;
+    std::function<BenchmarkResult(std::vector<CacheAccess> const &)> run;
+};
+
+static std::vector<Simulator>
+get_simulators(CommandLineArguments const &args)
+{
+    uint64_t const num_keys = args.num_keys;
+    uint64_t const cap = std::max<uint64_t>(1, args.capacity_ratio * num_keys);
+    // NOTE We scale the byte capacity by the mean size so that the byte
+    //      caches hold roughly as many objects as the object caches.
+    uint64_t const cap_b = std::max<uint64_t>(
+        1,
+        args.capacity_ratio * num_keys * args.mean_size_b);
+    // NOTE We do not sample within the byte caches.
+    double const shards = 1.0;
+    // NOTE These are the prediction thresholds for the predictive caches.
+    double const lower_ratio = 0.25, upper_ratio = 0.75;
+
+    auto obj = [=]<typename T>(auto... xs) {
+        return [=](std::vector<CacheAccess> const &t) {
+            return run_object_cache<T>(t, num_keys, cap, xs...);
+        };
+    };
+    auto byte = [=]<typename T>(auto... xs) {
+        return [=](std::vector<CacheAccess> const &t) {
+            return run_byte_cache<T>(t, cap_b, xs...);
+        };
+    };
+    return {
+        {"libCacheSim-Clock",
+         nullptr,
+         obj.operator()<YangCache>(YangCacheType::CLOCK)},
+        {"libCacheSim-Sieve",
+         nullptr,
+         obj.operator()<YangCache>(YangCacheType::SIEVE)},
+        {FIFOCache::name, nullptr, obj.operator()<FIFOCache>()},
+        {LRUCache::name, nullptr, obj.operator()<LRUCache>()},
+        {ClockCache::name, "libCacheSim-Clock", obj.operator()<ClockCache>()},
+        {SieveCache::name, "libCacheSim-Sieve", obj.operator()<SieveCache>()},
+        {LFUCache::name, nullptr, obj.operator()<LFUCache>()},
+        {TTLFIFOCache::name, nullptr, obj.operator()<TTLFIFOCache>()},
+        {TTLLRUCache::name, nullptr, obj.operator()<TTLLRUCache>()},
+        {TTLClockCache::name,
+         "libCacheSim-Clock",
+         obj.operator()<TTLClockCache>()},
+        {NewTTLClockCache::name,
+         "libCacheSim-Clock",
+         obj.operator()<NewTTLClockCache>()},
+        {TTLSieveCache::name,
+         "libCacheSim-Sieve",
+         obj.operator()<TTLSieveCache>()},
+        {TTLLFUCache::name, nullptr, obj.operator()<TTLLFUCache>()},
+        {"TTL_Cache", nullptr, byte.operator()<TTL_Cache>(shards)},
+        {"LRU_TTL_Cache", nullptr, byte.operator()<LRU_TTL_Cache>(shards)},
+        {"LFU_TTL_Cache", nullptr, byte.operator()<LFU_TTL_Cache>(shards)},
+        {"RedisTTL", nullptr, byte.operator()<RedisTTL>(shards)},
+        {"MemcachedTTL", nullptr, byte.operator()<MemcachedTTL>(shards)},
+        {"CacheLibTTL", nullptr, byte.operator()<CacheLibTTL>(shards)},
+        {"PredictiveCache",
+         nullptr,
+         byte.operator()<PredictiveCache>(lower_ratio, upper_ratio, shards)},
+        {"PredictiveLFUCache",
+         nullptr,
+         byte.operator()<PredictiveLFUCache>(lower_ratio,
+                                             upper_ratio,
+                                             shards)},
+    };
+}
+
+/*******************************************************************************
+ *  DRIVER
+ *******************************************************************************/
+
+/// @brief  Print a double as JSON, which does not support infinities.
+static void
+print_json_double(FILE *const fp, double const x)
+{
+    if (std::isfinite(x)) {
+        std::fprintf(fp, "%.9g", x);
+    } else {
+        std::fprintf(fp, "null");
+    }
+}
+
+static void
+print_result(FILE *const fp,
+             bool const first,
+             Simulator const &sim,
+             CommandLineArguments const &args,
+             BenchmarkResult const &r)
+{
+    double const nr_accesses = args.trace_length;
+    std::fprintf(fp, "%s\n    {", first ? "" : ",");
+    std::fprintf(fp, "\"simulator\": \"%s\", ", sim.name);
+    if (sim.baseline != nullptr) {
+        std::fprintf(fp, "\"libcachesim_baseline\": \"%s\", ", sim.baseline);
+    } else {
+        std::fprintf(fp, "\"libcachesim_baseline\": null, ");
+    }
+    std::fprintf(fp, "\"accesses_per_sec\": ");
+    print_json_double(fp, nr_accesses / r.seconds);
+    std::fprintf(fp, ", \"allocations_per_access\": ");
+    print_json_double(fp, r.nr_allocations / nr_accesses);
+    std::fprintf(fp, ", \"metadata_bytes_per_object\": ");
+    print_json_double(fp,
+                      r.resident_objects ? (double)r.live_bytes /
+                                               r.resident_objects
+                                         : NAN);
+    std::fprintf(fp, ", \"resident_objects\": %" PRIu64, r.resident_objects);
+    std::fprintf(fp,
+                 ", \"resident_objects_is_estimate\": %s",
+                 r.resident_objects_is_estimate ? "true" : "false");
+    std::fprintf(fp, ", \"live_bytes\": %" PRId64, r.live_bytes);
+    std::fprintf(fp, ", \"miss_ratio\": ");
+    print_json_double(fp, r.miss_ratio);
+    std::fprintf(fp, ", \"seconds\": ");
+    print_json_double(fp, r.seconds);
+    std::fprintf(fp, "}");
+    std::fflush(fp);
+}
+
+static CommandLineArguments
+parse_command_line_arguments(int argc, char *argv[])
+{
+    CommandLineArguments args;
+    GOptionEntry entries[] = {
+        {"num-keys",
+         'n',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.num_keys,
+         "number of unique keys. Default: 1<<20",
+         NULL},
+        {"trace-length",
+         'l',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.trace_length,
+         "number of accesses. Default: 1<<24",
+         NULL},
+        {"zipf-skew",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &args.zipf_skew,
+         "skew of the key popularity (0 is uniform). Default: 0.99",
+         NULL},
+        {"capacity-ratio",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &args.capacity_ratio,
+         "cache capacity as a fraction of the keys (or bytes). Default: 0.1",
+         NULL},
+        {"size-distribution",
+         0,
+         0,
+         G_OPTION_ARG_STRING,
+         &args.size_distribution,
+         "object sizes: constant|uniform|exponential. Default: constant",
+         NULL},
+        {"mean-size",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &args.mean_size_b,
+         "mean object size in bytes. Default: 1024",
+         NULL},
+        {"ttl-distribution",
+         0,
+         0,
+         G_OPTION_ARG_STRING,
+         &args.ttl_distribution,
+         "TTLs: infinite|constant|uniform|exponential. Default: constant",
+         NULL},
+        {"mean-ttl",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &args.mean_ttl_s,
+         "mean TTL in seconds. Default: 3600",
+         NULL},
+        {"accesses-per-sec",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &args.accesses_per_s,
+         "accesses per (simulated) second. Default: 1000",
+         NULL},
+        {"output",
+         'o',
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.output_path,
+         "path to the JSON output. Default: cache_benchmark.json",
+         NULL},
+        G_OPTION_ENTRY_NULL,
+    };
+
+    GError *error = NULL;
+    GOptionContext *context =
+        g_option_context_new("- benchmark the cache simulators");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        goto cleanup;
+    }
+    if (args.size_distribution != nullptr) {
+        args.size_dist = parse_distribution(args.size_distribution);
+    }
+    if (args.ttl_distribution != nullptr) {
+        args.ttl_dist = parse_distribution(args.ttl_distribution);
+    }
+    // NOTE Objects must have a size, so only the TTLs can be infinite.
+    if (args.size_dist == Distribution::INVALID ||
+        args.size_dist == Distribution::INFINITE ||
+        args.ttl_dist == Distribution::INVALID) {
+        LOGGER_ERROR("bad size or TTL distribution");
+        goto cleanup;
+    }
+    if (args.num_keys <= 0 || args.trace_length <= 0 ||
+        args.capacity_ratio <= 0.0 || args.mean_size_b <= 0.0 ||
+        args.mean_ttl_s <= 0.0 || args.accesses_per_s <= 0 ||
+        args.zipf_skew < 0.0) {
+        LOGGER_ERROR("bad numerical argument");
+        goto cleanup;
+    }
+    g_option_context_free(context);
+    return args;
+cleanup:
+    gchar *help_msg = g_option_context_get_help(context, FALSE, NULL);
+    g_print("%s", help_msg);
+    g_free(help_msg);
+    g_option_context_free(context);
+    exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    CommandLineArguments args = parse_command_line_arguments(argc, argv);
+    char const *const output_path = args.output_path != nullptr
+                                        ? args.output_path
+                                        : "cache_benchmark.json";
+    FILE *fp = std::fopen(output_path, "w");
+    if (fp == nullptr) {
+        LOGGER_ERROR("failed to open '%s'", output_path);
+        exit(EXIT_FAILURE);
+    }
+
+    LOGGER_INFO("generating trace with %" PRId64 " keys and %" PRId64
+                " accesses",
+                (int64_t)args.num_keys,
+                (int64_t)args.trace_length);
+    std::vector<CacheAccess> const trace = generate_trace(args);
+    std::fprintf(fp,
+                 "{\"type\": \"CacheBenchmark\", \"num_keys\": %" PRId64
+                 ", \"trace_length\": %" PRId64 ", \"zipf_skew\": %g"
+                 ", \"capacity_ratio\": %g, \"size_distribution\": \"%s\""
+                 ", \"mean_size_b\": %g, \"ttl_distribution\": \"%s\""
+                 ", \"mean_ttl_s\": %g, \"results\": [",
+                 (int64_t)args.num_keys,
+                 (int64_t)args.trace_length,
+                 args.zipf_skew,
+                 args.capacity_ratio,
+                 args.size_distribution ? args.size_distribution : "constant",
+                 args.mean_size_b,
+                 args.ttl_distribution ? args.ttl_distribution : "constant",
+                 args.mean_ttl_s);
+    bool first = true;
+    for (auto const &sim : get_simulators(args)) {
+        LOGGER_INFO("running '%s'", sim.name);
+        BenchmarkResult const r = sim.run(trace);
+        print_result(fp, first, sim, args, r);
+        first = false;
+    }
+    std::fprintf(fp, "\n]}\n");
+
+    std::fclose(fp);
+    LOGGER_INFO("wrote results to '%s'", output_path);
+    g_free(args.size_distribution);
+    g_free(args.ttl_distribution);
+    g_free(args.output_path);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/** @brief  Compare the sequential and prefetching batch hash table
+ *          operations on a table much larger than the last-level cache.
+ *
+ *  @note   Run with: `<exe> [<log2 number of keys>]`. The default of
+ *          2^24 keys puts several hundred MB into the KHashTable, so its
+ *          accesses miss in the cache (and often in the TLB).
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "hash/hash.h"
+#include "logger/logger.h"
+#include "lookup/evicting_hash_table.h"
+#include "lookup/k_hash_table.h"
+#include "lookup/lookup.h"
+#include "timer/timer.h"
+
+// The number of keys per call to the batch operations, like the runner.
+#define BATCH_SIZE 4096
+
+static bool
+time_khash(EntryType const *const keys,
+           EntryType const *const missing_keys,
+           size_t const num_keys)
+{
+    struct KHashTable seq = {0}, batch = {0};
+    struct LookupReturn *results = malloc(BATCH_SIZE * sizeof(*results));
+    size_t num_mismatches = 0;
+    if (results == NULL || !KHashTable__init(&seq) ||
+        !KHashTable__init(&batch)) {
+        LOGGER_ERROR("initialization failed");
+        free(results);
+        return false;
+    }
+
+    double const t0 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; ++i) {
+        KHashTable__put(&seq, keys[i], i);
+    }
+    double const t1 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; i += BATCH_SIZE) {
+        size_t const n = MIN(BATCH_SIZE, num_keys - i);
+        // NOTE The values are the keys' indices like the sequential puts.
+        TimeStampType values[BATCH_SIZE];
+        for (size_t j = 0; j < n; ++j) {
+            values[j] = i + j;
+        }
+        KHashTable__put_batch(&batch, &keys[i], values, n, NULL);
+    }
+    double const t2 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; ++i) {
+        KHashTable__lookup(&seq, keys[i]);
+    }
+    double const t3 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; i += BATCH_SIZE) {
+        size_t const n = MIN(BATCH_SIZE, num_keys - i);
+        KHashTable__lookup_batch(&batch, &keys[i], n, results);
+        for (size_t j = 0; j < n; ++j) {
+            if (!results[j].success || results[j].timestamp != i + j) {
+                ++num_mismatches;
+            }
+        }
+    }
+    double const t4 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; ++i) {
+        KHashTable__lookup(&seq, missing_keys[i]);
+    }
+    double const t5 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; i += BATCH_SIZE) {
+        size_t const n = MIN(BATCH_SIZE, num_keys - i);
+        KHashTable__lookup_batch(&batch, &missing_keys[i], n, results);
+        for (size_t j = 0; j < n; ++j) {
+            if (results[j].success) {
+                ++num_mismatches;
+            }
+        }
+    }
+    double const t6 = get_wall_time_sec();
+
+    LOGGER_INFO("KLib Hash Table -- put: %f vs %f batch | lookup: %f vs %f "
+                "batch | lookup miss: %f vs %f batch",
+                t1 - t0,
+                t2 - t1,
+                t3 - t2,
+                t4 - t3,
+                t5 - t4,
+                t6 - t5);
+    if (num_mismatches != 0) {
+        LOGGER_ERROR("%zu batch lookups differ", num_mismatches);
+    }
+    KHashTable__destroy(&seq);
+    KHashTable__destroy(&batch);
+    free(results);
+    return num_mismatches == 0;
+}
+
+static bool
+time_evicting_hash_table(EntryType const *const keys, size_t const num_keys)
+{
+    struct EvictingHashTable seq = {0}, batch = {0};
+    struct SampledTryPutReturn *results =
+        malloc(BATCH_SIZE * sizeof(*results));
+    size_t num_mismatches = 0;
+    // NOTE A table the size of the key set keeps (nearly) every key.
+    if (results == NULL || !EvictingHashTable__init(&seq, num_keys, 1.0) ||
+        !EvictingHashTable__init(&batch, num_keys, 1.0)) {
+        LOGGER_ERROR("initialization failed");
+        free(results);
+        return false;
+    }
+
+    double const t0 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; ++i) {
+        EvictingHashTable__try_put(&seq, keys[i], i);
+    }
+    double const t1 = get_wall_time_sec();
+    for (size_t i = 0; i < num_keys; i += BATCH_SIZE) {
+        size_t const n = MIN(BATCH_SIZE, num_keys - i);
+        ValueType values[BATCH_SIZE];
+        for (size_t j = 0; j < n; ++j) {
+            values[j] = i + j;
+        }
+        EvictingHashTable__try_put_batch(&batch, &keys[i], values, n, results);
+    }
+    double const t2 = get_wall_time_sec();
+
+    for (size_t i = 0; i < num_keys; ++i) {
+        if (seq.hashes[i] != batch.hashes[i] ||
+            seq.values[i] != batch.values[i]) {
+            ++num_mismatches;
+        }
+    }
+    LOGGER_INFO("Evicting Hash Table -- try put: %f vs %f batch",
+                t1 - t0,
+                t2 - t1);
+    if (num_mismatches != 0) {
+        LOGGER_ERROR("%zu batch slots differ", num_mismatches);
+    }
+    EvictingHashTable__destroy(&seq);
+    EvictingHashTable__destroy(&batch);
+    free(results);
+    return num_mismatches == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int log2_num_keys = 24;
+    if (argc == 2) {
+        log2_num_keys = atoi(argv[1]);
+    }
+    if (argc > 2 || log2_num_keys < 0 || log2_num_keys > 32) {
+        LOGGER_ERROR("usage: %s [<log2 number of keys>]", argv[0]);
+        return EXIT_FAILURE;
+    }
+    size_t const num_keys = (size_t)1 << log2_num_keys;
+    EntryType *keys = malloc(num_keys * sizeof(*keys));
+    EntryType *missing_keys = malloc(num_keys * sizeof(*missing_keys));
+    if (keys == NULL || missing_keys == NULL) {
+        LOGGER_ERROR("cannot allocate %zu keys", num_keys);
+        free(keys);
+        free(missing_keys);
+        return EXIT_FAILURE;
+    }
+    // NOTE We scramble the keys so consecutive accesses touch unrelated
+    //      buckets, as they do in a real trace.
+    for (size_t i = 0; i < num_keys; ++i) {
+        keys[i] = Hash64Bit(i);
+        missing_keys[i] = Hash64Bit(i + num_keys);
+    }
+    bool ok = time_khash(keys, missing_keys, num_keys);
+    ok = time_evicting_hash_table(keys, num_keys) && ok;
+    free(keys);
+    free(missing_keys);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
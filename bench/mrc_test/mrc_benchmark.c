@@ -0,0 +1,381 @@
+/** @brief  Benchmark the MRC algorithms across a matrix of synthetic
+ *          workloads and trace lengths.
+ *
+ *  For every (workload, length) pair, we run the Olken oracle and then
+ *  every algorithm through the trace runner. We report the throughput,
+ *  peak memory, per-phase times, and the error against the oracle as
+ *  JSON so that we can track regressions between releases.
+ *
+ *  Example:
+ *      ./mrc_benchmark_exe --min-length-log2 20 --max-length-log2 30 \
+ *          --output mrc_benchmark.json
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "logger/logger.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "run/runner_arguments.h"
+#include "run/trace_runner.h"
+#include "trace/generator.h"
+#include "trace/trace.h"
+
+/// @brief  The default runs. Every algorithm that the trace runner
+///         supports is listed here with its typical parameters.
+/// @note   We use the runner's default histogram (one distance per bin)
+///         for every algorithm so that the MRCs are comparable.
+static char const *const DEFAULT_RUNS[] = {
+    "Olken()",
+    "Fixed-Rate-SHARDS(sampling=1e-3,adj=true)",
+    "Fixed-Size-SHARDS(sampling=1e-1,max_size=8192)",
+    "Fused-Fixed-Size-SHARDS(sampling=1e-1,max_size=8192)",
+    "Evicting-Map(sampling=1e-1,max_size=8192)",
+    "Evicting-QuickMRC(sampling=1e-1,max_size=8192)",
+    "Counter-Stacks()",
+    NULL,
+};
+
+static char const *const ORACLE_RUN = "Olken()";
+
+static char const *const DEFAULT_OUTPUT_PATH = "mrc_benchmark.json";
+
+enum Workload {
+    WORKLOAD_UNIFORM,
+    WORKLOAD_ZIPF_0_5,
+    WORKLOAD_ZIPF_0_99,
+    WORKLOAD_STEP,
+    WORKLOAD_TWO_STEP,
+    WORKLOAD_TWO_DISTRIBUTION,
+    NUM_WORKLOADS,
+};
+
+static char const *const WORKLOAD_NAMES[NUM_WORKLOADS] = {
+    "uniform",
+    "zipf-0.5",
+    "zipf-0.99",
+    "step",
+    "two-step",
+    "two-distribution",
+};
+
+struct CommandLineArguments {
+    gint min_length_log2;
+    gint max_length_log2;
+    gint64 num_unique;
+    gchar **run;
+    gchar *output_path;
+};
+
+static struct Trace
+generate_workload(enum Workload const workload,
+                  uint64_t const length,
+                  uint64_t const num_unique)
+{
+    uint64_t const seed = 0;
+    switch (workload) {
+    case WORKLOAD_UNIFORM:
+        return generate_uniform_trace(length, num_unique, seed);
+    case WORKLOAD_ZIPF_0_5:
+        return generate_zipfian_trace(length, num_unique, 0.5, seed);
+    case WORKLOAD_ZIPF_0_99:
+        return generate_zipfian_trace(length, num_unique, 0.99, seed);
+    case WORKLOAD_STEP:
+        return generate_step_trace(length, num_unique);
+    case WORKLOAD_TWO_STEP:
+        return generate_two_step_trace(length, num_unique);
+    case WORKLOAD_TWO_DISTRIBUTION:
+        return generate_two_distribution_trace(length, num_unique);
+    default:
+        return (struct Trace){.trace = NULL, .length = 0};
+    }
+}
+
+/// @brief  Read a field (in kB) from '/proc/self/status'.
+/// @return The field's value in bytes or 0 on error.
+static uint64_t
+read_proc_status_bytes(char const *const field)
+{
+    char line[256] = {0};
+    uint64_t kb = 0;
+    size_t const field_length = strlen(field);
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, field, field_length) == 0 &&
+            line[field_length] == ':') {
+            kb = strtoull(&line[field_length + 1], NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb * 1024;
+}
+
+/// @brief  Reset the peak RSS to the current RSS.
+/// @note   Writing '5' to '/proc/self/clear_refs' resets the peak RSS on
+///         Linux 4.0+. We return the memory that the allocator cached
+///         first, otherwise freed memory from the last run would count.
+static bool
+reset_peak_rss(void)
+{
+    malloc_trim(0);
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp == NULL) {
+        return false;
+    }
+    bool ok = fputs("5", fp) >= 0;
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
+
+/// @brief  Get the peak RSS since the last reset.
+/// @note   If we cannot read the peak since the last reset, we fall back
+///         to the peak over the process's lifetime.
+static uint64_t
+get_peak_rss_bytes(void)
+{
+    uint64_t const hwm = read_proc_status_bytes("VmHWM");
+    if (hwm != 0) {
+        return hwm;
+    }
+    struct rusage usage = {0};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // NOTE Linux reports the maximum RSS in kilobytes.
+    return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+/// @brief  Print a double as JSON, which does not support infinities.
+static void
+print_json_double(FILE *const fp, double const x)
+{
+    if (isfinite(x)) {
+        fprintf(fp, "%.9g", x);
+    } else {
+        fprintf(fp, "null");
+    }
+}
+
+static bool
+run_one(FILE *const fp,
+        bool *const first,
+        char const *const run_str,
+        enum Workload const workload,
+        uint64_t const num_unique,
+        struct Trace const *const trace,
+        struct MissRateCurve *const oracle_mrc)
+{
+    struct RunnerArguments args = {0};
+    struct RunnerResults results = {0};
+    if (!RunnerArguments__init(&args, run_str)) {
+        LOGGER_ERROR("failed to parse '%s'", run_str);
+        return false;
+    }
+    bool const reset_ok = reset_peak_rss();
+    uint64_t const baseline_rss = read_proc_status_bytes("VmRSS");
+    if (!run_runner_with_results(&args, trace, &results) || !results.ok) {
+        LOGGER_WARN("'%s' failed on '%s'", run_str, WORKLOAD_NAMES[workload]);
+        RunnerArguments__destroy(&args);
+        return true;
+    }
+    uint64_t const peak_rss = get_peak_rss_bytes();
+    double const mae =
+        MissRateCurve__mean_absolute_error(&results.mrc, oracle_mrc);
+    double const mse =
+        MissRateCurve__mean_squared_error(&results.mrc, oracle_mrc);
+
+    fprintf(fp, "%s\n    {", *first ? "" : ",");
+    *first = false;
+    fprintf(fp, "\"algorithm\": \"%s\", ", algorithm_names[args.algorithm]);
+    fprintf(fp, "\"run\": \"%s\", ", run_str);
+    fprintf(fp, "\"workload\": \"%s\", ", WORKLOAD_NAMES[workload]);
+    fprintf(fp, "\"length\": %zu, ", trace->length);
+    fprintf(fp, "\"num_unique\": %" PRIu64 ", ", num_unique);
+    fprintf(fp, "\"ns_per_access\": ");
+    print_json_double(fp,
+                      1e9 * results.histogram_time_sec /
+                          (trace->length ? trace->length : 1));
+    fprintf(fp, ", \"histogram_time_sec\": ");
+    print_json_double(fp, results.histogram_time_sec);
+    fprintf(fp, ", \"post_process_time_sec\": ");
+    print_json_double(fp, results.post_process_time_sec);
+    fprintf(fp, ", \"mrc_time_sec\": ");
+    print_json_double(fp, results.mrc_time_sec);
+    fprintf(fp, ", \"total_time_sec\": ");
+    print_json_double(fp, results.total_time_sec);
+    fprintf(fp, ", \"peak_rss_bytes\": %" PRIu64, peak_rss);
+    fprintf(fp, ", \"baseline_rss_bytes\": %" PRIu64, baseline_rss);
+    fprintf(fp, ", \"peak_rss_is_per_run\": %s", reset_ok ? "true" : "false");
+    fprintf(fp, ", \"live_memory_bytes\": %zu", results.memory.live_bytes);
+    fprintf(fp, ", \"peak_memory_bytes\": %zu", results.memory.peak_bytes);
+    fprintf(fp, ", \"mae\": ");
+    print_json_double(fp, mae);
+    fprintf(fp, ", \"mse\": ");
+    print_json_double(fp, mse);
+    fprintf(fp, "}");
+    fflush(fp);
+
+    MissRateCurve__destroy(&results.mrc);
+    RunnerArguments__destroy(&args);
+    return true;
+}
+
+static bool
+run_oracle(struct Trace const *const trace, struct MissRateCurve *const mrc)
+{
+    struct RunnerArguments args = {0};
+    struct RunnerResults results = {0};
+    if (!RunnerArguments__init(&args, ORACLE_RUN)) {
+        return false;
+    }
+    bool const ok = run_runner_with_results(&args, trace, &results) &&
+                    results.ok;
+    RunnerArguments__destroy(&args);
+    *mrc = results.mrc;
+    return ok;
+}
+
+static struct CommandLineArguments
+parse_command_line_arguments(int argc, char *argv[])
+{
+    struct CommandLineArguments args = {
+        .min_length_log2 = 16,
+        .max_length_log2 = 20,
+        .num_unique = 1 << 20,
+        .run = NULL,
+        .output_path = NULL,
+    };
+    GOptionEntry entries[] = {
+        {"min-length-log2",
+         0,
+         0,
+         G_OPTION_ARG_INT,
+         &args.min_length_log2,
+         "log2 of the shortest trace. Default: 16",
+         NULL},
+        {"max-length-log2",
+         0,
+         0,
+         G_OPTION_ARG_INT,
+         &args.max_length_log2,
+         "log2 of the longest trace (at most 30). We step by factors of 4. "
+         "Default: 20",
+         NULL},
+        {"num-unique",
+         'n',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.num_unique,
+         "maximum number of unique keys (capped at half of the trace "
+         "length). Default: 1<<20",
+         NULL},
+        {"run",
+         'r',
+         0,
+         G_OPTION_ARG_STRING_ARRAY,
+         &args.run,
+         "arguments for the algorithm runs. Default: every algorithm",
+         NULL},
+        {"output",
+         'o',
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.output_path,
+         "path to the JSON output. Default: mrc_benchmark.json",
+         NULL},
+        G_OPTION_ENTRY_NULL,
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- benchmark the MRCs");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        goto cleanup;
+    }
+    errno = 0;
+    if (args.min_length_log2 < 0 || args.max_length_log2 > 30 ||
+        args.min_length_log2 > args.max_length_log2 || args.num_unique <= 0) {
+        LOGGER_ERROR("bad lengths or number of unique keys");
+        goto cleanup;
+    }
+    g_option_context_free(context);
+    return args;
+cleanup:;
+    gchar *help_msg = g_option_context_get_help(context, FALSE, NULL);
+    g_print("%s", help_msg);
+    g_free(help_msg);
+    g_option_context_free(context);
+    exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct CommandLineArguments args = parse_command_line_arguments(argc, argv);
+    char const *const *const runs =
+        args.run != NULL ? (char const *const *)args.run : DEFAULT_RUNS;
+    // NOTE We do not write to stdout by default because the logger
+    //      (and the runner) print there.
+    char const *const output_path =
+        args.output_path != NULL ? args.output_path : DEFAULT_OUTPUT_PATH;
+    FILE *fp = fopen(output_path, "w");
+    if (fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", output_path);
+        exit(EXIT_FAILURE);
+    }
+
+    bool first = true;
+    fprintf(fp, "{\"type\": \"MRCBenchmark\", \"results\": [");
+    for (gint log2 = args.min_length_log2; log2 <= args.max_length_log2;
+         log2 += 2) {
+        uint64_t const length = UINT64_C(1) << log2;
+        // NOTE Some generators require at least two accesses per key.
+        uint64_t const num_unique = MIN((uint64_t)args.num_unique, length / 2);
+        for (enum Workload w = 0; w < NUM_WORKLOADS; ++w) {
+            struct MissRateCurve oracle_mrc = {0};
+            struct Trace trace =
+                generate_workload(w, length, num_unique);
+            if (trace.trace == NULL) {
+                LOGGER_ERROR("failed to generate '%s' with length %" PRIu64,
+                             WORKLOAD_NAMES[w],
+                             length);
+                continue;
+            }
+            if (!run_oracle(&trace, &oracle_mrc)) {
+                LOGGER_ERROR("oracle failed on '%s'", WORKLOAD_NAMES[w]);
+            }
+            for (size_t i = 0; runs[i] != NULL; ++i) {
+                run_one(fp,
+                        &first,
+                        runs[i],
+                        w,
+                        num_unique,
+                        &trace,
+                        &oracle_mrc);
+            }
+            MissRateCurve__destroy(&oracle_mrc);
+            Trace__destroy(&trace);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    fclose(fp);
+    LOGGER_INFO("wrote results to '%s'", output_path);
+    g_strfreev(args.run);
+    g_free(args.output_path);
+    return EXIT_SUCCESS;
+}
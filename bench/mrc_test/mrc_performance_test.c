@@ -6,6 +6,7 @@
 #include "math/positive_ceiling_divide.h"
 #include "random/zipfian_random.h"
 
+#include "counter_stacks/counter_stacks.h"
 #include "evicting_map/evicting_map.h"
 #include "mimir/mimir.h"
 #include "olken/olken.h"
@@ -111,6 +112,18 @@ test_all(void)
         EvictingMap__init(&me, 1e-3, 1 << 13, hist_num_bins, hist_bin_size),
         EvictingMap__access_item,
         EvictingMap__destroy);
+
+    PERFORMANCE_TEST(
+        struct CounterStacks,
+        me,
+        CounterStacks__init(&me,
+                            COUNTER_STACKS_DEFAULT_DOWNSAMPLE_INTERVAL,
+                            COUNTER_STACKS_DEFAULT_PRUNING_DELTA,
+                            COUNTER_STACKS_DEFAULT_PRECISION,
+                            hist_num_bins,
+                            hist_bin_size),
+        CounterStacks__access_item,
+        CounterStacks__destroy);
 }
 
 static void
@@ -175,6 +188,21 @@ test_sampling(void)
         EvictingMap__access_item,
         EvictingMap__destroy);
 #endif
+
+#if 1
+    // Compare against a non-sampling, sublinear-memory approach
+    PERFORMANCE_TEST(
+        struct CounterStacks,
+        me,
+        CounterStacks__init(&me,
+                            COUNTER_STACKS_DEFAULT_DOWNSAMPLE_INTERVAL,
+                            COUNTER_STACKS_DEFAULT_PRUNING_DELTA,
+                            COUNTER_STACKS_DEFAULT_PRECISION,
+                            hist_num_bins,
+                            hist_bin_size),
+        CounterStacks__access_item,
+        CounterStacks__destroy);
+#endif
 }
 
 static void
@@ -0,0 +1,509 @@
+/** @brief  Run any subset of the trace analyses in a single scan.
+ *
+ *  This replaces running analyze_trace, analyze_ttls, analyze_rw,
+ *  analyze_clients, and time_between_accesses one after another. The
+ *  worker threads first split the (memory-mapped) trace by the keys'
+ *  hashes, then each processes only the keys that hash to it, so it owns
+ *  a private per-key table and needs no locking. We merge the workers'
+ *  summaries at the end.
+ */
+
+#include "analysis/access_statistics.hpp"
+#include "cpp_lib/cache_access.hpp"
+#include "cpp_lib/cache_trace.hpp"
+#include "cpp_lib/cache_trace_format.hpp"
+#include "cpp_lib/histogram.hpp"
+#include "cpp_lib/progress_bar.hpp"
+#include "cpp_lib/util.hpp"
+#include "hash/splitmix64.h"
+#include "logger/logger.h"
+
+#include <boost/version.hpp>
+// Boost introduced unordered flat maps in version 1.83.0
+#if BOOST_VERSION >= 108300
+#include <boost/unordered/unordered_flat_map.hpp>
+#else
+#include <unordered_map>
+#endif
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdbool.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using size_t = std::size_t;
+using uint64_t = std::uint64_t;
+using uint16_t = std::uint16_t;
+using uint8_t = std::uint8_t;
+
+enum AnalysisPass : unsigned {
+    ANALYSIS_PASS_TRACE = 1 << 0,
+    ANALYSIS_PASS_TTLS = 1 << 1,
+    ANALYSIS_PASS_RW = 1 << 2,
+    ANALYSIS_PASS_CLIENTS = 1 << 3,
+    ANALYSIS_PASS_TIME = 1 << 4,
+    ANALYSIS_PASS_ALL = (1 << 5) - 1,
+};
+
+/// @brief  Parse a comma-separated list of passes, e.g. "trace,rw".
+/// @return the bitmask of passes or 0 upon an error.
+static unsigned
+parse_passes(std::string const &str)
+{
+    unsigned passes = 0;
+    for (auto const &name : string_split(str, ",")) {
+        if (name == "all") {
+            passes |= ANALYSIS_PASS_ALL;
+        } else if (name == "trace") {
+            passes |= ANALYSIS_PASS_TRACE;
+        } else if (name == "ttls") {
+            passes |= ANALYSIS_PASS_TTLS;
+        } else if (name == "rw") {
+            passes |= ANALYSIS_PASS_RW;
+        } else if (name == "clients") {
+            passes |= ANALYSIS_PASS_CLIENTS;
+        } else if (name == "time") {
+            passes |= ANALYSIS_PASS_TIME;
+        } else {
+            LOGGER_ERROR("unrecognized pass '%s'", name.c_str());
+            return 0;
+        }
+    }
+    return passes;
+}
+
+template <typename T>
+static void
+saturation_iincr(T &x)
+{
+    if (x == std::numeric_limits<T>::max()) {
+        return;
+    }
+    x += 1;
+}
+
+/// @brief  The state of a single key for every pass. This is kept
+///         compact because there is one per key in the trace.
+struct KeyState {
+    // Used by the 'trace' and 'time' passes.
+    AccessStatistics stats;
+    // Used by the 'rw' pass.
+    bool read : 1 = 0;
+    bool write : 1 = 0;
+    // Check whether there was a read miss without write
+    bool read_miss_without_write : 1 = 0;
+    bool write_before_read : 1 = 0;
+    // Used by the 'clients' pass.
+    uint16_t client_id = UINT16_MAX;
+    uint16_t switched_clients = 0;
+    uint16_t remained_with_client = 0;
+};
+
+/// @brief  The analysis of one partition of the keys.
+class Partition {
+public:
+    Partition(unsigned const passes)
+        : passes_{passes}
+    {
+    }
+
+    void
+    access(CacheAccess const &x)
+    {
+        KeyState &s = table_[x.key];
+        if (passes_ & ANALYSIS_PASS_TIME) {
+            access_time(s, x);
+        }
+        if (passes_ & ANALYSIS_PASS_TRACE) {
+            access_trace(s, x);
+        }
+        if (passes_ & (ANALYSIS_PASS_TRACE | ANALYSIS_PASS_TIME)) {
+            // NOTE We update the statistics after the other passes
+            //      because they look at the previous access.
+            s.stats.access(x);
+        }
+        if ((passes_ & ANALYSIS_PASS_TTLS) && x.has_ttl()) {
+            ttls_.update(x.ttl_ms);
+        }
+        if (passes_ & ANALYSIS_PASS_RW) {
+            access_rw(s, x);
+        }
+        if (passes_ & ANALYSIS_PASS_CLIENTS) {
+            access_clients(s, x);
+        }
+    }
+
+    /// @brief  Summarize the per-key table and then free it.
+    void
+    summarize()
+    {
+        for (auto const &[k, s] : table_) {
+            if (passes_ & ANALYSIS_PASS_TRACE) {
+                key_summary_.add(s.stats);
+            }
+            if (passes_ & ANALYSIS_PASS_RW) {
+                read_only_ += s.read && !s.write;
+                write_only_ += !s.read && s.write;
+                rw_ += s.read && s.write;
+                read_miss_without_write_ += s.read_miss_without_write;
+                write_before_read_ += s.write_before_read;
+            }
+            if (passes_ & ANALYSIS_PASS_CLIENTS) {
+                final_client_popularity_.update(s.client_id);
+                switched_.update(s.switched_clients);
+                stayed_.update(s.remained_with_client);
+            }
+        }
+        nr_keys_ = table_.size();
+        decltype(table_){}.swap(table_);
+    }
+
+    /// @note   The partitions must have been summarized.
+    void
+    merge(Partition const &other)
+    {
+        assert(passes_ == other.passes_);
+        nr_keys_ += other.nr_keys_;
+        nr_accesses_ += other.nr_accesses_;
+
+        cnt_gets_ += other.cnt_gets_;
+        cnt_sets_ += other.cnt_sets_;
+        ttl_hist_.merge(other.ttl_hist_);
+        ttl_diff_hist_.merge(other.ttl_diff_hist_);
+        key_summary_.merge(other.key_summary_);
+
+        ttls_.merge(other.ttls_);
+
+        read_only_ += other.read_only_;
+        write_only_ += other.write_only_;
+        rw_ += other.rw_;
+        read_miss_without_write_ += other.read_miss_without_write_;
+        write_before_read_ += other.write_before_read_;
+
+        client_read_.merge(other.client_read_);
+        client_write_.merge(other.client_write_);
+        final_client_popularity_.merge(other.final_client_popularity_);
+        switched_.merge(other.switched_);
+        stayed_.merge(other.stayed_);
+
+        time_.merge(other.time_);
+        read_time_.merge(other.read_time_);
+        write_time_.merge(other.write_time_);
+    }
+
+    void
+    print(char const *const trace_path, CacheTraceFormat const format) const
+    {
+        std::cout << "# Trace Analysis for " << trace_path << " ("
+                  << CacheTraceFormat__string(format) << "'s format)"
+                  << std::endl;
+        if (passes_ & ANALYSIS_PASS_TRACE) {
+            print_trace();
+        }
+        if (passes_ & ANALYSIS_PASS_TTLS) {
+            std::cout << "## TTLs of All Accesses [ms]" << std::endl;
+            std::cout << ttls_.csv();
+        }
+        if (passes_ & ANALYSIS_PASS_RW) {
+            print_rw();
+        }
+        if (passes_ & ANALYSIS_PASS_CLIENTS) {
+            print_clients();
+        }
+        if (passes_ & ANALYSIS_PASS_TIME) {
+            std::cout << "## Time Between Accesses [ms]" << std::endl;
+            std::cout << time_.csv();
+            std::cout << "## Time Between Reads [ms]" << std::endl;
+            std::cout << read_time_.csv();
+            std::cout << "## Time Between Writes [ms]" << std::endl;
+            std::cout << write_time_.csv();
+        }
+    }
+
+    uint64_t nr_accesses_ = 0;
+
+private:
+    /// @brief  Record the time since the previous access (of any kind),
+    ///         the previous read, and the previous write to the key.
+    void
+    access_time(KeyState const &s, CacheAccess const &x)
+    {
+        tm_t const get = s.stats.latest_get_time_ms;
+        tm_t const set = s.stats.latest_set_time_ms;
+        tm_t const any = !valid_time(get)   ? set
+                         : !valid_time(set) ? get
+                                            : std::max(get, set);
+        time_.update(valid_time(any) ? (double)x.timestamp_ms - any
+                                     : INFINITY);
+        if (x.is_read()) {
+            read_time_.update(valid_time(get) ? (double)x.timestamp_ms - get
+                                              : INFINITY);
+        } else {
+            write_time_.update(valid_time(set) ? (double)x.timestamp_ms - set
+                                               : INFINITY);
+        }
+    }
+
+    /// @note   This matches analyze_trace.cpp.
+    void
+    access_trace(KeyState const &s, CacheAccess const &x)
+    {
+        if (x.is_read()) {
+            cnt_gets_ += 1;
+            return;
+        }
+        ttl_hist_.update(x.ttl_ms);
+        // Analyze whether the TTL has changed before we update the
+        // object with the new TTL.
+        if (valid_time(s.stats.current_ttl_ms)) {
+            double const old_ttl = s.stats.current_ttl_ms;
+            double const new_ttl = x.ttl_ms;
+            ttl_diff_hist_.update((double)old_ttl - new_ttl);
+        }
+        cnt_sets_ += 1;
+    }
+
+    /// @note   This matches analyze_rw.cpp.
+    static void
+    access_rw(KeyState &s, CacheAccess const &x)
+    {
+        if (x.is_read()) {
+            s.read = 1;
+            if (x.value_size_b == 0) {
+                s.read_miss_without_write = 1;
+            }
+        } else if (x.is_write()) {
+            // Since there was a write, reset the read-miss-without-write bit.
+            s.read_miss_without_write = 0;
+            s.write = 1;
+            if (s.read == 0) {
+                s.write_before_read = 1;
+            }
+        }
+    }
+
+    /// @note   This matches analyze_clients.cpp.
+    void
+    access_clients(KeyState &s, CacheAccess const &x)
+    {
+        if (s.client_id == UINT16_MAX) {
+            s.client_id = x.client_id;
+        } else if (s.client_id != x.client_id) {
+            s.client_id = x.client_id;
+            saturation_iincr(s.switched_clients);
+        } else {
+            saturation_iincr(s.remained_with_client);
+        }
+
+        if (x.is_read()) {
+            client_read_.update(x.client_id);
+        } else if (x.is_write()) {
+            client_write_.update(x.client_id);
+        }
+    }
+
+    void
+    print_trace() const
+    {
+        std::cout << "## Commands" << std::endl;
+        std::cout << "Number of SETs: "
+                  << prettify_number(cnt_sets_, nr_accesses_) << std::endl;
+        std::cout << "Number of GETs: "
+                  << prettify_number(cnt_gets_, nr_accesses_) << std::endl;
+
+        std::cout << "## TTLs" << std::endl;
+        std::cout << "TTL Histogram [ms]: " << std::endl;
+        std::cout << ttl_hist_.csv();
+        std::cout << "Changes in TTLs Histogram [ms]: " << std::endl;
+        std::cout << ttl_diff_hist_.csv();
+        std::cout << "---" << std::endl;
+        key_summary_.print_per_key();
+        std::cout << "---" << std::endl;
+        key_summary_.print_per_access(nr_accesses_, cnt_sets_);
+    }
+
+    void
+    print_rw() const
+    {
+        std::cout << "## Reads and Writes" << std::endl;
+        std::cout << "Total Keys: " << nr_keys_ << std::endl;
+        std::cout << "Read-only Keys: " << read_only_ << std::endl;
+        std::cout << "Write-only Keys: " << write_only_ << std::endl;
+        std::cout << "Read-Write Keys: " << rw_ << std::endl;
+        std::cout << "Read-Miss without Write Keys: "
+                  << read_miss_without_write_ << std::endl;
+        std::cout << "Writes Before Read Keys: " << write_before_read_
+                  << std::endl;
+    }
+
+    void
+    print_clients() const
+    {
+        std::cout << "## Clients" << std::endl;
+        std::cout << "Final Client Popularity" << std::endl;
+        std::cout << final_client_popularity_.csv();
+        std::cout << "Stayed with Client" << std::endl;
+        std::cout << stayed_.csv();
+        std::cout << "Switched Client" << std::endl;
+        std::cout << switched_.csv();
+        std::cout << "Reads per Client" << std::endl;
+        std::cout << client_read_.csv();
+        std::cout << "Writes per client" << std::endl;
+        std::cout << client_write_.csv();
+    }
+
+    unsigned const passes_;
+#if BOOST_VERSION >= 108300
+    boost::unordered::unordered_flat_map<uint64_t, KeyState> table_;
+#else
+    std::unordered_map<uint64_t, KeyState> table_;
+#endif
+    uint64_t nr_keys_ = 0;
+
+    // The 'trace' pass.
+    uint64_t cnt_gets_ = 0, cnt_sets_ = 0;
+    Histogram ttl_hist_, ttl_diff_hist_;
+    KeyStatisticsSummary key_summary_;
+
+    // The 'ttls' pass.
+    Histogram ttls_;
+
+    // The 'rw' pass.
+    uint64_t read_only_ = 0, write_only_ = 0, rw_ = 0,
+             read_miss_without_write_ = 0, write_before_read_ = 0;
+
+    // The 'clients' pass.
+    Histogram client_read_, client_write_;
+    Histogram switched_, stayed_, final_client_popularity_;
+
+    // The 'time' pass.
+    Histogram time_, read_time_, write_time_;
+};
+
+/// @brief  The indices of one slice's accesses, by partition.
+using Buckets = std::vector<std::vector<size_t>>;
+
+/// @brief  Split a slice of the trace among the partitions.
+/// @note   Each thread scans a disjoint slice, so together they read the
+///         trace and hash each key only once.
+static void
+split_slice(CacheAccessTrace const &trace,
+            Buckets &buckets,
+            uint64_t const id,
+            uint64_t const nthreads)
+{
+    size_t const begin = trace.size() * id / nthreads;
+    size_t const end = trace.size() * (id + 1) / nthreads;
+    buckets.assign(nthreads, {});
+    for (auto &b : buckets) {
+        // NOTE The partitions are about equal, so we rarely need to grow.
+        b.reserve((end - begin) / nthreads + (end - begin) / nthreads / 8);
+    }
+    for (size_t i = begin; i < end; ++i) {
+        buckets[splitmix64_hash(trace.get(i).key) % nthreads].push_back(i);
+    }
+}
+
+static void
+run_partition(CacheAccessTrace const &trace,
+              std::vector<Buckets> const &slices,
+              Partition &partition,
+              uint64_t const id,
+              std::shared_ptr<std::ostream> progress_strm)
+{
+    size_t size = 0;
+    for (auto const &buckets : slices) {
+        size += buckets[id].size();
+    }
+    // NOTE Only the first thread shows its progress.
+    ProgressBar pbar{size, id == 0 ? progress_strm : nullptr};
+    // NOTE We process the slices in order, so that the partition sees its
+    //      accesses in trace order.
+    for (auto const &buckets : slices) {
+        for (size_t const i : buckets[id]) {
+            pbar.tick();
+            partition.access(trace.get(i));
+            partition.nr_accesses_ += 1;
+        }
+    }
+    partition.summarize();
+}
+
+static void
+analyze_all(char const *const trace_path,
+            CacheTraceFormat const format,
+            unsigned const passes,
+            uint64_t const nthreads,
+            std::shared_ptr<std::ostream> progress_strm)
+{
+    CacheAccessTrace const trace{trace_path, format};
+    std::vector<Buckets> slices(nthreads);
+    std::vector<Partition> partitions(nthreads, Partition{passes});
+    std::vector<std::thread> workers;
+    // NOTE We split the trace up front, rather than have each thread scan
+    //      the whole trace for its own keys, so that the threads divide
+    //      the work rather than repeat it.
+    for (uint64_t id = 0; id < nthreads; ++id) {
+        workers.emplace_back(split_slice,
+                             std::cref(trace),
+                             std::ref(slices[id]),
+                             id,
+                             nthreads);
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    workers.clear();
+    for (uint64_t id = 0; id < nthreads; ++id) {
+        workers.emplace_back(run_partition,
+                             std::cref(trace),
+                             std::cref(slices),
+                             std::ref(partitions[id]),
+                             id,
+                             progress_strm);
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    for (uint64_t id = 1; id < nthreads; ++id) {
+        partitions[0].merge(partitions[id]);
+    }
+    assert(partitions[0].nr_accesses_ == trace.size());
+    partitions[0].print(trace_path, format);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 6) {
+        std::cout << "Usage: " << argv[0]
+                  << " <trace-path> <format> "
+                     "<passes: comma-separated {all,trace,ttls,rw,clients,"
+                     "time}> [<nthreads>=#cores] [<progress-stream>=nullptr]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    char const *const trace_path = argv[1];
+    CacheTraceFormat format = CacheTraceFormat__parse(argv[2]);
+    unsigned const passes = parse_passes(argv[3]);
+    // NOTE The hardware concurrency may be 0 if it is unknown.
+    uint64_t const nthreads =
+        (argc >= 5) ? std::strtoull(argv[4], nullptr, 10)
+                    : std::max(1u, std::thread::hardware_concurrency());
+    std::shared_ptr<std::ostream> const progress_strm =
+        (argc == 6) ? str2stream(argv[5]) : nullptr;
+    if (!CacheTraceFormat__valid(format) || passes == 0 || nthreads == 0) {
+        LOGGER_ERROR("invalid arguments");
+        return EXIT_FAILURE;
+    }
+    analyze_all(trace_path, format, passes, nthreads, progress_strm);
+    return 0;
+}
@@ -7,6 +7,7 @@
  *  An idea I would like to explore is whether we can find the number of unique
  *  accesses within an interval based only on the stream of stack distances.
  */
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -47,6 +48,9 @@ struct CommandLineArguments {
     double fr_shards_sampling_rate;
     double fs_shards_sampling_rate;
 
+    // Number of items per compressed block, or 0 for the raw format.
+    gint64 block_length;
+
     gboolean cleanup;
 };
 
@@ -69,6 +73,9 @@ parse_command_line_arguments(struct CommandLineArguments *const args,
     double const DEFAULT_FIXED_RATE_SHARDS_SAMPLING_RATE = 1e-3;
     double const DEFAULT_FIXED_SIZE_SHARDS_SAMPLING_RATE = 1e-1;
 
+    gint64 const DEFAULT_BLOCK_LENGTH =
+        INTERVAL_STATISTICS_DEFAULT_BLOCK_LENGTH;
+
     bool const DEFAULT_CLEANUP_MODE = FALSE;
 
     *args = (struct CommandLineArguments){
@@ -82,6 +89,7 @@ parse_command_line_arguments(struct CommandLineArguments *const args,
         .emap_output_path = DEFAULT_EVICTING_MAP_OUTPUT_PATH,
         .fr_shards_sampling_rate = DEFAULT_FIXED_RATE_SHARDS_SAMPLING_RATE,
         .fs_shards_sampling_rate = DEFAULT_FIXED_SIZE_SHARDS_SAMPLING_RATE,
+        .block_length = DEFAULT_BLOCK_LENGTH,
         .cleanup = DEFAULT_CLEANUP_MODE,
     };
 
@@ -158,6 +166,15 @@ parse_command_line_arguments(struct CommandLineArguments *const args,
          &args->fs_shards_sampling_rate,
          "fixed-size SHARDS sampling rate. Default: 1e-1.",
          "<fixed-size-shards-sampling-rate>"},
+        {"block-length",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &args->block_length,
+         "number of items per compressed block that we stream to the "
+         "output, or 0 to buffer everything and write the raw format. "
+         "Default: 65536.",
+         "<block-length>"},
         {"cleanup",
          0,
          0,
@@ -196,6 +213,10 @@ parse_command_line_arguments(struct CommandLineArguments *const args,
                     args->run_uniform,
                     args->run_zipfian);
     }
+    if (args->block_length < 0) {
+        LOGGER_ERROR("negative block length %" PRId64, args->block_length);
+        is_error = true;
+    }
     if (trace_format_str != NULL &&
         !parse_trace_format_string(trace_format_str)) {
         LOGGER_ERROR("invalid trace format '%s'", trace_format_str);
@@ -212,16 +233,36 @@ parse_command_line_arguments(struct CommandLineArguments *const args,
     return true;
 }
 
+/// @brief  Stream the statistics to the output path in constant memory
+///         rather than buffering them until the end.
+static bool
+stream_interval_statistics(struct IntervalStatistics *const istats,
+                           char const *const output_path,
+                           struct CommandLineArguments const *const args)
+{
+    if (args->block_length == 0) {
+        return true;
+    }
+    if (!IntervalStatistics__stream_to(istats,
+                                       output_path,
+                                       args->block_length)) {
+        LOGGER_ERROR("failed to stream to '%s'", output_path);
+        return false;
+    }
+    return true;
+}
+
 /// @param  cleanup: bool
 ///         immediately remove the file we just created. Alternatively,
 ///         I could just not save it in the first place, but I want to
 ///         test everything.
 static void
-save_interval_statistics(struct IntervalStatistics const *const istats,
+save_interval_statistics(struct IntervalStatistics *const istats,
                          char const *const output_path,
                          bool const cleanup)
 {
-    LOGGER_TRACE("begin writing buffer with length %zu", istats->length);
+    LOGGER_TRACE("begin writing buffer with length %zu",
+                 IntervalStatistics__num_items(istats));
     if (!IntervalStatistics__save(istats, output_path)) {
         LOGGER_ERROR("failed to write results to '%s'", output_path);
     }
@@ -251,6 +292,10 @@ generate_olken_reuse_stats(struct Trace *trace,
         LOGGER_ERROR("bad initialization");
         return false;
     }
+    if (!stream_interval_statistics(&me.stats, args->output_path, args)) {
+        IntervalOlken__destroy(&me);
+        return false;
+    }
 
     LOGGER_TRACE("begin processing trace with length %zu", trace->length);
     for (size_t i = 0; i < trace->length; ++i) {
@@ -286,6 +331,10 @@ generate_emap_reuse_stats(struct Trace *trace,
         LOGGER_ERROR("bad initialization");
         return false;
     }
+    if (!stream_interval_statistics(&me.istats, args->emap_output_path, args)) {
+        EvictingMap__destroy(&me);
+        return false;
+    }
 
     LOGGER_TRACE("begin processing trace with length %zu", trace->length);
     for (size_t i = 0; i < trace->length; ++i) {
@@ -323,6 +372,12 @@ generate_fr_shards_reuse_stats(struct Trace *trace,
         LOGGER_ERROR("bad initialization");
         return false;
     }
+    if (!stream_interval_statistics(&me.istats,
+                                    args->fr_shards_output_path,
+                                    args)) {
+        FixedRateShards__destroy(&me);
+        return false;
+    }
 
     LOGGER_TRACE("begin processing trace with length %zu", trace->length);
     for (size_t i = 0; i < trace->length; ++i) {
@@ -362,6 +417,12 @@ generate_fs_shards_reuse_stats(struct Trace *trace,
         LOGGER_ERROR("bad initialization");
         return false;
     }
+    if (!stream_interval_statistics(&me.istats,
+                                    args->fs_shards_output_path,
+                                    args)) {
+        FixedSizeShards__destroy(&me);
+        return false;
+    }
 
     LOGGER_TRACE("begin processing trace with length %zu", trace->length);
     for (size_t i = 0; i < trace->length; ++i) {
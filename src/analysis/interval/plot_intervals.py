@@ -11,6 +11,75 @@ from matplotlib.axes import Axes
 from tqdm import tqdm
 
 DTYPE = np.dtype([("reuse_dist", np.float64), ("reuse_time", np.float64)])
+# NOTE  This matches the format of the streaming IntervalStatistics writer.
+COMPRESSED_MAGIC = b"ISTATVZ1"
+BLOCK_HEADER_DTYPE = np.dtype(
+    [("length", "<u8"), ("num_varint_bytes", "<u8"), ("num_raw", "<u8")]
+)
+FIELD_TAG_INTEGER, FIELD_TAG_NAN, FIELD_TAG_INFINITY, FIELD_TAG_RAW = range(4)
+
+
+def decode_varints(data: np.ndarray) -> np.ndarray:
+    """Decode a buffer of LEB128 varints into an array of uint64."""
+    ends = np.flatnonzero(data < 0x80)
+    starts = np.concatenate(([0], ends[:-1] + 1))
+    lengths = ends - starts + 1
+    group = np.repeat(np.arange(len(ends)), lengths)
+    shift = 7 * (np.arange(len(data)) - np.repeat(starts, lengths))
+    parts = (data[: len(group)] & 0x7F).astype(np.uint64) << shift.astype(
+        np.uint64
+    )
+    values = np.zeros(len(ends), dtype=np.uint64)
+    np.bitwise_or.at(values, group, parts)
+    return values
+
+
+def decode_field(codes: np.ndarray, raw: np.ndarray, raw_index: np.ndarray):
+    """Decode one field (i.e. reuse distance or time) of a block."""
+    tags = codes & np.uint64(3)
+    zigzag = codes >> np.uint64(2)
+    deltas = (zigzag >> np.uint64(1)) ^ (-(zigzag & np.uint64(1)))
+    is_int = tags == FIELD_TAG_INTEGER
+    values = np.empty(len(codes), dtype=np.float64)
+    # NOTE  The deltas wrap around as unsigned integers, like in C.
+    values[is_int] = np.cumsum(deltas[is_int], dtype=np.uint64)
+    values[tags == FIELD_TAG_NAN] = np.nan
+    values[tags == FIELD_TAG_INFINITY] = np.inf
+    values[tags == FIELD_TAG_RAW] = raw[raw_index[tags == FIELD_TAG_RAW]]
+    return values
+
+
+def read_compressed_blocks(f) -> np.ndarray:
+    """Read the blocks that follow the compressed file's header."""
+    _block_length = np.fromfile(f, dtype="<u8", count=1)
+    blocks = []
+    while True:
+        header = np.fromfile(f, dtype=BLOCK_HEADER_DTYPE, count=1)
+        if len(header) == 0:
+            break
+        length, num_varint_bytes, num_raw = (int(x) for x in header[0])
+        varints = np.fromfile(f, dtype=np.uint8, count=num_varint_bytes)
+        raw = np.fromfile(f, dtype="<f8", count=num_raw)
+        codes = decode_varints(varints)
+        assert len(codes) == 2 * length, "corrupt block"
+        # NOTE  The raw doubles are in the order of the interleaved fields.
+        is_raw = (codes & np.uint64(3)) == FIELD_TAG_RAW
+        raw_index = np.cumsum(is_raw) - 1
+        block = np.empty(length, dtype=DTYPE)
+        block["reuse_dist"] = decode_field(codes[0::2], raw, raw_index[0::2])
+        block["reuse_time"] = decode_field(codes[1::2], raw, raw_index[1::2])
+        blocks.append(block)
+    if not blocks:
+        return np.empty(0, dtype=DTYPE)
+    return np.concatenate(blocks)
+
+
+def read_interval_statistics(path: str) -> np.ndarray:
+    """Read either the raw or the compressed interval statistics."""
+    with open(path, "rb") as f:
+        if f.read(len(COMPRESSED_MAGIC)) == COMPRESSED_MAGIC:
+            return read_compressed_blocks(f)
+    return np.fromfile(path, dtype=DTYPE)
 
 
 def divide_array(array: np.ndarray, subdivisions: int):
@@ -224,7 +293,7 @@ def main():
     arrays = []
     for input_file in args.input_files:
         print(f"Processing {input_file} file")
-        x = np.fromfile(input_file, dtype=DTYPE)
+        x = read_interval_statistics(input_file)
         x = divide_array(x, args.num_intervals)
         x = choose_selective_intervals(x, args.head)
         print_statistics(x)
@@ -0,0 +1,344 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "access_ring/access_ring.h"
+#include "logger/logger.h"
+#include "trace/trace.h"
+
+#define CACHE_LINE_SIZE 64
+#define POLL_PERIOD_MS  1
+
+// NOTE The atomics must not use a lock, since the lock would be private
+//      to each process.
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "need lock-free 64-bit atomics");
+
+struct AccessRingShared {
+    // We set the magic number last, so that the consumer knows when
+    // the remaining metadata is valid.
+    _Atomic uint64_t magic;
+    uint64_t record_size;
+    uint64_t capacity;
+    _Atomic uint64_t consumer_attached;
+    _Atomic uint64_t closed;
+    _Atomic uint64_t num_dropped;
+    // Written by the producer.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;
+    // Written by the consumer.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;
+    _Alignas(CACHE_LINE_SIZE) struct FullTraceItem records[];
+};
+
+static void
+sleep_ms(uint64_t const ms)
+{
+    struct timespec const ts = {.tv_sec = ms / 1000,
+                                .tv_nsec = ms % 1000 * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+static size_t
+get_num_bytes(uint64_t const capacity)
+{
+    return sizeof(struct AccessRingShared) +
+           capacity * sizeof(struct FullTraceItem);
+}
+
+bool
+AccessRingProducer__init(struct AccessRingProducer *const me,
+                         char const *const name,
+                         size_t const capacity)
+{
+    if (me == NULL || name == NULL || capacity == 0) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    uint64_t rounded_capacity = 1;
+    while (rounded_capacity < capacity) {
+        rounded_capacity <<= 1;
+    }
+    *me = (struct AccessRingProducer){
+        .name = strdup(name),
+        .num_bytes = get_num_bytes(rounded_capacity),
+    };
+    if (me->name == NULL) {
+        LOGGER_ERROR("failed to copy the name");
+        return false;
+    }
+    // NOTE We replace an existing ring rather than join it, since its
+    //      producer may still be writing to it.
+    shm_unlink(name);
+    int const fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        LOGGER_ERROR("failed to create '%s': %s", name, strerror(errno));
+        goto cleanup;
+    }
+    if (ftruncate(fd, me->num_bytes) != 0) {
+        LOGGER_ERROR("failed to size '%s': %s", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        goto cleanup;
+    }
+    void *const buffer =
+        mmap(NULL, me->num_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (buffer == MAP_FAILED) {
+        LOGGER_ERROR("failed to map '%s': %s", name, strerror(errno));
+        shm_unlink(name);
+        goto cleanup;
+    }
+    // NOTE The new object is zeroed, so we only set the non-zero fields.
+    me->shared = buffer;
+    me->shared->record_size = sizeof(struct FullTraceItem);
+    me->shared->capacity = rounded_capacity;
+    atomic_store_explicit(&me->shared->magic,
+                          ACCESS_RING_MAGIC,
+                          memory_order_release);
+    return true;
+cleanup:
+    free(me->name);
+    *me = (struct AccessRingProducer){0};
+    return false;
+}
+
+bool
+AccessRingProducer__wait_for_consumer(struct AccessRingProducer *const me,
+                                      uint64_t const timeout_ms)
+{
+    if (me == NULL || me->shared == NULL) {
+        return false;
+    }
+    for (uint64_t waited_ms = 0; timeout_ms == 0 || waited_ms < timeout_ms;
+         waited_ms += POLL_PERIOD_MS) {
+        if (atomic_load_explicit(&me->shared->consumer_attached,
+                                 memory_order_acquire)) {
+            return true;
+        }
+        sleep_ms(POLL_PERIOD_MS);
+    }
+    return false;
+}
+
+/// @brief  Get the number of free slots, waiting for at least one
+///         unless 'drop_when_full'.
+static uint64_t
+get_free_space(struct AccessRingProducer *const me, uint64_t const head)
+{
+    struct AccessRingShared *const shared = me->shared;
+    uint64_t free_space = shared->capacity - (head - me->cached_tail);
+    while (free_space == 0) {
+        me->cached_tail =
+            atomic_load_explicit(&shared->tail, memory_order_acquire);
+        free_space = shared->capacity - (head - me->cached_tail);
+        if (free_space != 0 || me->drop_when_full) {
+            break;
+        }
+        sched_yield();
+    }
+    return free_space;
+}
+
+size_t
+AccessRingProducer__push_batch(struct AccessRingProducer *const me,
+                               struct FullTraceItem const *const items,
+                               size_t const nmemb)
+{
+    if (me == NULL || me->shared == NULL || items == NULL) {
+        return 0;
+    }
+    struct AccessRingShared *const shared = me->shared;
+    uint64_t const mask = shared->capacity - 1;
+    uint64_t head = atomic_load_explicit(&shared->head, memory_order_relaxed);
+    size_t i = 0;
+    while (i < nmemb) {
+        uint64_t const free_space = get_free_space(me, head);
+        if (free_space == 0) {
+            atomic_fetch_add_explicit(&shared->num_dropped,
+                                      nmemb - i,
+                                      memory_order_relaxed);
+            break;
+        }
+        uint64_t const n =
+            nmemb - i < free_space ? nmemb - i : free_space;
+        for (uint64_t j = 0; j < n; ++j) {
+            shared->records[(head + j) & mask] = items[i + j];
+        }
+        head += n;
+        i += n;
+        // NOTE We publish once per chunk rather than once per record,
+        //      so that the consumer's cache line bounces less.
+        atomic_store_explicit(&shared->head, head, memory_order_release);
+    }
+    return i;
+}
+
+bool
+AccessRingProducer__push(struct AccessRingProducer *const me,
+                         struct FullTraceItem const *const item)
+{
+    return AccessRingProducer__push_batch(me, item, 1) == 1;
+}
+
+void
+AccessRingProducer__destroy(struct AccessRingProducer *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->shared != NULL) {
+        atomic_store_explicit(&me->shared->closed, 1, memory_order_release);
+        munmap(me->shared, me->num_bytes);
+    }
+    if (me->name != NULL) {
+        shm_unlink(me->name);
+        free(me->name);
+    }
+    *me = (struct AccessRingProducer){0};
+}
+
+/// @brief  Try to map the ring once.
+/// @return false if the producer has not (finished) creating it yet.
+static bool
+try_attach(struct AccessRingConsumer *const me, char const *const name)
+{
+    struct stat st = {0};
+    int const fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < sizeof(struct AccessRingShared)) {
+        close(fd);
+        return false;
+    }
+    void *const buffer =
+        mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (buffer == MAP_FAILED) {
+        return false;
+    }
+    struct AccessRingShared *const shared = buffer;
+    if (atomic_load_explicit(&shared->magic, memory_order_acquire) !=
+        ACCESS_RING_MAGIC) {
+        munmap(buffer, st.st_size);
+        return false;
+    }
+    *me = (struct AccessRingConsumer){.shared = shared,
+                                      .num_bytes = st.st_size};
+    return true;
+}
+
+bool
+AccessRingConsumer__init(struct AccessRingConsumer *const me,
+                         char const *const name,
+                         uint64_t const timeout_ms)
+{
+    if (me == NULL || name == NULL) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    *me = (struct AccessRingConsumer){0};
+    for (uint64_t waited_ms = 0; !try_attach(me, name);
+         waited_ms += POLL_PERIOD_MS) {
+        if (waited_ms >= timeout_ms) {
+            LOGGER_ERROR("no ring named '%s'", name);
+            return false;
+        }
+        sleep_ms(POLL_PERIOD_MS);
+    }
+    struct AccessRingShared *const shared = me->shared;
+    if (shared->record_size != sizeof(struct FullTraceItem) ||
+        shared->capacity == 0 ||
+        (shared->capacity & (shared->capacity - 1)) != 0 ||
+        me->num_bytes < get_num_bytes(shared->capacity)) {
+        LOGGER_ERROR("ring '%s' has an incompatible layout (record size: "
+                     "%" PRIu64 ", capacity: %" PRIu64 ")",
+                     name,
+                     shared->record_size,
+                     shared->capacity);
+        munmap(me->shared, me->num_bytes);
+        *me = (struct AccessRingConsumer){0};
+        return false;
+    }
+    if (atomic_exchange(&shared->consumer_attached, 1) != 0) {
+        LOGGER_ERROR("ring '%s' already has a consumer", name);
+        munmap(me->shared, me->num_bytes);
+        *me = (struct AccessRingConsumer){0};
+        return false;
+    }
+    return true;
+}
+
+size_t
+AccessRingConsumer__read(struct AccessRingConsumer *const me,
+                         struct FullTraceItem *const items,
+                         size_t const nmemb)
+{
+    if (me == NULL || me->shared == NULL || items == NULL) {
+        return 0;
+    }
+    struct AccessRingShared *const shared = me->shared;
+    uint64_t const mask = shared->capacity - 1;
+    uint64_t const tail =
+        atomic_load_explicit(&shared->tail, memory_order_relaxed);
+    uint64_t const head =
+        atomic_load_explicit(&shared->head, memory_order_acquire);
+    uint64_t const n = head - tail < nmemb ? head - tail : nmemb;
+    for (uint64_t i = 0; i < n; ++i) {
+        items[i] = shared->records[(tail + i) & mask];
+    }
+    // NOTE The release lets the producer overwrite these slots only
+    //      after we have copied them.
+    atomic_store_explicit(&shared->tail, tail + n, memory_order_release);
+    return n;
+}
+
+bool
+AccessRingConsumer__is_done(struct AccessRingConsumer const *const me)
+{
+    if (me == NULL || me->shared == NULL) {
+        return true;
+    }
+    struct AccessRingShared *const shared = me->shared;
+    // NOTE We must check 'closed' before the head, otherwise we could
+    //      miss the records that were pushed between the two loads.
+    return atomic_load_explicit(&shared->closed, memory_order_acquire) &&
+           atomic_load_explicit(&shared->head, memory_order_acquire) ==
+               atomic_load_explicit(&shared->tail, memory_order_relaxed);
+}
+
+uint64_t
+AccessRingConsumer__num_dropped(struct AccessRingConsumer const *const me)
+{
+    if (me == NULL || me->shared == NULL) {
+        return 0;
+    }
+    return atomic_load_explicit(&me->shared->num_dropped,
+                                memory_order_relaxed);
+}
+
+void
+AccessRingConsumer__destroy(struct AccessRingConsumer *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->shared != NULL) {
+        atomic_store_explicit(&me->shared->consumer_attached,
+                              0,
+                              memory_order_release);
+        munmap(me->shared, me->num_bytes);
+    }
+    *me = (struct AccessRingConsumer){0};
+}
@@ -0,0 +1,123 @@
+/** @brief  A ring of accesses in POSIX shared memory.
+ *
+ *  A single producer process (e.g. a cache proxy) writes fixed-size
+ *  access records that a single consumer process (e.g. the MRC daemon)
+ *  reads. The producer creates the shared memory object and removes its
+ *  name when it closes the ring; a consumer that has already attached
+ *  keeps its mapping and drains the remaining records.
+ *
+ *  Producer:
+ *      struct AccessRingProducer p = {0};
+ *      AccessRingProducer__init(&p, "/online_mrc", 1 << 20);
+ *      AccessRingProducer__push(&p, &(struct FullTraceItem){.key = 1});
+ *      AccessRingProducer__destroy(&p);
+ *
+ *  Consumer:
+ *      struct AccessRingConsumer c = {0};
+ *      AccessRingConsumer__init(&c, "/online_mrc", 0);
+ *      n = AccessRingConsumer__read(&c, items, ARRAY_SIZE(items));
+ *      AccessRingConsumer__destroy(&c);
+ *
+ *  @note   The records are 'struct FullTraceItem' in the host's layout,
+ *          so both processes must run on the same machine with the same
+ *          build of this header. We check the record size on attaching.
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "trace/trace.h"
+
+// NOTE This is "ACCSRING" in little endian.
+#define ACCESS_RING_MAGIC            UINT64_C(0x474e495253434341)
+#define ACCESS_RING_DEFAULT_CAPACITY (1 << 20)
+
+/// @brief  The layout of the shared memory (defined in the source).
+struct AccessRingShared;
+
+struct AccessRingProducer {
+    char *name;
+    struct AccessRingShared *shared;
+    size_t num_bytes;
+    // A stale copy of the consumer's tail, so that we only read the
+    // consumer's cache line when the ring looks full.
+    uint64_t cached_tail;
+    // If the ring is full, drop the record rather than wait.
+    bool drop_when_full;
+};
+
+/// @brief  Create the shared ring.
+/// @param  name: the name of the shared memory object (e.g. "/foo").
+/// @param  capacity: the number of records. This is rounded up to a power
+///                   of two.
+/// @note   This replaces any existing ring of the same name.
+bool
+AccessRingProducer__init(struct AccessRingProducer *const me,
+                         char const *const name,
+                         size_t const capacity);
+
+/// @brief  Wait until a consumer attaches or the timeout expires.
+/// @param  timeout_ms: 0 means wait forever.
+/// @return true if a consumer attached.
+bool
+AccessRingProducer__wait_for_consumer(struct AccessRingProducer *const me,
+                                      uint64_t const timeout_ms);
+
+/// @brief  Append a record, waiting for space unless 'drop_when_full'.
+/// @return false if we dropped the record.
+bool
+AccessRingProducer__push(struct AccessRingProducer *const me,
+                         struct FullTraceItem const *const item);
+
+/// @brief  Append up to 'nmemb' records with a single publication.
+/// @return the number of records written (fewer than 'nmemb' only if we
+///         dropped records because the ring was full).
+size_t
+AccessRingProducer__push_batch(struct AccessRingProducer *const me,
+                               struct FullTraceItem const *const items,
+                               size_t const nmemb);
+
+/// @brief  Tell the consumer that no more records will come and remove
+///         the ring's name.
+void
+AccessRingProducer__destroy(struct AccessRingProducer *const me);
+
+struct AccessRingConsumer {
+    struct AccessRingShared *shared;
+    size_t num_bytes;
+};
+
+/// @brief  Attach to the ring that a producer created.
+/// @param  timeout_ms: how long to wait for the producer to create the
+///                     ring. 0 means do not wait.
+bool
+AccessRingConsumer__init(struct AccessRingConsumer *const me,
+                         char const *const name,
+                         uint64_t const timeout_ms);
+
+/// @brief  Copy out up to 'nmemb' records.
+/// @return the number of records read (possibly 0).
+size_t
+AccessRingConsumer__read(struct AccessRingConsumer *const me,
+                         struct FullTraceItem *const items,
+                         size_t const nmemb);
+
+/// @brief  Whether the producer closed the ring and we read everything.
+bool
+AccessRingConsumer__is_done(struct AccessRingConsumer const *const me);
+
+/// @brief  The number of records that the producer dropped.
+uint64_t
+AccessRingConsumer__num_dropped(struct AccessRingConsumer const *const me);
+
+void
+AccessRingConsumer__destroy(struct AccessRingConsumer *const me);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
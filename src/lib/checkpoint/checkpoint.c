@@ -0,0 +1,326 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "checkpoint/checkpoint.h"
+#include "io/io.h"
+#include "logger/logger.h"
+
+#define ALIGNMENT 8
+
+static size_t
+padding(size_t const offset)
+{
+    return (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT;
+}
+
+bool
+CheckpointWriter__init(struct CheckpointWriter *const me,
+                       char const *const path,
+                       char const *const tag,
+                       uint64_t const position)
+{
+    if (me == NULL || path == NULL || tag == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    *me = (struct CheckpointWriter){
+        .path = strdup(path),
+        .tmp_path = g_strdup_printf("%s.tmp", path),
+        .ok = true,
+    };
+    if (me->path == NULL || me->tmp_path == NULL) {
+        LOGGER_ERROR("failed to allocate the paths");
+        goto cleanup;
+    }
+    me->fp = fopen(me->tmp_path, "wb");
+    if (me->fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", me->tmp_path);
+        goto cleanup;
+    }
+    if (!CheckpointWriter__write_u64(me, CHECKPOINT_MAGIC) ||
+        !CheckpointWriter__write_array(me, tag, strlen(tag), 1) ||
+        !CheckpointWriter__write_u64(me, position)) {
+        LOGGER_ERROR("failed to write the header");
+        goto cleanup;
+    }
+    return true;
+cleanup:
+    CheckpointWriter__destroy(me);
+    return false;
+}
+
+bool
+CheckpointWriter__write(struct CheckpointWriter *const me,
+                        void const *const data,
+                        size_t const num_bytes)
+{
+    if (me == NULL || me->fp == NULL || (data == NULL && num_bytes != 0)) {
+        return false;
+    }
+    if (num_bytes != 0 && fwrite(data, 1, num_bytes, me->fp) != num_bytes) {
+        LOGGER_ERROR("failed to write %zu bytes to '%s'",
+                     num_bytes,
+                     me->tmp_path);
+        me->ok = false;
+        return false;
+    }
+    me->num_bytes += num_bytes;
+    return me->ok;
+}
+
+bool
+CheckpointWriter__write_u64(struct CheckpointWriter *const me,
+                            uint64_t const value)
+{
+    return CheckpointWriter__write(me, &value, sizeof(value));
+}
+
+bool
+CheckpointWriter__write_f64(struct CheckpointWriter *const me,
+                            double const value)
+{
+    return CheckpointWriter__write(me, &value, sizeof(value));
+}
+
+bool
+CheckpointWriter__begin_array(struct CheckpointWriter *const me,
+                              size_t const nmemb)
+{
+    static uint8_t const zeros[ALIGNMENT] = {0};
+    if (me == NULL) {
+        return false;
+    }
+    // NOTE The element count is 8 bytes, so the array remains aligned
+    //      if the count was aligned.
+    return CheckpointWriter__write(me, zeros, padding(me->num_bytes)) &&
+           CheckpointWriter__write_u64(me, nmemb);
+}
+
+bool
+CheckpointWriter__end_array(struct CheckpointWriter *const me)
+{
+    static uint8_t const zeros[ALIGNMENT] = {0};
+    if (me == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write(me, zeros, padding(me->num_bytes));
+}
+
+bool
+CheckpointWriter__write_array(struct CheckpointWriter *const me,
+                              void const *const data,
+                              size_t const nmemb,
+                              size_t const size)
+{
+    return CheckpointWriter__begin_array(me, nmemb) &&
+           CheckpointWriter__write(me, data, nmemb * size) &&
+           CheckpointWriter__end_array(me);
+}
+
+bool
+CheckpointWriter__commit(struct CheckpointWriter *const me)
+{
+    if (me == NULL || me->fp == NULL) {
+        return false;
+    }
+    uint64_t const footer_offset = me->num_bytes;
+    if (!CheckpointWriter__write_u64(me, CHECKPOINT_FOOTER_MAGIC) ||
+        !CheckpointWriter__write_u64(me, footer_offset)) {
+        LOGGER_ERROR("failed to write the footer");
+        return false;
+    }
+    // NOTE We must sync the data before the rename, otherwise a crash
+    //      could leave us with a renamed but empty file.
+    if (fflush(me->fp) != 0 || fsync(fileno(me->fp)) != 0) {
+        LOGGER_ERROR("failed to sync '%s': %s", me->tmp_path, strerror(errno));
+        me->ok = false;
+    }
+    if (fclose(me->fp) != 0) {
+        LOGGER_ERROR("failed to close '%s'", me->tmp_path);
+        me->ok = false;
+    }
+    me->fp = NULL;
+    if (!me->ok) {
+        return false;
+    }
+    if (rename(me->tmp_path, me->path) != 0) {
+        LOGGER_ERROR("failed to rename '%s' to '%s': %s",
+                     me->tmp_path,
+                     me->path,
+                     strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void
+CheckpointWriter__destroy(struct CheckpointWriter *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->fp != NULL) {
+        fclose(me->fp);
+        remove(me->tmp_path);
+    }
+    free(me->path);
+    g_free(me->tmp_path);
+    *me = (struct CheckpointWriter){0};
+}
+
+bool
+CheckpointReader__init(struct CheckpointReader *const me,
+                       char const *const path,
+                       char const *const tag)
+{
+    uint64_t magic = 0, footer_offset = 0;
+    size_t tag_length = 0;
+    if (me == NULL || path == NULL || tag == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    *me = (struct CheckpointReader){0};
+    if (!MemoryMap__init(&me->mm, path, "rb")) {
+        LOGGER_ERROR("failed to map '%s'", path);
+        return false;
+    }
+    if (me->mm.buffer == MAP_FAILED) {
+        LOGGER_ERROR("failed to map '%s'", path);
+        me->mm = (struct MemoryMap){0};
+        return false;
+    }
+    if (me->mm.num_bytes < 4 * sizeof(magic)) {
+        LOGGER_ERROR("'%s' is too short to be a checkpoint", path);
+        goto cleanup;
+    }
+    // Check the footer first, since it tells us whether the file is
+    // complete.
+    me->end = me->mm.num_bytes;
+    me->offset = me->end - 2 * sizeof(magic);
+    if (!CheckpointReader__read_u64(me, &magic) ||
+        !CheckpointReader__read_u64(me, &footer_offset) ||
+        magic != CHECKPOINT_FOOTER_MAGIC ||
+        footer_offset != me->end - 2 * sizeof(magic)) {
+        LOGGER_ERROR("'%s' is truncated or corrupt", path);
+        goto cleanup;
+    }
+    me->end = footer_offset;
+    me->offset = 0;
+    if (!CheckpointReader__read_u64(me, &magic) || magic != CHECKPOINT_MAGIC) {
+        LOGGER_ERROR("'%s' is not a checkpoint", path);
+        goto cleanup;
+    }
+    char const *const stored_tag =
+        CheckpointReader__read_array(me, &tag_length, 1);
+    if (stored_tag == NULL || tag_length != strlen(tag) ||
+        memcmp(stored_tag, tag, tag_length) != 0) {
+        LOGGER_ERROR("'%s' is not a checkpoint of '%s'", path, tag);
+        goto cleanup;
+    }
+    if (!CheckpointReader__read_u64(me, &me->position)) {
+        goto cleanup;
+    }
+    return true;
+cleanup:
+    CheckpointReader__destroy(me);
+    return false;
+}
+
+/// @brief  Get a pointer to the next 'num_bytes' and advance past them.
+static void const *
+advance(struct CheckpointReader *const me, size_t const num_bytes)
+{
+    if (num_bytes > me->end - me->offset) {
+        LOGGER_ERROR("checkpoint ended early (need %zu bytes, have %zu)",
+                     num_bytes,
+                     me->end - me->offset);
+        return NULL;
+    }
+    void const *const data = &((uint8_t const *)me->mm.buffer)[me->offset];
+    me->offset += num_bytes;
+    return data;
+}
+
+bool
+CheckpointReader__read(struct CheckpointReader *const me,
+                       void *const data,
+                       size_t const num_bytes)
+{
+    if (me == NULL || me->mm.buffer == NULL) {
+        return false;
+    }
+    void const *const src = advance(me, num_bytes);
+    if (src == NULL) {
+        return false;
+    }
+    memcpy(data, src, num_bytes);
+    return true;
+}
+
+bool
+CheckpointReader__read_u64(struct CheckpointReader *const me,
+                           uint64_t *const value)
+{
+    return CheckpointReader__read(me, value, sizeof(*value));
+}
+
+bool
+CheckpointReader__read_f64(struct CheckpointReader *const me,
+                           double *const value)
+{
+    return CheckpointReader__read(me, value, sizeof(*value));
+}
+
+void const *
+CheckpointReader__read_array(struct CheckpointReader *const me,
+                             size_t *const nmemb,
+                             size_t const size)
+{
+    uint64_t n = 0;
+    if (me == NULL || me->mm.buffer == NULL || nmemb == NULL || size == 0) {
+        return NULL;
+    }
+    if (advance(me, padding(me->offset)) == NULL ||
+        !CheckpointReader__read_u64(me, &n)) {
+        return NULL;
+    }
+    if (n > (me->end - me->offset) / size) {
+        LOGGER_ERROR("array of %" PRIu64 " elements exceeds the checkpoint",
+                     n);
+        return NULL;
+    }
+    void const *const data = advance(me, n * size);
+    if (data == NULL || advance(me, padding(me->offset)) == NULL) {
+        return NULL;
+    }
+    *nmemb = n;
+    return data;
+}
+
+bool
+CheckpointReader__is_done(struct CheckpointReader const *const me)
+{
+    return me != NULL && me->mm.buffer != NULL && me->offset == me->end;
+}
+
+void
+CheckpointReader__destroy(struct CheckpointReader *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->mm.buffer != NULL) {
+        MemoryMap__destroy(&me->mm);
+    }
+    *me = (struct CheckpointReader){0};
+}
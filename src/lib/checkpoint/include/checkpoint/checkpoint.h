@@ -0,0 +1,136 @@
+/** @brief  Save and restore the state of long-running algorithms.
+ *
+ *  A checkpoint is a flat binary file with a header (magic, a tag that
+ *  names the writer, and a user-defined position), the writer's fields
+ *  in order, and a footer (magic and total size), which lets us detect
+ *  a truncated file. We write to a temporary file and then rename it,
+ *  so a crash while checkpointing never corrupts the previous
+ *  checkpoint.
+ *
+ *  Arrays are 8-byte aligned within the file, so the reader can return
+ *  pointers straight into the memory-mapped file rather than copying.
+ *
+ *  @note   The format uses the host's byte order and is only meant to
+ *          be read back by the same build on the same machine.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "io/io.h"
+
+/// @brief  The strings "MRCCKPT1" and "MRCCKEND" in little-endian.
+#define CHECKPOINT_MAGIC        UINT64_C(0x3154504b4343524d)
+#define CHECKPOINT_FOOTER_MAGIC UINT64_C(0x444e454b4343524d)
+
+struct CheckpointWriter {
+    FILE *fp;
+    char *path;
+    char *tmp_path;
+    size_t num_bytes;
+    /// Whether every write so far has succeeded. We check this once in
+    /// the commit rather than after every field.
+    bool ok;
+};
+
+/// @param  tag: the name of the algorithm, which the reader checks.
+/// @param  position: a user-defined position (e.g. the number of
+///                   accesses processed), which the reader returns.
+bool
+CheckpointWriter__init(struct CheckpointWriter *const me,
+                       char const *const path,
+                       char const *const tag,
+                       uint64_t const position);
+
+bool
+CheckpointWriter__write(struct CheckpointWriter *const me,
+                        void const *const data,
+                        size_t const num_bytes);
+
+bool
+CheckpointWriter__write_u64(struct CheckpointWriter *const me,
+                            uint64_t const value);
+
+bool
+CheckpointWriter__write_f64(struct CheckpointWriter *const me,
+                            double const value);
+
+/// @brief  Write the number of elements and then the (aligned) array.
+bool
+CheckpointWriter__write_array(struct CheckpointWriter *const me,
+                              void const *const data,
+                              size_t const nmemb,
+                              size_t const size);
+
+/// @brief  Start an array whose 'nmemb' elements the caller streams
+///         with 'CheckpointWriter__write' (e.g. from a file).
+/// @note   The caller must write exactly 'nmemb' elements and then call
+///         'CheckpointWriter__end_array'.
+bool
+CheckpointWriter__begin_array(struct CheckpointWriter *const me,
+                              size_t const nmemb);
+
+bool
+CheckpointWriter__end_array(struct CheckpointWriter *const me);
+
+/// @brief  Write the footer, sync, and atomically replace the old file.
+bool
+CheckpointWriter__commit(struct CheckpointWriter *const me);
+
+/// @brief  Discard the temporary file if we did not commit it.
+void
+CheckpointWriter__destroy(struct CheckpointWriter *const me);
+
+struct CheckpointReader {
+    struct MemoryMap mm;
+    size_t offset;
+    /// Where the footer begins.
+    size_t end;
+    uint64_t position;
+};
+
+/// @brief  Map a checkpoint and check its header, tag, and footer.
+bool
+CheckpointReader__init(struct CheckpointReader *const me,
+                       char const *const path,
+                       char const *const tag);
+
+bool
+CheckpointReader__read(struct CheckpointReader *const me,
+                       void *const data,
+                       size_t const num_bytes);
+
+bool
+CheckpointReader__read_u64(struct CheckpointReader *const me,
+                           uint64_t *const value);
+
+bool
+CheckpointReader__read_f64(struct CheckpointReader *const me,
+                           double *const value);
+
+/// @brief  Return a pointer to the array within the memory map.
+/// @param  nmemb: the number of elements that we read.
+/// @param  size: the size of each element, which must match the writer's.
+/// @note   The pointer is valid until we destroy the reader.
+void const *
+CheckpointReader__read_array(struct CheckpointReader *const me,
+                             size_t *const nmemb,
+                             size_t const size);
+
+/// @brief  Whether we consumed every field up to the footer.
+bool
+CheckpointReader__is_done(struct CheckpointReader const *const me);
+
+void
+CheckpointReader__destroy(struct CheckpointReader *const me);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
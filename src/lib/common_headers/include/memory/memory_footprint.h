@@ -0,0 +1,41 @@
+/** @brief  A common interface for the memory footprint of data structures.
+ *
+ *  Each structure provides a 'Type__memory_usage' function that returns
+ *  the number of bytes that it owns on the heap. This excludes the struct
+ *  itself, since the caller may embed it or put it on the stack.
+ *
+ *  The structures do not track their own peak usage. Instead, the caller
+ *  samples the live usage periodically (e.g. once per chunk of accesses)
+ *  with 'MemoryFootprint__update'.
+ */
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct MemoryFootprint {
+    size_t live_bytes;
+    size_t peak_bytes;
+};
+
+static inline void
+MemoryFootprint__update(struct MemoryFootprint *const me,
+                        size_t const live_bytes)
+{
+    me->live_bytes = live_bytes;
+    if (live_bytes > me->peak_bytes) {
+        me->peak_bytes = live_bytes;
+    }
+}
+
+static inline void
+MemoryFootprint__write_as_json(FILE *const stream,
+                               struct MemoryFootprint const *const me)
+{
+    fprintf(stream,
+            "{\"live_bytes\": %zu, \"peak_bytes\": %zu}",
+            me->live_bytes,
+            me->peak_bytes);
+}
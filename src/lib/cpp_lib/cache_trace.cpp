@@ -6,10 +6,12 @@
 #include "io/io.h"
 #include "logger/logger.h"
 #include "math/is_nth_iter.h"
+#include "memory/memory_placement.h"
 
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <pthread.h>
 #include <string>
 #include <sys/mman.h>
@@ -50,10 +52,51 @@ CacheAccessTrace::CacheAccessTrace(std::string const &fname,
     if ((err = pthread_barrier_init(&barrier_, nullptr, nthreads))) {
         exit(1);
     }
+    // NOTE The replicas only speed up the reads, so we fall back to the
+    //      memory map rather than fail.
+    if (!init_replicas()) {
+        LOGGER_WARN("reading '%s' from its memory map instead",
+                    path_.c_str());
+    }
+}
+
+bool
+CacheAccessTrace::init_replicas()
+{
+    bool const per_node = memory_placement.numa == NUMA_MODE_REPLICATE;
+    if (mm_.num_bytes == 0 ||
+        (!per_node &&
+         memory_placement.huge_pages != HUGE_PAGE_MODE_HUGETLB)) {
+        return true;
+    }
+    int const num_replicas = per_node ? MemoryPlacement__get_num_nodes() : 1;
+    for (int i = 0; i < num_replicas; ++i) {
+        // NOTE The memory is bound to its node, so it does not matter
+        //      which thread copies the trace.
+        int const node = per_node ? MemoryPlacement__get_node(i) : -1;
+        void *const replica = MemoryPlacement__alloc(mm_.num_bytes, node);
+        if (replica == nullptr) {
+            LOGGER_ERROR("failed to allocate replica %d of '%s'",
+                         i,
+                         path_.c_str());
+            for (auto r : replicas_) {
+                MemoryPlacement__free(r, mm_.num_bytes);
+            }
+            replicas_.clear();
+            return false;
+        }
+        std::memcpy(replica, mm_.buffer, mm_.num_bytes);
+        replicas_.push_back(replica);
+    }
+    LOGGER_INFO("copied '%s' into %d replica(s)", path_.c_str(), num_replicas);
+    return true;
 }
 
 CacheAccessTrace::~CacheAccessTrace()
 {
+    for (auto replica : replicas_) {
+        MemoryPlacement__free(replica, mm_.num_bytes);
+    }
     MemoryMap__kdestroy(&mm_);
     pthread_barrier_destroy(&barrier_);
 }
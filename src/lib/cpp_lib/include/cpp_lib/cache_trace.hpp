@@ -3,6 +3,7 @@
 #include "cpp_lib/cache_trace_format.hpp"
 
 #include "io/io.h"
+#include "memory/memory_placement.h"
 
 #include <cassert>
 #include <cstddef>
@@ -12,13 +13,32 @@
 
 class CacheAccessTrace {
 private:
+    /// @brief  Get the calling thread's replica of the trace (or the
+    ///         memory map if we have no replicas).
+    void const *
+    buffer() const
+    {
+        if (replicas_.empty()) {
+            return mm_.buffer;
+        }
+        int const index = MemoryPlacement__get_thread_node_index();
+        return replicas_[index < 0 ? 0 : index % replicas_.size()];
+    }
+
     template <typename T>
     T const *
     get_ptr(size_t const i) const
     {
-        return &((T *)mm_.buffer)[i * bytes_per_obj_];
+        return &((T const *)buffer())[i * bytes_per_obj_];
     }
 
+    /// @brief  Copy the trace into anonymous memory if configured, either
+    ///         onto each NUMA node or into reserved huge pages.
+    /// @return false if we failed to copy the trace, in which case we
+    ///         have no replicas.
+    bool
+    init_replicas();
+
 public:
     CacheAccessTrace(std::string const &fname,
                      CacheTraceFormat const format,
@@ -66,6 +86,9 @@ private:
     struct MemoryMap const mm_ = {};
     size_t const bytes_per_obj_ = 0;
     size_t const length_ = 0;
+    // Copies of the trace indexed by the online NUMA node's index (or a
+    // single copy in reserved huge pages). Each has the memory map's size.
+    std::vector<void *> replicas_;
 
     // Synchronization
     // NOTE I use the pthread barrier because it supports a dynamic
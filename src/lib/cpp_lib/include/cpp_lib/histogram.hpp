@@ -3,6 +3,7 @@
 #include "cpp_lib/format_measurement.hpp"
 #include "cpp_lib/util.hpp"
 #include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -143,6 +144,18 @@ public:
         histogram_[b] += frq;
     }
 
+    /// @brief  Add another histogram's frequencies into this one.
+    /// @note   The histograms must have the same bucket size.
+    void
+    merge(Histogram const &other)
+    {
+        assert(bucket_size_ == other.bucket_size_);
+        for (auto [b, frq] : other.histogram_) {
+            histogram_[b] += frq;
+        }
+        total_ += other.total_;
+    }
+
     /// @brief  Get minimum bucket.
     double
     min() const
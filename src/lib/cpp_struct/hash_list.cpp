@@ -10,6 +10,7 @@
 #include <unordered_map>
 
 #include "cpp_struct/hash_list.hpp"
+#include "cpp_struct/memory_usage.hpp"
 #include "logger/logger.h"
 #include <glib.h>
 
@@ -165,6 +166,12 @@ HashList::size() const
     return map_.size();
 }
 
+uint64_t
+HashList::memory_usage() const
+{
+    return ::memory_usage(map_) + map_.size() * sizeof(ListNode);
+}
+
 bool
 HashList::contains(uint64_t const key) const
 {
@@ -149,6 +149,10 @@ public:
     ListNode *
     extract_head();
 
+    /// @brief  Get the number of bytes that this owns on the heap.
+    uint64_t
+    memory_usage() const;
+
 private:
     std::unordered_map<uint64_t, ListNode *const> map_;
     ListNode *head_ = nullptr;
@@ -0,0 +1,56 @@
+/// @brief  Estimate the number of bytes that standard containers own on the
+///         heap, for the 'memory_usage()' methods of our data structures.
+/// @note   These assume the libstdc++ layouts. Node-based containers
+///         allocate one node per element, which holds the element and
+///         some pointers (and the cached hash in the unordered containers).
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using size_t = std::size_t;
+using uint64_t = std::uint64_t;
+
+template <typename K, typename V, typename... Rest>
+uint64_t
+memory_usage(std::unordered_map<K, V, Rest...> const &map)
+{
+    size_t const node_size =
+        sizeof(std::pair<K const, V>) + sizeof(void *) + sizeof(size_t);
+    return map.size() * node_size + map.bucket_count() * sizeof(void *);
+}
+
+template <typename K, typename... Rest>
+uint64_t
+memory_usage(std::unordered_set<K, Rest...> const &set)
+{
+    size_t const node_size = sizeof(K) + sizeof(void *) + sizeof(size_t);
+    return set.size() * node_size + set.bucket_count() * sizeof(void *);
+}
+
+/// @note   A red-black tree node has a colour and three pointers.
+template <typename K, typename V, typename... Rest>
+uint64_t
+memory_usage(std::map<K, V, Rest...> const &map)
+{
+    size_t const node_size = sizeof(std::pair<K const, V>) + 4 * sizeof(void *);
+    return map.size() * node_size;
+}
+
+template <typename K, typename V, typename... Rest>
+uint64_t
+memory_usage(std::multimap<K, V, Rest...> const &map)
+{
+    size_t const node_size = sizeof(std::pair<K const, V>) + 4 * sizeof(void *);
+    return map.size() * node_size;
+}
+
+template <typename T, typename... Rest>
+uint64_t
+memory_usage(std::vector<T, Rest...> const &vec)
+{
+    return vec.capacity() * sizeof(T);
+}
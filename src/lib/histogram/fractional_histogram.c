@@ -25,6 +25,13 @@ FractionalHistogram__init(struct FractionalHistogram *me,
     if (me->histogram == NULL) {
         return false;
     }
+    me->pending = calloc(num_bins + 1, sizeof(*me->pending));
+    if (me->pending == NULL) {
+        free(me->histogram);
+        me->histogram = NULL;
+        return false;
+    }
+    me->has_pending = false;
     me->bin_size = bin_size;
     me->num_bins = num_bins;
     me->infinity = 0;
@@ -58,35 +65,28 @@ get_last_bin(const uint64_t scaled_exclusive_end, const uint64_t bin_size)
     return (scaled_exclusive_end - 1) / bin_size;
 }
 
-/// @brief  How much to fill a given bin.
-static double
-bin_portion(uint64_t bin_id,
-            uint64_t bin_size,
-            uint64_t scaled_start,
-            uint64_t scaled_exclusive_end,
-            const uint64_t scale,
-            const uint64_t range)
+/// @brief  Add 'amount' to each of the bins in [first_bin, end_bin).
+/// @note   We defer this to FractionalHistogram__materialize so that a
+///         range insertion is O(1) regardless of how many bins it spans.
+static void
+add_to_whole_bins(struct FractionalHistogram *me,
+                  const uint64_t first_bin,
+                  const uint64_t end_bin,
+                  const double amount)
 {
-    uint64_t first_bin = get_first_bin(scaled_start, bin_size);
-    uint64_t last_bin = get_last_bin(scaled_exclusive_end, bin_size);
-
-    if (bin_id < first_bin || bin_id > last_bin)
-        return 0.0;
-
-    uint64_t overlap = 0;
-    if (bin_id == first_bin && bin_id == last_bin) {
-        overlap = range;
-    } else if (bin_id == first_bin) {
-        overlap = (bin_id + 1) * bin_size - scaled_start;
-    } else if (bin_id == last_bin) {
-        overlap = scaled_exclusive_end - bin_id * bin_size;
-    } else {
-        overlap = bin_size;
+    assert(first_bin <= end_bin && end_bin <= me->num_bins);
+    if (first_bin == end_bin) {
+        return;
     }
-    return (double)scale * (double)overlap / (double)range;
+    me->pending[first_bin] += amount;
+    me->pending[end_bin] -= amount;
+    me->has_pending = true;
 }
 
 /// @brief  Update the histogram over a fully-in-range section.
+/// @note   Each unit of the range gets 'scale / range'. The first and
+///         last bins may be partially covered, so we update them
+///         directly; the bins in between are updated lazily.
 static void
 insert_full_range(struct FractionalHistogram *me,
                   const uint64_t scaled_start,
@@ -99,14 +99,19 @@ insert_full_range(struct FractionalHistogram *me,
     uint64_t first_bin = get_first_bin(scaled_start, me->bin_size);
     uint64_t last_bin = get_last_bin(scaled_exclusive_end, me->bin_size);
     assert(last_bin + 1 <= me->num_bins);
-    for (uint64_t i = first_bin; i < last_bin + 1; ++i) {
-        me->histogram[i] += bin_portion(i,
-                                        me->bin_size,
-                                        scaled_start,
-                                        scaled_exclusive_end,
-                                        scale,
-                                        range);
+    if (first_bin == last_bin) {
+        me->histogram[first_bin] += (double)scale;
+        return;
     }
+    const double density = (double)scale / (double)range;
+    me->histogram[first_bin] +=
+        density * (double)((first_bin + 1) * me->bin_size - scaled_start);
+    me->histogram[last_bin] +=
+        density * (double)(scaled_exclusive_end - last_bin * me->bin_size);
+    add_to_whole_bins(me,
+                      first_bin + 1,
+                      last_bin,
+                      density * (double)me->bin_size);
 }
 
 /// @brief  Update the histogram over a partially-in-range portion and then add
@@ -123,14 +128,13 @@ insert_partial_range(struct FractionalHistogram *me,
     uint64_t first_bin = get_first_bin(scaled_start, me->bin_size);
     uint64_t last_bin = get_last_bin(scaled_exclusive_end, me->bin_size);
     assert(last_bin + 1 >= me->num_bins);
-    for (uint64_t i = first_bin; i < me->num_bins; ++i) {
-        me->histogram[i] += bin_portion(i,
-                                        me->bin_size,
-                                        scaled_start,
-                                        scaled_exclusive_end,
-                                        scale,
-                                        range);
-    }
+    const double density = (double)scale / (double)range;
+    me->histogram[first_bin] +=
+        density * (double)((first_bin + 1) * me->bin_size - scaled_start);
+    add_to_whole_bins(me,
+                      first_bin + 1,
+                      me->num_bins,
+                      density * (double)me->bin_size);
     // NOTE I worked this out on paper. This is correct as far as I can tell. An
     //      illustrative example is me->length = 1 and scaled_exclusive_end = 5.
     //      Now, we have {1, 2, 3, 4} numbers to account for and 5-1 = 4. QED!
@@ -139,6 +143,25 @@ insert_partial_range(struct FractionalHistogram *me,
         (double)(scaled_exclusive_end - me->num_bins * me->bin_size);
 }
 
+void
+FractionalHistogram__materialize(struct FractionalHistogram *me)
+{
+    if (me == NULL || me->pending == NULL || !me->has_pending) {
+        return;
+    }
+    double owed = 0.0;
+    for (uint64_t i = 0; i < me->num_bins; ++i) {
+        owed += me->pending[i];
+        // NOTE Adding and subtracting the same amounts may leave a tiny
+        //      negative remainder where nothing is owed. A negative
+        //      bin would make the MRC non-monotonic, so we clamp it.
+        me->histogram[i] += owed > 0.0 ? owed : 0.0;
+        me->pending[i] = 0.0;
+    }
+    me->pending[me->num_bins] = 0.0;
+    me->has_pending = false;
+}
+
 bool
 FractionalHistogram__insert_scaled_finite(struct FractionalHistogram *me,
                                           const uint64_t start,
@@ -190,6 +213,7 @@ FractionalHistogram__print_as_json(struct FractionalHistogram *me)
         printf("{\"type\": \"FractionalHistogram\", \".histogram\": null}\n");
         return;
     }
+    FractionalHistogram__materialize(me);
     printf("{\"type\": \"FractionalHistogram\", \".length\": %" PRIu64
            ", \".running_sum\": %" PRIu64 ", \".bin_size\": %" PRIu64
            ", \".histogram\": {",
@@ -223,6 +247,8 @@ FractionalHistogram__exactly_equal(struct FractionalHistogram *me,
     if (me == NULL || other == NULL) {
         return false;
     }
+    FractionalHistogram__materialize(me);
+    FractionalHistogram__materialize(other);
 
     if (me->num_bins != other->num_bins || me->bin_size != other->bin_size ||
         !doubles_are_equal(me->false_infinity, other->false_infinity) ||
@@ -244,6 +270,7 @@ static bool
 debug(struct FractionalHistogram *me, bool print)
 {
     assert(me != NULL);
+    FractionalHistogram__materialize(me);
 
     double expected_sum = me->running_sum;
     double sum = 0.0;
@@ -281,6 +308,7 @@ FractionalHistogram__destroy(struct FractionalHistogram *me)
         return;
     }
     free(me->histogram);
+    free(me->pending);
     *me = (struct FractionalHistogram){0};
     return;
 }
@@ -11,11 +11,13 @@
 #include <glib.h>
 
 #include "arrays/array_size.h"
+#include "checkpoint/checkpoint.h"
 #include "histogram/histogram.h"
 #include "invariants/implies.h"
 #include "io/io.h"
 #include "logger/logger.h"
 #include "math/positive_ceiling_divide.h"
+#include "memory/memory_placement.h"
 
 bool
 HistogramOutOfBoundsMode__parse(enum HistogramOutOfBoundsMode *me,
@@ -37,7 +39,8 @@ init_histogram(struct Histogram *const me,
                uint64_t const false_infinity,
                uint64_t const infinity,
                uint64_t const running_sum,
-               enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+               enum HistogramOutOfBoundsMode const out_of_bounds_mode,
+               size_t const log_sub_bins)
 {
     assert(me != NULL);
 
@@ -46,16 +49,84 @@ init_histogram(struct Histogram *const me,
     if (me->histogram == NULL) {
         return false;
     }
+    MemoryPlacement__advise(me->histogram, num_bins * sizeof(*me->histogram));
     me->num_bins = num_bins;
     me->bin_size = bin_size;
     me->false_infinity = false_infinity;
     me->infinity = infinity;
     me->running_sum = running_sum;
     me->out_of_bounds_mode = out_of_bounds_mode;
+    me->log_sub_bins = log_sub_bins;
 
     return true;
 }
 
+static inline bool
+is_log(struct Histogram const *const me)
+{
+    return me->out_of_bounds_mode == HistogramOutOfBoundsMode__log;
+}
+
+/// @brief  Round the requested number of sub-bins up to a power of two
+///         no larger than HISTOGRAM_LOG_MAX_SUB_BINS.
+static size_t
+get_log_sub_bins(size_t const num_bins)
+{
+    size_t sub_bins = 1;
+    while (sub_bins < num_bins && sub_bins < HISTOGRAM_LOG_MAX_SUB_BINS) {
+        sub_bins *= 2;
+    }
+    return sub_bins;
+}
+
+size_t
+Histogram__log_bin_index(size_t const log_sub_bins, uint64_t const value)
+{
+    assert(log_sub_bins != 0 && (log_sub_bins & (log_sub_bins - 1)) == 0);
+    // NOTE The first two powers of two have bins of width 1, so small
+    //      reuse distances are recorded exactly.
+    if (value < 2 * log_sub_bins) {
+        return value;
+    }
+    unsigned const precision = __builtin_ctzll(log_sub_bins);
+    unsigned const shift = 63 - __builtin_clzll(value) - precision;
+    return (shift + 1) * log_sub_bins + ((value >> shift) - log_sub_bins);
+}
+
+static uint64_t
+get_log_bin_start(size_t const log_sub_bins, size_t const i)
+{
+    if (i < 2 * log_sub_bins) {
+        return i;
+    }
+    unsigned const precision = __builtin_ctzll(log_sub_bins);
+    size_t const shift = i / log_sub_bins - 1;
+    // NOTE The bin past the final one would start at 2^64.
+    if (shift + precision >= 64) {
+        return UINT64_MAX;
+    }
+    return (uint64_t)(log_sub_bins + i % log_sub_bins) << shift;
+}
+
+uint64_t
+Histogram__get_bin_start(struct Histogram const *const me, size_t const i)
+{
+    assert(me != NULL);
+    if (is_log(me)) {
+        return get_log_bin_start(me->log_sub_bins, i);
+    }
+    return i * me->bin_size;
+}
+
+static size_t
+get_bin_index(struct Histogram const *const me, uint64_t const value)
+{
+    if (is_log(me)) {
+        return Histogram__log_bin_index(me->log_sub_bins, value);
+    }
+    return value / me->bin_size;
+}
+
 bool
 Histogram__init(struct Histogram *me,
                 size_t const num_bins,
@@ -65,7 +136,36 @@ Histogram__init(struct Histogram *me,
     if (me == NULL || num_bins == 0) {
         return false;
     }
-    if (!init_histogram(me, num_bins, bin_size, 0, 0, 0, out_of_bounds_mode)) {
+    if (out_of_bounds_mode == HistogramOutOfBoundsMode__log) {
+        // NOTE We reinterpret the number of bins as the number of
+        //      sub-bins per power of two. We start with the exact bins
+        //      and grow (by at most ~1.7 MB) as we see larger values.
+        size_t const log_sub_bins = get_log_sub_bins(num_bins);
+        if (bin_size != 1) {
+            LOGGER_WARN("ignoring bin size %zu for logarithmic bins",
+                        bin_size);
+        }
+        if (!init_histogram(me,
+                            2 * log_sub_bins,
+                            1,
+                            0,
+                            0,
+                            0,
+                            out_of_bounds_mode,
+                            log_sub_bins)) {
+            LOGGER_ERROR("failed to init histogram");
+            return false;
+        }
+        return true;
+    }
+    if (!init_histogram(me,
+                        num_bins,
+                        bin_size,
+                        0,
+                        0,
+                        0,
+                        out_of_bounds_mode,
+                        0)) {
         LOGGER_ERROR("failed to init histogram");
         return false;
     }
@@ -100,10 +200,15 @@ is_initialized(struct Histogram const *const me)
     //      or something actually intelligent.
     if (me->out_of_bounds_mode != HistogramOutOfBoundsMode__allow_overflow &&
         me->out_of_bounds_mode != HistogramOutOfBoundsMode__merge_bins &&
-        me->out_of_bounds_mode != HistogramOutOfBoundsMode__realloc) {
+        me->out_of_bounds_mode != HistogramOutOfBoundsMode__realloc &&
+        me->out_of_bounds_mode != HistogramOutOfBoundsMode__log) {
         LOGGER_ERROR("invalid out of bounds mode!");
         return false;
     }
+    if (is_log(me) && me->log_sub_bins == 0) {
+        LOGGER_ERROR("number of logarithmic sub-bins is 0");
+        return false;
+    }
     return true;
 }
 
@@ -202,6 +307,8 @@ alloc_more_histogram(struct Histogram *const me,
         // NOTE If we cannot allocate
         return alloc_more_histogram(me, index, horizontal_scale, 1.0);
     }
+    MemoryPlacement__advise(new_histogram,
+                            new_num_bins * sizeof(*new_histogram));
     // Zero the indices that have not been set.
     memset(&new_histogram[me->num_bins],
            0,
@@ -211,6 +318,53 @@ alloc_more_histogram(struct Histogram *const me,
     return true;
 }
 
+/// @brief  Grow a logarithmic histogram so that it holds the bin 'index'.
+/// @note   We double the number of bins (i.e. we add as many powers of
+///         two as we already have) to amortize the reallocation. This
+///         is bounded by the number of bins needed for UINT64_MAX.
+static bool
+alloc_more_log_bins(struct Histogram *const me, size_t const index)
+{
+    assert(me && is_log(me));
+    size_t const max_num_bins =
+        Histogram__log_bin_index(me->log_sub_bins, UINT64_MAX) + 1;
+    assert(index < max_num_bins);
+    if (index < me->num_bins) {
+        return true;
+    }
+    size_t const new_num_bins = MIN(MAX(index + 1, 2 * me->num_bins),
+                                    max_num_bins);
+    uint64_t *new_histogram =
+        realloc(me->histogram, new_num_bins * sizeof(*me->histogram));
+    if (new_histogram == NULL) {
+        LOGGER_ERROR("unable to reallocate from %zu to %zu bins",
+                     me->num_bins,
+                     new_num_bins);
+        return false;
+    }
+    memset(&new_histogram[me->num_bins],
+           0,
+           (new_num_bins - me->num_bins) * sizeof(*new_histogram));
+    me->histogram = new_histogram;
+    me->num_bins = new_num_bins;
+    return true;
+}
+
+static bool
+insert_log(struct Histogram *const me,
+           uint64_t const value,
+           uint64_t const count)
+{
+    size_t const i = Histogram__log_bin_index(me->log_sub_bins, value);
+    if (!alloc_more_log_bins(me, i)) {
+        LOGGER_ERROR("stretch failed");
+        return false;
+    }
+    me->histogram[i] += count;
+    me->running_sum += count;
+    return true;
+}
+
 /// @note   I use the term 'stretch' because I want it to encompass the
 ///         'allocate' and 'merge' operations. It isn't a great term.
 static bool
@@ -250,6 +404,9 @@ Histogram__insert_scaled_finite(struct Histogram *me,
     if (!is_initialized(me)) {
         return false;
     }
+    if (is_log(me)) {
+        return insert_log(me, scale * index, scale);
+    }
     if (!stretch_histogram_if_necessary(me, index, scale)) {
         LOGGER_ERROR("stretch failed");
         return false;
@@ -267,6 +424,31 @@ Histogram__insert_scaled_finite(struct Histogram *me,
     return true;
 }
 
+bool
+Histogram__insert_weighted_finite(struct Histogram *me,
+                                  const uint64_t index,
+                                  const uint64_t weight)
+{
+    if (!is_initialized(me)) {
+        return false;
+    }
+    if (is_log(me)) {
+        return insert_log(me, index, weight);
+    }
+    if (!stretch_histogram_if_necessary(me, index, 1)) {
+        LOGGER_ERROR("stretch failed");
+        return false;
+    }
+    if (fits_in_histogram(me, index, 1)) {
+        me->histogram[index / me->bin_size] += weight;
+        me->running_sum += weight;
+    } else {
+        me->false_infinity += weight;
+        me->running_sum += weight;
+    }
+    return true;
+}
+
 bool
 Histogram__insert_infinite(struct Histogram *me)
 {
@@ -340,7 +522,7 @@ Histogram__write_as_json(FILE *const stream, struct Histogram const *const me)
             }
             fprintf(stream,
                     "\"%" PRIu64 "\": %" PRIu64 "",
-                    i * me->bin_size,
+                    Histogram__get_bin_start(me, i),
                     me->histogram[i]);
         }
     }
@@ -370,13 +552,16 @@ Histogram__exactly_equal(struct Histogram *me, struct Histogram *other)
         return false;
     }
 
-    if (me->num_bins != other->num_bins || me->bin_size != other->bin_size) {
+    if (me->num_bins != other->num_bins || me->bin_size != other->bin_size ||
+        me->log_sub_bins != other->log_sub_bins) {
         LOGGER_DEBUG("Histograms differ in metadata (.num_bins: %zu vs %zu, "
-                     ".bin_size: %zu vs %zu",
+                     ".bin_size: %zu vs %zu, .log_sub_bins: %zu vs %zu",
                      me->num_bins,
                      other->num_bins,
                      me->bin_size,
-                     other->bin_size);
+                     other->bin_size,
+                     me->log_sub_bins,
+                     other->log_sub_bins);
         return false;
     }
     if (me->false_infinity != other->false_infinity ||
@@ -490,15 +675,19 @@ Histogram__adjust_first_buckets(struct Histogram *me, int64_t const adjustment)
 
 /// @brief  Write the metadata required to recreate the histogram.
 /// @note   This must follow the same conventions as 'read_metadata'.
+/// @note   A logarithmic histogram is marked by a bin size of 0 (which
+///         is otherwise invalid) and is followed by its number of
+///         sub-bins. This keeps the format of linear histograms as-is.
 static bool
 write_metadata(FILE *fp, struct Histogram const *const me)
 {
     unsigned long r = 0;
     assert(fp != NULL && me != NULL);
+    size_t const bin_size = is_log(me) ? 0 : me->bin_size;
 
     r = fwrite(&me->num_bins, sizeof(me->num_bins), 1, fp);
     assert(r == 1);
-    r = fwrite(&me->bin_size, sizeof(me->bin_size), 1, fp);
+    r = fwrite(&bin_size, sizeof(bin_size), 1, fp);
     assert(r == 1);
     r = fwrite(&me->false_infinity, sizeof(me->false_infinity), 1, fp);
     assert(r == 1);
@@ -506,6 +695,10 @@ write_metadata(FILE *fp, struct Histogram const *const me)
     assert(r == 1);
     r = fwrite(&me->running_sum, sizeof(me->running_sum), 1, fp);
     assert(r == 1);
+    if (is_log(me)) {
+        r = fwrite(&me->log_sub_bins, sizeof(me->log_sub_bins), 1, fp);
+        assert(r == 1);
+    }
 
     return true;
 }
@@ -528,23 +721,31 @@ read_metadata(FILE *fp, struct Histogram *const me)
     assert(r == 1);
     r = fread(&me->running_sum, sizeof(me->running_sum), 1, fp);
     assert(r == 1);
+    if (me->bin_size == 0) {
+        r = fread(&me->log_sub_bins, sizeof(me->log_sub_bins), 1, fp);
+        assert(r == 1);
+        me->bin_size = 1;
+        me->out_of_bounds_mode = HistogramOutOfBoundsMode__log;
+    } else {
+        me->log_sub_bins = 0;
+        me->out_of_bounds_mode = HistogramOutOfBoundsMode__allow_overflow;
+    }
 
     return true;
 }
 
 static bool
 write_index_miss_rate_pair(FILE *fp,
-                           const uint64_t index,
-                           const uint64_t bin_size,
+                           const uint64_t scaled_idx,
                            const uint64_t frequency)
 {
     size_t n = 0;
-    uint64_t scaled_idx = index * bin_size;
 
     // We want to make sure we're writing the expected sizes out the file.
     // Otherwise, our reader will be confused. We should write out:
     // (uint64, float64)
-    assert(sizeof(index) == 8 && sizeof(frequency) == 8 && "unexpected sizes");
+    assert(sizeof(scaled_idx) == 8 && sizeof(frequency) == 8 &&
+           "unexpected sizes");
 
     n = fwrite(&scaled_idx, sizeof(scaled_idx), 1, fp);
     if (n != 1) {
@@ -570,8 +771,7 @@ write_sparse_histogram(FILE *fp, struct Histogram const *const me)
         if (me->histogram[i] == 0)
             continue;
         if (!write_index_miss_rate_pair(fp,
-                                        i,
-                                        me->bin_size,
+                                        Histogram__get_bin_start(me, i),
                                         me->histogram[i])) {
 
             LOGGER_ERROR("failed to write histogram");
@@ -602,9 +802,10 @@ read_sparse_histogram(FILE *fp, struct Histogram *const me)
         r = fread(&frequency, sizeof(frequency), 1, fp);
         assert(r);
 
-        assert(index % me->bin_size == 0);
-        assert(index / me->bin_size < me->num_bins);
-        me->histogram[index / me->bin_size] = frequency;
+        size_t const i = get_bin_index(me, index);
+        assert(Histogram__get_bin_start(me, i) == index);
+        assert(i < me->num_bins);
+        me->histogram[i] = frequency;
     }
     return true;
 }
@@ -643,6 +844,67 @@ cleanup:
     return false;
 }
 
+bool
+Histogram__save_checkpoint(struct Histogram const *const me,
+                           struct CheckpointWriter *const writer)
+{
+    if (!is_initialized(me) || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->bin_size) &&
+           CheckpointWriter__write_u64(writer, me->false_infinity) &&
+           CheckpointWriter__write_u64(writer, me->infinity) &&
+           CheckpointWriter__write_u64(writer, me->running_sum) &&
+           CheckpointWriter__write_u64(writer, me->out_of_bounds_mode) &&
+           CheckpointWriter__write_u64(writer, me->log_sub_bins) &&
+           CheckpointWriter__write_array(writer,
+                                         me->histogram,
+                                         me->num_bins,
+                                         sizeof(*me->histogram));
+}
+
+bool
+Histogram__load_checkpoint(struct Histogram *const me,
+                           struct CheckpointReader *const reader)
+{
+    uint64_t bin_size = 0, false_infinity = 0, infinity = 0, running_sum = 0;
+    uint64_t mode = 0, log_sub_bins = 0;
+    size_t num_bins = 0;
+    if (!is_initialized(me) || reader == NULL) {
+        return false;
+    }
+    if (!CheckpointReader__read_u64(reader, &bin_size) ||
+        !CheckpointReader__read_u64(reader, &false_infinity) ||
+        !CheckpointReader__read_u64(reader, &infinity) ||
+        !CheckpointReader__read_u64(reader, &running_sum) ||
+        !CheckpointReader__read_u64(reader, &mode) ||
+        !CheckpointReader__read_u64(reader, &log_sub_bins)) {
+        LOGGER_ERROR("failed to read histogram metadata");
+        return false;
+    }
+    uint64_t const *const bins =
+        CheckpointReader__read_array(reader, &num_bins, sizeof(*bins));
+    if (bins == NULL || num_bins == 0 ||
+        mode >= HistogramOutOfBoundsMode__INVALID) {
+        LOGGER_ERROR("failed to read histogram");
+        return false;
+    }
+    Histogram__destroy(me);
+    if (!init_histogram(me,
+                        num_bins,
+                        bin_size,
+                        false_infinity,
+                        infinity,
+                        running_sum,
+                        (enum HistogramOutOfBoundsMode)mode,
+                        log_sub_bins)) {
+        LOGGER_ERROR("init failed");
+        return false;
+    }
+    memcpy(me->histogram, bins, num_bins * sizeof(*bins));
+    return true;
+}
+
 /// @brief  Read the full histogram from a file.
 bool
 Histogram__load(struct Histogram *const me, char const *const path)
@@ -663,7 +925,8 @@ Histogram__load(struct Histogram *const me, char const *const path)
                         me->false_infinity,
                         me->infinity,
                         me->running_sum,
-                        false)) {
+                        me->out_of_bounds_mode,
+                        me->log_sub_bins)) {
         LOGGER_ERROR("init failed");
         goto cleanup;
     }
@@ -767,18 +1030,183 @@ Histogram__iadd(struct Histogram *const me, struct Histogram const *const other)
     assert(other != NULL);
     assert(me->histogram != NULL);
     assert(other->histogram != NULL);
-    assert(me->bin_size == other->bin_size);
-    assert(me->num_bins == other->num_bins);
+    assert(me->log_sub_bins == other->log_sub_bins);
 
-    for (size_t i = 0; i < me->num_bins; ++i) {
+    if (is_log(me)) {
+        // NOTE Logarithmic histograms grow on demand, so they may have
+        //      different lengths.
+        if (!alloc_more_log_bins(me, other->num_bins - 1)) {
+            return false;
+        }
+    } else {
+        assert(me->bin_size == other->bin_size);
+        assert(me->num_bins == other->num_bins);
+    }
+
+    for (size_t i = 0; i < other->num_bins; ++i) {
         me->histogram[i] += other->histogram[i];
     }
     me->false_infinity += other->false_infinity;
     me->infinity += other->infinity;
+    me->running_sum += other->running_sum;
 
     return true;
 }
 
+bool
+Histogram__iadd_stretched(struct Histogram *const me,
+                          struct Histogram const *const other,
+                          uint64_t const stretch)
+{
+    if (!is_initialized(me) || !is_initialized(other) || stretch == 0) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    // Find the last non-empty bin so that we don't stretch 'me' more
+    // than necessary.
+    size_t num_used_bins = other->num_bins;
+    while (num_used_bins > 0 && other->histogram[num_used_bins - 1] == 0) {
+        --num_used_bins;
+    }
+    if (num_used_bins != 0) {
+        uint64_t const max_value =
+            Histogram__get_bin_start(other, num_used_bins) * stretch - 1;
+        bool const ok =
+            is_log(me)
+                ? alloc_more_log_bins(me, get_bin_index(me, max_value))
+                : stretch_histogram_if_necessary(me, max_value, 1);
+        if (!ok) {
+            LOGGER_ERROR("stretch failed");
+            return false;
+        }
+    }
+    // NOTE We look up our bins after stretching because merging bins
+    //      may have changed the bin size.
+    for (size_t i = 0; i < num_used_bins; ++i) {
+        uint64_t const count = other->histogram[i];
+        if (count == 0) {
+            continue;
+        }
+        // We spread the count uniformly over the distances [lo, hi). To
+        // avoid rounding errors, we assign each of our bins the
+        // difference in the cumulative share at its boundaries.
+        uint64_t const lo = Histogram__get_bin_start(other, i) * stretch;
+        uint64_t const hi = Histogram__get_bin_start(other, i + 1) * stretch;
+        uint64_t const other_bin_width = hi - lo;
+        uint64_t prev_share = 0;
+        for (size_t j = get_bin_index(me, lo); j <= get_bin_index(me, hi - 1);
+             ++j) {
+            uint64_t const end = MIN(Histogram__get_bin_start(me, j + 1), hi);
+            // NOTE The last bin gets the exact remainder. We round to
+            //      the nearest to avoid biasing the counts to the right.
+            uint64_t const share =
+                end == hi ? count
+                          : (uint64_t)((double)count * (end - lo) /
+                                           other_bin_width +
+                                       0.5);
+            if (j < me->num_bins) {
+                me->histogram[j] += share - prev_share;
+            } else {
+                me->false_infinity += share - prev_share;
+            }
+            prev_share = share;
+        }
+        me->running_sum += count;
+    }
+    me->false_infinity += other->false_infinity;
+    me->infinity += other->infinity;
+    me->running_sum += other->false_infinity + other->infinity;
+    return true;
+}
+
+bool
+Histogram__init_reshaped(struct Histogram *const me,
+                         struct Histogram const *const other,
+                         struct Histogram const *const shape)
+{
+    if (me == NULL || !is_initialized(other) || !is_initialized(shape) ||
+        other->out_of_bounds_mode != shape->out_of_bounds_mode ||
+        other->log_sub_bins != shape->log_sub_bins ||
+        shape->bin_size % other->bin_size != 0) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    if (!init_histogram(me,
+                        shape->num_bins,
+                        shape->bin_size,
+                        other->false_infinity,
+                        other->infinity,
+                        other->running_sum,
+                        shape->out_of_bounds_mode,
+                        shape->log_sub_bins)) {
+        LOGGER_ERROR("failed to init histogram");
+        return false;
+    }
+    // NOTE Merging multiplies the bin size and reallocating appends
+    //      bins (for the logarithmic bins too), so each of our bins is
+    //      the sum of a contiguous run of the other's bins.
+    size_t const factor = shape->bin_size / other->bin_size;
+    for (size_t i = 0; i < other->num_bins; ++i) {
+        size_t const j = i / factor;
+        if (j < me->num_bins) {
+            me->histogram[j] += other->histogram[i];
+        } else {
+            me->false_infinity += other->histogram[i];
+        }
+    }
+    return true;
+}
+
+/// @brief  Return 'newer - older' or zero if that would be negative.
+static uint64_t
+subtract_or_zero(uint64_t const newer,
+                 uint64_t const older,
+                 bool *const clamped)
+{
+    if (newer < older) {
+        *clamped = true;
+        return 0;
+    }
+    return newer - older;
+}
+
+bool
+Histogram__init_difference(struct Histogram *const me,
+                           struct Histogram const *const newer,
+                           struct Histogram const *const older)
+{
+    if (!Histogram__init_reshaped(me, older, newer)) {
+        return false;
+    }
+    bool clamped = false;
+    uint64_t running_sum = 0;
+    for (size_t i = 0; i < me->num_bins; ++i) {
+        me->histogram[i] =
+            subtract_or_zero(newer->histogram[i], me->histogram[i], &clamped);
+        running_sum += me->histogram[i];
+    }
+    me->false_infinity =
+        subtract_or_zero(newer->false_infinity, me->false_infinity, &clamped);
+    me->infinity = subtract_or_zero(newer->infinity, me->infinity, &clamped);
+    // NOTE We recount the sum so that it stays consistent with the bins
+    //      even if we clamped some of them.
+    me->running_sum = running_sum + me->false_infinity + me->infinity;
+    if (clamped) {
+        LOGGER_WARN("histogram shrank since the earlier copy, so we clamped "
+                    "the negative differences to zero");
+    }
+    return true;
+}
+
+size_t
+Histogram__memory_usage(struct Histogram const *const me)
+{
+    if (me == NULL || me->histogram == NULL) {
+        return 0;
+    }
+    return me->num_bins * sizeof(*me->histogram);
+}
+
 void
 Histogram__destroy(struct Histogram *me)
 {
@@ -16,6 +16,11 @@ struct FractionalHistogram {
     /// We have not seen this before
     uint64_t infinity;
     uint64_t running_sum;
+    /// Contributions to whole bins that we have not yet added to the
+    /// histogram. This is a difference array of 'num_bins + 1' entries,
+    /// i.e. bin i is owed the sum of pending[0..=i].
+    double *pending;
+    bool has_pending;
 };
 
 bool
@@ -32,6 +37,13 @@ FractionalHistogram__insert_scaled_finite(struct FractionalHistogram *me,
                                           const uint64_t range,
                                           const uint64_t scale);
 
+/// @brief  Add the pending range insertions to the histogram.
+/// @note   The insertions only update the bins at the ends of their
+///         ranges, so this must be called before reading the bins. The
+///         functions below (and the MRC conversion) call it for you.
+void
+FractionalHistogram__materialize(struct FractionalHistogram *me);
+
 bool
 FractionalHistogram__insert_scaled_infinite(struct FractionalHistogram *me,
                                             const uint64_t scale);
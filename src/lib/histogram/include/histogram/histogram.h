@@ -5,13 +5,22 @@
 #include <stdint.h>
 #include <stdio.h>
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 static char const *const HISTOGRAM_MODE_STRINGS[] = {
     "allow_overflow",
     "merge_bins",
     "realloc",
+    "log",
     "INVALID",
 };
 
+/// @brief  The maximum number of linear sub-bins per power of two in the
+///         logarithmic mode. This bounds the relative precision to 2^-12
+///         and the histogram to (65 - 12) * 2^12 bins (i.e. ~1.7 MB).
+#define HISTOGRAM_LOG_MAX_SUB_BINS ((size_t)1 << 12)
+
 /// @brief  When we have an element that doesn't fit in the histogram,
 ///         we have multiple options of resolution.
 ///         1. Allow overflow (and record this as a 'false infinity')
@@ -22,6 +31,11 @@ static char const *const HISTOGRAM_MODE_STRINGS[] = {
 ///             (N.B. we must zero out the newly allocated space!)
 ///             This maintains the precision at the expense of larger
 ///             storage overheads.
+///         4. Use logarithmically sized bins (as in HDR histograms)
+///             Each power of two is split into 'num_bins' linear
+///             sub-bins (rounded up to a power of two and capped at
+///             HISTOGRAM_LOG_MAX_SUB_BINS), so the relative precision
+///             is fixed and the memory is bounded for any range.
 enum HistogramOutOfBoundsMode {
     // NOTE This value is set to zero for backwards compatibility (with
     //      'false'). This guarantee is deprecated and future code
@@ -32,6 +46,7 @@ enum HistogramOutOfBoundsMode {
     // until we can fit the element!
     HistogramOutOfBoundsMode__merge_bins,
     HistogramOutOfBoundsMode__realloc,
+    HistogramOutOfBoundsMode__log,
     HistogramOutOfBoundsMode__INVALID,
 };
 
@@ -54,6 +69,9 @@ struct Histogram {
     uint64_t running_sum;
 
     enum HistogramOutOfBoundsMode out_of_bounds_mode;
+    /// Number of linear sub-bins per power of two in the logarithmic
+    /// mode (a power of two); zero otherwise. The bin size is then 1.
+    size_t log_sub_bins;
 };
 
 bool
@@ -65,6 +83,22 @@ Histogram__init(struct Histogram *me,
 void
 Histogram__destroy(struct Histogram *me);
 
+/// @brief  Get the index of the logarithmic bin that holds 'value'.
+/// @param  log_sub_bins: the number of sub-bins per power of two. This
+///                       must be a power of two.
+size_t
+Histogram__log_bin_index(size_t const log_sub_bins, uint64_t const value);
+
+/// @brief  Get the smallest value (i.e. reuse distance) in the i-th bin.
+/// @note   The bins are contiguous, so the i-th bin ends where the
+///         (i+1)-th bin starts.
+uint64_t
+Histogram__get_bin_start(struct Histogram const *const me, size_t const i);
+
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+Histogram__memory_usage(struct Histogram const *const me);
+
 bool
 Histogram__insert_finite(struct Histogram *me, const uint64_t index);
 
@@ -76,6 +110,15 @@ Histogram__insert_scaled_finite(struct Histogram *me,
                                 const uint64_t index,
                                 const uint64_t scale);
 
+/// @brief  Insert 'weight' copies of a non-infinite index. Unlike the
+///         scaled insertion, the index itself is not scaled.
+/// @note   This is used for Counter Stacks, which estimates the number
+///         of reuses at a given distance in bulk.
+bool
+Histogram__insert_weighted_finite(struct Histogram *me,
+                                  const uint64_t index,
+                                  const uint64_t weight);
+
 bool
 Histogram__insert_infinite(struct Histogram *me);
 
@@ -108,6 +151,17 @@ Histogram__load(struct Histogram *const me, char const *const path);
 bool
 Histogram__save(struct Histogram const *const me, char const *const path);
 
+/// @brief  Append the full histogram to a checkpoint.
+bool
+Histogram__save_checkpoint(struct Histogram const *const me,
+                           struct CheckpointWriter *const writer);
+
+/// @brief  Replace the histogram with the next one in a checkpoint.
+/// @note   The histogram must be initialized (its shape may differ).
+bool
+Histogram__load_checkpoint(struct Histogram *const me,
+                           struct CheckpointReader *const reader);
+
 /// @brief  Write the Histogram as a JSON object to stdout.
 void
 Histogram__print_as_json(struct Histogram const *const me);
@@ -131,3 +185,38 @@ Histogram__euclidean_error(struct Histogram const *const lhs,
 bool
 Histogram__iadd(struct Histogram *const me,
                 struct Histogram const *const other);
+
+/// @brief  Add 'other' histogram, whose reuse distances are 'stretch'
+///         times smaller than ours, into 'me'.
+/// @details    This is for combining the histograms of independent
+///             partitions of the key space. A partition with 1/N of the
+///             keys sees reuse distances that are about 1/N of the full
+///             trace's. We spread each of the other's bins uniformly
+///             over the distances it covers once stretched.
+/// @note   Unlike 'Histogram__iadd', the histograms' shapes may differ.
+bool
+Histogram__iadd_stretched(struct Histogram *const me,
+                          struct Histogram const *const other,
+                          uint64_t const stretch);
+
+/// @brief  Copy 'other' into the shape (i.e. the number of bins and the
+///         bin size) of 'shape'.
+/// @details    This is for comparing an earlier copy of a histogram with
+///             the live one, which may have since reallocated more bins
+///             or merged its bins. We fold any bins that do not fit into
+///             the false infinities.
+/// @note   The histograms must have the same mode and the bin size of
+///         'shape' must be a multiple of the bin size of 'other'.
+bool
+Histogram__init_reshaped(struct Histogram *const me,
+                         struct Histogram const *const other,
+                         struct Histogram const *const shape);
+
+/// @brief  Initialize 'me' to the accesses that 'newer' recorded since
+///         'older' was copied from it, i.e. 'newer - older'.
+/// @note   We clamp negative differences to zero (and warn), since we
+///         expect the histograms to only grow.
+bool
+Histogram__init_difference(struct Histogram *const me,
+                           struct Histogram const *const newer,
+                           struct Histogram const *const older);
@@ -14,6 +14,7 @@ HyperLogLog::linear_counting() const
 HyperLogLog::HyperLogLog(uint64_t const nr_buckets)
     : alpha_m_(hll_alpha_m(nr_buckets)),
       m_(nr_buckets),
+      is_power_of_two_(nr_buckets != 0 && (nr_buckets & (nr_buckets - 1)) == 0),
       V_(m_),
       inv_Z_((double)nr_buckets / 2)
 {
@@ -25,9 +26,9 @@ void
 HyperLogLog::add(uint64_t const hash)
 {
     uint64_t const nlz_h = clz(hash);
-    // NOTE This isn't as efficient as if we had defined the number
-    //      of buckets to be a power of 2, but optimize later.
-    auto &cur_nlz = M_[hash % m_];
+    // NOTE We avoid the (slow) modulo when the number of buckets is a
+    //      power of 2, which is the common case.
+    auto &cur_nlz = M_[is_power_of_two_ ? (hash & (m_ - 1)) : (hash % m_)];
     if (nlz_h > cur_nlz) {
         // Due to the inequality, we know that the incoming number
         // of leading zeroes is greater than 0, so we don't need to
@@ -36,8 +37,8 @@ HyperLogLog::add(uint64_t const hash)
             assert(nlz_h > 0);
             V_ -= 1;
         }
-        inv_Z_ -= std::exp2(-(double)cur_nlz - 1);
-        inv_Z_ += std::exp2(-(double)nlz_h - 1);
+        inv_Z_ -= std::ldexp(1.0, -(int)cur_nlz - 1);
+        inv_Z_ += std::ldexp(1.0, -(int)nlz_h - 1);
         cur_nlz = nlz_h;
     }
 }
@@ -68,6 +69,7 @@ HyperLogLog::json() const
     ss << "\"m\": " << m_ << ",";
     ss << "\"V\": " << V_ << ",";
     ss << "\"M\": " << vec2str<uint8_t, int>(M_) << ",";
+    ss << "\"Memory [B]\": " << memory_usage() << ",";
     ss << "\"inverted Z\": " << inv_Z_ << ",";
     ss << "}";
     return ss.str();
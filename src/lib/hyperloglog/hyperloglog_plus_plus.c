@@ -0,0 +1,567 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <glib.h>
+
+#include "arrays/array_size.h"
+#include "hash/types.h"
+#include "hyperloglog/hyperloglog.h"
+#include "hyperloglog/hyperloglog_plus_plus.h"
+#include "logger/logger.h"
+#include "math/count_leading_zeros.h"
+
+#define SPARSE_PRECISION HYPERLOGLOG_PLUS_PLUS_SPARSE_PRECISION
+// The sparse entry is (sparse index << RANK_BITS | rank).
+#define RANK_BITS 6
+#define RANK_MASK ((UINT32_C(1) << RANK_BITS) - 1)
+// The number of unsorted entries we buffer before merging them into the
+// sorted sparse list.
+#define TMP_CAPACITY 64
+#define MIN_SPARSE_CAPACITY 16
+
+/// @brief  The number of valid entries in each row of 'rawEstimateData'
+///         and 'biasData'. The rest of each row is padded with zeros.
+static size_t const BIAS_DATA_LENGTH[] = {
+    79, 159, 200, 200, 200, 201, 200, 201, 201, 200, 201, 201, 200, 201, 200,
+};
+
+/// @brief  The cardinality at which we switch from linear counting to the
+///         bias-corrected estimate for each precision.
+/// Source: "HyperLogLog in Practice" (Heule et al., EDBT '13) Appendix.
+static double const LINEAR_COUNTING_THRESHOLD[] = {
+    10,   20,    40,    80,    220,    400,    900,    1800,
+    3100, 6500,  11500, 20000, 50000, 120000, 350000,
+};
+
+/// Source: https://en.wikipedia.org/wiki/HyperLogLog#Practical_considerations
+static double
+hll_alpha_m(uint64_t const m)
+{
+    if (m == 16) {
+        return 0.673;
+    } else if (m == 32) {
+        return 0.697;
+    } else if (m == 64) {
+        return 0.709;
+    } else {
+        return 0.7213 / (1 + 1.079 / m);
+    }
+}
+
+static inline uint32_t
+encode_sparse(Hash64BitType const hash)
+{
+    uint32_t const index = hash >> (64 - SPARSE_PRECISION);
+    // NOTE The sentinel bit bounds the rank so that it fits in RANK_BITS.
+    uint32_t const rank = clz((hash << SPARSE_PRECISION) |
+                              (UINT64_C(1) << (SPARSE_PRECISION - 1))) +
+                          1;
+    return index << RANK_BITS | rank;
+}
+
+/// @brief  Convert a sparse entry into the dense index and rank. This
+///         gives the same result as if we had added the original hash
+///         to the dense registers.
+static inline void
+decode_sparse(uint32_t const entry,
+              uint64_t const precision,
+              uint64_t *const index,
+              uint8_t *const rank)
+{
+    uint32_t const sparse_index = entry >> RANK_BITS;
+    uint64_t const extra_bits = SPARSE_PRECISION - precision;
+    uint32_t const w = sparse_index & ((UINT32_C(1) << extra_bits) - 1);
+    *index = sparse_index >> extra_bits;
+    if (w != 0) {
+        // The rank is the number of leading zeros within the extra bits.
+        *rank = extra_bits - (63 - clz(w));
+    } else {
+        *rank = extra_bits + (entry & RANK_MASK);
+    }
+}
+
+static int
+compare_uint32(void const *const a, void const *const b)
+{
+    uint32_t const x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+    return (x > y) - (x < y);
+}
+
+bool
+HyperLogLogPlusPlus__init(struct HyperLogLogPlusPlus *const me,
+                          uint64_t const precision)
+{
+    if (me == NULL || precision < HYPERLOGLOG_PLUS_PLUS_MIN_PRECISION ||
+        precision > HYPERLOGLOG_PLUS_PLUS_MAX_PRECISION) {
+        LOGGER_WARN("bad input");
+        return false;
+    }
+    uint32_t *tmp_list = malloc(TMP_CAPACITY * sizeof(*tmp_list));
+    if (tmp_list == NULL) {
+        LOGGER_ERROR("bad malloc");
+        return false;
+    }
+    *me = (struct HyperLogLogPlusPlus){
+        .precision = precision,
+        .num_registers = UINT64_C(1) << precision,
+        .is_sparse = true,
+        .sparse_list = NULL,
+        .sparse_length = 0,
+        .sparse_capacity = 0,
+        .tmp_list = tmp_list,
+        .tmp_length = 0,
+        .registers = NULL,
+    };
+    return true;
+}
+
+static inline void
+update_register(struct HyperLogLogPlusPlus *const me,
+                uint64_t const index,
+                uint8_t const rank)
+{
+    if (rank > me->registers[index]) {
+        me->registers[index] = rank;
+    }
+}
+
+static bool
+convert_to_dense(struct HyperLogLogPlusPlus *const me)
+{
+    assert(me != NULL && me->is_sparse);
+    uint8_t *registers = calloc(me->num_registers, sizeof(*registers));
+    if (registers == NULL) {
+        LOGGER_ERROR("bad calloc(%" PRIu64 ", %zu)",
+                     me->num_registers,
+                     sizeof(*registers));
+        return false;
+    }
+    me->registers = registers;
+    for (size_t i = 0; i < me->sparse_length; ++i) {
+        uint64_t index = 0;
+        uint8_t rank = 0;
+        decode_sparse(me->sparse_list[i], me->precision, &index, &rank);
+        update_register(me, index, rank);
+    }
+    for (size_t i = 0; i < me->tmp_length; ++i) {
+        uint64_t index = 0;
+        uint8_t rank = 0;
+        decode_sparse(me->tmp_list[i], me->precision, &index, &rank);
+        update_register(me, index, rank);
+    }
+    free(me->sparse_list);
+    free(me->tmp_list);
+    me->sparse_list = NULL;
+    me->sparse_length = 0;
+    me->sparse_capacity = 0;
+    me->tmp_list = NULL;
+    me->tmp_length = 0;
+    me->is_sparse = false;
+    return true;
+}
+
+/// @brief  Merge the temporary list into the sorted sparse list, keeping
+///         only the largest rank for each sparse index.
+/// @note   Since the rank is in the low bits, entries with the same
+///         sparse index are sorted by rank, so we keep the last one.
+static bool
+compact_sparse(struct HyperLogLogPlusPlus *const me)
+{
+    assert(me != NULL && me->is_sparse);
+    if (me->tmp_length == 0) {
+        return true;
+    }
+    qsort(me->tmp_list, me->tmp_length, sizeof(*me->tmp_list), compare_uint32);
+
+    size_t const max_length = me->sparse_length + me->tmp_length;
+    size_t new_capacity = MAX(me->sparse_capacity, MIN_SPARSE_CAPACITY);
+    while (new_capacity < max_length) {
+        new_capacity *= 2;
+    }
+    uint32_t *new_list = malloc(new_capacity * sizeof(*new_list));
+    if (new_list == NULL) {
+        LOGGER_ERROR("bad malloc");
+        return false;
+    }
+    size_t i = 0, j = 0, n = 0;
+    while (i < me->sparse_length || j < me->tmp_length) {
+        uint32_t entry = 0;
+        if (j == me->tmp_length ||
+            (i < me->sparse_length && me->sparse_list[i] < me->tmp_list[j])) {
+            entry = me->sparse_list[i++];
+        } else {
+            entry = me->tmp_list[j++];
+        }
+        if (n != 0 && (new_list[n - 1] >> RANK_BITS) == (entry >> RANK_BITS)) {
+            new_list[n - 1] = entry;
+        } else {
+            new_list[n++] = entry;
+        }
+    }
+    free(me->sparse_list);
+    me->sparse_list = new_list;
+    me->sparse_length = n;
+    me->sparse_capacity = new_capacity;
+    me->tmp_length = 0;
+
+    // NOTE We switch once the sparse list uses as much memory as the
+    //      dense registers would.
+    if (me->sparse_length * sizeof(*me->sparse_list) >= me->num_registers) {
+        return convert_to_dense(me);
+    }
+    return true;
+}
+
+static void
+add_sparse_entry(struct HyperLogLogPlusPlus *const me, uint32_t const entry)
+{
+    assert(me != NULL && me->is_sparse);
+    me->tmp_list[me->tmp_length++] = entry;
+    if (me->tmp_length == TMP_CAPACITY) {
+        if (!compact_sparse(me)) {
+            LOGGER_ERROR("failed to compact sparse list");
+            // NOTE We drop the newest entry rather than overflow the
+            //      buffer. At worst, this underestimates the cardinality.
+            --me->tmp_length;
+        }
+    }
+}
+
+void
+HyperLogLogPlusPlus__add_hash(struct HyperLogLogPlusPlus *const me,
+                              Hash64BitType const hash)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->is_sparse) {
+        add_sparse_entry(me, encode_sparse(hash));
+        return;
+    }
+    uint64_t const index = hash >> (64 - me->precision);
+    uint8_t const rank =
+        clz((hash << me->precision) | (UINT64_C(1) << (me->precision - 1))) +
+        1;
+    update_register(me, index, rank);
+}
+
+/// @brief  Compute sum(2^-M[j]) and the number of zero registers.
+static void
+sum_registers(uint8_t const *const registers,
+              uint64_t const num_registers,
+              double *const inv_z,
+              uint64_t *const num_zeros)
+{
+    double sum = 0.0;
+    uint64_t zeros = 0;
+    uint64_t i = 0;
+#ifdef __AVX2__
+    // NOTE We construct 2^-M directly as an IEEE 754 double by writing
+    //      (1023 - M) into the exponent bits.
+    __m256i const exponent_bias = _mm256_set1_epi64x(1023);
+    __m256i const zero = _mm256_setzero_si256();
+    __m256d acc[4] = {_mm256_setzero_pd(),
+                      _mm256_setzero_pd(),
+                      _mm256_setzero_pd(),
+                      _mm256_setzero_pd()};
+    for (; i + 32 <= num_registers; i += 32) {
+        __m256i const v = _mm256_loadu_si256((__m256i const *)&registers[i]);
+        zeros += __builtin_popcount(
+            (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+        for (int j = 0; j < 8; ++j) {
+            int32_t four_registers = 0;
+            memcpy(&four_registers, &registers[i + 4 * j], 4);
+            __m256i const r =
+                _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four_registers));
+            __m256i const e =
+                _mm256_slli_epi64(_mm256_sub_epi64(exponent_bias, r), 52);
+            acc[j % 4] = _mm256_add_pd(acc[j % 4], _mm256_castsi256_pd(e));
+        }
+    }
+    __m256d const acc01 = _mm256_add_pd(acc[0], acc[1]);
+    __m256d const acc23 = _mm256_add_pd(acc[2], acc[3]);
+    double lanes[4] = {0};
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc01, acc23));
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < num_registers; ++i) {
+        sum += ldexp(1.0, -registers[i]);
+        zeros += registers[i] == 0;
+    }
+    *inv_z = sum;
+    *num_zeros = zeros;
+}
+
+/// @brief  Estimate the bias with k-nearest neighbours (k = 6) on the
+///         empirical raw estimates, as per the HyperLogLog++ paper.
+static double
+estimate_bias(double const raw_estimate, uint64_t const precision)
+{
+    size_t const row = precision - HYPERLOGLOG_PLUS_PLUS_MIN_PRECISION;
+    double const *const raw = rawEstimateData[row];
+    double const *const bias = biasData[row];
+    size_t const length = BIAS_DATA_LENGTH[row];
+    size_t const k = 6;
+
+    // The raw estimates are sorted, so the nearest neighbours form a
+    // contiguous window. Find the first raw estimate >= the value.
+    size_t lo = 0, hi = length;
+    while (lo < hi) {
+        size_t const mid = lo + (hi - lo) / 2;
+        if (raw[mid] < raw_estimate) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    // Grow the window [left, right) around the insertion point.
+    size_t left = lo, right = lo;
+    while (right - left < k && (left > 0 || right < length)) {
+        if (left == 0) {
+            ++right;
+        } else if (right == length) {
+            --left;
+        } else if (raw_estimate - raw[left - 1] < raw[right] - raw_estimate) {
+            --left;
+        } else {
+            ++right;
+        }
+    }
+    double sum = 0.0;
+    for (size_t i = left; i < right; ++i) {
+        sum += bias[i];
+    }
+    return sum / (right - left);
+}
+
+static double
+linear_counting(double const m, double const num_zeros)
+{
+    return m * log(m / num_zeros);
+}
+
+uint64_t
+HyperLogLogPlusPlus__count(struct HyperLogLogPlusPlus *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    if (me->is_sparse) {
+        if (!compact_sparse(me)) {
+            LOGGER_WARN("failed to compact sparse list");
+        }
+    }
+    if (me->is_sparse) {
+        double const m = (double)(UINT64_C(1) << SPARSE_PRECISION);
+        return (uint64_t)round(
+            linear_counting(m, m - (double)me->sparse_length));
+    }
+
+    double inv_z = 0.0;
+    uint64_t num_zeros = 0;
+    sum_registers(me->registers, me->num_registers, &inv_z, &num_zeros);
+    double const m = (double)me->num_registers;
+    double const raw_estimate = hll_alpha_m(me->num_registers) * m * m / inv_z;
+    double const estimate =
+        raw_estimate <= 5 * m
+            ? raw_estimate - estimate_bias(raw_estimate, me->precision)
+            : raw_estimate;
+    if (num_zeros != 0) {
+        double const lc = linear_counting(m, (double)num_zeros);
+        size_t const row = me->precision - HYPERLOGLOG_PLUS_PLUS_MIN_PRECISION;
+        if (lc <= LINEAR_COUNTING_THRESHOLD[row]) {
+            return (uint64_t)round(lc);
+        }
+    }
+    return (uint64_t)round(MAX(estimate, 0.0));
+}
+
+static void
+merge_dense(uint8_t *const dst,
+            uint8_t const *const src,
+            uint64_t const num_registers)
+{
+    uint64_t i = 0;
+#ifdef __AVX2__
+    for (; i + 32 <= num_registers; i += 32) {
+        __m256i const a = _mm256_loadu_si256((__m256i const *)&dst[i]);
+        __m256i const b = _mm256_loadu_si256((__m256i const *)&src[i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_max_epu8(a, b));
+    }
+#endif
+    for (; i < num_registers; ++i) {
+        dst[i] = MAX(dst[i], src[i]);
+    }
+}
+
+bool
+HyperLogLogPlusPlus__merge(struct HyperLogLogPlusPlus *const me,
+                           struct HyperLogLogPlusPlus const *const other)
+{
+    if (me == NULL || other == NULL || me->precision != other->precision) {
+        LOGGER_WARN("bad input");
+        return false;
+    }
+    if (other->is_sparse) {
+        // NOTE The other sketch's temporary list may be unsorted, but
+        //      that doesn't matter since we insert entries one by one.
+        uint32_t const *const lists[2] = {other->sparse_list, other->tmp_list};
+        size_t const lengths[2] = {other->sparse_length, other->tmp_length};
+        for (size_t l = 0; l < ARRAY_SIZE(lists); ++l) {
+            for (size_t i = 0; i < lengths[l]; ++i) {
+                if (me->is_sparse) {
+                    add_sparse_entry(me, lists[l][i]);
+                } else {
+                    uint64_t index = 0;
+                    uint8_t rank = 0;
+                    decode_sparse(lists[l][i], me->precision, &index, &rank);
+                    update_register(me, index, rank);
+                }
+            }
+        }
+        return true;
+    }
+    if (me->is_sparse && !convert_to_dense(me)) {
+        LOGGER_ERROR("failed to convert to dense");
+        return false;
+    }
+    merge_dense(me->registers, other->registers, me->num_registers);
+    return true;
+}
+
+/// @note   The format is: precision (uint64_t), is_sparse (uint64_t),
+///         length (uint64_t), followed by either 'length' sparse entries
+///         (uint32_t) or 'length' dense registers (uint8_t).
+bool
+HyperLogLogPlusPlus__write(struct HyperLogLogPlusPlus *const me,
+                           FILE *const fp)
+{
+    if (me == NULL || fp == NULL) {
+        return false;
+    }
+    if (me->is_sparse && !compact_sparse(me)) {
+        LOGGER_ERROR("failed to compact sparse list");
+        return false;
+    }
+    uint64_t const header[3] = {
+        me->precision,
+        me->is_sparse,
+        me->is_sparse ? me->sparse_length : me->num_registers,
+    };
+    if (fwrite(header, sizeof(*header), ARRAY_SIZE(header), fp) !=
+        ARRAY_SIZE(header)) {
+        LOGGER_ERROR("failed to write header");
+        return false;
+    }
+    if (me->is_sparse) {
+        if (fwrite(me->sparse_list,
+                   sizeof(*me->sparse_list),
+                   me->sparse_length,
+                   fp) != me->sparse_length) {
+            LOGGER_ERROR("failed to write sparse list");
+            return false;
+        }
+    } else {
+        if (fwrite(me->registers,
+                   sizeof(*me->registers),
+                   me->num_registers,
+                   fp) != me->num_registers) {
+            LOGGER_ERROR("failed to write registers");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+HyperLogLogPlusPlus__read(struct HyperLogLogPlusPlus *const me,
+                          FILE *const fp)
+{
+    if (me == NULL || fp == NULL) {
+        return false;
+    }
+    uint64_t header[3] = {0};
+    if (fread(header, sizeof(*header), ARRAY_SIZE(header), fp) !=
+        ARRAY_SIZE(header)) {
+        LOGGER_ERROR("failed to read header");
+        return false;
+    }
+    if (!HyperLogLogPlusPlus__init(me, header[0])) {
+        LOGGER_ERROR("failed to initialize with precision %" PRIu64,
+                     header[0]);
+        return false;
+    }
+    bool const is_sparse = header[1];
+    uint64_t const length = header[2];
+    if (is_sparse) {
+        if (length * sizeof(*me->sparse_list) >= me->num_registers) {
+            LOGGER_ERROR("sparse list is too long: %" PRIu64, length);
+            goto cleanup;
+        }
+        me->sparse_capacity = MAX(length, MIN_SPARSE_CAPACITY);
+        me->sparse_list = malloc(me->sparse_capacity * sizeof(*me->sparse_list));
+        if (me->sparse_list == NULL) {
+            LOGGER_ERROR("bad malloc");
+            goto cleanup;
+        }
+        if (fread(me->sparse_list, sizeof(*me->sparse_list), length, fp) !=
+            length) {
+            LOGGER_ERROR("failed to read sparse list");
+            goto cleanup;
+        }
+        me->sparse_length = length;
+    } else {
+        if (length != me->num_registers || !convert_to_dense(me)) {
+            LOGGER_ERROR("bad dense registers");
+            goto cleanup;
+        }
+        if (fread(me->registers, sizeof(*me->registers), length, fp) !=
+            length) {
+            LOGGER_ERROR("failed to read registers");
+            goto cleanup;
+        }
+    }
+    return true;
+cleanup:
+    HyperLogLogPlusPlus__destroy(me);
+    return false;
+}
+
+size_t
+HyperLogLogPlusPlus__memory_usage(struct HyperLogLogPlusPlus const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    size_t bytes = me->sparse_capacity * sizeof(*me->sparse_list);
+    if (me->tmp_list != NULL) {
+        bytes += TMP_CAPACITY * sizeof(*me->tmp_list);
+    }
+    if (me->registers != NULL) {
+        bytes += me->num_registers * sizeof(*me->registers);
+    }
+    return bytes;
+}
+
+void
+HyperLogLogPlusPlus__destroy(struct HyperLogLogPlusPlus *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    free(me->sparse_list);
+    free(me->tmp_list);
+    free(me->registers);
+    *me = (struct HyperLogLogPlusPlus){0};
+}
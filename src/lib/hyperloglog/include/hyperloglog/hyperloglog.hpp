@@ -62,7 +62,8 @@ private:
     {
         double r = 0.0;
         for (auto m : M_) {
-            r += std::exp2(-m - 1);
+            // NOTE ldexp is much cheaper than exp2 for integer powers.
+            r += std::ldexp(1.0, -m - 1);
         }
         return r;
     }
@@ -108,6 +109,13 @@ public:
     uint64_t
     size() const;
 
+    /// @brief  Get the number of bytes that this owns on the heap.
+    uint64_t
+    memory_usage() const
+    {
+        return M_.capacity() * sizeof(M_[0]);
+    }
+
     std::string
     json() const;
 
@@ -116,6 +124,8 @@ private:
     double const alpha_m_;
     // Number of buckets in M_.
     uint64_t const m_;
+    // Whether we can replace the modulo with a mask.
+    bool const is_power_of_two_;
     // Number of zeroes in M_ (i.e. count the entries in M_ where the
     // number of leading zeroes is zero). This is slightly different
     // than my earlier implementations, which checked whether the value
@@ -0,0 +1,86 @@
+/** @brief  A HyperLogLog++ cardinality sketch.
+ *
+ *  This follows Heule et al.'s "HyperLogLog in Practice" (EDBT '13):
+ *  1. The number of registers is a power of two (2^precision), so the
+ *     register index is simply the top 'precision' bits of the hash.
+ *  2. Small cardinalities use a sparse representation with a precision
+ *     of 25 bits. We switch to the dense representation once the sparse
+ *     list would use as much memory as the dense registers.
+ *  3. The dense estimate is bias-corrected with the empirical tables in
+ *     'hyperloglog/hyperloglog.h'.
+ *
+ *  The dense registers are one byte each (rather than packed into 6
+ *  bits) so that merging and estimating can use byte-wise SIMD
+ *  instructions. We use AVX2 when we compile with it enabled (i.e.
+ *  __AVX2__), which the build does, so it needs AVX2 at run-time.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hash/types.h"
+
+#define HYPERLOGLOG_PLUS_PLUS_MIN_PRECISION    4
+#define HYPERLOGLOG_PLUS_PLUS_MAX_PRECISION    18
+#define HYPERLOGLOG_PLUS_PLUS_SPARSE_PRECISION 25
+
+struct HyperLogLogPlusPlus {
+    uint64_t precision;
+    uint64_t num_registers;
+
+    bool is_sparse;
+    // The sorted list of sparse entries. Each entry encodes the 25-bit
+    // sparse index and the rank, with at most one entry per index.
+    uint32_t *sparse_list;
+    size_t sparse_length;
+    size_t sparse_capacity;
+    // Unsorted, recently added sparse entries. We merge these into the
+    // sorted list in bulk.
+    uint32_t *tmp_list;
+    size_t tmp_length;
+
+    // The dense registers. This is NULL in the sparse representation.
+    uint8_t *registers;
+};
+
+bool
+HyperLogLogPlusPlus__init(struct HyperLogLogPlusPlus *const me,
+                          uint64_t const precision);
+
+void
+HyperLogLogPlusPlus__add_hash(struct HyperLogLogPlusPlus *const me,
+                              Hash64BitType const hash);
+
+/// @brief  Get the cardinality estimate.
+/// @note   This is not const because it may compact the sparse list.
+uint64_t
+HyperLogLogPlusPlus__count(struct HyperLogLogPlusPlus *const me);
+
+/// @brief  Merge 'other' into 'me' so that 'me' estimates the cardinality
+///         of the union of both streams.
+/// @note   Both sketches must have the same precision.
+bool
+HyperLogLogPlusPlus__merge(struct HyperLogLogPlusPlus *const me,
+                           struct HyperLogLogPlusPlus const *const other);
+
+/// @brief  Write the sketch to a stream in a compact binary format.
+/// @note   Multiple sketches may be written back-to-back to a stream.
+bool
+HyperLogLogPlusPlus__write(struct HyperLogLogPlusPlus *const me,
+                           FILE *const fp);
+
+/// @brief  Read a sketch previously written by 'HyperLogLogPlusPlus__write'.
+/// @param  me: an uninitialized sketch.
+bool
+HyperLogLogPlusPlus__read(struct HyperLogLogPlusPlus *const me,
+                          FILE *const fp);
+
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+HyperLogLogPlusPlus__memory_usage(struct HyperLogLogPlusPlus const *const me);
+
+void
+HyperLogLogPlusPlus__destroy(struct HyperLogLogPlusPlus *const me);
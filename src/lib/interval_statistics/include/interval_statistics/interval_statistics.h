@@ -3,9 +3,14 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "histogram/histogram.h"
 
+/// @brief  The default number of items that we buffer before handing a
+///         block to the background writer.
+#define INTERVAL_STATISTICS_DEFAULT_BLOCK_LENGTH ((size_t)1 << 16)
+
 /// @note   I am safe to use a 'double' here because it can represent
 ///         1<<53 without loss of precision (i.e. more than 1<<48, which
 ///         is the size of the virtual address space). For this reason,
@@ -18,18 +23,61 @@ struct IntervalStatisticsItem {
     double reuse_time;
 };
 
+/// @brief  The background writer of a streaming IntervalStatistics.
+/// @note   This is opaque so users need not include <pthread.h>.
+struct IntervalStatisticsWriter;
+
 struct IntervalStatistics {
     // This is a buffer to collect the reuse statistics (time and distance).
+    // NOTE When streaming, this is only the block that we are filling.
     struct IntervalStatisticsItem *stats;
     // The length of the stats.
     size_t length;
     size_t capacity;
+    // The writer that streams full blocks to a compressed file (or NULL
+    // if we keep every item in memory).
+    struct IntervalStatisticsWriter *writer;
+};
+
+/// @brief  Read the items of a file of interval statistics one at a
+///         time, either in the raw or in the compressed format.
+struct IntervalStatisticsReader {
+    FILE *fp;
+    bool compressed;
+    // The decoded items of the current block.
+    struct IntervalStatisticsItem *block;
+    size_t length;
+    size_t index;
+    size_t capacity;
+    // Scratch space for the encoded block.
+    uint8_t *varints;
+    size_t varints_capacity;
+    double *raw;
+    size_t raw_capacity;
 };
 
 bool
 IntervalStatistics__init(struct IntervalStatistics *const me,
                          size_t const init_capacity);
 
+/// @brief  Stream the statistics to a compressed file at 'path' rather
+///         than keeping them all in memory.
+/// @details    We buffer blocks of 'block_length' items and hand each
+///             full block to a background thread, which encodes the
+///             reuse distances and times as varint deltas and appends
+///             them to the file. This keeps the memory constant.
+/// @note   This must be called before appending any items. Any items
+///         that we appended are dropped.
+bool
+IntervalStatistics__stream_to(struct IntervalStatistics *const me,
+                              char const *const path,
+                              size_t const block_length);
+
+/// @brief  Return the total number of items appended so far.
+size_t
+IntervalStatistics__num_items(struct IntervalStatistics const *const me);
+
+/// @note   If we are streaming, this flushes the stream.
 void
 IntervalStatistics__destroy(struct IntervalStatistics *const me);
 
@@ -55,12 +103,29 @@ IntervalStatistics__append_unsampled(struct IntervalStatistics *const me);
 bool
 IntervalStatistics__append_infinity(struct IntervalStatistics *const me);
 
+/// @note   If we are streaming, this flushes and closes the stream,
+///         which must already be writing to 'path'.
 bool
-IntervalStatistics__save(struct IntervalStatistics const *const me,
+IntervalStatistics__save(struct IntervalStatistics *const me,
                          char const *const path);
 
+/// @note   If we are streaming, this flushes the stream and reads the
+///         items back from its file.
 bool
-IntervalStatistics__to_histogram(struct IntervalStatistics const *const me,
+IntervalStatistics__to_histogram(struct IntervalStatistics *const me,
                                  struct Histogram *const hist,
                                  size_t const num_bins,
                                  size_t const bin_size);
+
+bool
+IntervalStatisticsReader__init(struct IntervalStatisticsReader *const me,
+                               char const *const path);
+
+/// @brief  Read the next item into 'item'.
+/// @return false at the end of the file or upon an error.
+bool
+IntervalStatisticsReader__next(struct IntervalStatisticsReader *const me,
+                               struct IntervalStatisticsItem *const item);
+
+void
+IntervalStatisticsReader__destroy(struct IntervalStatisticsReader *const me);
@@ -1,9 +1,13 @@
 #include <assert.h>
+#include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "file/file.h"
 #include "histogram/histogram.h"
@@ -11,6 +15,286 @@
 #include "invariants/implies.h"
 #include "logger/logger.h"
 
+/// @brief  The magic number at the start of a compressed file. A raw
+///         file has no header, so this is how the readers tell them apart.
+static char const COMPRESSED_MAGIC[8] =
+    {'I', 'S', 'T', 'A', 'T', 'V', 'Z', '1'};
+
+/// @brief  Each field is encoded as a varint whose bottom two bits are
+///         one of these tags. Only integers carry a (delta) payload in the
+///         varint; other finite values are stored in the block's section
+///         of raw doubles.
+enum FieldTag {
+    FIELD_TAG_INTEGER = 0,
+    FIELD_TAG_NAN = 1,
+    FIELD_TAG_INFINITY = 2,
+    FIELD_TAG_RAW = 3,
+};
+
+/// @note   The maximum number of bytes in a 64-bit varint.
+#define MAX_VARINT_BYTES 10
+/// @note   Each item has a reuse distance and a reuse time.
+#define FIELDS_PER_ITEM 2
+
+struct IntervalStatisticsWriter {
+    FILE *fp;
+    char *path;
+    size_t block_length;
+    // The number of items that we handed to the background thread.
+    size_t num_items;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // The full block that the background thread is writing (or NULL).
+    struct IntervalStatisticsItem *pending;
+    size_t pending_length;
+    // The block that the background thread finished writing, which the
+    // appender takes when it hands off its next full block.
+    struct IntervalStatisticsItem *spare;
+    bool stop_requested;
+    bool failed;
+    bool finished;
+
+    // Scratch space for encoding, only touched by the background thread.
+    uint8_t *varints;
+    double *raw;
+};
+
+static size_t
+encode_varint(uint8_t *const dst, uint64_t value)
+{
+    size_t n = 0;
+    do {
+        dst[n] = value & 0x7F;
+        value >>= 7;
+        if (value != 0) {
+            dst[n] |= 0x80;
+        }
+        ++n;
+    } while (value != 0);
+    return n;
+}
+
+static bool
+decode_varint(uint8_t const **const cursor,
+              uint8_t const *const end,
+              uint64_t *const value)
+{
+    uint64_t r = 0;
+    for (unsigned shift = 0; *cursor < end && shift < 64; shift += 7) {
+        uint8_t const byte = *(*cursor)++;
+        r |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief  Encode one field as a zig-zagged delta from the previous
+///         integer of the same field (if it is an integer).
+static void
+encode_field(double const value,
+             uint64_t *const prev,
+             uint8_t *const varints,
+             size_t *const num_varint_bytes,
+             double *const raw,
+             size_t *const num_raw)
+{
+    uint64_t code = 0;
+    if (isnan(value)) {
+        code = FIELD_TAG_NAN;
+    } else if (isinf(value) && value > 0) {
+        code = FIELD_TAG_INFINITY;
+    } else if (value >= 0 && value <= (double)((uint64_t)1 << 53) &&
+               value == floor(value)) {
+        uint64_t const x = (uint64_t)value;
+        int64_t const delta = (int64_t)(x - *prev);
+        uint64_t const zigzag =
+            ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+        code = zigzag << 2 | FIELD_TAG_INTEGER;
+        *prev = x;
+    } else {
+        code = FIELD_TAG_RAW;
+        raw[(*num_raw)++] = value;
+    }
+    *num_varint_bytes += encode_varint(&varints[*num_varint_bytes], code);
+}
+
+static bool
+decode_field(uint8_t const **const cursor,
+             uint8_t const *const end,
+             uint64_t *const prev,
+             double const *const raw,
+             size_t const num_raw,
+             size_t *const raw_index,
+             double *const value)
+{
+    uint64_t code = 0;
+    if (!decode_varint(cursor, end, &code)) {
+        return false;
+    }
+    switch ((enum FieldTag)(code & 3)) {
+    case FIELD_TAG_INTEGER: {
+        uint64_t const zigzag = code >> 2;
+        uint64_t const delta = (zigzag >> 1) ^ -(zigzag & 1);
+        *prev += delta;
+        *value = (double)*prev;
+        return true;
+    }
+    case FIELD_TAG_NAN:
+        *value = NAN;
+        return true;
+    case FIELD_TAG_INFINITY:
+        *value = INFINITY;
+        return true;
+    case FIELD_TAG_RAW:
+        if (*raw_index >= num_raw) {
+            return false;
+        }
+        *value = raw[(*raw_index)++];
+        return true;
+    default:
+        assert(0 && "impossible");
+        return false;
+    }
+}
+
+/// @brief  Write a block as its header (number of items, number of
+///         varint bytes, number of raw doubles) followed by the varints
+///         and the raw doubles.
+/// @note   The deltas restart at each block, so blocks decode
+///         independently.
+static bool
+write_block(struct IntervalStatisticsWriter *const w,
+            struct IntervalStatisticsItem const *const block,
+            size_t const length)
+{
+    uint64_t prev_dist = 0, prev_time = 0;
+    size_t num_varint_bytes = 0, num_raw = 0;
+    for (size_t i = 0; i < length; ++i) {
+        encode_field(block[i].reuse_distance,
+                     &prev_dist,
+                     w->varints,
+                     &num_varint_bytes,
+                     w->raw,
+                     &num_raw);
+        encode_field(block[i].reuse_time,
+                     &prev_time,
+                     w->varints,
+                     &num_varint_bytes,
+                     w->raw,
+                     &num_raw);
+    }
+    uint64_t const header[3] = {length, num_varint_bytes, num_raw};
+    if (fwrite(header, sizeof(header), 1, w->fp) != 1 ||
+        fwrite(w->varints, 1, num_varint_bytes, w->fp) != num_varint_bytes ||
+        fwrite(w->raw, sizeof(*w->raw), num_raw, w->fp) != num_raw) {
+        LOGGER_ERROR("failed to write block to '%s'", w->path);
+        return false;
+    }
+    return true;
+}
+
+static void *
+writer_worker(void *arg)
+{
+    struct IntervalStatisticsWriter *const w = arg;
+    pthread_mutex_lock(&w->lock);
+    while (true) {
+        while (w->pending == NULL && !w->stop_requested) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (w->pending == NULL) {
+            break;
+        }
+        struct IntervalStatisticsItem *const block = w->pending;
+        size_t const length = w->pending_length;
+        bool const failed = w->failed;
+        // NOTE We encode and write without the lock so that the appender
+        //      can keep filling its block.
+        pthread_mutex_unlock(&w->lock);
+        bool const ok = failed || write_block(w, block, length);
+        pthread_mutex_lock(&w->lock);
+        w->failed |= !ok;
+        w->spare = block;
+        w->pending = NULL;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/// @brief  Hand the appender's block to the background thread and take
+///         the spare block in exchange.
+static bool
+hand_off_block(struct IntervalStatistics *const me)
+{
+    struct IntervalStatisticsWriter *const w = me->writer;
+    pthread_mutex_lock(&w->lock);
+    while (w->pending != NULL) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    if (w->failed) {
+        pthread_mutex_unlock(&w->lock);
+        return false;
+    }
+    w->pending = me->stats;
+    w->pending_length = me->length;
+    me->stats = w->spare;
+    w->spare = NULL;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    w->num_items += me->length;
+    me->length = 0;
+    return true;
+}
+
+/// @brief  Flush the partial block, stop the background thread, and
+///         close the file.
+static bool
+finish_stream(struct IntervalStatistics *const me)
+{
+    struct IntervalStatisticsWriter *const w = me->writer;
+    if (w->finished) {
+        return !w->failed;
+    }
+    if (me->length != 0) {
+        // NOTE If this fails, the background thread has already failed.
+        hand_off_block(me);
+    }
+    pthread_mutex_lock(&w->lock);
+    w->stop_requested = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    if (fclose(w->fp) != 0) {
+        LOGGER_ERROR("failed to close '%s'", w->path);
+        w->failed = true;
+    }
+    w->fp = NULL;
+    w->finished = true;
+    return !w->failed;
+}
+
+static void
+destroy_writer(struct IntervalStatisticsWriter *const w)
+{
+    if (w == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    free(w->spare);
+    free(w->varints);
+    free(w->raw);
+    free(w->path);
+    free(w);
+}
+
 bool
 IntervalStatistics__init(struct IntervalStatistics *const me,
                          size_t const init_capacity)
@@ -21,8 +305,87 @@ IntervalStatistics__init(struct IntervalStatistics *const me,
     *me = (struct IntervalStatistics){
         .stats = calloc(init_capacity, sizeof(*me->stats)),
         .length = 0,
-        .capacity = init_capacity};
+        .capacity = init_capacity,
+        .writer = NULL};
+    return true;
+}
+
+bool
+IntervalStatistics__stream_to(struct IntervalStatistics *const me,
+                              char const *const path,
+                              size_t const block_length)
+{
+    if (me == NULL || path == NULL || block_length == 0) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    if (me->writer != NULL) {
+        LOGGER_ERROR("already streaming");
+        return false;
+    }
+    if (me->length != 0) {
+        LOGGER_WARN("dropping %zu items", me->length);
+    }
+
+    struct IntervalStatisticsItem *block = NULL;
+    struct IntervalStatisticsWriter *w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        LOGGER_ERROR("failed to allocate writer");
+        return false;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->block_length = block_length;
+    w->path = strdup(path);
+    w->spare = calloc(block_length, sizeof(*w->spare));
+    w->varints = calloc(FIELDS_PER_ITEM * block_length, MAX_VARINT_BYTES);
+    w->raw = calloc(FIELDS_PER_ITEM * block_length, sizeof(*w->raw));
+    block = calloc(block_length, sizeof(*block));
+    if (w->path == NULL || w->spare == NULL || w->varints == NULL ||
+        w->raw == NULL || block == NULL) {
+        LOGGER_ERROR("failed to allocate stream buffers");
+        goto cleanup;
+    }
+    w->fp = fopen(path, "wb");
+    if (w->fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", path);
+        goto cleanup;
+    }
+    uint64_t const header_block_length = block_length;
+    if (fwrite(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC), 1, w->fp) != 1 ||
+        fwrite(&header_block_length, sizeof(header_block_length), 1, w->fp) !=
+            1) {
+        LOGGER_ERROR("failed to write header to '%s'", path);
+        goto cleanup;
+    }
+    if (pthread_create(&w->thread, NULL, writer_worker, w) != 0) {
+        LOGGER_ERROR("failed to create the writer thread");
+        goto cleanup;
+    }
+
+    free(me->stats);
+    *me = (struct IntervalStatistics){.stats = block,
+                                      .length = 0,
+                                      .capacity = block_length,
+                                      .writer = w};
     return true;
+cleanup:
+    if (w->fp != NULL) {
+        fclose(w->fp);
+        remove(path);
+    }
+    destroy_writer(w);
+    free(block);
+    return false;
+}
+
+size_t
+IntervalStatistics__num_items(struct IntervalStatistics const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return (me->writer ? me->writer->num_items : 0) + me->length;
 }
 
 static bool
@@ -39,7 +402,8 @@ resize(struct IntervalStatistics *const me)
     }
     *me = (struct IntervalStatistics){.stats = new_stats,
                                       .capacity = new_cap,
-                                      .length = me->length};
+                                      .length = me->length,
+                                      .writer = me->writer};
     return true;
 }
 
@@ -52,7 +416,15 @@ IntervalStatistics__append_scaled(struct IntervalStatistics *const me,
     if (me == NULL) {
         return false;
     }
-    if (me->length >= me->capacity) {
+    if (me->writer != NULL) {
+        if (me->writer->finished) {
+            LOGGER_ERROR("stream to '%s' is closed", me->writer->path);
+            return false;
+        }
+        if (me->length >= me->capacity && !hand_off_block(me)) {
+            return false;
+        }
+    } else if (me->length >= me->capacity) {
         if (!resize(me)) {
             return false;
         }
@@ -91,13 +463,22 @@ IntervalStatistics__append_infinity(struct IntervalStatistics *const me)
 }
 
 bool
-IntervalStatistics__save(struct IntervalStatistics const *const me,
+IntervalStatistics__save(struct IntervalStatistics *const me,
                          char const *const path)
 {
     if (me == NULL || path == NULL) {
         return false;
     }
 
+    if (me->writer != NULL) {
+        if (strcmp(path, me->writer->path) != 0) {
+            LOGGER_ERROR("streaming to '%s' rather than '%s'",
+                         me->writer->path,
+                         path);
+            return false;
+        }
+        return finish_stream(me);
+    }
     return write_buffer(path, me->stats, me->length, sizeof(*me->stats));
 }
 
@@ -107,12 +488,63 @@ IntervalStatistics__destroy(struct IntervalStatistics *const me)
     if (me == NULL) {
         return;
     }
+    if (me->writer != NULL) {
+        if (!finish_stream(me)) {
+            LOGGER_ERROR("failed to stream to '%s'", me->writer->path);
+        }
+        destroy_writer(me->writer);
+    }
     free(me->stats);
     *me = (struct IntervalStatistics){0};
 }
 
+static void
+insert_item(struct Histogram *const hist,
+            struct IntervalStatisticsItem const *const item)
+{
+    double const reuse_dist = item->reuse_distance;
+    if (isnan(reuse_dist)) {
+        // NOTE NAN represents a non-sampled value.
+    } else if (isinf(reuse_dist)) {
+        Histogram__insert_infinite(hist);
+    } else {
+        if (reuse_dist > (uint64_t)1 << 53) {
+            LOGGER_WARN("lost precision on reuse distance %g", reuse_dist);
+        }
+        Histogram__insert_finite(hist, (uint64_t)reuse_dist);
+    }
+}
+
+static bool
+stream_to_histogram(struct IntervalStatistics *const me,
+                    struct Histogram *const hist)
+{
+    struct IntervalStatisticsReader reader = {0};
+    struct IntervalStatisticsItem item = {0};
+    if (!finish_stream(me)) {
+        LOGGER_ERROR("failed to stream to '%s'", me->writer->path);
+        return false;
+    }
+    if (!IntervalStatisticsReader__init(&reader, me->writer->path)) {
+        return false;
+    }
+    size_t n = 0;
+    for (; IntervalStatisticsReader__next(&reader, &item); ++n) {
+        insert_item(hist, &item);
+    }
+    IntervalStatisticsReader__destroy(&reader);
+    if (n != me->writer->num_items) {
+        LOGGER_ERROR("read %zu of %zu items from '%s'",
+                     n,
+                     me->writer->num_items,
+                     me->writer->path);
+        return false;
+    }
+    return true;
+}
+
 bool
-IntervalStatistics__to_histogram(struct IntervalStatistics const *const me,
+IntervalStatistics__to_histogram(struct IntervalStatistics *const me,
                                  struct Histogram *const hist,
                                  size_t const num_bins,
                                  size_t const bin_size)
@@ -129,18 +561,162 @@ IntervalStatistics__to_histogram(struct IntervalStatistics const *const me,
         return false;
     }
 
+    if (me->writer != NULL) {
+        if (!stream_to_histogram(me, hist)) {
+            Histogram__destroy(hist);
+            return false;
+        }
+        return true;
+    }
     for (size_t i = 0; i < me->length; ++i) {
-        double reuse_dist = me->stats[i].reuse_distance;
-        if (isnan(reuse_dist)) {
-            // NOTE NAN represents a non-sampled value.
-        } else if (isinf(reuse_dist)) {
-            Histogram__insert_infinite(hist);
-        } else {
-            if (reuse_dist > (uint64_t)1 << 53) {
-                LOGGER_WARN("lost precision on reuse distance %g", reuse_dist);
-            }
-            Histogram__insert_finite(hist, (uint64_t)reuse_dist);
+        insert_item(hist, &me->stats[i]);
+    }
+    return true;
+}
+
+bool
+IntervalStatisticsReader__init(struct IntervalStatisticsReader *const me,
+                               char const *const path)
+{
+    char magic[sizeof(COMPRESSED_MAGIC)] = {0};
+    uint64_t block_length = 0;
+    if (me == NULL || path == NULL) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    *me = (struct IntervalStatisticsReader){0};
+    me->fp = fopen(path, "rb");
+    if (me->fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", path);
+        return false;
+    }
+    if (fread(magic, sizeof(magic), 1, me->fp) == 1 &&
+        memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) == 0) {
+        if (fread(&block_length, sizeof(block_length), 1, me->fp) != 1 ||
+            block_length == 0) {
+            LOGGER_ERROR("bad header in '%s'", path);
+            goto cleanup;
+        }
+        me->compressed = true;
+        me->capacity = block_length;
+        me->varints_capacity =
+            FIELDS_PER_ITEM * MAX_VARINT_BYTES * block_length;
+        me->raw_capacity = FIELDS_PER_ITEM * block_length;
+        me->varints = malloc(me->varints_capacity);
+        me->raw = malloc(me->raw_capacity * sizeof(*me->raw));
+        if (me->varints == NULL || me->raw == NULL) {
+            LOGGER_ERROR("failed to allocate decoding buffers");
+            goto cleanup;
+        }
+    } else {
+        // NOTE A raw file is simply an array of items with no header.
+        rewind(me->fp);
+        me->compressed = false;
+        me->capacity = INTERVAL_STATISTICS_DEFAULT_BLOCK_LENGTH;
+    }
+    me->block = malloc(me->capacity * sizeof(*me->block));
+    if (me->block == NULL) {
+        LOGGER_ERROR("failed to allocate block");
+        goto cleanup;
+    }
+    return true;
+cleanup:
+    IntervalStatisticsReader__destroy(me);
+    return false;
+}
+
+static bool
+read_compressed_block(struct IntervalStatisticsReader *const me)
+{
+    uint64_t header[3] = {0};
+    if (fread(header, sizeof(header), 1, me->fp) != 1) {
+        // NOTE This is the regular end of the file.
+        return false;
+    }
+    uint64_t const length = header[0], num_varint_bytes = header[1],
+                   num_raw = header[2];
+    if (length > me->capacity || num_varint_bytes > me->varints_capacity ||
+        num_raw > me->raw_capacity) {
+        LOGGER_ERROR("corrupt block header {%" PRIu64 ", %" PRIu64
+                     ", %" PRIu64 "}",
+                     length,
+                     num_varint_bytes,
+                     num_raw);
+        return false;
+    }
+    if (fread(me->varints, 1, num_varint_bytes, me->fp) != num_varint_bytes ||
+        fread(me->raw, sizeof(*me->raw), num_raw, me->fp) != num_raw) {
+        LOGGER_ERROR("truncated block");
+        return false;
+    }
+
+    uint8_t const *cursor = me->varints;
+    uint8_t const *const end = &me->varints[num_varint_bytes];
+    uint64_t prev_dist = 0, prev_time = 0;
+    size_t raw_index = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (!decode_field(&cursor,
+                          end,
+                          &prev_dist,
+                          me->raw,
+                          num_raw,
+                          &raw_index,
+                          &me->block[i].reuse_distance) ||
+            !decode_field(&cursor,
+                          end,
+                          &prev_time,
+                          me->raw,
+                          num_raw,
+                          &raw_index,
+                          &me->block[i].reuse_time)) {
+            LOGGER_ERROR("corrupt block");
+            return false;
+        }
+    }
+    me->length = length;
+    me->index = 0;
+    return true;
+}
+
+static bool
+read_raw_block(struct IntervalStatisticsReader *const me)
+{
+    me->length = fread(me->block, sizeof(*me->block), me->capacity, me->fp);
+    me->index = 0;
+    return me->length != 0;
+}
+
+bool
+IntervalStatisticsReader__next(struct IntervalStatisticsReader *const me,
+                               struct IntervalStatisticsItem *const item)
+{
+    if (me == NULL || me->fp == NULL || item == NULL) {
+        return false;
+    }
+    // NOTE We loop in case a block is empty.
+    while (me->index >= me->length) {
+        bool const ok =
+            me->compressed ? read_compressed_block(me) : read_raw_block(me);
+        if (!ok) {
+            return false;
         }
     }
+    *item = me->block[me->index];
+    ++me->index;
     return true;
 }
+
+void
+IntervalStatisticsReader__destroy(struct IntervalStatisticsReader *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->fp != NULL) {
+        fclose(me->fp);
+    }
+    free(me->block);
+    free(me->varints);
+    free(me->raw);
+    *me = (struct IntervalStatisticsReader){0};
+}
@@ -8,6 +8,7 @@
 
 #include "io/io.h"
 #include "logger/logger.h"
+#include "memory/memory_placement.h"
 
 static bool
 file_to_mmap(struct MemoryMap *const me,
@@ -39,6 +40,9 @@ file_to_mmap(struct MemoryMap *const me,
     }
 
     buffer = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buffer != MAP_FAILED) {
+        MemoryPlacement__advise(buffer, sb.st_size);
+    }
     *me = (struct MemoryMap){.buffer = buffer, .num_bytes = sb.st_size};
     return true;
 }
@@ -9,11 +9,13 @@
 #include <glib.h>
 
 #include "array/print_array.h"
+#include "checkpoint/checkpoint.h"
 #include "hash/hash.h"
 #include "hash/types.h"
 #include "logger/logger.h"
 #include "lookup/evicting_hash_table.h"
 #include "math/ratio.h"
+#include "memory/memory_placement.h"
 #include "types/key_type.h"
 #include "types/time_stamp_type.h"
 #include "types/value_type.h"
@@ -38,6 +40,27 @@ hll_alpha_m(size_t m)
     }
 }
 
+/// @brief  Build the max tree from scratch.
+static void
+build_max_tree(struct EvictingHashTable *me)
+{
+    assert(me != NULL && me->hashes != NULL && me->max_tree != NULL);
+    size_t const num_blocks =
+        (me->length + EHT__BLOCK_SIZE - 1) / EHT__BLOCK_SIZE;
+    for (size_t i = 0; i < me->num_leaves; ++i) {
+        size_t const begin = i * EHT__BLOCK_SIZE;
+        size_t const end = begin + EHT__BLOCK_SIZE < me->length
+                               ? begin + EHT__BLOCK_SIZE
+                               : me->length;
+        // NOTE The padding leaves are zero so they never win.
+        me->max_tree[me->num_leaves + i] =
+            i < num_blocks ? EHT__block_max(me->hashes, begin, end) : 0;
+    }
+    for (size_t i = me->num_leaves - 1; i >= 1; --i) {
+        me->max_tree[i] = MAX(me->max_tree[2 * i], me->max_tree[2 * i + 1]);
+    }
+}
+
 bool
 EvictingHashTable__init(struct EvictingHashTable *me,
                         const size_t length,
@@ -55,8 +78,24 @@ EvictingHashTable__init(struct EvictingHashTable *me,
     Hash64BitType *hashes = malloc(length * sizeof(*hashes));
     if (hashes == NULL) {
         LOGGER_ERROR("failed to initialize hashes with length %zu", length);
+        free(data);
         return false;
     }
+    size_t const num_blocks = (length + EHT__BLOCK_SIZE - 1) / EHT__BLOCK_SIZE;
+    size_t num_leaves = 1;
+    while (num_leaves < num_blocks) {
+        num_leaves *= 2;
+    }
+    Hash64BitType *max_tree = malloc(2 * num_leaves * sizeof(*max_tree));
+    if (max_tree == NULL) {
+        LOGGER_ERROR("failed to initialize max tree with %zu leaves",
+                     num_leaves);
+        free(data);
+        free(hashes);
+        return false;
+    }
+    MemoryPlacement__advise(data, length * sizeof(*data));
+    MemoryPlacement__advise(hashes, length * sizeof(*hashes));
     // NOTE I'm not sure what the best way of representing all 1's. I
     //      don't want to rely on two's complement. I think it's safest
     //      to assume that 0 is represented by all zeros.
@@ -77,7 +116,10 @@ EvictingHashTable__init(struct EvictingHashTable *me,
         .running_denominator = length * init_sampling_ratio,
         .hll_alpha_m = hll_alpha_m(length),
         .track_global_threshold = true,
+        .max_tree = max_tree,
+        .num_leaves = num_leaves,
     };
+    build_max_tree(me);
     return true;
 }
 
@@ -113,8 +155,9 @@ EvictingHashTable__put(struct EvictingHashTable *me,
         return (struct SampledPutReturn){.status = SAMPLED_NOTFOUND};
 
     Hash64BitType hash = Hash64Bit(key);
-    ValueType *incumbent = &me->values[hash % me->length];
-    Hash64BitType *const hash_ptr = &me->hashes[hash % me->length];
+    size_t const index = hash % me->length;
+    ValueType *incumbent = &me->values[index];
+    Hash64BitType *const hash_ptr = &me->hashes[index];
     Hash64BitType const old_hash = *hash_ptr;
 
     ++me->num_inserted;
@@ -127,6 +170,7 @@ EvictingHashTable__put(struct EvictingHashTable *me,
         TimeStampType old_timestamp = *incumbent;
         *incumbent = value;
         *hash_ptr = hash;
+        EHT__update_max_tree(me, index, old_hash);
         return (struct SampledPutReturn){.status = SAMPLED_INSERTED,
                                          .new_hash = hash,
                                          .old_timestamp = old_timestamp};
@@ -135,6 +179,7 @@ EvictingHashTable__put(struct EvictingHashTable *me,
         TimeStampType old_timestamp = *incumbent;
         *incumbent = value;
         *hash_ptr = hash;
+        EHT__update_max_tree(me, index, old_hash);
         return (struct SampledPutReturn){.status = SAMPLED_REPLACED,
                                          .new_hash = hash,
                                          .old_timestamp = old_timestamp};
@@ -156,13 +201,53 @@ EvictingHashTable__refresh_threshold(struct EvictingHashTable *me)
 {
     if (!me || !me->hashes || !me->values || me->length == 0)
         return;
-    Hash64BitType max_hash = 0;
-    for (size_t i = 0; i < me->length; ++i) {
-        Hash64BitType hash = me->hashes[i];
-        if (hash > max_hash)
-            max_hash = hash;
+    // NOTE The root of the max tree is always up-to-date, so we don't
+    //      need to scan the hashes.
+    me->global_threshold = me->max_tree[1];
+}
+
+/// @note   We skip the hashes above the threshold, since we will ignore
+///         them without touching the table.
+static inline void
+prefetch_slot(struct EvictingHashTable const *const me,
+              Hash64BitType const hash)
+{
+    if (hash <= me->global_threshold) {
+        __builtin_prefetch(&me->hashes[hash % me->length], 1);
+        __builtin_prefetch(&me->values[hash % me->length], 1);
+    }
+}
+
+bool
+EvictingHashTable__try_put_batch(struct EvictingHashTable *me,
+                                 KeyType const *const keys,
+                                 ValueType const *const values,
+                                 size_t const num_keys,
+                                 struct SampledTryPutReturn *const results)
+{
+    // A ring of the hashes of the keys that we have prefetched.
+    Hash64BitType hashes[EHT__PREFETCH_DISTANCE];
+
+    if (!me || !me->hashes || !me->values || me->length == 0 ||
+        ((keys == NULL || values == NULL || results == NULL) &&
+         num_keys != 0)) {
+        return false;
+    }
+    for (size_t i = 0; i < num_keys && i < EHT__PREFETCH_DISTANCE; ++i) {
+        hashes[i] = Hash64Bit(keys[i]);
+        prefetch_slot(me, hashes[i]);
+    }
+    for (size_t i = 0; i < num_keys; ++i) {
+        Hash64BitType const hash = hashes[i % EHT__PREFETCH_DISTANCE];
+        if (i + EHT__PREFETCH_DISTANCE < num_keys) {
+            Hash64BitType const next =
+                Hash64Bit(keys[i + EHT__PREFETCH_DISTANCE]);
+            hashes[i % EHT__PREFETCH_DISTANCE] = next;
+            prefetch_slot(me, next);
+        }
+        results[i] = EHT__try_put_hash(me, hash, values[i]);
     }
-    me->global_threshold = max_hash;
+    return true;
 }
 
 void
@@ -200,6 +285,81 @@ EvictingHashTable__print_as_json(struct EvictingHashTable *me)
     printf("}\n");
 }
 
+bool
+EvictingHashTable__save_checkpoint(struct EvictingHashTable const *const me,
+                                   struct CheckpointWriter *const writer)
+{
+    if (me == NULL || me->hashes == NULL || me->values == NULL ||
+        writer == NULL)
+        return false;
+    // NOTE The max tree is derived from the hashes, so we rebuild it
+    //      rather than storing it.
+    return CheckpointWriter__write_u64(writer, me->global_threshold) &&
+           CheckpointWriter__write_u64(writer, me->num_inserted) &&
+           CheckpointWriter__write_f64(writer, me->running_denominator) &&
+           CheckpointWriter__write_f64(writer, me->scale_factor) &&
+           CheckpointWriter__write_u64(writer, me->track_global_threshold) &&
+           CheckpointWriter__write_array(writer,
+                                         me->hashes,
+                                         me->length,
+                                         sizeof(*me->hashes)) &&
+           CheckpointWriter__write_array(writer,
+                                         me->values,
+                                         me->length,
+                                         sizeof(*me->values));
+}
+
+bool
+EvictingHashTable__load_checkpoint(struct EvictingHashTable *const me,
+                                   struct CheckpointReader *const reader)
+{
+    uint64_t global_threshold = 0, num_inserted = 0, track = 0;
+    double running_denominator = 0.0, scale_factor = 0.0;
+    size_t num_hashes = 0, num_values = 0;
+    if (me == NULL || me->hashes == NULL || me->values == NULL ||
+        reader == NULL)
+        return false;
+    if (!CheckpointReader__read_u64(reader, &global_threshold) ||
+        !CheckpointReader__read_u64(reader, &num_inserted) ||
+        !CheckpointReader__read_f64(reader, &running_denominator) ||
+        !CheckpointReader__read_f64(reader, &scale_factor) ||
+        !CheckpointReader__read_u64(reader, &track))
+        return false;
+    Hash64BitType const *const hashes =
+        CheckpointReader__read_array(reader, &num_hashes, sizeof(*hashes));
+    ValueType const *const values =
+        CheckpointReader__read_array(reader, &num_values, sizeof(*values));
+    if (hashes == NULL || values == NULL || num_hashes != me->length ||
+        num_values != me->length) {
+        LOGGER_ERROR("expected %zu slots, got %zu hashes and %zu values",
+                     me->length,
+                     num_hashes,
+                     num_values);
+        return false;
+    }
+    memcpy(me->hashes, hashes, me->length * sizeof(*hashes));
+    memcpy(me->values, values, me->length * sizeof(*values));
+    me->global_threshold = global_threshold;
+    me->num_inserted = num_inserted;
+    me->running_denominator = running_denominator;
+    me->scale_factor = scale_factor;
+    me->track_global_threshold = track;
+    build_max_tree(me);
+    return true;
+}
+
+size_t
+EvictingHashTable__memory_usage(struct EvictingHashTable const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    size_t const max_tree_bytes =
+        me->max_tree == NULL ? 0 : 2 * me->num_leaves * sizeof(*me->max_tree);
+    return me->length * (sizeof(*me->hashes) + sizeof(*me->values)) +
+           max_tree_bytes;
+}
+
 void
 EvictingHashTable__destroy(struct EvictingHashTable *me)
 {
@@ -207,5 +367,6 @@ EvictingHashTable__destroy(struct EvictingHashTable *me)
         return;
     free(me->values);
     free(me->hashes);
+    free(me->max_tree);
     *me = (struct EvictingHashTable){0};
 }
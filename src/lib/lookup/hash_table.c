@@ -1,10 +1,12 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <glib.h>
 
 #include "arrays/is_last.h"
+#include "checkpoint/checkpoint.h"
 #include "logger/logger.h"
 #include "lookup/hash_table.h"
 #include "lookup/lookup.h"
@@ -146,6 +148,60 @@ HashTable__write_as_json(FILE *const stream, struct HashTable const *const me)
     fprintf(stream, "}\n");
 }
 
+bool
+HashTable__save_checkpoint(struct HashTable const *const me,
+                           struct CheckpointWriter *const writer)
+{
+    if (me == NULL || me->hash_table == NULL || writer == NULL)
+        return false;
+
+    // NOTE We flatten the pairs so that loading is a single read.
+    guint const size = g_hash_table_size(me->hash_table);
+    uint64_t *const pairs = malloc(2 * (size_t)size * sizeof(*pairs));
+    if (pairs == NULL && size != 0) {
+        LOGGER_ERROR("failed to allocate %u pairs", size);
+        return false;
+    }
+    GHashTableIter iter = {0};
+    gpointer key = NULL, value = NULL;
+    size_t i = 0;
+    g_hash_table_iter_init(&iter, me->hash_table);
+    while (i < size && g_hash_table_iter_next(&iter, &key, &value)) {
+        pairs[2 * i] = (uint64_t)key;
+        pairs[2 * i + 1] = (uint64_t)value;
+        ++i;
+    }
+    bool const ok =
+        i == size &&
+        CheckpointWriter__write_array(writer, pairs, size, 2 * sizeof(*pairs));
+    free(pairs);
+    return ok;
+}
+
+bool
+HashTable__load_checkpoint(struct HashTable *const me,
+                           struct CheckpointReader *const reader)
+{
+    size_t size = 0;
+    if (me == NULL || me->hash_table == NULL || reader == NULL)
+        return false;
+    uint64_t const *const pairs =
+        CheckpointReader__read_array(reader, &size, 2 * sizeof(*pairs));
+    if (pairs == NULL)
+        return false;
+    GHashTable *const hash_table = g_hash_table_new(g_direct_hash, NULL);
+    if (hash_table == NULL)
+        return false;
+    for (size_t i = 0; i < size; ++i) {
+        g_hash_table_insert(hash_table,
+                            (gpointer)pairs[2 * i],
+                            (gpointer)pairs[2 * i + 1]);
+    }
+    g_hash_table_destroy(me->hash_table);
+    me->hash_table = hash_table;
+    return true;
+}
+
 void
 HashTable__destroy(struct HashTable *const me)
 {
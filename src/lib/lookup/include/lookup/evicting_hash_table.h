@@ -37,6 +37,14 @@
 #include "types/value_type.h"
 #include "unused/mark_unused.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
+// The number of hashes summarized by each leaf of the max tree.
+#define EHT__BLOCK_SIZE 64
+// The number of keys ahead whose slots the batch operations prefetch.
+#define EHT__PREFETCH_DISTANCE 16
+
 struct EvictingHashTable {
     Hash64BitType *hashes;
     ValueType *values;
@@ -51,6 +59,15 @@ struct EvictingHashTable {
     double scale_factor;
 
     bool track_global_threshold;
+
+    // A tournament tree of the maximum hash. Leaf i (stored at index
+    // 'num_leaves + i') is the maximum of the i-th block of
+    // EHT__BLOCK_SIZE hashes and each internal node is the maximum of
+    // its two children, so the root (index 1) is the maximum hash.
+    // NOTE Hashes in the table only ever decrease, so an update only
+    //      has to rescan a block if it replaced the block's maximum.
+    Hash64BitType *max_tree;
+    size_t num_leaves;
 };
 
 enum SampledStatus {
@@ -100,9 +117,70 @@ EvictingHashTable__put(struct EvictingHashTable *me,
 /// @note   This is an optimization to try to match SHARDS's performance.
 ///         Without this, we slightly underperform SHARDS. I don't know
 ///         how the Splay Tree priority queue is so fast...
+/// @note   This is O(1) since we incrementally maintain the max tree.
 void
 EvictingHashTable__refresh_threshold(struct EvictingHashTable *me);
 
+/// @brief  Append the hashes, values, and estimator state to a checkpoint.
+bool
+EvictingHashTable__save_checkpoint(struct EvictingHashTable const *const me,
+                                   struct CheckpointWriter *const writer);
+
+/// @brief  Replace the table's contents with the next table in a
+///         checkpoint. The table must have the same length.
+bool
+EvictingHashTable__load_checkpoint(struct EvictingHashTable *const me,
+                                   struct CheckpointReader *const reader);
+
+static inline Hash64BitType
+EHT__block_max(Hash64BitType const *const hashes,
+               size_t const begin,
+               size_t const end)
+{
+    Hash64BitType max_hash = 0;
+    // NOTE This loop is simple enough for the compiler to vectorize.
+    for (size_t i = begin; i < end; ++i) {
+        max_hash = hashes[i] > max_hash ? hashes[i] : max_hash;
+    }
+    return max_hash;
+}
+
+/// @brief  Update the max tree after the hash at 'index' decreased from
+///         'old_hash'. This takes O(EHT__BLOCK_SIZE + log(n)) time in
+///         the worst case, but usually returns after one comparison.
+static inline void
+EHT__update_max_tree(struct EvictingHashTable *me,
+                     size_t const index,
+                     Hash64BitType const old_hash)
+{
+    size_t const block = index / EHT__BLOCK_SIZE;
+    size_t node = me->num_leaves + block;
+    // The block maximum can only change if we replaced it.
+    if (old_hash != me->max_tree[node]) {
+        return;
+    }
+    size_t const begin = block * EHT__BLOCK_SIZE;
+    size_t const end = begin + EHT__BLOCK_SIZE < me->length
+                           ? begin + EHT__BLOCK_SIZE
+                           : me->length;
+    Hash64BitType const new_max = EHT__block_max(me->hashes, begin, end);
+    if (new_max == old_hash) {
+        return;
+    }
+    me->max_tree[node] = new_max;
+    for (node /= 2; node >= 1; node /= 2) {
+        Hash64BitType const left = me->max_tree[2 * node];
+        Hash64BitType const right = me->max_tree[2 * node + 1];
+        Hash64BitType const max_hash = left > right ? left : right;
+        // Only one child changed, so if this node didn't change, then
+        // none of its ancestors will either.
+        if (max_hash == me->max_tree[node]) {
+            break;
+        }
+        me->max_tree[node] = max_hash;
+    }
+}
+
 /// @param  m: uint64_t const
 ///             Number of HLL counters.
 /// @param  V: uint64_t const
@@ -160,6 +238,7 @@ EHT__insert_new_element(struct EvictingHashTable *me,
 {
     *value_ptr = value;
     *hash_ptr = hash;
+    EHT__update_max_tree(me, hash_ptr - me->hashes, UINT64_MAX);
     ++me->num_inserted;
     if (me->num_inserted == me->length) {
         EvictingHashTable__refresh_threshold(me);
@@ -184,11 +263,12 @@ EHT__replace_incumbent_element(struct EvictingHashTable *me,
         .old_hash = old_hash,
         .old_value = *value_ptr,
     };
-    // NOTE Update the incumbent before we do the scan for the maximum
-    //      threshold because we want do not want to "find" that the
-    //      maximum hasn't changed.
+    // NOTE Update the incumbent and the max tree before we refresh the
+    //      maximum threshold because we want do not want to "find" that
+    //      the maximum hasn't changed.
     *value_ptr = value;
     *hash_ptr = hash;
+    EHT__update_max_tree(me, hash_ptr - me->hashes, old_hash);
     if (old_hash == me->global_threshold) {
         EvictingHashTable__refresh_threshold(me);
     }
@@ -216,27 +296,13 @@ EHT__update_incumbent_element(struct EvictingHashTable *me,
     return r;
 }
 
-/// @brief  Try to put a value into the hash table.
-/// @return A structure of the new hash value and the evicted data (if
-///         applicable).
-/// @note   This combines the lookup and put traditionally used by the
-///         MRC algorithm. I haven't thought too hard about whether all
-///         other MRC algorithms could similarly combine the lookup and
-///         put.
-/// @note   Defining this as a `static inline` function improves performance
-///         dramatically. In fact, without it, performance is much worse
-///         than the separate lookup and put. I'm not exactly sure why, but
-///         this has a much more complex return type. The performance is
-///         better this way than enabling link-time optimizations too.
+/// @brief  Try to put a value whose key has the given hash.
+/// @note   The table must be initialized.
 static inline struct SampledTryPutReturn
-EvictingHashTable__try_put(struct EvictingHashTable *me,
-                           KeyType key,
-                           ValueType value)
+EHT__try_put_hash(struct EvictingHashTable *me,
+                  Hash64BitType const hash,
+                  ValueType value)
 {
-    if (!me || !me->hashes || !me->values || me->length == 0)
-        return (struct SampledTryPutReturn){.status = SAMPLED_NOTFOUND};
-
-    Hash64BitType hash = Hash64Bit(key);
     if (hash > me->global_threshold)
         return (struct SampledTryPutReturn){.status = SAMPLED_IGNORED};
 
@@ -267,8 +333,48 @@ EvictingHashTable__try_put(struct EvictingHashTable *me,
     }
 }
 
+/// @brief  Try to put a value into the hash table.
+/// @return A structure of the new hash value and the evicted data (if
+///         applicable).
+/// @note   This combines the lookup and put traditionally used by the
+///         MRC algorithm. I haven't thought too hard about whether all
+///         other MRC algorithms could similarly combine the lookup and
+///         put.
+/// @note   Defining this as a `static inline` function improves performance
+///         dramatically. In fact, without it, performance is much worse
+///         than the separate lookup and put. I'm not exactly sure why, but
+///         this has a much more complex return type. The performance is
+///         better this way than enabling link-time optimizations too.
+static inline struct SampledTryPutReturn
+EvictingHashTable__try_put(struct EvictingHashTable *me,
+                           KeyType key,
+                           ValueType value)
+{
+    if (!me || !me->hashes || !me->values || me->length == 0)
+        return (struct SampledTryPutReturn){.status = SAMPLED_NOTFOUND};
+
+    return EHT__try_put_hash(me, Hash64Bit(key), value);
+}
+
+/// @brief  Try to put the pairs in order, as if by
+///         'EvictingHashTable__try_put'.
+/// @note   We hash the upcoming keys and prefetch their slots while we
+///         put the current one, so that their cache misses overlap. We
+///         still complete each put before the next, so a repeated key in
+///         the batch sees the earlier put as it would one by one.
+bool
+EvictingHashTable__try_put_batch(struct EvictingHashTable *me,
+                                 KeyType const *const keys,
+                                 ValueType const *const values,
+                                 size_t const num_keys,
+                                 struct SampledTryPutReturn *const results);
+
 void
 EvictingHashTable__print_as_json(struct EvictingHashTable *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+EvictingHashTable__memory_usage(struct EvictingHashTable const *const me);
+
 void
 EvictingHashTable__destroy(struct EvictingHashTable *me);
@@ -9,6 +9,9 @@
 
 #include <glib.h>
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct HashTable {
     GHashTable *hash_table;
 };
@@ -33,5 +36,16 @@ HashTable__remove(struct HashTable *const me, EntryType const key);
 void
 HashTable__write_as_json(FILE *const stream, struct HashTable const *const me);
 
+/// @brief  Append the key-value pairs to a checkpoint.
+bool
+HashTable__save_checkpoint(struct HashTable const *const me,
+                           struct CheckpointWriter *const writer);
+
+/// @brief  Replace the table's contents with the next table in a
+///         checkpoint.
+bool
+HashTable__load_checkpoint(struct HashTable *const me,
+                           struct CheckpointReader *const reader);
+
 void
 HashTable__destroy(struct HashTable *const me);
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -15,6 +16,12 @@
 //      just have a 'void *'. Who knows?
 struct kh_64_s;
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
+/// The number of keys ahead whose buckets the batch operations prefetch.
+#define KHASH_TABLE_PREFETCH_DISTANCE 16
+
 /// @brief  This implemenents a hash table with key and values of type
 ///         uint64_t. It uses the klib library backend.
 struct KHashTable {
@@ -27,6 +34,10 @@ KHashTable__init(struct KHashTable *const me);
 size_t
 KHashTable__get_size(struct KHashTable const *const me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+KHashTable__memory_usage(struct KHashTable const *const me);
+
 struct LookupReturn
 KHashTable__lookup(struct KHashTable const *const me, EntryType key);
 
@@ -36,13 +47,62 @@ KHashTable__put(struct KHashTable *const me,
                 EntryType const key,
                 TimeStampType const value);
 
+/// @brief  Prefetch the bucket where a lookup or put of the key starts.
+/// @note   This is only a hint, so it does not change the table.
+void
+KHashTable__prefetch(struct KHashTable const *const me, EntryType const key);
+
+/// @brief  Look up the keys in order, as if by 'KHashTable__lookup'.
+/// @note   We prefetch the buckets of the upcoming keys while we look up
+///         the current one, so that their cache misses overlap.
+bool
+KHashTable__lookup_batch(struct KHashTable const *const me,
+                         EntryType const *const keys,
+                         size_t const num_keys,
+                         struct LookupReturn *const results);
+
+/// @brief  Put the pairs in order, as if by 'KHashTable__put'.
+/// @note   We prefetch like 'KHashTable__lookup_batch', but we complete
+///         each put before starting the next, so a repeated key in the
+///         batch replaces the earlier value as it would one by one.
+/// @param  statuses: the status of each put or NULL to ignore them.
+/// @return false if any put errored.
+bool
+KHashTable__put_batch(struct KHashTable *const me,
+                      EntryType const *const keys,
+                      TimeStampType const *const values,
+                      size_t const num_keys,
+                      enum PutUniqueStatus *const statuses);
+
 struct LookupReturn
 KHashTable__remove(struct KHashTable *const me, EntryType const key);
 
+/// @brief  Remove every entry for which the predicate returns true.
+/// @note   The predicate may release whatever else the entry owns (e.g.
+///         its node in a tree), but it must not modify this table.
+/// @return the number of entries that we removed.
+size_t
+KHashTable__remove_if(struct KHashTable *const me,
+                      bool (*predicate)(void *data,
+                                        EntryType key,
+                                        TimeStampType value),
+                      void *data);
+
 bool
 KHashTable__write(struct KHashTable const *const me,
                   FILE *const stream,
                   bool const newline);
 
+/// @brief  Append the raw buckets to a checkpoint.
+bool
+KHashTable__save_checkpoint(struct KHashTable const *const me,
+                            struct CheckpointWriter *const writer);
+
+/// @brief  Replace the table's contents with the next table in a
+///         checkpoint. We copy the buckets directly, so we do not rehash.
+bool
+KHashTable__load_checkpoint(struct KHashTable *const me,
+                            struct CheckpointReader *const reader);
+
 void
 KHashTable__destroy(struct KHashTable *const me);
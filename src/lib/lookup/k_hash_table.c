@@ -5,13 +5,34 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "khash.h"
+#include "checkpoint/checkpoint.h"
 #include "lookup/k_hash_table.h"
 #include "lookup/lookup.h"
+#include "memory/memory_placement.h"
 #include "types/entry_type.h"
 #include "types/time_stamp_type.h"
 
+/// @brief  Allocate khash's bucket arrays and advise huge pages for them.
+/// @note   We advise before khash fills the new buckets, because the
+///         kernel chooses the page size when it first touches a page.
+static inline void *
+realloc_buckets(void *const ptr, size_t const size)
+{
+    void *const new_ptr = realloc(ptr, size);
+    if (new_ptr != NULL) {
+        MemoryPlacement__advise(new_ptr, size);
+    }
+    return new_ptr;
+}
+
+// NOTE These must precede the khash.h include.
+#define kmalloc(Z)     realloc_buckets(NULL, Z)
+#define krealloc(P, Z) realloc_buckets(P, Z)
+#include "khash.h"
+
 // NOTE If I were to put this in the header, then I would be dumping
 //      a whole whack of unwanted symbols into the header namespace.
 //      I did have to do some sketchy stuff, such as directly using the
@@ -35,6 +56,18 @@ KHashTable__get_size(struct KHashTable const *const me)
     return kh_size(me->hash_table);
 }
 
+size_t
+KHashTable__memory_usage(struct KHashTable const *const me)
+{
+    if (me == NULL || me->hash_table == NULL) {
+        return 0;
+    }
+    khint_t const n = me->hash_table->n_buckets;
+    return sizeof(*me->hash_table) + n * sizeof(*me->hash_table->keys) +
+           n * sizeof(*me->hash_table->vals) +
+           __ac_fsize(n) * sizeof(*me->hash_table->flags);
+}
+
 struct LookupReturn
 KHashTable__lookup(struct KHashTable const *const me, EntryType key)
 {
@@ -73,6 +106,93 @@ KHashTable__put(struct KHashTable *const me,
                     : LOOKUP_PUTUNIQUE_INSERT_KEY_VALUE;
 }
 
+/// @param  rw: 1 if we will write to the bucket, otherwise 0.
+/// @note   The hints must be compile-time constants.
+#define PREFETCH_BUCKET(h, key, rw)                                            \
+    do {                                                                       \
+        khint_t const i__ = kh_int64_hash_func(key) & ((h)->n_buckets - 1);    \
+        __builtin_prefetch(&(h)->flags[i__ >> 4], (rw));                       \
+        __builtin_prefetch(&(h)->keys[i__], (rw));                             \
+        __builtin_prefetch(&(h)->vals[i__], (rw));                             \
+    } while (0)
+
+void
+KHashTable__prefetch(struct KHashTable const *const me, EntryType const key)
+{
+    // NOTE An empty table has no buckets (so no arrays) yet.
+    if (me == NULL || me->hash_table == NULL ||
+        me->hash_table->n_buckets == 0) {
+        return;
+    }
+    PREFETCH_BUCKET(me->hash_table, key, 0);
+}
+
+bool
+KHashTable__lookup_batch(struct KHashTable const *const me,
+                         EntryType const *const keys,
+                         size_t const num_keys,
+                         struct LookupReturn *const results)
+{
+    if (me == NULL || me->hash_table == NULL ||
+        ((keys == NULL || results == NULL) && num_keys != 0)) {
+        return false;
+    }
+    khash_t(64) const *const h = me->hash_table;
+    if (h->n_buckets == 0) {
+        for (size_t i = 0; i < num_keys; ++i) {
+            results[i] = (struct LookupReturn){.success = false};
+        }
+        return true;
+    }
+    for (size_t i = 0; i < num_keys && i < KHASH_TABLE_PREFETCH_DISTANCE;
+         ++i) {
+        PREFETCH_BUCKET(h, keys[i], 0);
+    }
+    for (size_t i = 0; i < num_keys; ++i) {
+        if (i + KHASH_TABLE_PREFETCH_DISTANCE < num_keys) {
+            PREFETCH_BUCKET(h, keys[i + KHASH_TABLE_PREFETCH_DISTANCE], 0);
+        }
+        results[i] = KHashTable__lookup(me, keys[i]);
+    }
+    return true;
+}
+
+bool
+KHashTable__put_batch(struct KHashTable *const me,
+                      EntryType const *const keys,
+                      TimeStampType const *const values,
+                      size_t const num_keys,
+                      enum PutUniqueStatus *const statuses)
+{
+    bool ok = true;
+    if (me == NULL || me->hash_table == NULL ||
+        ((keys == NULL || values == NULL) && num_keys != 0)) {
+        return false;
+    }
+    khash_t(64) *const h = me->hash_table;
+    for (size_t i = 0; i < num_keys && i < KHASH_TABLE_PREFETCH_DISTANCE &&
+                       h->n_buckets != 0;
+         ++i) {
+        PREFETCH_BUCKET(h, keys[i], 1);
+    }
+    for (size_t i = 0; i < num_keys; ++i) {
+        // NOTE A put may resize the table, so we read the arrays afresh
+        //      for each prefetch. A stale prefetch only wastes a load.
+        if (i + KHASH_TABLE_PREFETCH_DISTANCE < num_keys &&
+            h->n_buckets != 0) {
+            PREFETCH_BUCKET(h, keys[i + KHASH_TABLE_PREFETCH_DISTANCE], 1);
+        }
+        enum PutUniqueStatus const s = KHashTable__put(me, keys[i], values[i]);
+        if (s == LOOKUP_PUTUNIQUE_ERROR) {
+            ok = false;
+        }
+        if (statuses != NULL) {
+            statuses[i] = s;
+        }
+    }
+    return ok;
+}
+
 struct LookupReturn
 KHashTable__remove(struct KHashTable *const me, EntryType const key)
 {
@@ -82,6 +202,11 @@ KHashTable__remove(struct KHashTable *const me, EntryType const key)
     khiter_t k;
     k = kh_get(64, me->hash_table, key);
     bool const found = (k != kh_end(me->hash_table));
+    if (!found) {
+        // NOTE The end iterator is one past the last bucket, so we must
+        //      not read its value.
+        return (struct LookupReturn){.success = false, .timestamp = 0};
+    }
     uint64_t const stolen_value = kh_value(me->hash_table, k);
     kh_del(64, me->hash_table, k);
     // NOTE We assume that a found item implies a successful deletion.
@@ -90,6 +215,30 @@ KHashTable__remove(struct KHashTable *const me, EntryType const key)
                                  .timestamp = (TimeStampType)stolen_value};
 }
 
+size_t
+KHashTable__remove_if(struct KHashTable *const me,
+                      bool (*predicate)(void *data,
+                                        EntryType key,
+                                        TimeStampType value),
+                      void *data)
+{
+    if (me == NULL || me->hash_table == NULL || predicate == NULL)
+        return 0;
+    size_t num_removed = 0;
+    // NOTE Deleting only marks the bucket, so we can keep iterating.
+    for (khiter_t k = kh_begin(me->hash_table); k != kh_end(me->hash_table);
+         ++k) {
+        if (kh_exist(me->hash_table, k) &&
+            predicate(data,
+                      kh_key(me->hash_table, k),
+                      kh_value(me->hash_table, k))) {
+            kh_del(64, me->hash_table, k);
+            ++num_removed;
+        }
+    }
+    return num_removed;
+}
+
 bool
 KHashTable__write(struct KHashTable const *const me,
                   FILE *const stream,
@@ -118,6 +267,80 @@ KHashTable__write(struct KHashTable const *const me,
     return true;
 }
 
+bool
+KHashTable__save_checkpoint(struct KHashTable const *const me,
+                            struct CheckpointWriter *const writer)
+{
+    if (me == NULL || me->hash_table == NULL || writer == NULL)
+        return false;
+    kh_64_t const *const h = me->hash_table;
+    return CheckpointWriter__write_u64(writer, h->size) &&
+           CheckpointWriter__write_u64(writer, h->n_occupied) &&
+           CheckpointWriter__write_u64(writer, h->upper_bound) &&
+           CheckpointWriter__write_array(writer,
+                                         h->flags,
+                                         h->n_buckets == 0
+                                             ? 0
+                                             : __ac_fsize(h->n_buckets),
+                                         sizeof(*h->flags)) &&
+           CheckpointWriter__write_array(writer,
+                                         h->keys,
+                                         h->n_buckets,
+                                         sizeof(*h->keys)) &&
+           CheckpointWriter__write_array(writer,
+                                         h->vals,
+                                         h->n_buckets,
+                                         sizeof(*h->vals));
+}
+
+bool
+KHashTable__load_checkpoint(struct KHashTable *const me,
+                            struct CheckpointReader *const reader)
+{
+    uint64_t size = 0, n_occupied = 0, upper_bound = 0;
+    size_t num_flags = 0, num_keys = 0, num_vals = 0;
+    if (me == NULL || me->hash_table == NULL || reader == NULL)
+        return false;
+    if (!CheckpointReader__read_u64(reader, &size) ||
+        !CheckpointReader__read_u64(reader, &n_occupied) ||
+        !CheckpointReader__read_u64(reader, &upper_bound))
+        return false;
+    khint32_t const *const flags =
+        CheckpointReader__read_array(reader, &num_flags, sizeof(*flags));
+    uint64_t const *const keys =
+        CheckpointReader__read_array(reader, &num_keys, sizeof(*keys));
+    uint64_t const *const vals =
+        CheckpointReader__read_array(reader, &num_vals, sizeof(*vals));
+    if (flags == NULL || keys == NULL || vals == NULL ||
+        num_keys != num_vals ||
+        num_flags != (num_keys == 0 ? 0 : __ac_fsize(num_keys)) ||
+        num_keys > UINT32_MAX || size > n_occupied || n_occupied > num_keys)
+        return false;
+
+    kh_64_t *const h = kh_init(64);
+    if (h == NULL)
+        return false;
+    if (num_keys != 0) {
+        h->flags = kmalloc(num_flags * sizeof(*flags));
+        h->keys = kmalloc(num_keys * sizeof(*keys));
+        h->vals = kmalloc(num_vals * sizeof(*vals));
+        if (h->flags == NULL || h->keys == NULL || h->vals == NULL) {
+            kh_destroy(64, h);
+            return false;
+        }
+        memcpy(h->flags, flags, num_flags * sizeof(*flags));
+        memcpy(h->keys, keys, num_keys * sizeof(*keys));
+        memcpy(h->vals, vals, num_vals * sizeof(*vals));
+    }
+    h->n_buckets = num_keys;
+    h->size = size;
+    h->n_occupied = n_occupied;
+    h->upper_bound = upper_bound;
+    kh_destroy(64, me->hash_table);
+    me->hash_table = h;
+    return true;
+}
+
 void
 KHashTable__destroy(struct KHashTable *const me)
 {
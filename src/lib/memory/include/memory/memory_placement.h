@@ -0,0 +1,119 @@
+/** @brief  Opt-in huge pages and NUMA placement for large memory.
+ *
+ *  Our traces (up to 100 GB) and tables (several GB) suffer many TLB
+ *  misses with the default 4 KiB pages. On a multi-socket host, the
+ *  worker threads also read the trace and their state from whichever
+ *  node first touched them, which is often remote.
+ *
+ *  Everything is disabled by default, in which case every hook is a
+ *  single branch on a global setting. Enable it with the environment
+ *  variables:
+ *  - MRC_HUGE_PAGES=madvise: advise transparent huge pages (i.e.
+ *    MADV_HUGEPAGE) for trace maps and large tables.
+ *  - MRC_HUGE_PAGES=hugetlb: additionally back the trace replicas with
+ *    reserved huge pages (i.e. MAP_HUGETLB), falling back to transparent
+ *    huge pages if none are free.
+ *  - MRC_NUMA=pin: pin each worker thread to a node in turn, so that
+ *    it allocates its state on that node.
+ *  - MRC_NUMA=replicate: also give each node its own copy of the trace.
+ *
+ *  @note   We use the system calls directly rather than libnuma, so that
+ *          this has no extra dependencies.
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum HugePageMode {
+    HUGE_PAGE_MODE_OFF,
+    HUGE_PAGE_MODE_MADVISE,
+    HUGE_PAGE_MODE_HUGETLB,
+};
+
+enum NumaMode {
+    NUMA_MODE_OFF,
+    NUMA_MODE_PIN,
+    NUMA_MODE_REPLICATE,
+};
+
+struct MemoryPlacement {
+    enum HugePageMode huge_pages;
+    enum NumaMode numa;
+};
+
+/// @note   Do not modify this directly; use 'MemoryPlacement__configure'.
+extern struct MemoryPlacement memory_placement;
+
+bool
+MemoryPlacement__configure(enum HugePageMode const huge_pages,
+                           enum NumaMode const numa);
+
+/// @brief  Configure from MRC_HUGE_PAGES and MRC_NUMA (see above).
+/// @return false if a variable is set to an unrecognized value.
+bool
+MemoryPlacement__configure_from_env(void);
+
+/// @brief  Advise huge pages for the huge-page-aligned part of a region.
+/// @note   This is only a hint, so we ignore failures. It is most
+///         effective before the region is first touched, e.g. right
+///         after a large malloc or calloc.
+void
+MemoryPlacement__advise_slow(void *const ptr, size_t const num_bytes);
+
+static inline void
+MemoryPlacement__advise(void *const ptr, size_t const num_bytes)
+{
+    if (memory_placement.huge_pages != HUGE_PAGE_MODE_OFF) {
+        MemoryPlacement__advise_slow(ptr, num_bytes);
+    }
+}
+
+/// @brief  Map anonymous memory with the configured huge pages.
+/// @param  node: the NUMA node to bind the memory to or -1 for any.
+/// @return the zeroed memory or NULL on error. Free it with
+///         'MemoryPlacement__free' and the same size.
+void *
+MemoryPlacement__alloc(size_t const num_bytes, int const node);
+
+void
+MemoryPlacement__free(void *const ptr, size_t const num_bytes);
+
+/// @brief  Get the number of online NUMA nodes (1 if unknown).
+int
+MemoryPlacement__get_num_nodes(void);
+
+/// @brief  Get the ID of online node 'index mod number of nodes'.
+/// @note   The online node IDs may have gaps (e.g. 0 and 2), so the
+///         index is not necessarily the ID.
+/// @return the node ID (0 if unknown) or -1 if the index is negative.
+int
+MemoryPlacement__get_node(int const index);
+
+/// @brief  Pin the calling thread to the CPUs of a node.
+bool
+MemoryPlacement__pin_thread_to_node(int const node);
+
+/// @brief  Pin the calling worker thread to the node
+///         'MemoryPlacement__get_node(id)' if configured, otherwise do
+///         nothing.
+/// @note   Call this before the worker allocates its state, so that the
+///         kernel places the state on the local node.
+bool
+MemoryPlacement__pin_worker(int const id);
+
+/// @brief  Get the node that the calling thread is pinned to or -1.
+int
+MemoryPlacement__get_thread_node(void);
+
+/// @brief  Get the index (among the online nodes) of the node that the
+///         calling thread is pinned to or -1.
+int
+MemoryPlacement__get_thread_node_index(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
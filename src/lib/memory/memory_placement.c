@@ -0,0 +1,343 @@
+// NOTE We need this for the CPU set macros and 'pthread_setaffinity_np'.
+#define _GNU_SOURCE
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger/logger.h"
+#include "memory/memory_placement.h"
+
+// The size of a (transparent) huge page on x86-64.
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define NODE_DIRECTORY "/sys/devices/system/node"
+
+struct MemoryPlacement memory_placement = {.huge_pages = HUGE_PAGE_MODE_OFF,
+                                           .numa = NUMA_MODE_OFF};
+
+static _Thread_local int thread_node = -1;
+static _Thread_local int thread_node_index = -1;
+
+static char const *const HUGE_PAGE_MODE_NAMES[] = {"off", "madvise", "hugetlb"};
+static char const *const NUMA_MODE_NAMES[] = {"off", "pin", "replicate"};
+
+bool
+MemoryPlacement__configure(enum HugePageMode const huge_pages,
+                           enum NumaMode const numa)
+{
+    if (huge_pages > HUGE_PAGE_MODE_HUGETLB || numa > NUMA_MODE_REPLICATE) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    memory_placement =
+        (struct MemoryPlacement){.huge_pages = huge_pages, .numa = numa};
+    if (huge_pages != HUGE_PAGE_MODE_OFF || numa != NUMA_MODE_OFF) {
+        LOGGER_INFO("huge pages: %s, NUMA: %s (%d nodes)",
+                    HUGE_PAGE_MODE_NAMES[huge_pages],
+                    NUMA_MODE_NAMES[numa],
+                    MemoryPlacement__get_num_nodes());
+    }
+    return true;
+}
+
+/// @return the index of 'str' in 'names' or -1 if absent.
+static int
+parse_mode(char const *const str,
+           char const *const *const names,
+           int const num_names)
+{
+    for (int i = 0; i < num_names; ++i) {
+        if (strcmp(str, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool
+MemoryPlacement__configure_from_env(void)
+{
+    char const *const huge_pages_str = getenv("MRC_HUGE_PAGES");
+    char const *const numa_str = getenv("MRC_NUMA");
+    int huge_pages = HUGE_PAGE_MODE_OFF, numa = NUMA_MODE_OFF;
+
+    if (huge_pages_str != NULL && huge_pages_str[0] != '\0') {
+        huge_pages = parse_mode(huge_pages_str, HUGE_PAGE_MODE_NAMES, 3);
+        if (huge_pages == -1) {
+            LOGGER_ERROR("bad MRC_HUGE_PAGES='%s' (expected off, madvise, "
+                         "or hugetlb)",
+                         huge_pages_str);
+            return false;
+        }
+    }
+    if (numa_str != NULL && numa_str[0] != '\0') {
+        numa = parse_mode(numa_str, NUMA_MODE_NAMES, 3);
+        if (numa == -1) {
+            LOGGER_ERROR("bad MRC_NUMA='%s' (expected off, pin, or "
+                         "replicate)",
+                         numa_str);
+            return false;
+        }
+    }
+    return MemoryPlacement__configure(huge_pages, numa);
+}
+
+void
+MemoryPlacement__advise_slow(void *const ptr, size_t const num_bytes)
+{
+    uintptr_t const begin =
+        ((uintptr_t)ptr + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    uintptr_t const end = ((uintptr_t)ptr + num_bytes) & ~(HUGE_PAGE_SIZE - 1);
+    if (ptr == NULL || begin >= end) {
+        return;
+    }
+    // NOTE This fails if the kernel lacks transparent huge pages (or, for
+    //      a file, read-only huge pages for file systems). The memory
+    //      still works with small pages, so we do not complain.
+    madvise((void *)begin, end - begin, MADV_HUGEPAGE);
+}
+
+static size_t
+round_up_to_huge_page(size_t const num_bytes)
+{
+    return (num_bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+static bool
+bind_to_node(void *const ptr, size_t const num_bytes, int const node)
+{
+    unsigned long mask = 0;
+    if (node < 0 || node >= (int)(8 * sizeof(mask))) {
+        LOGGER_ERROR("unsupported node %d", node);
+        return false;
+    }
+    mask = 1UL << node;
+    if (syscall(SYS_mbind,
+                ptr,
+                num_bytes,
+                MPOL_BIND,
+                &mask,
+                // NOTE The kernel reads 'maxnode - 1' bits of the mask.
+                8 * sizeof(mask) + 1,
+                0) != 0) {
+        LOGGER_ERROR("failed to bind memory to node %d", node);
+        return false;
+    }
+    return true;
+}
+
+void *
+MemoryPlacement__alloc(size_t const num_bytes, int const node)
+{
+    size_t const size = round_up_to_huge_page(num_bytes);
+    void *ptr = MAP_FAILED;
+    if (num_bytes == 0) {
+        LOGGER_ERROR("bad input");
+        return NULL;
+    }
+    if (memory_placement.huge_pages == HUGE_PAGE_MODE_HUGETLB) {
+        ptr = mmap(NULL,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1,
+                   0);
+        if (ptr == MAP_FAILED) {
+            LOGGER_WARN("no free reserved huge pages for %zu bytes, so we "
+                        "fall back to transparent huge pages",
+                        size);
+        }
+    }
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1,
+                   0);
+        if (ptr == MAP_FAILED) {
+            LOGGER_ERROR("failed to map %zu bytes", size);
+            return NULL;
+        }
+        MemoryPlacement__advise(ptr, size);
+    }
+    // NOTE We bind before touching the memory, because the kernel places
+    //      each page when it is first touched.
+    if (node >= 0 && !bind_to_node(ptr, size, node)) {
+        munmap(ptr, size);
+        return NULL;
+    }
+    return ptr;
+}
+
+void
+MemoryPlacement__free(void *const ptr, size_t const num_bytes)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    if (munmap(ptr, round_up_to_huge_page(num_bytes)) != 0) {
+        LOGGER_ERROR("failed to unmap region");
+    }
+}
+
+/// @brief  Parse a CPU list (e.g. "0-3,8,10-11") into a CPU set.
+/// @note   We also use this for lists of node IDs.
+static bool
+parse_cpu_list(char const *str, cpu_set_t *const cpus)
+{
+    CPU_ZERO(cpus);
+    while (*str != '\0' && *str != '\n') {
+        char *end = NULL;
+        unsigned long const first = strtoul(str, &end, 10);
+        unsigned long last = first;
+        if (end == str) {
+            return false;
+        }
+        if (*end == '-') {
+            str = end + 1;
+            last = strtoul(str, &end, 10);
+            if (end == str || last < first) {
+                return false;
+            }
+        }
+        for (unsigned long cpu = first; cpu <= last && cpu < CPU_SETSIZE;
+             ++cpu) {
+            CPU_SET(cpu, cpus);
+        }
+        str = *end == ',' ? end + 1 : end;
+    }
+    return CPU_COUNT(cpus) != 0;
+}
+
+/// @brief  Read the IDs of the online nodes, which may have gaps.
+static bool
+get_online_nodes(cpu_set_t *const nodes)
+{
+    char list[4096] = {0};
+    FILE *fp = fopen(NODE_DIRECTORY "/online", "r");
+    if (fp == NULL) {
+        return false;
+    }
+    bool const ok = fgets(list, sizeof(list), fp) != NULL &&
+                    parse_cpu_list(list, nodes);
+    fclose(fp);
+    return ok;
+}
+
+int
+MemoryPlacement__get_num_nodes(void)
+{
+    cpu_set_t nodes;
+    if (!get_online_nodes(&nodes)) {
+        return 1;
+    }
+    return CPU_COUNT(&nodes);
+}
+
+int
+MemoryPlacement__get_node(int const index)
+{
+    cpu_set_t nodes;
+    if (index < 0) {
+        LOGGER_ERROR("bad input");
+        return -1;
+    }
+    if (!get_online_nodes(&nodes)) {
+        return 0;
+    }
+    for (int node = 0, i = index % CPU_COUNT(&nodes); node < CPU_SETSIZE;
+         ++node) {
+        if (CPU_ISSET(node, &nodes) && i-- == 0) {
+            return node;
+        }
+    }
+    return 0;
+}
+
+/// @return the index of 'node' among the online nodes or -1 if offline.
+static int
+get_node_index(int const node)
+{
+    cpu_set_t nodes;
+    int index = 0;
+    if (!get_online_nodes(&nodes)) {
+        return node == 0 ? 0 : -1;
+    }
+    if (node < 0 || node >= CPU_SETSIZE || !CPU_ISSET(node, &nodes)) {
+        return -1;
+    }
+    for (int i = 0; i < node; ++i) {
+        index += CPU_ISSET(i, &nodes) ? 1 : 0;
+    }
+    return index;
+}
+
+bool
+MemoryPlacement__pin_thread_to_node(int const node)
+{
+    char path[64] = {0}, cpu_list[4096] = {0};
+    cpu_set_t cpus;
+    FILE *fp = NULL;
+    int err = 0;
+
+    snprintf(path, sizeof(path), NODE_DIRECTORY "/node%d/cpulist", node);
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        // NOTE Without NUMA support, there is only node 0 with every CPU.
+        if (node == 0) {
+            thread_node = 0;
+            thread_node_index = 0;
+            return true;
+        }
+        LOGGER_ERROR("failed to open '%s'", path);
+        return false;
+    }
+    bool const ok = fgets(cpu_list, sizeof(cpu_list), fp) != NULL &&
+                    parse_cpu_list(cpu_list, &cpus);
+    fclose(fp);
+    if (!ok) {
+        LOGGER_ERROR("failed to parse '%s'", path);
+        return false;
+    }
+    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))) {
+        LOGGER_ERROR("failed to pin thread to node %d (error %d)", node, err);
+        return false;
+    }
+    thread_node = node;
+    thread_node_index = get_node_index(node);
+    return true;
+}
+
+bool
+MemoryPlacement__pin_worker(int const id)
+{
+    if (memory_placement.numa == NUMA_MODE_OFF) {
+        return true;
+    }
+    if (id < 0) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    return MemoryPlacement__pin_thread_to_node(MemoryPlacement__get_node(id));
+}
+
+int
+MemoryPlacement__get_thread_node(void)
+{
+    return thread_node;
+}
+
+int
+MemoryPlacement__get_thread_node_index(void)
+{
+    return thread_node_index;
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#ifdef __cplusplus
+extern "C" {
+#define restrict __restrict__
+#endif /* __cplusplus */
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -8,6 +13,9 @@
 #include "histogram/fractional_histogram.h"
 #include "histogram/histogram.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct MissRateCurve {
     double *miss_rate;
     size_t num_bins;
@@ -50,6 +58,18 @@ bool
 MissRateCurve__load(struct MissRateCurve *const me,
                     char const *restrict const file_name);
 
+/// @brief  Append the dense MRC to a checkpoint.
+/// @note   Unlike the other functions, this accepts an empty MRC (i.e.
+///         {0}), since algorithms may not have created theirs yet.
+bool
+MissRateCurve__save_checkpoint(struct MissRateCurve const *const me,
+                               struct CheckpointWriter *const writer);
+
+/// @brief  Replace the MRC with the next one in a checkpoint.
+bool
+MissRateCurve__load_checkpoint(struct MissRateCurve *const me,
+                               struct CheckpointReader *const reader);
+
 /// @note   This is useful when trying to average many MRCs without
 ///         needing to load all of the histograms at once.
 /// @note   I am not entirely content with the semantics of this function.
@@ -87,3 +107,7 @@ MissRateCurve__validate(struct MissRateCurve *me);
 
 void
 MissRateCurve__destroy(struct MissRateCurve *me);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
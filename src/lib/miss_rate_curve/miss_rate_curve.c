@@ -12,6 +12,7 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include "checkpoint/checkpoint.h"
 #include "histogram/fractional_histogram.h"
 #include "io/io.h"
 #include "logger/logger.h"
@@ -80,6 +81,7 @@ MissRateCurve__init_from_fractional_histogram(
         histogram->num_bins == 0) {
         return false;
     }
+    FractionalHistogram__materialize(histogram);
     // NOTE We include 1 past the histogram length to record "false infinities",
     //      i.e. elements past the maximum length of the histogram.
     const uint64_t num_bins = histogram->num_bins + 2;
@@ -115,6 +117,66 @@ MissRateCurve__init_from_fractional_histogram(
     return true;
 }
 
+/// @brief  The maximum number of bins in an MRC that we generate from a
+///         logarithmic histogram.
+static size_t const MAX_NUM_LOG_MRC_BINS = (size_t)1 << 20;
+
+/// @brief  Generate a uniformly binned MRC from a logarithmic histogram.
+/// @note   We pick the smallest power-of-two bin size that covers the
+///         used range in MAX_NUM_LOG_MRC_BINS bins and interpolate
+///         linearly within each (possibly wide) logarithmic bin.
+static bool
+init_from_log_histogram(struct MissRateCurve *const me,
+                        struct Histogram const *const histogram)
+{
+    size_t num_used_bins = histogram->num_bins;
+    while (num_used_bins > 0 && histogram->histogram[num_used_bins - 1] == 0) {
+        --num_used_bins;
+    }
+    uint64_t const max_distance =
+        Histogram__get_bin_start(histogram, num_used_bins);
+    uint64_t bin_size = 1;
+    while (max_distance / bin_size > MAX_NUM_LOG_MRC_BINS) {
+        bin_size *= 2;
+    }
+    uint64_t const length = max_distance / bin_size +
+                            (max_distance % bin_size != 0);
+    // NOTE We include 1 past the histogram length to record "false
+    //      infinities", like the linear histograms.
+    uint64_t const num_bins = length + 2;
+    me->miss_rate = (double *)malloc(num_bins * sizeof(*me->miss_rate));
+    if (me->miss_rate == NULL) {
+        return false;
+    }
+    me->num_bins = num_bins;
+    me->bin_size = bin_size;
+
+    double const total = histogram->running_sum;
+    // Number of accesses in the logarithmic bins below the j-th bin.
+    uint64_t below = 0;
+    size_t j = 0;
+    for (uint64_t i = 0; i < length; ++i) {
+        uint64_t const distance = i * bin_size;
+        while (j < num_used_bins &&
+               Histogram__get_bin_start(histogram, j + 1) <= distance) {
+            below += histogram->histogram[j];
+            ++j;
+        }
+        double partial = 0.0;
+        if (j < num_used_bins) {
+            uint64_t const lo = Histogram__get_bin_start(histogram, j);
+            uint64_t const hi = Histogram__get_bin_start(histogram, j + 1);
+            partial = (double)histogram->histogram[j] * (distance - lo) /
+                      (hi - lo);
+        }
+        me->miss_rate[i] = (total - below - partial) / total;
+    }
+    me->miss_rate[length] =
+        (double)(histogram->false_infinity + histogram->infinity) / total;
+    me->miss_rate[length + 1] = (double)histogram->infinity / total;
+    return true;
+}
+
 bool
 MissRateCurve__init_from_histogram(struct MissRateCurve *me,
                                    struct Histogram const *const histogram)
@@ -126,6 +188,9 @@ MissRateCurve__init_from_histogram(struct MissRateCurve *me,
     if (histogram->running_sum == 0) {
         LOGGER_WARN("empty histogram");
     }
+    if (histogram->out_of_bounds_mode == HistogramOutOfBoundsMode__log) {
+        return init_from_log_histogram(me, histogram);
+    }
     // NOTE We include 1 past the histogram length to record "false infinities",
     //      i.e. elements past the maximum length of the histogram.
     const uint64_t num_bins = histogram->num_bins + 2;
@@ -269,6 +334,53 @@ cleanup:
     return false;
 }
 
+bool
+MissRateCurve__save_checkpoint(struct MissRateCurve const *const me,
+                               struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->bin_size) &&
+           CheckpointWriter__write_array(writer,
+                                         me->miss_rate,
+                                         me->num_bins,
+                                         sizeof(*me->miss_rate));
+}
+
+bool
+MissRateCurve__load_checkpoint(struct MissRateCurve *const me,
+                               struct CheckpointReader *const reader)
+{
+    uint64_t bin_size = 0;
+    size_t num_bins = 0;
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    if (!CheckpointReader__read_u64(reader, &bin_size)) {
+        return false;
+    }
+    double const *const miss_rate =
+        CheckpointReader__read_array(reader, &num_bins, sizeof(*miss_rate));
+    if (miss_rate == NULL) {
+        return false;
+    }
+    MissRateCurve__destroy(me);
+    if (num_bins == 0) {
+        return true;
+    }
+    double *const copy = malloc(num_bins * sizeof(*copy));
+    if (copy == NULL) {
+        LOGGER_ERROR("failed to allocate %zu bins", num_bins);
+        return false;
+    }
+    memcpy(copy, miss_rate, num_bins * sizeof(*copy));
+    *me = (struct MissRateCurve){.miss_rate = copy,
+                                 .num_bins = num_bins,
+                                 .bin_size = bin_size};
+    return true;
+}
+
 bool
 MissRateCurve__load(struct MissRateCurve *const me,
                     char const *restrict const file_name)
@@ -0,0 +1,141 @@
+/** @brief  Emit MRCs of a live histogram periodically during a run.
+ *
+ *  An online deployment resizes its caches based on how the working set
+ *  evolves, so it needs a stream of MRCs rather than one for the whole
+ *  trace. We support three kinds of snapshots:
+ *  1. Cumulative: everything since the start of the run.
+ *  2. Tumbling: only the accesses since the previous snapshot.
+ *  3. Decayed: each snapshot's window plus the previous decayed
+ *     histogram, scaled down by the decay factor. We update this
+ *     incrementally, so we never rescan the earlier windows.
+ *
+ *  The caller only pays to copy (and possibly subtract) the histogram's
+ *  bins; a background thread converts the copies to MRCs and writes
+ *  them, so the caller can keep updating the live histogram.
+ *
+ *  File format (in the host's byte order):
+ *  - Header: the magic "MRCSNAP1" and the mode (u64).
+ *  - Records: position (u64), timestamp in ms (u64), weight (f64),
+ *    bin size (u64), number of bins (u64), and then the dense miss
+ *    rates (f64).
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram/histogram.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+
+enum MRCSnapshotMode {
+    MRC_SNAPSHOT_MODE_INVALID,
+    MRC_SNAPSHOT_MODE_CUMULATIVE,
+    MRC_SNAPSHOT_MODE_TUMBLING,
+    MRC_SNAPSHOT_MODE_DECAYED,
+};
+
+static char const *const MRC_SNAPSHOT_MODE_STRINGS[] = {"INVALID",
+                                                        "cumulative",
+                                                        "tumbling",
+                                                        "decayed"};
+
+bool
+MRCSnapshotMode__parse(enum MRCSnapshotMode *const me, char const *const str);
+
+struct MRCSnapshotHeader {
+    /// Number of accesses that the algorithm had processed.
+    uint64_t position;
+    /// Timestamp of the last access (or zero if the trace has none).
+    uint64_t timestamp_ms;
+    /// Number of (possibly decayed or scaled) accesses in the MRC.
+    double weight;
+};
+
+struct MRCSnapshotWriter;
+
+struct MRCSnapshotStream {
+    enum MRCSnapshotMode mode;
+    /// The factor by which we scale the previous decayed histogram at
+    /// each snapshot.
+    double decay;
+    /// Copy of the live histogram at the previous snapshot.
+    struct Histogram previous;
+    /// The decayed histogram in units of 1/MRC_SNAPSHOT_FIXED_POINT
+    /// accesses, so that we keep the fractions of small bins.
+    struct Histogram decayed;
+    size_t num_snapshots;
+    struct MRCSnapshotWriter *writer;
+};
+
+#define MRC_SNAPSHOT_FIXED_POINT ((uint64_t)1 << 12)
+
+/// @param  decay: in [0, 1). Only used in the decayed mode.
+bool
+MRCSnapshotStream__init(struct MRCSnapshotStream *const me,
+                        char const *const path,
+                        enum MRCSnapshotMode const mode,
+                        double const decay);
+
+/// @brief  Continue the stream of a run that resumed from a checkpoint.
+/// @details    We append to the existing file, after dropping any
+///             snapshots past 'position' (which the resumed run will take
+///             again). We seed the previous histogram with the restored
+///             one, so the first window only covers the accesses since
+///             the checkpoint. If the file does not exist, we create it.
+/// @param  restored: the live histogram as restored from the checkpoint.
+/// @note   The checkpoint does not include the decayed histogram, so it
+///         restarts from the first window after the checkpoint.
+bool
+MRCSnapshotStream__init_resumed(struct MRCSnapshotStream *const me,
+                                char const *const path,
+                                enum MRCSnapshotMode const mode,
+                                double const decay,
+                                struct Histogram const *const restored,
+                                uint64_t const position);
+
+/// @brief  Emit an MRC of the live histogram.
+/// @note   We copy what we need before returning, so the caller may
+///         modify the histogram right away. We skip empty windows.
+bool
+MRCSnapshotStream__take(struct MRCSnapshotStream *const me,
+                        struct Histogram const *const live,
+                        struct MRCSnapshotHeader const header);
+
+/// @brief  Wait for the pending snapshot to be written and close the
+///         file.
+bool
+MRCSnapshotStream__finish(struct MRCSnapshotStream *const me);
+
+/// @note   This finishes the stream if the caller has not.
+void
+MRCSnapshotStream__destroy(struct MRCSnapshotStream *const me);
+
+struct MRCSnapshotReader {
+    FILE *fp;
+    enum MRCSnapshotMode mode;
+};
+
+bool
+MRCSnapshotReader__init(struct MRCSnapshotReader *const me,
+                        char const *const path);
+
+/// @brief  Read the next snapshot into an uninitialized MRC.
+/// @param  done: set to true (and return true) at the end of the file.
+bool
+MRCSnapshotReader__next(struct MRCSnapshotReader *const me,
+                        struct MRCSnapshotHeader *const header,
+                        struct MissRateCurve *const mrc,
+                        bool *const done);
+
+void
+MRCSnapshotReader__destroy(struct MRCSnapshotReader *const me);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
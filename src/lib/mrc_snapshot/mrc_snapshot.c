@@ -0,0 +1,506 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "file/file.h"
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "mrc_snapshot/mrc_snapshot.h"
+
+static char const MAGIC[8] = {'M', 'R', 'C', 'S', 'N', 'A', 'P', '1'};
+
+struct MRCSnapshotWriter {
+    FILE *fp;
+    char *path;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // The snapshot that the background thread is converting and writing.
+    // The background thread owns the histogram once we hand it off.
+    bool has_pending;
+    struct MRCSnapshotHeader pending_header;
+    struct Histogram pending;
+    bool stop_requested;
+    bool failed;
+    bool finished;
+};
+
+bool
+MRCSnapshotMode__parse(enum MRCSnapshotMode *const me, char const *const str)
+{
+    if (me == NULL || str == NULL) {
+        return false;
+    }
+    for (size_t i = MRC_SNAPSHOT_MODE_CUMULATIVE;
+         i <= MRC_SNAPSHOT_MODE_DECAYED;
+         ++i) {
+        if (strcmp(str, MRC_SNAPSHOT_MODE_STRINGS[i]) == 0) {
+            *me = (enum MRCSnapshotMode)i;
+            return true;
+        }
+    }
+    LOGGER_ERROR("unrecognized snapshot mode '%s'", str);
+    *me = MRC_SNAPSHOT_MODE_INVALID;
+    return false;
+}
+
+static bool
+write_snapshot(struct MRCSnapshotWriter *const w,
+               struct MRCSnapshotHeader const *const header,
+               struct Histogram const *const hist)
+{
+    struct MissRateCurve mrc = {0};
+    if (!MissRateCurve__init_from_histogram(&mrc, hist)) {
+        LOGGER_ERROR("failed to convert the histogram to an MRC");
+        return false;
+    }
+    uint64_t const shape[2] = {mrc.bin_size, mrc.num_bins};
+    bool const ok =
+        fwrite(&header->position, sizeof(header->position), 1, w->fp) == 1 &&
+        fwrite(&header->timestamp_ms, sizeof(header->timestamp_ms), 1, w->fp) ==
+            1 &&
+        fwrite(&header->weight, sizeof(header->weight), 1, w->fp) == 1 &&
+        fwrite(shape, sizeof(shape), 1, w->fp) == 1 &&
+        fwrite(mrc.miss_rate, sizeof(*mrc.miss_rate), mrc.num_bins, w->fp) ==
+            mrc.num_bins;
+    if (!ok) {
+        LOGGER_ERROR("failed to write snapshot to '%s'", w->path);
+    }
+    MissRateCurve__destroy(&mrc);
+    return ok;
+}
+
+static void *
+writer_worker(void *arg)
+{
+    struct MRCSnapshotWriter *const w = arg;
+    pthread_mutex_lock(&w->lock);
+    while (true) {
+        while (!w->has_pending && !w->stop_requested) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->has_pending) {
+            break;
+        }
+        struct MRCSnapshotHeader const header = w->pending_header;
+        struct Histogram hist = w->pending;
+        bool const failed = w->failed;
+        // NOTE We convert and write without the lock so that the caller
+        //      can keep preparing its next snapshot.
+        pthread_mutex_unlock(&w->lock);
+        bool const ok = failed || write_snapshot(w, &header, &hist);
+        Histogram__destroy(&hist);
+        pthread_mutex_lock(&w->lock);
+        w->failed |= !ok;
+        w->pending = (struct Histogram){0};
+        w->has_pending = false;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/// @brief  Hand the histogram to the background thread, which takes
+///         ownership of it (even if we fail).
+static bool
+hand_off(struct MRCSnapshotWriter *const w,
+         struct MRCSnapshotHeader const header,
+         struct Histogram *const hist)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->has_pending) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    if (w->failed) {
+        pthread_mutex_unlock(&w->lock);
+        Histogram__destroy(hist);
+        return false;
+    }
+    w->pending_header = header;
+    w->pending = *hist;
+    w->has_pending = true;
+    *hist = (struct Histogram){0};
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return true;
+}
+
+static void
+destroy_writer(struct MRCSnapshotWriter *const w)
+{
+    if (w == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    Histogram__destroy(&w->pending);
+    free(w->path);
+    free(w);
+}
+
+/// @brief  Drop the snapshots after 'position' (and any partial record
+///         that a crash left behind).
+/// @param  exists: set to whether the file exists.
+static bool
+truncate_after(char const *const path,
+               enum MRCSnapshotMode const mode,
+               uint64_t const position,
+               bool *const exists)
+{
+    struct MRCSnapshotReader r = {0};
+    struct MRCSnapshotHeader header = {0};
+    struct MissRateCurve mrc = {0};
+    bool done = false;
+    long offset = 0;
+
+    *exists = file_exists(path);
+    if (!*exists) {
+        return true;
+    }
+    if (!MRCSnapshotReader__init(&r, path)) {
+        return false;
+    }
+    if (r.mode != mode) {
+        LOGGER_ERROR("'%s' has %s snapshots, not %s",
+                     path,
+                     MRC_SNAPSHOT_MODE_STRINGS[r.mode],
+                     MRC_SNAPSHOT_MODE_STRINGS[mode]);
+        MRCSnapshotReader__destroy(&r);
+        return false;
+    }
+    while (true) {
+        offset = ftell(r.fp);
+        if (!MRCSnapshotReader__next(&r, &header, &mrc, &done)) {
+            LOGGER_WARN("dropping the partial snapshot at the end of '%s'",
+                        path);
+            break;
+        }
+        if (done) {
+            break;
+        }
+        MissRateCurve__destroy(&mrc);
+        if (header.position > position) {
+            break;
+        }
+    }
+    MRCSnapshotReader__destroy(&r);
+    if (!done && truncate(path, offset) != 0) {
+        LOGGER_ERROR("failed to truncate '%s' to %ld bytes", path, offset);
+        return false;
+    }
+    return true;
+}
+
+/// @param  append: whether to append to an existing file (which must
+///                 have the same mode) rather than replace it.
+static bool
+init_stream(struct MRCSnapshotStream *const me,
+            char const *const path,
+            enum MRCSnapshotMode const mode,
+            double const decay,
+            bool const append)
+{
+    if (me == NULL || path == NULL || mode == MRC_SNAPSHOT_MODE_INVALID ||
+        mode > MRC_SNAPSHOT_MODE_DECAYED || !(decay >= 0.0 && decay < 1.0)) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    *me = (struct MRCSnapshotStream){.mode = mode, .decay = decay};
+
+    struct MRCSnapshotWriter *w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        LOGGER_ERROR("failed to allocate writer");
+        return false;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->path = strdup(path);
+    if (w->path == NULL) {
+        LOGGER_ERROR("failed to allocate the path");
+        goto cleanup;
+    }
+    w->fp = fopen(path, append ? "ab" : "wb");
+    if (w->fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", path);
+        goto cleanup;
+    }
+    uint64_t const header_mode = mode;
+    if (!append && (fwrite(MAGIC, sizeof(MAGIC), 1, w->fp) != 1 ||
+                    fwrite(&header_mode, sizeof(header_mode), 1, w->fp) != 1)) {
+        LOGGER_ERROR("failed to write header to '%s'", path);
+        goto cleanup;
+    }
+    if (pthread_create(&w->thread, NULL, writer_worker, w) != 0) {
+        LOGGER_ERROR("failed to create the writer thread");
+        goto cleanup;
+    }
+    me->writer = w;
+    return true;
+cleanup:
+    if (w->fp != NULL) {
+        fclose(w->fp);
+        // NOTE We keep the earlier snapshots when we append.
+        if (!append) {
+            remove(path);
+        }
+    }
+    destroy_writer(w);
+    return false;
+}
+
+bool
+MRCSnapshotStream__init(struct MRCSnapshotStream *const me,
+                        char const *const path,
+                        enum MRCSnapshotMode const mode,
+                        double const decay)
+{
+    return init_stream(me, path, mode, decay, false);
+}
+
+bool
+MRCSnapshotStream__init_resumed(struct MRCSnapshotStream *const me,
+                                char const *const path,
+                                enum MRCSnapshotMode const mode,
+                                double const decay,
+                                struct Histogram const *const restored,
+                                uint64_t const position)
+{
+    bool exists = false;
+    if (me == NULL || path == NULL || mode == MRC_SNAPSHOT_MODE_INVALID ||
+        mode > MRC_SNAPSHOT_MODE_DECAYED || restored == NULL) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    if (!truncate_after(path, mode, position, &exists) ||
+        !init_stream(me, path, mode, decay, exists)) {
+        return false;
+    }
+    if (mode != MRC_SNAPSHOT_MODE_CUMULATIVE &&
+        !Histogram__init_reshaped(&me->previous, restored, restored)) {
+        LOGGER_ERROR("failed to copy the restored histogram");
+        MRCSnapshotStream__destroy(me);
+        return false;
+    }
+    return true;
+}
+
+/// @brief  Send the histogram (which we give up) to the background
+///         thread, unless it is empty.
+static bool
+emit(struct MRCSnapshotStream *const me,
+     struct Histogram *const hist,
+     struct MRCSnapshotHeader header,
+     double const weight)
+{
+    if (hist->running_sum == 0) {
+        Histogram__destroy(hist);
+        return true;
+    }
+    header.weight = weight;
+    ++me->num_snapshots;
+    return hand_off(me->writer, header, hist);
+}
+
+/// @brief  Set the decayed histogram to 'decay * decayed + window'.
+static bool
+update_decayed(struct MRCSnapshotStream *const me,
+               struct Histogram const *const window)
+{
+    struct Histogram decayed = {0};
+    bool const first = me->decayed.histogram == NULL;
+    // NOTE The live histogram may have changed shape since the previous
+    //      snapshot, so we match the (current) window's shape.
+    if (!Histogram__init_reshaped(&decayed,
+                                  first ? window : &me->decayed,
+                                  window)) {
+        return false;
+    }
+    uint64_t running_sum = 0;
+    for (size_t i = 0; i < decayed.num_bins; ++i) {
+        uint64_t const old = first ? 0 : decayed.histogram[i];
+        decayed.histogram[i] = llround(old * me->decay) +
+                               window->histogram[i] * MRC_SNAPSHOT_FIXED_POINT;
+        running_sum += decayed.histogram[i];
+    }
+    decayed.false_infinity =
+        (first ? 0 : llround(decayed.false_infinity * me->decay)) +
+        window->false_infinity * MRC_SNAPSHOT_FIXED_POINT;
+    decayed.infinity = (first ? 0 : llround(decayed.infinity * me->decay)) +
+                       window->infinity * MRC_SNAPSHOT_FIXED_POINT;
+    decayed.running_sum =
+        running_sum + decayed.false_infinity + decayed.infinity;
+    Histogram__destroy(&me->decayed);
+    me->decayed = decayed;
+    return true;
+}
+
+bool
+MRCSnapshotStream__take(struct MRCSnapshotStream *const me,
+                        struct Histogram const *const live,
+                        struct MRCSnapshotHeader const header)
+{
+    struct Histogram copy = {0}, window = {0};
+    if (me == NULL || me->writer == NULL || live == NULL) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    if (!Histogram__init_reshaped(&copy, live, live)) {
+        LOGGER_ERROR("failed to copy the histogram");
+        return false;
+    }
+    if (me->mode == MRC_SNAPSHOT_MODE_CUMULATIVE) {
+        return emit(me, &copy, header, copy.running_sum);
+    }
+
+    bool const ok =
+        me->previous.histogram == NULL
+            ? Histogram__init_reshaped(&window, &copy, &copy)
+            : Histogram__init_difference(&window, &copy, &me->previous);
+    Histogram__destroy(&me->previous);
+    me->previous = copy;
+    if (!ok) {
+        LOGGER_ERROR("failed to get the window's histogram");
+        return false;
+    }
+    if (me->mode == MRC_SNAPSHOT_MODE_TUMBLING) {
+        return emit(me, &window, header, window.running_sum);
+    }
+
+    assert(me->mode == MRC_SNAPSHOT_MODE_DECAYED);
+    struct Histogram decayed = {0};
+    if (!update_decayed(me, &window) ||
+        !Histogram__init_reshaped(&decayed, &me->decayed, &me->decayed)) {
+        LOGGER_ERROR("failed to decay the histogram");
+        Histogram__destroy(&window);
+        return false;
+    }
+    Histogram__destroy(&window);
+    return emit(me,
+                &decayed,
+                header,
+                (double)decayed.running_sum / MRC_SNAPSHOT_FIXED_POINT);
+}
+
+bool
+MRCSnapshotStream__finish(struct MRCSnapshotStream *const me)
+{
+    if (me == NULL || me->writer == NULL) {
+        return false;
+    }
+    struct MRCSnapshotWriter *const w = me->writer;
+    if (w->finished) {
+        return !w->failed;
+    }
+    pthread_mutex_lock(&w->lock);
+    w->stop_requested = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    if (fclose(w->fp) != 0) {
+        LOGGER_ERROR("failed to close '%s'", w->path);
+        w->failed = true;
+    }
+    w->fp = NULL;
+    w->finished = true;
+    return !w->failed;
+}
+
+void
+MRCSnapshotStream__destroy(struct MRCSnapshotStream *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->writer != NULL) {
+        MRCSnapshotStream__finish(me);
+        destroy_writer(me->writer);
+    }
+    Histogram__destroy(&me->previous);
+    Histogram__destroy(&me->decayed);
+    *me = (struct MRCSnapshotStream){0};
+}
+
+bool
+MRCSnapshotReader__init(struct MRCSnapshotReader *const me,
+                        char const *const path)
+{
+    char magic[sizeof(MAGIC)] = {0};
+    uint64_t mode = 0;
+    if (me == NULL || path == NULL) {
+        return false;
+    }
+    *me = (struct MRCSnapshotReader){.fp = fopen(path, "rb")};
+    if (me->fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", path);
+        return false;
+    }
+    if (fread(magic, sizeof(magic), 1, me->fp) != 1 ||
+        memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        fread(&mode, sizeof(mode), 1, me->fp) != 1 ||
+        mode == MRC_SNAPSHOT_MODE_INVALID || mode > MRC_SNAPSHOT_MODE_DECAYED) {
+        LOGGER_ERROR("'%s' is not an MRC snapshot file", path);
+        MRCSnapshotReader__destroy(me);
+        return false;
+    }
+    me->mode = mode;
+    return true;
+}
+
+bool
+MRCSnapshotReader__next(struct MRCSnapshotReader *const me,
+                        struct MRCSnapshotHeader *const header,
+                        struct MissRateCurve *const mrc,
+                        bool *const done)
+{
+    uint64_t shape[2] = {0};
+    if (me == NULL || me->fp == NULL || header == NULL || mrc == NULL ||
+        done == NULL) {
+        return false;
+    }
+    *done = false;
+    if (fread(&header->position, sizeof(header->position), 1, me->fp) != 1) {
+        *done = feof(me->fp);
+        return *done;
+    }
+    if (fread(&header->timestamp_ms, sizeof(header->timestamp_ms), 1, me->fp) !=
+            1 ||
+        fread(&header->weight, sizeof(header->weight), 1, me->fp) != 1 ||
+        fread(shape, sizeof(shape), 1, me->fp) != 1 || shape[1] == 0) {
+        LOGGER_ERROR("truncated snapshot");
+        return false;
+    }
+    if (!MissRateCurve__alloc_empty(mrc, shape[1], shape[0])) {
+        LOGGER_ERROR("failed to allocate an MRC of %" PRIu64 " bins",
+                     shape[1]);
+        return false;
+    }
+    if (fread(mrc->miss_rate, sizeof(*mrc->miss_rate), mrc->num_bins, me->fp) !=
+        mrc->num_bins) {
+        LOGGER_ERROR("truncated snapshot");
+        MissRateCurve__destroy(mrc);
+        return false;
+    }
+    return true;
+}
+
+void
+MRCSnapshotReader__destroy(struct MRCSnapshotReader *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->fp != NULL) {
+        fclose(me->fp);
+    }
+    *me = (struct MRCSnapshotReader){0};
+}
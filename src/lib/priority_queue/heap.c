@@ -5,8 +5,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "arrays/is_last.h"
+#include "checkpoint/checkpoint.h"
 #include "hash/types.h"
 #include "invariants/implies.h"
 #include "logger/logger.h"
@@ -350,6 +352,66 @@ Heap__remove(struct Heap *me, KeyType rm_key, ValueType *value_return)
     return true;
 }
 
+size_t
+Heap__memory_usage(struct Heap const *const me)
+{
+    if (me == NULL || me->data == NULL) {
+        return 0;
+    }
+    return me->capacity * sizeof(*me->data);
+}
+
+bool
+Heap__save_checkpoint(struct Heap const *const me,
+                      struct CheckpointWriter *const writer)
+{
+    if (me == NULL || me->data == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->capacity) &&
+           CheckpointWriter__write_array(writer,
+                                         me->data,
+                                         me->length,
+                                         sizeof(*me->data));
+}
+
+bool
+Heap__load_checkpoint(struct Heap *const me,
+                      struct CheckpointReader *const reader)
+{
+    uint64_t capacity = 0;
+    size_t length = 0;
+    if (me == NULL || me->data == NULL || reader == NULL) {
+        return false;
+    }
+    if (!CheckpointReader__read_u64(reader, &capacity)) {
+        return false;
+    }
+    struct HeapItem const *const data =
+        CheckpointReader__read_array(reader, &length, sizeof(*data));
+    if (data == NULL || length > capacity || capacity == 0) {
+        LOGGER_ERROR("bad heap of length %zu", length);
+        return false;
+    }
+    if (capacity != me->capacity) {
+        struct HeapItem *const tmp =
+            realloc(me->data, capacity * sizeof(*tmp));
+        if (tmp == NULL) {
+            LOGGER_ERROR("failed to reallocate");
+            return false;
+        }
+        me->data = tmp;
+        me->capacity = capacity;
+    }
+    memcpy(me->data, data, length * sizeof(*data));
+    me->length = length;
+    if (!Heap__validate(me)) {
+        LOGGER_ERROR("invalid heap in checkpoint");
+        return false;
+    }
+    return true;
+}
+
 void
 Heap__destroy(struct Heap *me)
 {
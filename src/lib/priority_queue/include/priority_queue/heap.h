@@ -17,6 +17,9 @@ extern "C" {
 #include "types/key_type.h"
 #include "types/value_type.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct HeapItem {
     KeyType key;
     ValueType value;
@@ -69,6 +72,22 @@ Heap__get_top_key(struct Heap *me);
 bool
 Heap__remove(struct Heap *me, KeyType rm_key, ValueType *value_return);
 
+/// @brief  Append the items (in heap order) to a checkpoint.
+bool
+Heap__save_checkpoint(struct Heap const *const me,
+                      struct CheckpointWriter *const writer);
+
+/// @brief  Replace the items with the next heap in a checkpoint.
+/// @note   The heap must be initialized with the same ordering. We keep
+///         the items' order, so we do not need to re-heapify.
+bool
+Heap__load_checkpoint(struct Heap *const me,
+                      struct CheckpointReader *const reader);
+
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+Heap__memory_usage(struct Heap const *const me);
+
 void
 Heap__destroy(struct Heap *me);
 
@@ -0,0 +1,112 @@
+/** @brief  A runtime-enabled, sampled profiler for the hot paths.
+ *
+ *  Unlike 'profile/profile.h', this does not require a rebuild. It is
+ *  disabled by default, in which case every hook is a single branch on a
+ *  global flag. When enabled, we only read the time-stamp counter for one
+ *  in every 'period' accesses (per thread), so that we can time many
+ *  scopes at once without perturbing the measurement too much.
+ *
+ *  Usage:
+ *      Profiler__tick();   // Once per access.
+ *      uint64_t const start = Profiler__start();
+ *      ...
+ *      Profiler__stop(PROFILER_SCOPE_HASH_LOOKUP, start);
+ *
+ *  Scopes may nest (e.g. an eviction within the sampler), in which case the
+ *  outer scope's time includes the inner scope's time.
+ *
+ *  Each thread counts into its own counters, which we merge when we write
+ *  the report (at exit or upon 'Profiler__write_report').
+ *
+ *  Enable it with the environment variables:
+ *  - MRC_PROFILE=<path>: write the report to <path> (CSV if the path ends
+ *    in '.csv', otherwise JSON).
+ *  - MRC_PROFILE_PERIOD=<n>: sample 1 in <n> accesses (rounded up to a
+ *    power of two). Default: 1024.
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum ProfilerScope {
+    // The entire access (i.e. everything below and more).
+    PROFILER_SCOPE_ACCESS,
+    // Deciding whether to sample a key (including the hashing).
+    PROFILER_SCOPE_SAMPLER,
+    // Looking up the key in the hash table.
+    PROFILER_SCOPE_HASH_LOOKUP,
+    // Updating the stack distance tree (and the hash table's timestamp).
+    PROFILER_SCOPE_TREE_UPDATE,
+    // Inserting the stack distance into the histogram.
+    PROFILER_SCOPE_HISTOGRAM_INSERT,
+    // Evicting an item (e.g. because of a fixed-size sampler).
+    PROFILER_SCOPE_EVICTION,
+    NUM_PROFILER_SCOPES,
+};
+
+extern char const *const PROFILER_SCOPE_NAMES[NUM_PROFILER_SCOPES];
+
+/// @note   Do not modify this directly; use 'Profiler__enable'.
+extern bool profiler_is_enabled;
+
+/// @brief  Enable the profiler.
+/// @param  output_path: where to write the report at exit (or NULL to
+///                      only write it upon 'Profiler__write_report').
+/// @param  period: sample 1 in 'period' accesses. It is rounded up to a
+///                 power of two.
+/// @note   Call this before starting any worker threads.
+bool
+Profiler__enable(char const *const output_path, uint64_t const period);
+
+/// @brief  Enable the profiler if 'MRC_PROFILE' is set.
+/// @return false upon an error (but not if the variable is unset).
+bool
+Profiler__enable_from_env(void);
+
+/// @brief  Write the report of the merged counters.
+/// @note   The format is CSV if the path ends in '.csv' and JSON otherwise.
+bool
+Profiler__write_report(char const *const path);
+
+void
+Profiler__tick_slow(void);
+
+uint64_t
+Profiler__start_slow(void);
+
+void
+Profiler__stop_slow(enum ProfilerScope const scope, uint64_t const start);
+
+/// @brief  Mark the start of a new access for the calling thread.
+static inline void
+Profiler__tick(void)
+{
+    if (profiler_is_enabled) {
+        Profiler__tick_slow();
+    }
+}
+
+/// @brief  Start timing a scope.
+/// @return The time-stamp counter or 0 if this access is not sampled.
+static inline uint64_t
+Profiler__start(void)
+{
+    return profiler_is_enabled ? Profiler__start_slow() : 0;
+}
+
+/// @brief  Stop timing a scope that began at 'start'.
+static inline void
+Profiler__stop(enum ProfilerScope const scope, uint64_t const start)
+{
+    if (start != 0) {
+        Profiler__stop_slow(scope, start);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
@@ -0,0 +1,252 @@
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#include "logger/logger.h"
+#include "profiler/profiler.h"
+
+char const *const PROFILER_SCOPE_NAMES[NUM_PROFILER_SCOPES] = {
+    "access",
+    "sampler",
+    "hash_lookup",
+    "tree_update",
+    "histogram_insert",
+    "eviction",
+};
+
+bool profiler_is_enabled = false;
+
+/// @brief  The counters of a single thread.
+/// @note   We never free these until exit, so that the report includes
+///         the threads that have already finished.
+struct ProfilerThread {
+    uint64_t nr_accesses;
+    bool sampled;
+    uint64_t nr_hits[NUM_PROFILER_SCOPES];
+    uint64_t nr_cycles[NUM_PROFILER_SCOPES];
+    struct ProfilerThread *next;
+};
+
+static uint64_t period_mask = 0;
+static char *report_path = NULL;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ProfilerThread *threads = NULL;
+static _Thread_local struct ProfilerThread *local_thread = NULL;
+
+static struct ProfilerThread *
+get_local_thread(void)
+{
+    if (local_thread != NULL) {
+        return local_thread;
+    }
+    struct ProfilerThread *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        LOGGER_WARN("bad calloc(1, %zu)", sizeof(*t));
+        return NULL;
+    }
+    pthread_mutex_lock(&threads_lock);
+    t->next = threads;
+    threads = t;
+    pthread_mutex_unlock(&threads_lock);
+    local_thread = t;
+    return t;
+}
+
+void
+Profiler__tick_slow(void)
+{
+    struct ProfilerThread *const t = get_local_thread();
+    if (t == NULL) {
+        return;
+    }
+    t->sampled = (t->nr_accesses & period_mask) == 0;
+    ++t->nr_accesses;
+}
+
+uint64_t
+Profiler__start_slow(void)
+{
+    struct ProfilerThread const *const t = local_thread;
+    if (t == NULL || !t->sampled) {
+        return 0;
+    }
+    return __rdtsc();
+}
+
+void
+Profiler__stop_slow(enum ProfilerScope const scope, uint64_t const start)
+{
+    struct ProfilerThread *const t = local_thread;
+    if (t == NULL || scope >= NUM_PROFILER_SCOPES) {
+        return;
+    }
+    t->nr_cycles[scope] += __rdtsc() - start;
+    ++t->nr_hits[scope];
+}
+
+static bool
+ends_with(char const *const str, char const *const suffix)
+{
+    size_t const n = strlen(str), m = strlen(suffix);
+    return n >= m && strcmp(&str[n - m], suffix) == 0;
+}
+
+/// @brief  Merge the counters of every thread.
+/// @note   The counts of running threads may be slightly stale.
+static void
+merge_threads(struct ProfilerThread *const total, uint64_t *const nr_threads)
+{
+    *total = (struct ProfilerThread){0};
+    *nr_threads = 0;
+    pthread_mutex_lock(&threads_lock);
+    for (struct ProfilerThread const *t = threads; t != NULL; t = t->next) {
+        total->nr_accesses += t->nr_accesses;
+        for (size_t i = 0; i < NUM_PROFILER_SCOPES; ++i) {
+            total->nr_hits[i] += t->nr_hits[i];
+            total->nr_cycles[i] += t->nr_cycles[i];
+        }
+        ++*nr_threads;
+    }
+    pthread_mutex_unlock(&threads_lock);
+}
+
+bool
+Profiler__write_report(char const *const path)
+{
+    struct ProfilerThread total = {0};
+    uint64_t nr_threads = 0;
+    uint64_t const period = period_mask + 1;
+
+    if (path == NULL) {
+        return false;
+    }
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        LOGGER_ERROR("failed to open '%s'", path);
+        return false;
+    }
+    merge_threads(&total, &nr_threads);
+    bool const csv = ends_with(path, ".csv");
+    if (csv) {
+        fprintf(fp,
+                "Scope,Sampled Hits,Sampled Cycles,Mean Cycles per Hit,"
+                "Estimated Total Cycles\n");
+    } else {
+        fprintf(fp,
+                "{\"type\": \"Profiler\", \"period\": %" PRIu64
+                ", \"nr_threads\": %" PRIu64 ", \"nr_accesses\": %" PRIu64
+                ", \"scopes\": [",
+                period,
+                nr_threads,
+                total.nr_accesses);
+    }
+    for (size_t i = 0; i < NUM_PROFILER_SCOPES; ++i) {
+        uint64_t const hits = total.nr_hits[i];
+        uint64_t const cycles = total.nr_cycles[i];
+        double const mean = hits ? (double)cycles / hits : NAN;
+        if (csv) {
+            fprintf(fp,
+                    "%s,%" PRIu64 ",%" PRIu64 ",%f,%" PRIu64 "\n",
+                    PROFILER_SCOPE_NAMES[i],
+                    hits,
+                    cycles,
+                    mean,
+                    cycles * period);
+        } else {
+            fprintf(fp,
+                    "%s{\"scope\": \"%s\", \"sampled_hits\": %" PRIu64
+                    ", \"sampled_cycles\": %" PRIu64
+                    ", \"mean_cycles_per_hit\": ",
+                    i == 0 ? "" : ", ",
+                    PROFILER_SCOPE_NAMES[i],
+                    hits,
+                    cycles);
+            // NOTE JSON does not support NaN.
+            if (hits) {
+                fprintf(fp, "%f", mean);
+            } else {
+                fprintf(fp, "null");
+            }
+            fprintf(fp,
+                    ", \"estimated_total_cycles\": %" PRIu64 "}",
+                    cycles * period);
+        }
+    }
+    if (!csv) {
+        fprintf(fp, "]}\n");
+    }
+    bool const ok = fclose(fp) == 0;
+    LOGGER_INFO("wrote profile to '%s'", path);
+    return ok;
+}
+
+static void
+write_report_at_exit(void)
+{
+    if (report_path != NULL) {
+        Profiler__write_report(report_path);
+    }
+}
+
+bool
+Profiler__enable(char const *const output_path, uint64_t const period)
+{
+    static bool registered_at_exit = false;
+
+    if (period == 0) {
+        LOGGER_ERROR("period must be positive");
+        return false;
+    }
+    // Round up to a power of two so that sampling is a bit-wise 'and'.
+    uint64_t p = 1;
+    while (p < period && p < (UINT64_C(1) << 63)) {
+        p <<= 1;
+    }
+    period_mask = p - 1;
+
+    if (output_path != NULL) {
+        char *const path = strdup(output_path);
+        if (path == NULL) {
+            LOGGER_ERROR("bad strdup('%s')", output_path);
+            return false;
+        }
+        free(report_path);
+        report_path = path;
+        if (!registered_at_exit) {
+            if (atexit(write_report_at_exit) != 0) {
+                LOGGER_WARN("failed to register the report at exit");
+            }
+            registered_at_exit = true;
+        }
+    }
+    profiler_is_enabled = true;
+    LOGGER_INFO("profiling 1 in %" PRIu64 " accesses", p);
+    return true;
+}
+
+bool
+Profiler__enable_from_env(void)
+{
+    char const *const path = getenv("MRC_PROFILE");
+    char const *const period_str = getenv("MRC_PROFILE_PERIOD");
+    uint64_t period = 1024;
+
+    if (path == NULL || path[0] == '\0') {
+        return true;
+    }
+    if (period_str != NULL) {
+        char *end = NULL;
+        period = strtoull(period_str, &end, 10);
+        if (end == period_str || *end != '\0' || period == 0) {
+            LOGGER_ERROR("bad MRC_PROFILE_PERIOD='%s'", period_str);
+            return false;
+        }
+    }
+    return Profiler__enable(path, period);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "random/uniform_random.h"
+
+/// @brief  A Zipfian generator with O(1) initialization and O(1) expected
+///         time per sample, using Hörmann and Derflinger's rejection-
+///         inversion method.
+/// @details    Unlike ZipfianRandom (which is YCSB's approximation), this
+///             samples the exact Zipfian distribution, P(k) ∝ 1/(k+1)^theta
+///             for k in [0, items), for any theta >= 0.
+/// @note   Source: W. Hörmann and G. Derflinger. "Rejection-inversion to
+///         generate variates from monotone discrete distributions." ACM
+///         TOMACS 6.3 (1996). I follow Apache Commons RNG's
+///         RejectionInversionZipfSampler.
+struct RejectionInversionZipfianRandom {
+    struct UniformRandom urnd_;
+    uint64_t items_;
+    double theta_;
+    double h_integral_x1_;
+    double h_integral_items_;
+    double s_;
+};
+
+bool
+RejectionInversionZipfianRandom__init(
+    struct RejectionInversionZipfianRandom *me,
+    uint64_t items,
+    double theta,
+    uint64_t urnd_seed);
+
+/// @return a value in [0, items), where 0 is the most popular.
+uint64_t
+RejectionInversionZipfianRandom__next(
+    struct RejectionInversionZipfianRandom *me);
+
+void
+RejectionInversionZipfianRandom__destroy(
+    struct RejectionInversionZipfianRandom *me);
+
+#ifdef __cplusplus
+}
+#endif
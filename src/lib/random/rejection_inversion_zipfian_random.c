@@ -0,0 +1,117 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "random/rejection_inversion_zipfian_random.h"
+#include "random/uniform_random.h"
+
+/// @brief  Return log(1 + x) / x, which is numerically stable near 0.
+static inline double
+helper1(double const x)
+{
+    if (fabs(x) > 1e-8) {
+        return log1p(x) / x;
+    }
+    return 1 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+/// @brief  Return (exp(x) - 1) / x, which is numerically stable near 0.
+static inline double
+helper2(double const x)
+{
+    if (fabs(x) > 1e-8) {
+        return expm1(x) / x;
+    }
+    return 1 + x * 0.5 * (1 + x * 1.0 / 3.0 * (1 + 0.25 * x));
+}
+
+/// @brief  The hat function, h(x) = 1/x^theta.
+static inline double
+h(double const theta, double const x)
+{
+    return exp(-theta * log(x));
+}
+
+/// @brief  The integral of the hat function, H(x) = (x^(1-theta) - 1) /
+///         (1 - theta), which is log(x) for theta = 1.
+static inline double
+h_integral(double const theta, double const x)
+{
+    double const log_x = log(x);
+    return helper2((1 - theta) * log_x) * log_x;
+}
+
+static inline double
+h_integral_inverse(double const theta, double const x)
+{
+    double t = x * (1 - theta);
+    if (t < -1) {
+        // NOTE This limits the value to the range of valid inputs to
+        //      log1p in case of numerical error.
+        t = -1;
+    }
+    return exp(helper1(t) * x);
+}
+
+/// @brief  Return a uniform double in [0, 1).
+static inline double
+next_double(struct UniformRandom *const urnd)
+{
+    return (UniformRandom__next_uint64(urnd) >> 11) * 0x1.0p-53;
+}
+
+bool
+RejectionInversionZipfianRandom__init(
+    struct RejectionInversionZipfianRandom *me,
+    uint64_t items,
+    double theta,
+    uint64_t urnd_seed)
+{
+    if (me == NULL || items == 0 || !(theta >= 0)) {
+        return false;
+    }
+    *me = (struct RejectionInversionZipfianRandom){
+        .items_ = items,
+        .theta_ = theta,
+        .h_integral_x1_ = h_integral(theta, 1.5) - 1,
+        .h_integral_items_ = h_integral(theta, items + 0.5),
+        .s_ = 2 - h_integral_inverse(theta,
+                                     h_integral(theta, 2.5) - h(theta, 2))};
+    UniformRandom__init(&me->urnd_, urnd_seed);
+    return true;
+}
+
+uint64_t
+RejectionInversionZipfianRandom__next(
+    struct RejectionInversionZipfianRandom *me)
+{
+    double const theta = me->theta_;
+    while (true) {
+        double const u =
+            me->h_integral_items_ + next_double(&me->urnd_) *
+                                        (me->h_integral_x1_ -
+                                         me->h_integral_items_);
+        double const x = h_integral_inverse(theta, u);
+        // NOTE We round to the nearest integer (i.e. rank) in [1, items].
+        double kd = floor(x + 0.5);
+        if (kd < 1) {
+            kd = 1;
+        } else if (kd > me->items_) {
+            kd = me->items_;
+        }
+        // NOTE The first condition accepts most samples cheaply.
+        if (kd - x <= me->s_ ||
+            u >= h_integral(theta, kd + 0.5) - h(theta, kd)) {
+            return (uint64_t)kd - 1;
+        }
+    }
+}
+
+void
+RejectionInversionZipfianRandom__destroy(
+    struct RejectionInversionZipfianRandom *me)
+{
+    UniformRandom__destroy(&me->urnd_);
+    *me = (struct RejectionInversionZipfianRandom){0};
+}
@@ -1,26 +1,75 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include <glib.h>
 
 #include "histogram/histogram.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
+/// @brief  Spill the compressed phases to disk once the in-memory
+///         phases take this many bytes. A threshold of 0 never spills.
+#define PHASE_SAMPLER_DEFAULT_SPILL_THRESHOLD ((size_t)1 << 26)
+
+/// @brief  Convert a phase's histogram into its MRC.
+typedef bool (*PhaseSamplerToMRC)(struct Histogram const *const hist,
+                                  struct MissRateCurve *const mrc);
+
+/// @brief  Keep the histogram of each phase (compressed as sparse
+///         varints) and a running sum of the phases' MRCs.
 struct PhaseSampler {
-    GPtrArray *saved_histograms;
-    // HACK Concurrent instances of PhaseSamplers may overwrite each
-    //      other's files, so I am adding this complete hack to lessen
-    //      the probability of such.
-    size_t time_in_usec;
+    /// Compressed phases that are still in memory.
+    GByteArray *buffer;
+    /// Offset of each phase in the concatenation of the spilled bytes
+    /// and the in-memory buffer.
+    GArray *offsets;
+    /// Anonymous temporary file of the phases that we spilled (or NULL).
+    FILE *spill_file;
+    size_t num_spilled_bytes;
+    size_t spill_threshold;
+
+    PhaseSamplerToMRC to_mrc;
+    /// Sum of the phases' MRCs. This is only valid if all of the phases
+    /// have the same shape of MRC.
+    struct MissRateCurve mrc_sum;
+    size_t num_summed_phases;
+    bool mrc_sum_is_valid;
 };
 
 bool
 PhaseSampler__init(struct PhaseSampler *const me);
 
+/// @param  to_mrc: the conversion from a phase's histogram to its MRC,
+///                 or NULL to only store the phases.
+/// @param  spill_threshold: the number of bytes of compressed phases to
+///                          keep in memory before spilling them to a
+///                          temporary file; 0 keeps everything in memory.
+bool
+PhaseSampler__init_full(struct PhaseSampler *const me,
+                        PhaseSamplerToMRC const to_mrc,
+                        size_t const spill_threshold);
+
 void
 PhaseSampler__destroy(struct PhaseSampler *const me);
 
+/// @brief  Append the phases (including the spilled ones) and the MRC
+///         sum to a checkpoint.
+bool
+PhaseSampler__save_checkpoint(struct PhaseSampler const *const me,
+                              struct CheckpointWriter *const writer);
+
+/// @brief  Replace the phases with the next ones in a checkpoint.
+/// @note   We load every phase into memory; they spill again as usual.
+bool
+PhaseSampler__load_checkpoint(struct PhaseSampler *const me,
+                              struct CheckpointReader *const reader);
+
 bool
 should_i_create_a_new_histogram(struct Histogram const *const old_hist,
                                 struct Histogram const *const new_hist,
@@ -30,6 +79,16 @@ bool
 PhaseSampler__change_histogram(struct PhaseSampler *const me,
                                struct Histogram const *const old_hist);
 
+size_t
+PhaseSampler__num_phases(struct PhaseSampler const *const me);
+
+/// @brief  Decompress the i-th phase's histogram into 'hist'.
+/// @note   The caller must destroy the histogram.
+bool
+PhaseSampler__load_phase(struct PhaseSampler const *const me,
+                         size_t const i,
+                         struct Histogram *const hist);
+
 /// @note   The number of histogram bins is two less than the number of
 ///         MRC bins.
 bool
@@ -37,3 +96,13 @@ PhaseSampler__create_mrc(struct PhaseSampler const *const me,
                          struct MissRateCurve *const mrc,
                          uint64_t const num_hist_bins,
                          uint64_t const bin_size);
+
+/// @brief  Average the phases' MRCs along with an optional partial phase.
+/// @param  partial: the MRC of the current, unfinished phase (or NULL).
+/// @param  partial_weight: the weight of the partial phase relative to a
+///                         complete phase.
+bool
+PhaseSampler__create_weighted_mrc(struct PhaseSampler const *const me,
+                                  struct MissRateCurve *const mrc,
+                                  struct MissRateCurve const *const partial,
+                                  double const partial_weight);
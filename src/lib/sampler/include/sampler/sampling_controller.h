@@ -0,0 +1,121 @@
+/** @brief  Adapt a sampling rate online to meet a CPU budget.
+ *
+ *  The cost of a sampling MRC algorithm per access depends on the trace's
+ *  locality (e.g. the depth of the reuse-distance tree), so a static rate
+ *  may be too expensive for one workload and needlessly inaccurate for
+ *  another. This controller measures the thread's CPU time per access
+ *  over a sliding window and scales the rate toward the budget.
+ *
+ *  Usage:
+ *      struct SamplingControllerConfig config = {0};
+ *      SamplingControllerConfig__init(&config, 200.0);
+ *      SamplingController__init(&ctrl, &config, 1e-2);
+ *      for (each access) {
+ *          if (SamplingController__tick(&ctrl)) {
+ *              set_sampling_rate(ctrl.rate);
+ *          }
+ *          ...
+ *      }
+ *
+ *  @note   We measure with CLOCK_THREAD_CPUTIME_ID, so time spent waiting
+ *          (e.g. for accesses to arrive) does not count against the
+ *          budget, but everything the thread does between ticks does.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <glib.h>
+
+#define SAMPLING_CONTROLLER_MAX_WINDOW 64
+
+struct SamplingControllerConfig {
+    /// The target CPU time per access in nanoseconds.
+    double budget_ns;
+    /// The bounds of the sampling rate.
+    double min_rate;
+    double max_rate;
+    /// The number of accesses per measurement.
+    uint64_t period;
+    /// The number of measurements in the sliding window. We only change
+    /// the rate once the window is full of measurements at that rate.
+    size_t window;
+    /// We ignore relative errors within this tolerance.
+    double tolerance;
+    /// The largest factor by which we change the rate at once.
+    double max_step;
+};
+
+/// @brief  A point in the trajectory of the sampling rate.
+struct SamplingControllerPoint {
+    /// The number of accesses before the change.
+    uint64_t position;
+    /// The rate from this point onward.
+    double rate;
+    /// The measured cost that triggered the change (or NaN initially).
+    double ns_per_access;
+};
+
+struct SamplingController {
+    struct SamplingControllerConfig config;
+    double rate;
+
+    uint64_t num_accesses;
+    uint64_t num_pending;
+    uint64_t prev_time_ns;
+    // A ring of the latest measurements at the current rate.
+    uint64_t slot_ns[SAMPLING_CONTROLLER_MAX_WINDOW];
+    uint64_t slot_accesses[SAMPLING_CONTROLLER_MAX_WINDOW];
+    size_t num_slots;
+    size_t next_slot;
+
+    /// Array of 'struct SamplingControllerPoint'.
+    GArray *trajectory;
+};
+
+/// @brief  Set the default parameters for a budget.
+bool
+SamplingControllerConfig__init(struct SamplingControllerConfig *const me,
+                               double const budget_ns);
+
+bool
+SamplingController__init(struct SamplingController *const me,
+                         struct SamplingControllerConfig const *const config,
+                         double const initial_rate);
+
+/// @brief  Take a measurement and maybe change the rate.
+/// @note   This is the slow path of 'SamplingController__tick'.
+bool
+SamplingController__update(struct SamplingController *const me);
+
+/// @brief  Override the rate (e.g. after restoring a checkpoint) and
+///         restart the measurements.
+void
+SamplingController__set_rate(struct SamplingController *const me,
+                             double const rate);
+
+/// @brief  Get the mean CPU time per access over the window (or NaN if
+///         we have no measurements yet).
+double
+SamplingController__get_ns_per_access(
+    struct SamplingController const *const me);
+
+void
+SamplingController__write_trajectory_as_json(
+    FILE *const stream,
+    struct SamplingController const *const me);
+
+void
+SamplingController__destroy(struct SamplingController *const me);
+
+/// @brief  Account for one access.
+/// @return true if the caller should switch to 'me->rate'.
+static inline bool
+SamplingController__tick(struct SamplingController *const me)
+{
+    return ++me->num_pending >= me->config.period &&
+           SamplingController__update(me);
+}
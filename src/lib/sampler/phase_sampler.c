@@ -3,48 +3,80 @@
  *  between the old and new histograms */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <sys/time.h>
+#include <stdlib.h>
 
 #include <glib.h>
 
+#include "checkpoint/checkpoint.h"
 #include "histogram/histogram.h"
 #include "logger/logger.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "sampler/phase_sampler.h"
-#include "unused/mark_unused.h"
+
+static bool
+histogram_to_mrc(struct Histogram const *const hist,
+                 struct MissRateCurve *const mrc)
+{
+    return MissRateCurve__init_from_histogram(mrc, hist);
+}
 
 bool
 PhaseSampler__init(struct PhaseSampler *const me)
 {
-    me->saved_histograms = g_ptr_array_new();
-    if (me->saved_histograms == NULL) {
-        LOGGER_ERROR("failed to allocate ptr arrray");
-        return false;
-    }
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    me->time_in_usec = 1000000 * tv.tv_sec + tv.tv_usec;
-    return true;
+    return PhaseSampler__init_full(me,
+                                   histogram_to_mrc,
+                                   PHASE_SAMPLER_DEFAULT_SPILL_THRESHOLD);
 }
 
-static void
-free_gstr(void *data, void *user_data)
+bool
+PhaseSampler__init_full(struct PhaseSampler *const me,
+                        PhaseSamplerToMRC const to_mrc,
+                        size_t const spill_threshold)
 {
-    UNUSED(user_data);
-
-    if (remove(data) != 0) {
-        LOGGER_ERROR("failed to remove file '%s'", data);
+    if (me == NULL) {
+        LOGGER_ERROR("bad input");
+        return false;
     }
-    free(data);
+    *me = (struct PhaseSampler){
+        .buffer = g_byte_array_new(),
+        .offsets = g_array_new(false, false, sizeof(uint64_t)),
+        .spill_file = NULL,
+        .num_spilled_bytes = 0,
+        .spill_threshold = spill_threshold,
+        .to_mrc = to_mrc,
+        .mrc_sum = {0},
+        .num_summed_phases = 0,
+        .mrc_sum_is_valid = to_mrc != NULL,
+    };
+    if (me->buffer == NULL || me->offsets == NULL) {
+        LOGGER_ERROR("failed to allocate phase store");
+        PhaseSampler__destroy(me);
+        return false;
+    }
+    return true;
 }
 
 void
 PhaseSampler__destroy(struct PhaseSampler *const me)
 {
-    g_ptr_array_foreach(me->saved_histograms, free_gstr, NULL);
-    g_ptr_array_free(me->saved_histograms, true);
+    if (me == NULL) {
+        return;
+    }
+    if (me->buffer != NULL) {
+        g_byte_array_free(me->buffer, true);
+    }
+    if (me->offsets != NULL) {
+        g_array_free(me->offsets, true);
+    }
+    // NOTE The temporary file is removed when it is closed.
+    if (me->spill_file != NULL) {
+        fclose(me->spill_file);
+    }
+    MissRateCurve__destroy(&me->mrc_sum);
     *me = (struct PhaseSampler){0};
 }
 
@@ -62,69 +94,380 @@ should_i_create_a_new_histogram(struct Histogram const *const old_hist,
     return (norm2 > threshold);
 }
 
-static gchar *
-create_temporary_file_path(size_t const salt, size_t const id)
+////////////////////////////////////////////////////////////////////////////////
+/// COMPRESSED PHASE STORE
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Append an unsigned LEB128 variable-length integer.
+static void
+append_varint(GByteArray *const buffer, uint64_t value)
+{
+    uint8_t bytes[10] = {0};
+    guint n = 0;
+    do {
+        bytes[n] = value & 0x7F;
+        value >>= 7;
+        if (value != 0) {
+            bytes[n] |= 0x80;
+        }
+        ++n;
+    } while (value != 0);
+    g_byte_array_append(buffer, bytes, n);
+}
+
+static bool
+read_varint(uint8_t const **const cursor,
+            uint8_t const *const end,
+            uint64_t *const value)
 {
-    // TODO Upon upgrading to GLib 2.78, you can simplify this with
-    //      the function 'g_string_new_take'.
-    gchar *cwd = g_get_current_dir();
-    GString *tmp_name = g_string_new(NULL);
-    g_string_append_printf(tmp_name, "./.tmp-%zu-histogram-%zu.bin", salt, id);
-    gchar *path = g_build_path("/", cwd, tmp_name->str, NULL);
+    uint64_t r = 0;
+    for (unsigned shift = 0; *cursor < end && shift < 64; shift += 7) {
+        uint8_t const byte = *(*cursor)++;
+        r |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = r;
+            return true;
+        }
+    }
+    return false;
+}
 
-    free(cwd);
-    g_string_free(tmp_name, true);
-    return path;
+/// @brief  Encode the histogram's metadata followed by the (gap, count)
+///         pairs of its non-zero bins.
+/// @note   This must follow the same order as 'decode_histogram'.
+static void
+encode_histogram(GByteArray *const buffer, struct Histogram const *const hist)
+{
+    append_varint(buffer, hist->out_of_bounds_mode);
+    append_varint(buffer, hist->num_bins);
+    append_varint(buffer, hist->bin_size);
+    append_varint(buffer, hist->log_sub_bins);
+    append_varint(buffer, hist->false_infinity);
+    append_varint(buffer, hist->infinity);
+    append_varint(buffer, hist->running_sum);
+    size_t next = 0;
+    for (size_t i = 0; i < hist->num_bins; ++i) {
+        if (hist->histogram[i] == 0) {
+            continue;
+        }
+        append_varint(buffer, i - next);
+        append_varint(buffer, hist->histogram[i]);
+        next = i + 1;
+    }
+}
+
+/// @note   This must follow the same order as 'encode_histogram'.
+static bool
+decode_histogram(uint8_t const *cursor,
+                 uint8_t const *const end,
+                 struct Histogram *const hist)
+{
+    uint64_t fields[7] = {0};
+    for (size_t i = 0; i < 7; ++i) {
+        if (!read_varint(&cursor, end, &fields[i])) {
+            LOGGER_ERROR("truncated histogram metadata");
+            return false;
+        }
+    }
+    if (fields[1] == 0 || fields[0] >= HistogramOutOfBoundsMode__INVALID) {
+        LOGGER_ERROR("corrupted histogram metadata");
+        return false;
+    }
+    *hist = (struct Histogram){
+        .histogram = calloc(fields[1], sizeof(*hist->histogram)),
+        .num_bins = fields[1],
+        .bin_size = fields[2],
+        .false_infinity = fields[4],
+        .infinity = fields[5],
+        .running_sum = fields[6],
+        .out_of_bounds_mode = (enum HistogramOutOfBoundsMode)fields[0],
+        .log_sub_bins = fields[3],
+    };
+    if (hist->histogram == NULL) {
+        LOGGER_ERROR("failed to allocate histogram");
+        return false;
+    }
+    size_t i = 0;
+    while (cursor < end) {
+        uint64_t gap = 0, count = 0;
+        if (!read_varint(&cursor, end, &gap) ||
+            !read_varint(&cursor, end, &count) || i + gap >= hist->num_bins) {
+            LOGGER_ERROR("corrupted histogram bins");
+            Histogram__destroy(hist);
+            return false;
+        }
+        i += gap;
+        hist->histogram[i] = count;
+        ++i;
+    }
+    return true;
+}
+
+/// @brief  Move the in-memory phases to the end of the spill file.
+/// @note   We spill whole phases, so no phase straddles the two.
+static bool
+spill(struct PhaseSampler *const me)
+{
+    if (me->spill_file == NULL) {
+        me->spill_file = tmpfile();
+        if (me->spill_file == NULL) {
+            LOGGER_ERROR("failed to create spill file");
+            return false;
+        }
+    }
+    if (fseek(me->spill_file, 0, SEEK_END) != 0 ||
+        fwrite(me->buffer->data, 1, me->buffer->len, me->spill_file) !=
+            me->buffer->len) {
+        LOGGER_ERROR("failed to spill %u bytes", me->buffer->len);
+        return false;
+    }
+    me->num_spilled_bytes += me->buffer->len;
+    g_byte_array_set_size(me->buffer, 0);
+    return true;
+}
+
+/// @brief  Add the phase's MRC to the running sum.
+static bool
+add_to_mrc_sum(struct PhaseSampler *const me,
+               struct Histogram const *const hist)
+{
+    if (!me->mrc_sum_is_valid) {
+        return true;
+    }
+    if (hist->running_sum == 0) {
+        LOGGER_WARN("skipping empty phase in the MRC sum");
+        return true;
+    }
+    struct MissRateCurve mrc = {0};
+    if (!me->to_mrc(hist, &mrc)) {
+        LOGGER_ERROR("failed to convert phase to MRC");
+        return false;
+    }
+    if (me->mrc_sum.miss_rate == NULL) {
+        // NOTE We take ownership of the first phase's MRC.
+        me->mrc_sum = mrc;
+        ++me->num_summed_phases;
+        return true;
+    }
+    if (MissRateCurve__scaled_iadd(&me->mrc_sum, &mrc, 1.0)) {
+        ++me->num_summed_phases;
+    } else {
+        LOGGER_WARN("phases have different MRC shapes");
+        me->mrc_sum_is_valid = false;
+    }
+    MissRateCurve__destroy(&mrc);
+    return true;
 }
 
 bool
 PhaseSampler__change_histogram(struct PhaseSampler *const me,
                                struct Histogram const *const old_hist)
 {
-    size_t const id = me->saved_histograms->len;
-    gchar *new_tmp = create_temporary_file_path(me->time_in_usec, id);
-    LOGGER_TRACE("saving to '%s'", new_tmp);
-    bool r = Histogram__save(old_hist, new_tmp);
-    assert(r);
+    if (me == NULL || me->buffer == NULL || old_hist == NULL ||
+        old_hist->histogram == NULL) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    uint64_t const offset = me->num_spilled_bytes + me->buffer->len;
+    g_array_append_val(me->offsets, offset);
+    encode_histogram(me->buffer, old_hist);
+    if (me->spill_threshold != 0 && me->buffer->len >= me->spill_threshold &&
+        !spill(me)) {
+        // NOTE We keep the phases in memory if we cannot spill them.
+        LOGGER_WARN("keeping phases in memory");
+    }
+    return add_to_mrc_sum(me, old_hist);
+}
 
-    g_ptr_array_add(me->saved_histograms, new_tmp);
+/// @brief  Stream the spilled bytes into the checkpoint.
+static bool
+save_spilled_bytes(struct PhaseSampler const *const me,
+                   struct CheckpointWriter *const writer)
+{
+    uint8_t chunk[1 << 16];
+    if (me->num_spilled_bytes == 0) {
+        return true;
+    }
+    if (fseek(me->spill_file, 0, SEEK_SET) != 0) {
+        LOGGER_ERROR("failed to seek spill file");
+        return false;
+    }
+    for (size_t i = 0; i < me->num_spilled_bytes; i += sizeof(chunk)) {
+        size_t const n = MIN(sizeof(chunk), me->num_spilled_bytes - i);
+        if (fread(chunk, 1, n, me->spill_file) != n ||
+            !CheckpointWriter__write(writer, chunk, n)) {
+            LOGGER_ERROR("failed to copy the spill file");
+            return false;
+        }
+    }
+    return true;
+}
 
+bool
+PhaseSampler__save_checkpoint(struct PhaseSampler const *const me,
+                              struct CheckpointWriter *const writer)
+{
+    if (me == NULL || me->buffer == NULL || me->offsets == NULL ||
+        writer == NULL) {
+        return false;
+    }
+    // NOTE The spilled bytes are followed by the in-memory bytes, so we
+    //      store them as one array and the offsets need not change.
+    return CheckpointWriter__begin_array(writer,
+                                         me->num_spilled_bytes +
+                                             me->buffer->len) &&
+           save_spilled_bytes(me, writer) &&
+           CheckpointWriter__write(writer,
+                                   me->buffer->data,
+                                   me->buffer->len) &&
+           CheckpointWriter__end_array(writer) &&
+           CheckpointWriter__write_array(writer,
+                                         me->offsets->data,
+                                         me->offsets->len,
+                                         sizeof(uint64_t)) &&
+           CheckpointWriter__write_u64(writer, me->num_summed_phases) &&
+           CheckpointWriter__write_u64(writer, me->mrc_sum_is_valid) &&
+           MissRateCurve__save_checkpoint(&me->mrc_sum, writer);
+}
+
+bool
+PhaseSampler__load_checkpoint(struct PhaseSampler *const me,
+                              struct CheckpointReader *const reader)
+{
+    size_t num_bytes = 0, num_phases = 0;
+    uint64_t num_summed_phases = 0, mrc_sum_is_valid = 0;
+    if (me == NULL || me->buffer == NULL || me->offsets == NULL ||
+        reader == NULL) {
+        return false;
+    }
+    uint8_t const *const bytes =
+        CheckpointReader__read_array(reader, &num_bytes, sizeof(*bytes));
+    uint64_t const *const offsets =
+        CheckpointReader__read_array(reader, &num_phases, sizeof(*offsets));
+    if (bytes == NULL || offsets == NULL || num_bytes > UINT32_MAX ||
+        num_phases > UINT32_MAX ||
+        !CheckpointReader__read_u64(reader, &num_summed_phases) ||
+        !CheckpointReader__read_u64(reader, &mrc_sum_is_valid) ||
+        !MissRateCurve__load_checkpoint(&me->mrc_sum, reader)) {
+        LOGGER_ERROR("failed to read phases");
+        return false;
+    }
+    if (me->spill_file != NULL) {
+        fclose(me->spill_file);
+        me->spill_file = NULL;
+    }
+    me->num_spilled_bytes = 0;
+    g_byte_array_set_size(me->buffer, 0);
+    g_byte_array_append(me->buffer, bytes, num_bytes);
+    g_array_set_size(me->offsets, 0);
+    g_array_append_vals(me->offsets, offsets, num_phases);
+    me->num_summed_phases = num_summed_phases;
+    me->mrc_sum_is_valid = mrc_sum_is_valid && me->to_mrc != NULL;
     return true;
 }
 
+size_t
+PhaseSampler__num_phases(struct PhaseSampler const *const me)
+{
+    if (me == NULL || me->offsets == NULL) {
+        return 0;
+    }
+    return me->offsets->len;
+}
+
+bool
+PhaseSampler__load_phase(struct PhaseSampler const *const me,
+                         size_t const i,
+                         struct Histogram *const hist)
+{
+    if (me == NULL || hist == NULL || i >= PhaseSampler__num_phases(me)) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    uint64_t const start = g_array_index(me->offsets, uint64_t, i);
+    uint64_t const end = i + 1 < me->offsets->len
+                             ? g_array_index(me->offsets, uint64_t, i + 1)
+                             : me->num_spilled_bytes + me->buffer->len;
+    if (start >= me->num_spilled_bytes) {
+        uint8_t const *const data =
+            &me->buffer->data[start - me->num_spilled_bytes];
+        return decode_histogram(data, data + (end - start), hist);
+    }
+
+    uint8_t *data = malloc(end - start);
+    if (data == NULL) {
+        LOGGER_ERROR("failed to allocate %zu bytes", end - start);
+        return false;
+    }
+    bool r = false;
+    if (fseek(me->spill_file, start, SEEK_SET) != 0 ||
+        fread(data, 1, end - start, me->spill_file) != end - start) {
+        LOGGER_ERROR("failed to read phase %zu from spill file", i);
+        goto cleanup;
+    }
+    r = decode_histogram(data, data + (end - start), hist);
+cleanup:
+    free(data);
+    return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// MRC GENERATION
+////////////////////////////////////////////////////////////////////////////////
+
 bool
 PhaseSampler__create_mrc(struct PhaseSampler const *const me,
                          struct MissRateCurve *const mrc,
                          uint64_t const num_hist_bins,
                          uint64_t const bin_size)
 {
-    bool r = false;
-    if (me == NULL || me->saved_histograms == NULL) {
+    if (me == NULL || me->offsets == NULL) {
         return false;
     }
-    if (me->saved_histograms->len == 0) {
-        LOGGER_ERROR("expected non-zero number of histograms");
+    if (me->mrc_sum.num_bins != num_hist_bins + 2 ||
+        me->mrc_sum.bin_size != bin_size) {
+        LOGGER_ERROR("expected MRC with %" PRIu64 " bins of size %" PRIu64
+                     ", got %" PRIu64 " bins of size %" PRIu64,
+                     num_hist_bins + 2,
+                     bin_size,
+                     me->mrc_sum.num_bins,
+                     me->mrc_sum.bin_size);
         return false;
     }
+    return PhaseSampler__create_weighted_mrc(me, mrc, NULL, 0.0);
+}
 
-    // We preallocate the MRC simply because it's easier this way.
-    if (!MissRateCurve__alloc_empty(mrc, num_hist_bins + 2, bin_size)) {
+bool
+PhaseSampler__create_weighted_mrc(struct PhaseSampler const *const me,
+                                  struct MissRateCurve *const mrc,
+                                  struct MissRateCurve const *const partial,
+                                  double const partial_weight)
+{
+    if (me == NULL || me->offsets == NULL || mrc == NULL) {
+        return false;
+    }
+    if (!me->mrc_sum_is_valid) {
+        LOGGER_ERROR("cannot average phases without MRCs of the same shape");
+        return false;
+    }
+    if (me->mrc_sum.miss_rate == NULL) {
+        LOGGER_ERROR("expected non-zero number of histograms");
+        return false;
+    }
+    // NOTE Empty phases have no MRC, so they are not in the average.
+    double const scale = 1 / (me->num_summed_phases + partial_weight);
+    if (!MissRateCurve__alloc_empty(mrc,
+                                    me->mrc_sum.num_bins,
+                                    me->mrc_sum.bin_size)) {
         LOGGER_ERROR("failed to allocate MRC");
         return false;
     }
-    for (size_t i = 0; i < me->saved_histograms->len; ++i) {
-        char *hist_path = me->saved_histograms->pdata[i];
-        struct Histogram hist = {0};
-        r = Histogram__load(&hist, hist_path);
-        assert(r);
-        struct MissRateCurve my_mrc = {0};
-        r = MissRateCurve__init_from_histogram(&my_mrc, &hist);
-        assert(r);
-        r = MissRateCurve__scaled_iadd(mrc,
-                                       &my_mrc,
-                                       (double)1 / me->saved_histograms->len);
-        assert(r);
-        Histogram__destroy(&hist);
+    if (!MissRateCurve__scaled_iadd(mrc, &me->mrc_sum, scale) ||
+        (partial != NULL &&
+         !MissRateCurve__scaled_iadd(mrc, partial, scale * partial_weight))) {
+        LOGGER_ERROR("failed to average MRCs");
+        MissRateCurve__destroy(mrc);
+        return false;
     }
     return true;
 }
@@ -0,0 +1,208 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "logger/logger.h"
+#include "sampler/sampling_controller.h"
+
+static uint64_t
+get_thread_cpu_time_ns(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double
+clamp(double const x, double const lo, double const hi)
+{
+    return x < lo ? lo : x > hi ? hi : x;
+}
+
+bool
+SamplingControllerConfig__init(struct SamplingControllerConfig *const me,
+                               double const budget_ns)
+{
+    if (me == NULL || !(budget_ns > 0.0)) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    *me = (struct SamplingControllerConfig){
+        .budget_ns = budget_ns,
+        .min_rate = 1e-6,
+        .max_rate = 1.0,
+        // NOTE Reading the clock costs tens of nanoseconds, so we
+        //      amortize it over many accesses.
+        .period = 1 << 16,
+        .window = 8,
+        .tolerance = 0.1,
+        .max_step = 2.0,
+    };
+    return true;
+}
+
+static void
+append_point(struct SamplingController *const me, double const ns_per_access)
+{
+    struct SamplingControllerPoint const p = {.position = me->num_accesses,
+                                              .rate = me->rate,
+                                              .ns_per_access = ns_per_access};
+    g_array_append_val(me->trajectory, p);
+}
+
+bool
+SamplingController__init(struct SamplingController *const me,
+                         struct SamplingControllerConfig const *const config,
+                         double const initial_rate)
+{
+    if (me == NULL || config == NULL || !(config->budget_ns > 0.0) ||
+        !(0.0 < config->min_rate && config->min_rate <= config->max_rate &&
+          config->max_rate <= 1.0) ||
+        config->period == 0 || config->window == 0 ||
+        config->window > SAMPLING_CONTROLLER_MAX_WINDOW ||
+        !(config->tolerance >= 0.0) || !(config->max_step > 1.0)) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    *me = (struct SamplingController){
+        .config = *config,
+        .rate = clamp(initial_rate, config->min_rate, config->max_rate),
+        .prev_time_ns = get_thread_cpu_time_ns(),
+        .trajectory = g_array_new(FALSE,
+                                  FALSE,
+                                  sizeof(struct SamplingControllerPoint)),
+    };
+    append_point(me, NAN);
+    return true;
+}
+
+double
+SamplingController__get_ns_per_access(struct SamplingController const *const me)
+{
+    if (me == NULL || me->num_slots == 0) {
+        return NAN;
+    }
+    uint64_t ns = 0, accesses = 0;
+    for (size_t i = 0; i < me->num_slots; ++i) {
+        ns += me->slot_ns[i];
+        accesses += me->slot_accesses[i];
+    }
+    return (double)ns / accesses;
+}
+
+static void
+restart_window(struct SamplingController *const me)
+{
+    me->num_slots = 0;
+    me->next_slot = 0;
+}
+
+bool
+SamplingController__update(struct SamplingController *const me)
+{
+    if (me == NULL || me->num_pending == 0) {
+        return false;
+    }
+    uint64_t const now_ns = get_thread_cpu_time_ns();
+    me->slot_ns[me->next_slot] = now_ns - me->prev_time_ns;
+    me->slot_accesses[me->next_slot] = me->num_pending;
+    me->next_slot = (me->next_slot + 1) % me->config.window;
+    if (me->num_slots < me->config.window) {
+        ++me->num_slots;
+    }
+    me->num_accesses += me->num_pending;
+    me->num_pending = 0;
+    me->prev_time_ns = now_ns;
+    if (me->num_slots < me->config.window) {
+        return false;
+    }
+
+    // NOTE We assume that the cost is roughly proportional to the rate.
+    //      It is not quite (hashing every access costs the same at any
+    //      rate), but the repeated corrections converge anyway.
+    double const ns_per_access = SamplingController__get_ns_per_access(me);
+    double const error = me->config.budget_ns / ns_per_access;
+    if (fabs(error - 1.0) <= me->config.tolerance) {
+        return false;
+    }
+    double const step =
+        clamp(error, 1.0 / me->config.max_step, me->config.max_step);
+    double const new_rate =
+        clamp(me->rate * step, me->config.min_rate, me->config.max_rate);
+    if (new_rate == me->rate) {
+        // NOTE We are pinned at a bound, so keep measuring.
+        return false;
+    }
+    LOGGER_INFO("sampling rate %g -> %g after %" PRIu64
+                " accesses (%g ns/access; budget %g ns/access)",
+                me->rate,
+                new_rate,
+                me->num_accesses,
+                ns_per_access,
+                me->config.budget_ns);
+    me->rate = new_rate;
+    append_point(me, ns_per_access);
+    // NOTE The old measurements do not reflect the new rate.
+    restart_window(me);
+    return true;
+}
+
+void
+SamplingController__set_rate(struct SamplingController *const me,
+                             double const rate)
+{
+    if (me == NULL) {
+        return;
+    }
+    me->rate = clamp(rate, me->config.min_rate, me->config.max_rate);
+    me->num_pending = 0;
+    me->prev_time_ns = get_thread_cpu_time_ns();
+    append_point(me, NAN);
+    restart_window(me);
+}
+
+void
+SamplingController__write_trajectory_as_json(
+    FILE *const stream,
+    struct SamplingController const *const me)
+{
+    if (stream == NULL) {
+        return;
+    }
+    if (me == NULL || me->trajectory == NULL) {
+        fprintf(stream, "[]\n");
+        return;
+    }
+    fprintf(stream, "[");
+    for (size_t i = 0; i < me->trajectory->len; ++i) {
+        struct SamplingControllerPoint const *const p =
+            &g_array_index(me->trajectory, struct SamplingControllerPoint, i);
+        fprintf(stream,
+                "%s{\"position\": %" PRIu64 ", \"rate\": %g, "
+                "\"ns_per_access\": %g}",
+                i == 0 ? "" : ", ",
+                p->position,
+                p->rate,
+                // NOTE JSON has no NaN.
+                isnan(p->ns_per_access) ? -1.0 : p->ns_per_access);
+    }
+    fprintf(stream, "]\n");
+}
+
+void
+SamplingController__destroy(struct SamplingController *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    if (me->trajectory != NULL) {
+        g_array_free(me->trajectory, TRUE);
+    }
+    *me = (struct SamplingController){0};
+}
@@ -0,0 +1,97 @@
+/** @brief  A background thread that reports the live progress of runs.
+ *
+ *  Each runner publishes its progress into a 'TelemetryProgress' once per
+ *  TELEMETRY_CHUNK_SIZE accesses, so the hot loop has no per-access
+ *  progress branch. A single telemetry thread samples every registered
+ *  runner at a fixed interval and writes a compact JSON status record with
+ *  the throughput, percent complete, ETA, RSS, sampling ratio, and hit
+ *  ratio. We omit the sampling and hit ratios when they are unknown (e.g.
+ *  the MRC algorithms have no single cache size, so no hit ratio).
+ *  Finished runners stay in later records (with "done": true), so the
+ *  final record summarizes every run.
+ *
+ *  Usage:
+ *      struct TelemetryProgress progress = {0};
+ *      TelemetryProgress__init(&progress, "Olken", trace_length);
+ *      for (size_t begin = 0; begin < n; begin += TELEMETRY_CHUNK_SIZE) {
+ *          ... // Process up to TELEMETRY_CHUNK_SIZE accesses.
+ *          TelemetryProgress__update(&progress, end, NAN, NAN);
+ *      }
+ *      TelemetryProgress__destroy(&progress);
+ *
+ *  Enable it with the environment variables:
+ *  - MRC_TELEMETRY=<path>: overwrite <path> with the latest record, or
+ *    MRC_TELEMETRY=unix:<path>: send each record as a datagram to the Unix
+ *    socket at <path> (e.g. 'socat UNIX-RECVFROM:<path>,fork -').
+ *  - MRC_TELEMETRY_INTERVAL_MS=<n>: the reporting interval. Default: 1000.
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief  The number of accesses between progress updates.
+#define TELEMETRY_CHUNK_SIZE ((size_t)1 << 16)
+
+struct TelemetryProgress {
+    char name[64];
+    uint64_t total;
+    // NOTE These are written by the runner and read by the telemetry
+    //      thread, both under the telemetry lock.
+    uint64_t nr_accesses;
+    // NaN if unknown.
+    double sampling_ratio;
+    // NaN if unknown.
+    double hit_ratio;
+    // NOTE These are only used by the telemetry thread.
+    uint64_t prev_nr_accesses;
+    double prev_time_sec;
+
+    bool registered;
+    struct TelemetryProgress *next;
+};
+
+/// @brief  Start the telemetry thread.
+/// @param  output_path: a file path or 'unix:<socket path>'.
+/// @param  interval_ms: the time between records.
+bool
+Telemetry__start(char const *const output_path, uint64_t const interval_ms);
+
+/// @brief  Start the telemetry thread if 'MRC_TELEMETRY' is set.
+/// @return false upon an error (but not if the variable is unset).
+bool
+Telemetry__start_from_env(void);
+
+/// @brief  Write a final record and join the telemetry thread.
+/// @note   This is a no-op if the telemetry thread is not running.
+void
+Telemetry__stop(void);
+
+/// @brief  Register a runner's progress with the telemetry thread.
+/// @note   If telemetry is not running, this does not register anything
+///         and the updates are no-ops.
+void
+TelemetryProgress__init(struct TelemetryProgress *const me,
+                        char const *const name,
+                        uint64_t const total);
+
+/// @brief  Publish the runner's progress.
+/// @param  nr_accesses: the total number of accesses processed so far.
+/// @param  sampling_ratio: the current sampling ratio or NaN.
+/// @param  hit_ratio: the current hit ratio or NaN.
+void
+TelemetryProgress__update(struct TelemetryProgress *const me,
+                          uint64_t const nr_accesses,
+                          double const sampling_ratio,
+                          double const hit_ratio);
+
+void
+TelemetryProgress__destroy(struct TelemetryProgress *const me);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
@@ -0,0 +1,407 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger/logger.h"
+#include "telemetry/telemetry.h"
+#include "timer/timer.h"
+#include "unused/mark_unused.h"
+
+#define SOCKET_PREFIX "unix:"
+
+static pthread_mutex_t telemetry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t telemetry_cond = PTHREAD_COND_INITIALIZER;
+static struct TelemetryProgress *runners = NULL;
+// NOTE We keep a copy of each finished runner's last progress, so that
+//      the final record still describes every run.
+static struct TelemetryProgress *finished_runners = NULL;
+static bool running = false;
+static bool stop_requested = false;
+static pthread_t telemetry_thread;
+
+static char *file_path = NULL;
+static int socket_fd = -1;
+static struct sockaddr_un socket_addr = {0};
+static uint64_t period_ms = 1000;
+static double start_time_sec = 0.0;
+
+/// @brief  Get the resident set size from '/proc/self/statm'.
+/// @return the RSS in bytes or 0 if it is unavailable.
+static uint64_t
+get_rss_bytes(void)
+{
+    unsigned long size = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    int const n = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+    if (n != 2) {
+        return 0;
+    }
+    return (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+static void
+print_double_or_null(FILE *const fp, double const x)
+{
+    // NOTE JSON does not support NaN or infinity.
+    if (isfinite(x)) {
+        fprintf(fp, "%f", x);
+    } else {
+        fprintf(fp, "null");
+    }
+}
+
+/// @brief  Print the field only if its value is known.
+static void
+print_optional_field(FILE *const fp, char const *const name, double const x)
+{
+    if (isfinite(x)) {
+        fprintf(fp, ", \"%s\": %f", name, x);
+    }
+}
+
+static void
+print_runner(FILE *const fp,
+             struct TelemetryProgress *const r,
+             double const now,
+             bool const first,
+             bool const done)
+{
+    double const dt = now - r->prev_time_sec;
+    double const rate =
+        dt > 0.0 ? (r->nr_accesses - r->prev_nr_accesses) / dt : NAN;
+    double const remaining =
+        r->total > r->nr_accesses ? r->total - r->nr_accesses : 0;
+    r->prev_nr_accesses = r->nr_accesses;
+    r->prev_time_sec = now;
+
+    fprintf(fp,
+            "%s{\"name\": \"%s\", \"done\": %s, \"accesses\": %" PRIu64
+            ", \"total\": %" PRIu64 ", \"percent\": ",
+            first ? "" : ", ",
+            r->name,
+            done ? "true" : "false",
+            r->nr_accesses,
+            r->total);
+    print_double_or_null(fp, 100.0 * r->nr_accesses / r->total);
+    fprintf(fp, ", \"accesses_per_sec\": ");
+    print_double_or_null(fp, rate);
+    fprintf(fp, ", \"eta_sec\": ");
+    print_double_or_null(fp, done ? 0.0 : rate > 0.0 ? remaining / rate : NAN);
+    print_optional_field(fp, "sampling_ratio", r->sampling_ratio);
+    print_optional_field(fp, "hit_ratio", r->hit_ratio);
+    fprintf(fp, "}");
+}
+
+/// @brief  Format the status record of every runner.
+/// @note   The caller must hold the telemetry lock.
+static void
+print_record(FILE *const fp)
+{
+    double const now = get_wall_time_sec();
+    bool first = true;
+    fprintf(fp,
+            "{\"type\": \"Telemetry\", \"time_sec\": %f, \"rss_bytes\": "
+            "%" PRIu64 ", \"runners\": [",
+            now - start_time_sec,
+            get_rss_bytes());
+    for (struct TelemetryProgress *r = runners; r != NULL; r = r->next) {
+        print_runner(fp, r, now, first, false);
+        first = false;
+    }
+    for (struct TelemetryProgress *r = finished_runners; r != NULL;
+         r = r->next) {
+        print_runner(fp, r, now, first, true);
+        first = false;
+    }
+    fprintf(fp, "]}\n");
+}
+
+/// @brief  Overwrite the output file with the record.
+/// @note   We write to a temporary file and rename it so that readers
+///         never see a partial record.
+static void
+write_file(char const *const record, size_t const size)
+{
+    size_t const n = strlen(file_path) + sizeof(".tmp");
+    char *const tmp_path = malloc(n);
+    if (tmp_path == NULL) {
+        return;
+    }
+    snprintf(tmp_path, n, "%s.tmp", file_path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        LOGGER_WARN("failed to open '%s'", tmp_path);
+        free(tmp_path);
+        return;
+    }
+    bool ok = fwrite(record, 1, size, fp) == size;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp_path, file_path) != 0) {
+        LOGGER_WARN("failed to write '%s'", file_path);
+    }
+    free(tmp_path);
+}
+
+/// @brief  Send the record to the socket, if anyone is listening.
+/// @note   We never block the telemetry thread on a slow reader.
+static void
+send_socket(char const *const record, size_t const size)
+{
+    ssize_t const err = sendto(socket_fd,
+                               record,
+                               size,
+                               MSG_DONTWAIT,
+                               (struct sockaddr const *)&socket_addr,
+                               sizeof(socket_addr));
+    if (err < 0 && errno != ENOENT && errno != ECONNREFUSED &&
+        errno != EAGAIN) {
+        LOGGER_TRACE("failed to send telemetry");
+    }
+}
+
+/// @note   The caller must hold the telemetry lock. We release it while
+///         doing the I/O so that we do not stall the runners.
+static void
+report_locked(void)
+{
+    char *record = NULL;
+    size_t size = 0;
+    FILE *fp = open_memstream(&record, &size);
+    if (fp == NULL) {
+        LOGGER_WARN("failed to open memory stream");
+        return;
+    }
+    print_record(fp);
+    fclose(fp);
+
+    pthread_mutex_unlock(&telemetry_lock);
+    if (socket_fd >= 0) {
+        send_socket(record, size);
+    } else {
+        write_file(record, size);
+    }
+    pthread_mutex_lock(&telemetry_lock);
+    free(record);
+}
+
+static void *
+telemetry_worker(void *arg)
+{
+    UNUSED(arg);
+    pthread_mutex_lock(&telemetry_lock);
+    while (!stop_requested) {
+        struct timespec deadline = {0};
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += period_ms / 1000;
+        deadline.tv_nsec += (period_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        int err = 0;
+        while (!stop_requested && err != ETIMEDOUT) {
+            err = pthread_cond_timedwait(&telemetry_cond,
+                                         &telemetry_lock,
+                                         &deadline);
+        }
+        // NOTE We write a final record upon stopping too.
+        report_locked();
+    }
+    pthread_mutex_unlock(&telemetry_lock);
+    return NULL;
+}
+
+static bool
+open_socket(char const *const path)
+{
+    if (strlen(path) >= sizeof(socket_addr.sun_path)) {
+        LOGGER_ERROR("socket path '%s' is too long", path);
+        return false;
+    }
+    socket_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        LOGGER_ERROR("failed to create socket");
+        return false;
+    }
+    socket_addr.sun_family = AF_UNIX;
+    strcpy(socket_addr.sun_path, path);
+    return true;
+}
+
+bool
+Telemetry__start(char const *const output_path, uint64_t const interval_ms)
+{
+    if (output_path == NULL || interval_ms == 0) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    if (running) {
+        LOGGER_ERROR("telemetry is already running");
+        return false;
+    }
+    if (strncmp(output_path, SOCKET_PREFIX, strlen(SOCKET_PREFIX)) == 0) {
+        if (!open_socket(&output_path[strlen(SOCKET_PREFIX)])) {
+            return false;
+        }
+    } else {
+        file_path = strdup(output_path);
+        if (file_path == NULL) {
+            LOGGER_ERROR("bad strdup('%s')", output_path);
+            return false;
+        }
+    }
+    period_ms = interval_ms;
+    start_time_sec = get_wall_time_sec();
+    stop_requested = false;
+    if (pthread_create(&telemetry_thread, NULL, telemetry_worker, NULL) !=
+        0) {
+        LOGGER_ERROR("failed to create the telemetry thread");
+        goto cleanup;
+    }
+    running = true;
+    LOGGER_INFO("reporting telemetry to '%s' every %" PRIu64 " ms",
+                output_path,
+                interval_ms);
+    return true;
+cleanup:
+    free(file_path);
+    file_path = NULL;
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    return false;
+}
+
+bool
+Telemetry__start_from_env(void)
+{
+    char const *const path = getenv("MRC_TELEMETRY");
+    char const *const interval_str = getenv("MRC_TELEMETRY_INTERVAL_MS");
+    uint64_t interval_ms = 1000;
+
+    if (path == NULL || path[0] == '\0') {
+        return true;
+    }
+    if (interval_str != NULL) {
+        char *end = NULL;
+        interval_ms = strtoull(interval_str, &end, 10);
+        if (end == interval_str || *end != '\0' || interval_ms == 0) {
+            LOGGER_ERROR("bad MRC_TELEMETRY_INTERVAL_MS='%s'", interval_str);
+            return false;
+        }
+    }
+    return Telemetry__start(path, interval_ms);
+}
+
+void
+Telemetry__stop(void)
+{
+    if (!running) {
+        return;
+    }
+    pthread_mutex_lock(&telemetry_lock);
+    stop_requested = true;
+    pthread_cond_signal(&telemetry_cond);
+    pthread_mutex_unlock(&telemetry_lock);
+    pthread_join(telemetry_thread, NULL);
+    running = false;
+
+    pthread_mutex_lock(&telemetry_lock);
+    while (finished_runners != NULL) {
+        struct TelemetryProgress *const r = finished_runners;
+        finished_runners = r->next;
+        free(r);
+    }
+    pthread_mutex_unlock(&telemetry_lock);
+
+    free(file_path);
+    file_path = NULL;
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+}
+
+void
+TelemetryProgress__init(struct TelemetryProgress *const me,
+                        char const *const name,
+                        uint64_t const total)
+{
+    if (me == NULL) {
+        return;
+    }
+    *me = (struct TelemetryProgress){
+        .total = total,
+        .sampling_ratio = NAN,
+        .hit_ratio = NAN,
+        .prev_time_sec = get_wall_time_sec(),
+    };
+    // NOTE We do not escape the name for JSON, so callers should only
+    //      use plain names.
+    snprintf(me->name, sizeof(me->name), "%s", name != NULL ? name : "");
+    if (!running) {
+        return;
+    }
+    pthread_mutex_lock(&telemetry_lock);
+    me->next = runners;
+    runners = me;
+    me->registered = true;
+    pthread_mutex_unlock(&telemetry_lock);
+}
+
+void
+TelemetryProgress__update(struct TelemetryProgress *const me,
+                          uint64_t const nr_accesses,
+                          double const sampling_ratio,
+                          double const hit_ratio)
+{
+    if (me == NULL || !me->registered) {
+        return;
+    }
+    pthread_mutex_lock(&telemetry_lock);
+    me->nr_accesses = nr_accesses;
+    me->sampling_ratio = sampling_ratio;
+    me->hit_ratio = hit_ratio;
+    pthread_mutex_unlock(&telemetry_lock);
+}
+
+void
+TelemetryProgress__destroy(struct TelemetryProgress *const me)
+{
+    if (me == NULL || !me->registered) {
+        return;
+    }
+    struct TelemetryProgress *const copy = malloc(sizeof(*copy));
+    pthread_mutex_lock(&telemetry_lock);
+    for (struct TelemetryProgress **p = &runners; *p != NULL;
+         p = &(*p)->next) {
+        if (*p == me) {
+            *p = me->next;
+            break;
+        }
+    }
+    me->registered = false;
+    // NOTE If we cannot allocate the copy, then the runner is simply
+    //      missing from later records.
+    if (copy != NULL) {
+        *copy = *me;
+        copy->next = finished_runners;
+        finished_runners = copy;
+    }
+    pthread_mutex_unlock(&telemetry_lock);
+}
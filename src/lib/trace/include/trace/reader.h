@@ -42,6 +42,13 @@ parse_trace_format_string(char const *const format_str);
 struct Trace
 read_trace_keys(char const *const restrict file_name, enum TraceFormat format);
 
+/// @brief  Read the keys and the timestamps of the traces formatted by
+///         Kia and Sari.
+/// @note   This uses 1.5x the memory of reading only the keys.
+struct Trace
+read_trace_keys_and_timestamps(char const *const restrict file_name,
+                               enum TraceFormat format);
+
 /// @return Get the number of bytes per trace item.
 size_t
 get_bytes_per_trace_item(enum TraceFormat format);
@@ -70,6 +77,16 @@ struct FullTraceItemResult
 construct_full_trace_item(uint8_t const *const restrict bytes,
                           enum TraceFormat format);
 
+/// @brief  Serialize a trace item into the format's bytes. This is the
+///         inverse of 'construct_full_trace_item'.
+/// @note   The 'bytes' must have room for 'get_bytes_per_trace_item'.
+/// @note   Sari's format has no command and stores the timestamp in
+///         seconds, so we drop the command and round the timestamp down.
+bool
+write_full_trace_item(uint8_t *const restrict bytes,
+                      enum TraceFormat format,
+                      struct FullTraceItem const *const restrict item);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
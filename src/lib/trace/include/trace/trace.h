@@ -31,6 +31,9 @@ struct FullTraceItem {
 struct Trace {
     struct TraceItem *trace;
     size_t length;
+    /// The access times in milliseconds (or NULL if we only read the
+    /// keys). This runs parallel to the 'trace' array.
+    uint64_t *timestamps_ms;
 };
 
 void
@@ -0,0 +1,122 @@
+/** @brief  Generate synthetic traces (in the Kia or Sari formats) with
+ *          many threads.
+ *
+ *  We split the trace into fixed-length blocks. Each block has its own
+ *  random seed (derived from the workload's seed and the block's index),
+ *  so the output only depends on the configuration and not on the number
+ *  of threads or on which thread generates which block.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace/reader.h"
+
+#define WORKLOAD_DEFAULT_BLOCK_LENGTH ((size_t)1 << 16)
+
+/// @brief  The distribution of a per-key attribute (i.e. size or TTL).
+enum WorkloadDistribution {
+    WORKLOAD_DISTRIBUTION_INVALID,
+    /// Every key takes the minimum value.
+    WORKLOAD_DISTRIBUTION_CONSTANT,
+    /// Uniform in [min, max].
+    WORKLOAD_DISTRIBUTION_UNIFORM,
+    /// Uniform in [log(min), log(max)], i.e. many small values and a
+    /// few large ones.
+    WORKLOAD_DISTRIBUTION_LOG_UNIFORM,
+};
+
+static char const *const WORKLOAD_DISTRIBUTION_STRINGS[] = {"INVALID",
+                                                             "Constant",
+                                                             "Uniform",
+                                                             "LogUniform"};
+
+enum WorkloadDistribution
+parse_workload_distribution_string(char const *const str);
+
+struct WorkloadConfig {
+    enum TraceFormat format;
+    /// Number of accesses in the trace.
+    size_t length;
+    /// Number of accesses per block. Blocks are the unit of parallelism
+    /// and of seeding, so changing this changes the trace.
+    size_t block_length;
+    uint64_t seed;
+
+    /// Number of distinct keys that we draw from.
+    uint64_t num_keys;
+    /// Skew of the Zipfian popularity; 0 is uniform.
+    double zipf_skew;
+    /// Fraction of GET requests (the rest are SET requests).
+    double read_ratio;
+
+    enum WorkloadDistribution size_distribution;
+    uint32_t min_size;
+    uint32_t max_size;
+    enum WorkloadDistribution ttl_distribution;
+    uint32_t min_ttl_s;
+    uint32_t max_ttl_s;
+
+    /// @brief  Temporal locality.
+    /// Probability that an access re-references one of the block's most
+    /// recent 'reuse_window' keys rather than drawing a fresh key.
+    double reuse_probability;
+    size_t reuse_window;
+    /// Every 'drift_period' accesses, we shift the popularity ranks by
+    /// 'drift_step' so that the hot keys change over time. A period of 0
+    /// keeps the popularity fixed.
+    uint64_t drift_period;
+    uint64_t drift_step;
+
+    /// Timestamps start at 'start_time_ms' and advance at this rate.
+    uint64_t start_time_ms;
+    double accesses_per_second;
+};
+
+/// @brief  Set the required parameters and default the rest (i.e. a
+///         static popularity, all GETs, and constant sizes and TTLs).
+bool
+WorkloadConfig__init(struct WorkloadConfig *const me,
+                     enum TraceFormat const format,
+                     size_t const length,
+                     uint64_t const num_keys,
+                     double const zipf_skew,
+                     uint64_t const seed);
+
+bool
+WorkloadConfig__validate(struct WorkloadConfig const *const me);
+
+void
+WorkloadConfig__write_as_json(FILE *const stream,
+                              struct WorkloadConfig const *const me);
+
+size_t
+WorkloadConfig__num_blocks(struct WorkloadConfig const *const me);
+
+/// @brief  Generate the serialized bytes of the i-th block.
+/// @param  buffer: room for the block_length items.
+/// @param  num_bytes: the number of bytes that we wrote (the last block
+///                    may be short).
+bool
+generate_workload_block(struct WorkloadConfig const *const me,
+                        size_t const block_id,
+                        uint8_t *const buffer,
+                        size_t *const num_bytes);
+
+/// @brief  Generate the trace into 'path' using 'num_threads' threads.
+/// @note   The output is identical for any number of threads.
+bool
+write_workload(struct WorkloadConfig const *const me,
+               char const *const path,
+               size_t const num_threads);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
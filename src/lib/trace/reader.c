@@ -13,6 +13,7 @@
 #include "arrays/is_last.h"
 #include "io/io.h"
 #include "logger/logger.h"
+#include "memory/memory_placement.h"
 #include "trace/reader.h"
 #include "trace/trace.h"
 
@@ -105,6 +106,35 @@ read_sari_trace_item(uint8_t const *const restrict bytes)
         .ttl_s = le32toh(ttl_s)};
 }
 
+static void
+write_kia_trace_item(uint8_t *const restrict bytes,
+                     struct FullTraceItem const *const restrict item)
+{
+    uint64_t const timestamp_ms = htole64(item->timestamp_ms);
+    uint64_t const key = htole64(item->key);
+    uint32_t const size = htole32(item->size);
+    uint32_t const ttl_s = htole32(item->ttl_s);
+    memcpy(&bytes[0], &timestamp_ms, sizeof(timestamp_ms));
+    bytes[8] = item->command;
+    memcpy(&bytes[9], &key, sizeof(key));
+    memcpy(&bytes[17], &size, sizeof(size));
+    memcpy(&bytes[21], &ttl_s, sizeof(ttl_s));
+}
+
+static void
+write_sari_trace_item(uint8_t *const restrict bytes,
+                      struct FullTraceItem const *const restrict item)
+{
+    uint32_t const timestamp_s = htole32((uint32_t)(item->timestamp_ms / 1000));
+    uint64_t const key = htole64(item->key);
+    uint32_t const size = htole32(item->size);
+    uint32_t const ttl_s = htole32(item->ttl_s);
+    memcpy(&bytes[0], &timestamp_s, sizeof(timestamp_s));
+    memcpy(&bytes[4], &key, sizeof(key));
+    memcpy(&bytes[12], &size, sizeof(size));
+    memcpy(&bytes[16], &ttl_s, sizeof(ttl_s));
+}
+
 /// @note   Hehe... bit twiddly hacks.
 /// @note   I really hope the compiler inlines this for performance.
 /// Source: https://man7.org/linux/man-pages/man3/endian.3.html
@@ -211,10 +241,13 @@ get_trace_format_string(enum TraceFormat const format)
     return TRACE_FORMAT_STRINGS[format];
 }
 
-struct Trace
-read_trace_keys(char const *const restrict file_name, enum TraceFormat format)
+static struct Trace
+read_trace(char const *const restrict file_name,
+           enum TraceFormat format,
+           bool const with_timestamps)
 {
     struct TraceItem *trace = NULL;
+    uint64_t *timestamps_ms = NULL;
     size_t nobj_expected = 0;
 
     size_t bytes_per_obj = get_bytes_per_trace_item(format);
@@ -237,15 +270,28 @@ read_trace_keys(char const *const restrict file_name, enum TraceFormat format)
                      sizeof(*trace));
         goto cleanup;
     }
+    MemoryPlacement__advise(trace, nobj_expected * sizeof(*trace));
+    if (with_timestamps) {
+        timestamps_ms = calloc(nobj_expected, sizeof(*timestamps_ms));
+        if (timestamps_ms == NULL) {
+            LOGGER_ERROR("could not allocate timestamps for %zu * %zu bytes",
+                         nobj_expected,
+                         sizeof(*timestamps_ms));
+            goto cleanup;
+        }
+    }
 
     // Rearrange the bytes correctly
     size_t idx = 0;
     for (size_t i = 0; i < nobj_expected; ++i) {
-        struct TraceItemResult result =
-            construct_trace_item(&((uint8_t *)mm.buffer)[bytes_per_obj * i],
-                                 format);
+        uint8_t const *const bytes = &((uint8_t *)mm.buffer)[bytes_per_obj * i];
+        struct TraceItemResult result = construct_trace_item(bytes, format);
         if (result.valid) {
             trace[idx] = result.item;
+            if (with_timestamps) {
+                timestamps_ms[idx] =
+                    construct_full_trace_item(bytes, format).item.timestamp_ms;
+            }
             ++idx;
         }
     }
@@ -255,12 +301,50 @@ read_trace_keys(char const *const restrict file_name, enum TraceFormat format)
         goto cleanup;
     }
 
-    return (struct Trace){.trace = trace, .length = idx};
+    return (struct Trace){.trace = trace,
+                          .length = idx,
+                          .timestamps_ms = timestamps_ms};
 
 cleanup:
     MemoryMap__destroy(&mm);
     free(trace);
+    free(timestamps_ms);
     // Yes, I know I could just `return (struct Trace){0}`, but I want
     // to be VERY explicit.
-    return (struct Trace){.trace = NULL, .length = 0};
+    return (struct Trace){.trace = NULL, .length = 0, .timestamps_ms = NULL};
+}
+
+struct Trace
+read_trace_keys(char const *const restrict file_name, enum TraceFormat format)
+{
+    return read_trace(file_name, format, false);
+}
+
+struct Trace
+read_trace_keys_and_timestamps(char const *const restrict file_name,
+                               enum TraceFormat format)
+{
+    return read_trace(file_name, format, true);
+}
+
+bool
+write_full_trace_item(uint8_t *const restrict bytes,
+                      enum TraceFormat format,
+                      struct FullTraceItem const *const restrict item)
+{
+    if (bytes == NULL || item == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    switch (format) {
+    case TRACE_FORMAT_KIA:
+        write_kia_trace_item(bytes, item);
+        return true;
+    case TRACE_FORMAT_SARI:
+        write_sari_trace_item(bytes, item);
+        return true;
+    default:
+        LOGGER_ERROR("unrecognized format %d", format);
+        return false;
+    }
 }
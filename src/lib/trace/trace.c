@@ -74,5 +74,6 @@ Trace__destroy(struct Trace *const me)
 
     // HACK This is an utter hack to get around the const-qualifiers.
     free((void *)me->trace);
+    free(me->timestamps_ms);
     *me = (struct Trace){0};
 }
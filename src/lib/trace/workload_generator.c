@@ -0,0 +1,505 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "arrays/array_size.h"
+#include "hash/splitmix64.h"
+#include "logger/logger.h"
+#include "random/rejection_inversion_zipfian_random.h"
+#include "random/uniform_random.h"
+#include "trace/reader.h"
+#include "trace/trace.h"
+#include "trace/workload_generator.h"
+
+// NOTE These salts separate the random streams that we derive from the
+//      same seed. Their values are arbitrary.
+#define KEY_SALT  UINT64_C(0x6b657973)
+#define SIZE_SALT UINT64_C(0x73697a65)
+#define TTL_SALT  UINT64_C(0x74746c73)
+#define ZIPF_SALT UINT64_C(0x7a697066)
+
+enum WorkloadDistribution
+parse_workload_distribution_string(char const *const str)
+{
+    if (str == NULL) {
+        return WORKLOAD_DISTRIBUTION_INVALID;
+    }
+    for (size_t i = 1; i < ARRAY_SIZE(WORKLOAD_DISTRIBUTION_STRINGS); ++i) {
+        if (strcmp(WORKLOAD_DISTRIBUTION_STRINGS[i], str) == 0) {
+            return (enum WorkloadDistribution)i;
+        }
+    }
+    LOGGER_ERROR("unparsable distribution string: '%s'", str);
+    return WORKLOAD_DISTRIBUTION_INVALID;
+}
+
+bool
+WorkloadConfig__init(struct WorkloadConfig *const me,
+                     enum TraceFormat const format,
+                     size_t const length,
+                     uint64_t const num_keys,
+                     double const zipf_skew,
+                     uint64_t const seed)
+{
+    if (me == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    *me = (struct WorkloadConfig){
+        .format = format,
+        .length = length,
+        .block_length = WORKLOAD_DEFAULT_BLOCK_LENGTH,
+        .seed = seed,
+        .num_keys = num_keys,
+        .zipf_skew = zipf_skew,
+        .read_ratio = 1.0,
+        .size_distribution = WORKLOAD_DISTRIBUTION_CONSTANT,
+        .min_size = 1,
+        .max_size = 1,
+        .ttl_distribution = WORKLOAD_DISTRIBUTION_CONSTANT,
+        .min_ttl_s = 0,
+        .max_ttl_s = 0,
+        .reuse_probability = 0.0,
+        .reuse_window = 0,
+        .drift_period = 0,
+        .drift_step = 0,
+        .start_time_ms = 0,
+        .accesses_per_second = 1000.0,
+    };
+    return WorkloadConfig__validate(me);
+}
+
+static bool
+validate_distribution(char const *const name,
+                      enum WorkloadDistribution const dist,
+                      uint32_t const min,
+                      uint32_t const max)
+{
+    switch (dist) {
+    case WORKLOAD_DISTRIBUTION_CONSTANT:
+        return true;
+    case WORKLOAD_DISTRIBUTION_UNIFORM:
+        if (min > max) {
+            LOGGER_ERROR("%s: min (%" PRIu32 ") > max (%" PRIu32 ")",
+                         name,
+                         min,
+                         max);
+            return false;
+        }
+        return true;
+    case WORKLOAD_DISTRIBUTION_LOG_UNIFORM:
+        if (min == 0 || min > max) {
+            LOGGER_ERROR("%s: need 0 < min (%" PRIu32 ") <= max (%" PRIu32
+                         ") for a log-uniform distribution",
+                         name,
+                         min,
+                         max);
+            return false;
+        }
+        return true;
+    default:
+        LOGGER_ERROR("%s: invalid distribution %d", name, dist);
+        return false;
+    }
+}
+
+bool
+WorkloadConfig__validate(struct WorkloadConfig const *const me)
+{
+    bool ok = true;
+    if (me == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    if (get_bytes_per_trace_item(me->format) == 0) {
+        LOGGER_ERROR("invalid trace format %d", me->format);
+        ok = false;
+    }
+    if (me->block_length == 0) {
+        LOGGER_ERROR("block_length == 0");
+        ok = false;
+    }
+    if (me->num_keys == 0) {
+        LOGGER_ERROR("num_keys == 0");
+        ok = false;
+    }
+    if (!(me->zipf_skew >= 0.0)) {
+        LOGGER_ERROR("zipf_skew (%g) must be non-negative", me->zipf_skew);
+        ok = false;
+    }
+    if (!(0.0 <= me->read_ratio && me->read_ratio <= 1.0)) {
+        LOGGER_ERROR("read_ratio (%g) must be in [0, 1]", me->read_ratio);
+        ok = false;
+    }
+    if (!(0.0 <= me->reuse_probability && me->reuse_probability <= 1.0)) {
+        LOGGER_ERROR("reuse_probability (%g) must be in [0, 1]",
+                     me->reuse_probability);
+        ok = false;
+    }
+    if (me->reuse_probability > 0.0 && me->reuse_window == 0) {
+        LOGGER_ERROR("reuse_probability > 0 requires reuse_window > 0");
+        ok = false;
+    }
+    if (!(me->accesses_per_second > 0.0)) {
+        LOGGER_ERROR("accesses_per_second (%g) must be positive",
+                     me->accesses_per_second);
+        ok = false;
+    }
+    ok &= validate_distribution("size",
+                                me->size_distribution,
+                                me->min_size,
+                                me->max_size);
+    ok &= validate_distribution("ttl",
+                                me->ttl_distribution,
+                                me->min_ttl_s,
+                                me->max_ttl_s);
+    return ok;
+}
+
+void
+WorkloadConfig__write_as_json(FILE *const stream,
+                              struct WorkloadConfig const *const me)
+{
+    if (me == NULL) {
+        fprintf(stream, "{\"type\": null}\n");
+        return;
+    }
+    fprintf(stream,
+            "{\"type\": \"WorkloadConfig\", \".format\": \"%s\", "
+            "\".length\": %zu, \".block_length\": %zu, \".seed\": %" PRIu64
+            ", \".num_keys\": %" PRIu64
+            ", \".zipf_skew\": %g, \".read_ratio\": %g, "
+            "\".size_distribution\": \"%s\", \".min_size\": %" PRIu32
+            ", \".max_size\": %" PRIu32 ", \".ttl_distribution\": \"%s\", "
+            "\".min_ttl_s\": %" PRIu32 ", \".max_ttl_s\": %" PRIu32
+            ", \".reuse_probability\": %g, \".reuse_window\": %zu, "
+            "\".drift_period\": %" PRIu64 ", \".drift_step\": %" PRIu64
+            ", \".start_time_ms\": %" PRIu64
+            ", \".accesses_per_second\": %g}\n",
+            get_trace_format_string(me->format),
+            me->length,
+            me->block_length,
+            me->seed,
+            me->num_keys,
+            me->zipf_skew,
+            me->read_ratio,
+            WORKLOAD_DISTRIBUTION_STRINGS[me->size_distribution],
+            me->min_size,
+            me->max_size,
+            WORKLOAD_DISTRIBUTION_STRINGS[me->ttl_distribution],
+            me->min_ttl_s,
+            me->max_ttl_s,
+            me->reuse_probability,
+            me->reuse_window,
+            me->drift_period,
+            me->drift_step,
+            me->start_time_ms,
+            me->accesses_per_second);
+}
+
+size_t
+WorkloadConfig__num_blocks(struct WorkloadConfig const *const me)
+{
+    if (me == NULL || me->block_length == 0) {
+        return 0;
+    }
+    return (me->length + me->block_length - 1) / me->block_length;
+}
+
+/// @brief  Map a 64-bit value to a uniform double in [0, 1).
+static inline double
+to_unit_interval(uint64_t const x)
+{
+    return (x >> 11) * 0x1.0p-53;
+}
+
+/// @brief  Derive a key's attribute (i.e. size or TTL) from its hash, so
+///         that the same key always has the same attribute.
+static inline uint32_t
+sample_attribute(enum WorkloadDistribution const dist,
+                 uint32_t const min,
+                 uint32_t const max,
+                 uint64_t const hash)
+{
+    double const u = to_unit_interval(hash);
+    double x = 0.0;
+    switch (dist) {
+    case WORKLOAD_DISTRIBUTION_UNIFORM:
+        x = min + u * ((double)max - min + 1);
+        break;
+    case WORKLOAD_DISTRIBUTION_LOG_UNIFORM:
+        x = exp(log(min) + u * (log((double)max + 1) - log(min)));
+        break;
+    default:
+        return min;
+    }
+    // NOTE Rounding error may push us onto the (exclusive) upper bound.
+    return x >= max ? max : (uint32_t)x;
+}
+
+// NOTE GCC and Clang support this type, but ISO C does not, so we mark
+//      it as an extension to silence the pedantic warning.
+__extension__ typedef unsigned __int128 uint128_t;
+
+/// @brief  Map a popularity rank to a key. The splitmix64 hash is a
+///         bijection, so distinct ranks map to distinct keys.
+static inline uint64_t
+rank_to_key(struct WorkloadConfig const *const me,
+            uint64_t const key_salt,
+            uint64_t const rank,
+            uint64_t const index)
+{
+    uint64_t shifted = rank;
+    if (me->drift_period != 0) {
+        uint64_t const epoch = index / me->drift_period;
+        // NOTE We widen the product and the sum, since they may overflow
+        //      64 bits when there are more than 2^32 keys.
+        uint128_t const offset =
+            (uint128_t)(epoch % me->num_keys) *
+            (me->drift_step % me->num_keys) % me->num_keys;
+        shifted = (uint64_t)((rank + offset) % me->num_keys);
+    }
+    return splitmix64_hash(shifted ^ key_salt);
+}
+
+static inline uint64_t
+block_seed(struct WorkloadConfig const *const me,
+           size_t const block_id,
+           uint64_t const salt)
+{
+    return splitmix64_hash(splitmix64_hash(me->seed ^ salt) + block_id);
+}
+
+bool
+generate_workload_block(struct WorkloadConfig const *const me,
+                        size_t const block_id,
+                        uint8_t *const buffer,
+                        size_t *const num_bytes)
+{
+    struct RejectionInversionZipfianRandom zrng = {0};
+    struct UniformRandom urng = {0};
+    uint64_t *recent = NULL;
+    size_t num_recent = 0;
+
+    if (me == NULL || buffer == NULL || num_bytes == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    size_t const bytes_per_item = get_bytes_per_trace_item(me->format);
+    size_t const begin = block_id * me->block_length;
+    if (bytes_per_item == 0 || begin >= me->length) {
+        LOGGER_ERROR("invalid format or block %zu", block_id);
+        return false;
+    }
+    size_t const end = MIN(begin + me->block_length, me->length);
+    if (!RejectionInversionZipfianRandom__init(
+            &zrng,
+            me->num_keys,
+            me->zipf_skew,
+            block_seed(me, block_id, ZIPF_SALT)) ||
+        !UniformRandom__init(&urng, block_seed(me, block_id, 0))) {
+        LOGGER_ERROR("failed to initialize random number generators");
+        return false;
+    }
+    if (me->reuse_probability > 0.0) {
+        recent = malloc(me->reuse_window * sizeof(*recent));
+        if (recent == NULL) {
+            LOGGER_ERROR("failed to allocate recent keys");
+            return false;
+        }
+    }
+    // NOTE We hoist these out of the loop because the compiler cannot
+    //      prove that writing to the buffer leaves the config unchanged.
+    uint64_t const key_salt = splitmix64_hash(me->seed ^ KEY_SALT);
+    uint64_t const size_salt = splitmix64_hash(me->seed ^ SIZE_SALT);
+    uint64_t const ttl_salt = splitmix64_hash(me->seed ^ TTL_SALT);
+    double const ms_per_access = 1000.0 / me->accesses_per_second;
+
+    for (size_t i = begin; i < end; ++i) {
+        uint64_t key = 0;
+        // NOTE The recent keys are a ring buffer, so we fill it before
+        //      we start overwriting the oldest keys.
+        if (num_recent != 0 &&
+            to_unit_interval(UniformRandom__next_uint64(&urng)) <
+                me->reuse_probability) {
+            size_t const n = MIN(num_recent, me->reuse_window);
+            key = recent[UniformRandom__next_uint64(&urng) % n];
+        } else {
+            uint64_t const rank = RejectionInversionZipfianRandom__next(&zrng);
+            key = rank_to_key(me, key_salt, rank, i);
+        }
+        if (recent != NULL) {
+            recent[num_recent % me->reuse_window] = key;
+            ++num_recent;
+        }
+        bool const is_read =
+            me->read_ratio >= 1.0 ||
+            to_unit_interval(UniformRandom__next_uint64(&urng)) <
+                me->read_ratio;
+        struct FullTraceItem const item = {
+            .timestamp_ms =
+                me->start_time_ms + (uint64_t)(i * ms_per_access),
+            .command = is_read ? 0 : 1,
+            .key = key,
+            .size = sample_attribute(me->size_distribution,
+                                     me->min_size,
+                                     me->max_size,
+                                     splitmix64_hash(key ^ size_salt)),
+            .ttl_s = sample_attribute(me->ttl_distribution,
+                                      me->min_ttl_s,
+                                      me->max_ttl_s,
+                                      splitmix64_hash(key ^ ttl_salt)),
+        };
+        write_full_trace_item(&buffer[(i - begin) * bytes_per_item],
+                              me->format,
+                              &item);
+    }
+    *num_bytes = (end - begin) * bytes_per_item;
+
+    free(recent);
+    RejectionInversionZipfianRandom__destroy(&zrng);
+    UniformRandom__destroy(&urng);
+    return true;
+}
+
+struct WorkloadWorker {
+    pthread_t thread;
+    struct WorkloadConfig const *config;
+    int fd;
+    size_t first_block;
+    size_t block_stride;
+    bool ok;
+};
+
+static bool
+pwrite_all(int const fd,
+           uint8_t const *const buffer,
+           size_t const num_bytes,
+           off_t const offset)
+{
+    size_t done = 0;
+    while (done < num_bytes) {
+        ssize_t const r =
+            pwrite(fd, &buffer[done], num_bytes - done, offset + done);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGGER_ERROR("pwrite failed: %s", strerror(errno));
+            return false;
+        }
+        done += r;
+    }
+    return true;
+}
+
+static void *
+workload_worker(void *const arg)
+{
+    struct WorkloadWorker *const me = arg;
+    struct WorkloadConfig const *const config = me->config;
+    size_t const bytes_per_block =
+        config->block_length * get_bytes_per_trace_item(config->format);
+    size_t const num_blocks = WorkloadConfig__num_blocks(config);
+    uint8_t *buffer = malloc(bytes_per_block);
+    if (buffer == NULL) {
+        LOGGER_ERROR("failed to allocate block buffer");
+        me->ok = false;
+        return NULL;
+    }
+    // NOTE We assign blocks round-robin, which is balanced because every
+    //      block (but the last) has the same amount of work.
+    for (size_t b = me->first_block; b < num_blocks; b += me->block_stride) {
+        size_t num_bytes = 0;
+        if (!generate_workload_block(config, b, buffer, &num_bytes) ||
+            !pwrite_all(me->fd,
+                        buffer,
+                        num_bytes,
+                        (off_t)(b * bytes_per_block))) {
+            LOGGER_ERROR("failed to write block %zu", b);
+            me->ok = false;
+            break;
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+bool
+write_workload(struct WorkloadConfig const *const me,
+               char const *const path,
+               size_t const num_threads)
+{
+    struct WorkloadWorker *workers = NULL;
+    size_t num_started = 0;
+    bool ok = false;
+    int fd = -1;
+
+    if (me == NULL || path == NULL) {
+        LOGGER_ERROR("got NULL");
+        return false;
+    }
+    if (!WorkloadConfig__validate(me) || num_threads == 0) {
+        LOGGER_ERROR("invalid configuration or number of threads (%zu)",
+                     num_threads);
+        return false;
+    }
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOGGER_ERROR("failed to open '%s': %s", path, strerror(errno));
+        return false;
+    }
+    // NOTE We size the file up front so that the threads can write their
+    //      blocks at independent offsets.
+    off_t const total_bytes =
+        (off_t)(me->length * get_bytes_per_trace_item(me->format));
+    if (ftruncate(fd, total_bytes) != 0) {
+        LOGGER_ERROR("failed to resize '%s': %s", path, strerror(errno));
+        goto cleanup;
+    }
+    workers = calloc(num_threads, sizeof(*workers));
+    if (workers == NULL) {
+        LOGGER_ERROR("failed to allocate workers");
+        goto cleanup;
+    }
+    for (; num_started < num_threads; ++num_started) {
+        workers[num_started] = (struct WorkloadWorker){
+            .config = me,
+            .fd = fd,
+            .first_block = num_started,
+            .block_stride = num_threads,
+            .ok = true,
+        };
+        if (pthread_create(&workers[num_started].thread,
+                           NULL,
+                           workload_worker,
+                           &workers[num_started]) != 0) {
+            LOGGER_ERROR("failed to create thread %zu", num_started);
+            break;
+        }
+    }
+    ok = (num_started == num_threads);
+    for (size_t i = 0; i < num_started; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        ok &= workers[i].ok;
+    }
+cleanup:
+    free(workers);
+    if (close(fd) != 0) {
+        LOGGER_ERROR("failed to close '%s': %s", path, strerror(errno));
+        ok = false;
+    }
+    return ok;
+}
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "checkpoint/checkpoint.h"
+#include "logger/logger.h"
 #include "tree/basic_tree.h"
 #include "tree/types.h"
 
@@ -61,6 +63,15 @@ tree__cardinality(struct Tree *me)
     return me->cardinality;
 }
 
+size_t
+tree__memory_usage(struct Tree const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return me->cardinality * sizeof(struct Subtree);
+}
+
 bool
 subtree__insert(struct Subtree *me, KeyType key)
 {
@@ -456,6 +467,109 @@ free_subtree(struct Subtree *me)
     }
 }
 
+/// @brief  Copy the keys in order into 'keys' using a Morris traversal,
+///         which uses O(1) extra space regardless of the tree's depth.
+/// @note   Splay trees may be arbitrarily deep, so recursion could
+///         overflow the stack.
+static size_t
+subtree__get_sorted_keys(struct Subtree *me, KeyType *const keys)
+{
+    size_t n = 0;
+    struct Subtree *node = me;
+    while (node != NULL) {
+        if (node->left_subtree == NULL) {
+            keys[n++] = node->key;
+            node = node->right_subtree;
+            continue;
+        }
+        struct Subtree *pred = node->left_subtree;
+        while (pred->right_subtree != NULL && pred->right_subtree != node) {
+            pred = pred->right_subtree;
+        }
+        if (pred->right_subtree == NULL) {
+            // Thread the predecessor back to us so we can return.
+            pred->right_subtree = node;
+            node = node->left_subtree;
+        } else {
+            pred->right_subtree = NULL;
+            keys[n++] = node->key;
+            node = node->right_subtree;
+        }
+    }
+    return n;
+}
+
+bool
+tree__save_checkpoint(struct Tree const *me, struct CheckpointWriter *writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    KeyType *const keys = malloc(me->cardinality * sizeof(*keys));
+    if (keys == NULL && me->cardinality != 0) {
+        LOGGER_ERROR("failed to allocate %" PRIu64 " keys", me->cardinality);
+        return false;
+    }
+    size_t const n = subtree__get_sorted_keys(me->root, keys);
+    bool const ok =
+        n == me->cardinality &&
+        CheckpointWriter__write_array(writer, keys, n, sizeof(*keys));
+    free(keys);
+    return ok;
+}
+
+/// @brief  Build a balanced subtree of the sorted keys in [begin, end).
+/// @note   The recursion depth is logarithmic.
+static struct Subtree *
+subtree__from_sorted_keys(KeyType const *const keys,
+                          size_t const begin,
+                          size_t const end,
+                          bool *const ok)
+{
+    if (begin == end) {
+        return NULL;
+    }
+    size_t const mid = begin + (end - begin) / 2;
+    struct Subtree *const me = subtree__new(keys[mid]);
+    if (me == NULL) {
+        *ok = false;
+        return NULL;
+    }
+    me->left_subtree = subtree__from_sorted_keys(keys, begin, mid, ok);
+    me->right_subtree = subtree__from_sorted_keys(keys, mid + 1, end, ok);
+    me->cardinality = end - begin;
+    return me;
+}
+
+bool
+tree__load_checkpoint(struct Tree *me, struct CheckpointReader *reader)
+{
+    size_t n = 0;
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    KeyType const *const keys =
+        CheckpointReader__read_array(reader, &n, sizeof(*keys));
+    if (keys == NULL) {
+        return false;
+    }
+    for (size_t i = 1; i < n; ++i) {
+        if (keys[i - 1] >= keys[i]) {
+            LOGGER_ERROR("tree keys are not strictly increasing at %zu", i);
+            return false;
+        }
+    }
+    bool ok = true;
+    struct Subtree *const root = subtree__from_sorted_keys(keys, 0, n, &ok);
+    if (!ok) {
+        free_subtree(root);
+        return false;
+    }
+    tree__destroy(me);
+    *me = (struct Tree){.root = root, .cardinality = n};
+    return true;
+}
+
 void
 tree__destroy(struct Tree *me)
 {
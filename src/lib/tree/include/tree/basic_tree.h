@@ -9,6 +9,9 @@
 
 #include "tree/types.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct Subtree *
 subtree__new(KeyType key);
 
@@ -22,6 +25,10 @@ tree__new(void);
 uint64_t
 tree__cardinality(struct Tree *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+tree__memory_usage(struct Tree const *const me);
+
 bool
 subtree__insert(struct Subtree *me, KeyType key);
 
@@ -55,6 +62,18 @@ tree__prettyprint(struct Tree *me);
 bool
 tree__validate(struct Tree *me);
 
+/// @brief  Append the keys (in order) to a checkpoint.
+/// @note   We temporarily thread the tree to traverse it without a stack,
+///         so this is not safe to call concurrently with a reader. The
+///         tree is restored before we return.
+bool
+tree__save_checkpoint(struct Tree const *me, struct CheckpointWriter *writer);
+
+/// @brief  Replace the tree with a balanced tree of the next keys in a
+///         checkpoint. This takes O(n) time.
+bool
+tree__load_checkpoint(struct Tree *me, struct CheckpointReader *reader);
+
 void
 subtree__free(struct Subtree *me, size_t const recursion_depth);
 
@@ -5,6 +5,7 @@
 
 #include "arrays/reverse_index.h"
 #include "average_eviction_time/average_eviction_time.h"
+#include "checkpoint/checkpoint.h"
 #include "histogram/histogram.h"
 #include "invariants/implies.h"
 #include "io/io.h"
@@ -14,6 +15,10 @@
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "sampler/phase_sampler.h"
 
+static bool
+convert_hist_to_mrc(struct Histogram const *const hist,
+                    struct MissRateCurve *const mrc);
+
 bool
 AverageEvictionTime__init(struct AverageEvictionTime *const me,
                           uint64_t const histogram_num_bins,
@@ -48,7 +53,9 @@ AverageEvictionTime__init(struct AverageEvictionTime *const me,
         me->use_phase_sampling = true;
         me->phase_sampling_epoch = phase_sampling_epoch;
         me->phase_sampler = (struct PhaseSampler){0};
-        r = PhaseSampler__init(&me->phase_sampler);
+        r = PhaseSampler__init_full(&me->phase_sampler,
+                                    convert_hist_to_mrc,
+                                    PHASE_SAMPLER_DEFAULT_SPILL_THRESHOLD);
         // NOTE I don't know if this is the error handling pathway we
         //      want. Honestly, I haven't thought particularly hard
         //      about this.
@@ -245,42 +252,23 @@ AverageEvictionTime__to_mrc(struct AverageEvictionTime const *const me,
     if (!me->use_phase_sampling)
         return convert_hist_to_mrc(&me->histogram, mrc);
 
-    assert(me->phase_sampler.saved_histograms->len != 0);
+    assert(PhaseSampler__num_phases(&me->phase_sampler) != 0);
     double current_fullness =
         (double)me->histogram.running_sum / me->phase_sampling_epoch;
-    double scale =
-        1 / (me->phase_sampler.saved_histograms->len + current_fullness);
-    // We preallocate the MRC simply because it's easier this way.
-    if (!MissRateCurve__alloc_empty(mrc,
-                                    me->histogram.num_bins + 2,
-                                    me->histogram.bin_size)) {
-        LOGGER_ERROR("failed to allocate MRC");
-        return false;
-    }
-    for (size_t i = 0; i < me->phase_sampler.saved_histograms->len; ++i) {
-        char *hist_path = me->phase_sampler.saved_histograms->pdata[i];
-        struct Histogram hist = {0};
-        r = Histogram__load(&hist, hist_path);
-        assert(r);
-        struct MissRateCurve my_mrc = {0};
-        r = convert_hist_to_mrc(&hist, &my_mrc);
-        assert(r);
-        r = MissRateCurve__scaled_iadd(mrc, &my_mrc, scale);
-        assert(r);
-        Histogram__destroy(&hist);
-        MissRateCurve__destroy(&my_mrc);
-    }
 
     // Add contribution from current histograms
     struct MissRateCurve my_mrc = {0};
     r = convert_hist_to_mrc(&me->histogram, &my_mrc);
     assert(r);
-    // We decrease the scale because the current histogram may not be "full".
-    r = MissRateCurve__scaled_iadd(mrc, &my_mrc, scale * current_fullness);
-    assert(r);
+    // We decrease the weight because the current histogram may not be
+    // "full". The sampler keeps a running sum of the complete phases.
+    r = PhaseSampler__create_weighted_mrc(&me->phase_sampler,
+                                          mrc,
+                                          &my_mrc,
+                                          current_fullness);
     MissRateCurve__destroy(&my_mrc);
 
-    return true;
+    return r;
 }
 
 /// @brief  Calculate the Complement-Cumulative Distribution Function
@@ -358,6 +346,35 @@ AverageEvictionTime__their_to_mrc(struct AverageEvictionTime const *const me,
     return convert_hist_to_mrc_their_way(&me->histogram, mrc);
 }
 
+bool
+AverageEvictionTime__save_checkpoint(
+    struct AverageEvictionTime const *const me,
+    struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->current_time_stamp) &&
+           HashTable__save_checkpoint(&me->hash_table, writer) &&
+           Histogram__save_checkpoint(&me->histogram, writer) &&
+           (!me->use_phase_sampling ||
+            PhaseSampler__save_checkpoint(&me->phase_sampler, writer));
+}
+
+bool
+AverageEvictionTime__load_checkpoint(struct AverageEvictionTime *const me,
+                                     struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    return CheckpointReader__read_u64(reader, &me->current_time_stamp) &&
+           HashTable__load_checkpoint(&me->hash_table, reader) &&
+           Histogram__load_checkpoint(&me->histogram, reader) &&
+           (!me->use_phase_sampling ||
+            PhaseSampler__load_checkpoint(&me->phase_sampler, reader));
+}
+
 void
 AverageEvictionTime__destroy(struct AverageEvictionTime *me)
 {
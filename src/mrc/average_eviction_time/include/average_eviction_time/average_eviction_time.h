@@ -10,6 +10,9 @@
 #include "sampler/phase_sampler.h"
 #include "types/entry_type.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct AverageEvictionTime {
     struct HashTable hash_table;
     struct Histogram histogram;
@@ -73,5 +76,16 @@ bool
 AverageEvictionTime__their_to_mrc(struct AverageEvictionTime const *const me,
                                   struct MissRateCurve *const mrc);
 
+/// @brief  Append the full state to a checkpoint.
+bool
+AverageEvictionTime__save_checkpoint(struct AverageEvictionTime const *const me,
+                                     struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+AverageEvictionTime__load_checkpoint(struct AverageEvictionTime *const me,
+                                     struct CheckpointReader *const reader);
+
 void
 AverageEvictionTime__destroy(struct AverageEvictionTime *me);
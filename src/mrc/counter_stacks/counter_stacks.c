@@ -0,0 +1,552 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "counter_stacks/counter_stacks.h"
+#include "hash/hash.h"
+#include "hash/types.h"
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "math/count_leading_zeros.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "types/entry_type.h"
+#include "types/time_stamp_type.h"
+
+/// Source: https://en.wikipedia.org/wiki/HyperLogLog#Practical_considerations
+static double
+hll_alpha_m(uint64_t const m)
+{
+    if (m == 16) {
+        return 0.673;
+    } else if (m == 32) {
+        return 0.697;
+    } else if (m == 64) {
+        return 0.709;
+    } else {
+        return 0.7213 / (1 + 1.079 / m);
+    }
+}
+
+static bool
+init_counter(struct CounterStacksCounter *const counter,
+             TimeStampType const start_time_stamp,
+             uint64_t const num_registers)
+{
+    assert(counter != NULL);
+    uint8_t *registers = calloc(num_registers, sizeof(*registers));
+    if (registers == NULL) {
+        LOGGER_ERROR("bad calloc(%" PRIu64 ", %zu)",
+                     num_registers,
+                     sizeof(*registers));
+        return false;
+    }
+    *counter = (struct CounterStacksCounter){
+        .start_time_stamp = start_time_stamp,
+        .prev_count = 0,
+        .num_zero_registers = num_registers,
+        // NOTE Every register is zero, so each contributes 2^-0 = 1.
+        .inv_z = (double)num_registers,
+        .registers = registers,
+    };
+    return true;
+}
+
+static void
+destroy_counter(struct CounterStacksCounter *const counter)
+{
+    if (counter == NULL) {
+        return;
+    }
+    free(counter->registers);
+    *counter = (struct CounterStacksCounter){0};
+}
+
+/// @return whether the register changed. If it didn't, then none of
+///         the older counters' registers will change either.
+static inline bool
+update_counter(struct CounterStacksCounter *const counter,
+               uint64_t const index,
+               uint8_t const rank)
+{
+    uint8_t const old_rank = counter->registers[index];
+    if (rank <= old_rank) {
+        return false;
+    }
+    if (old_rank == 0) {
+        --counter->num_zero_registers;
+    }
+    counter->inv_z += ldexp(1.0, -rank) - ldexp(1.0, -old_rank);
+    counter->registers[index] = rank;
+    return true;
+}
+
+static uint64_t
+estimate_counter(struct CounterStacks const *const me,
+                 struct CounterStacksCounter const *const counter)
+{
+    double const m = (double)me->num_registers;
+    double const raw_estimate = me->hll_alpha_m * m * m / counter->inv_z;
+    if (raw_estimate <= 2.5 * m && counter->num_zero_registers != 0) {
+        return (uint64_t)round(
+            m * log(m / (double)counter->num_zero_registers));
+    }
+    return (uint64_t)round(raw_estimate);
+}
+
+static bool
+initialize(struct CounterStacks *const me,
+           uint64_t const downsample_interval,
+           double const pruning_delta,
+           uint64_t const precision,
+           size_t const histogram_num_bins,
+           size_t const histogram_bin_size,
+           enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+{
+    if (me == NULL || downsample_interval == 0 || pruning_delta < 0.0 ||
+        pruning_delta >= 1.0 || precision < 4 || precision > 18) {
+        LOGGER_WARN("bad input");
+        return false;
+    }
+    *me = (struct CounterStacks){
+        .counters = NULL,
+        .num_counters = 0,
+        .capacity = 0,
+        .downsample_interval = downsample_interval,
+        .pruning_delta = pruning_delta,
+        .precision = precision,
+        .num_registers = UINT64_C(1) << precision,
+        .hll_alpha_m = hll_alpha_m(UINT64_C(1) << precision),
+        .current_time_stamp = 0,
+        .num_unprocessed = 0,
+    };
+    if (!Histogram__init(&me->histogram,
+                         histogram_num_bins,
+                         histogram_bin_size,
+                         out_of_bounds_mode)) {
+        LOGGER_WARN("failed to initialize histogram");
+        return false;
+    }
+    return true;
+}
+
+bool
+CounterStacks__init(struct CounterStacks *const me,
+                    uint64_t const downsample_interval,
+                    double const pruning_delta,
+                    uint64_t const precision,
+                    size_t const histogram_num_bins,
+                    size_t const histogram_bin_size)
+{
+    return initialize(me,
+                      downsample_interval,
+                      pruning_delta,
+                      precision,
+                      histogram_num_bins,
+                      histogram_bin_size,
+                      HistogramOutOfBoundsMode__allow_overflow);
+}
+
+bool
+CounterStacks__init_full(
+    struct CounterStacks *const me,
+    uint64_t const downsample_interval,
+    double const pruning_delta,
+    uint64_t const precision,
+    size_t const histogram_num_bins,
+    size_t const histogram_bin_size,
+    enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+{
+    return initialize(me,
+                      downsample_interval,
+                      pruning_delta,
+                      precision,
+                      histogram_num_bins,
+                      histogram_bin_size,
+                      out_of_bounds_mode);
+}
+
+static bool
+start_counter(struct CounterStacks *const me)
+{
+    assert(me != NULL);
+    if (me->num_counters == me->capacity) {
+        size_t const new_capacity = me->capacity == 0 ? 16 : 2 * me->capacity;
+        struct CounterStacksCounter *new_counters =
+            realloc(me->counters, new_capacity * sizeof(*new_counters));
+        if (new_counters == NULL) {
+            LOGGER_ERROR("failed to grow counters from %zu to %zu",
+                         me->capacity,
+                         new_capacity);
+            return false;
+        }
+        me->counters = new_counters;
+        me->capacity = new_capacity;
+    }
+    if (!init_counter(&me->counters[me->num_counters],
+                      me->current_time_stamp,
+                      me->num_registers)) {
+        return false;
+    }
+    ++me->num_counters;
+    return true;
+}
+
+/// @brief  Remove counters that are nearly equal to the next older one.
+/// @note   We never prune the oldest counter because it records the
+///         cold misses.
+static void
+prune_counters(struct CounterStacks *const me)
+{
+    assert(me != NULL);
+    if (me->num_counters == 0) {
+        return;
+    }
+    size_t last_kept = 0;
+    for (size_t i = 1; i < me->num_counters; ++i) {
+        struct CounterStacksCounter *const c = &me->counters[i];
+        if ((double)c->prev_count >= (1.0 - me->pruning_delta) *
+                                         me->counters[last_kept].prev_count) {
+            destroy_counter(c);
+            continue;
+        }
+        ++last_kept;
+        // NOTE This shallow copy transfers ownership of the registers.
+        me->counters[last_kept] = *c;
+    }
+    me->num_counters = last_kept + 1;
+}
+
+/// @brief  Convert the growth of the counters over the last interval
+///         into reuse distances.
+/// @details    Let c_i be the value of the i-th oldest counter and d_i
+///             be how much it grew over the interval. An access that
+///             grows counter i+1 but not counter i was last accessed
+///             between the start of counters i and i+1, so its reuse
+///             distance is roughly c_i. Accesses that grow even the
+///             oldest counter are cold misses.
+static bool
+process_counters(struct CounterStacks *const me)
+{
+    assert(me != NULL);
+    uint64_t const block_length = me->num_unprocessed;
+    if (block_length == 0 || me->num_counters == 0) {
+        return true;
+    }
+
+    // The growth and value of the next older counter.
+    uint64_t older_delta = 0;
+    uint64_t older_count = 0;
+    for (size_t i = 0; i < me->num_counters; ++i) {
+        struct CounterStacksCounter *const c = &me->counters[i];
+        uint64_t const count = estimate_counter(me, c);
+        // NOTE The HyperLogLog estimates may be noisy, so we clamp the
+        //      growth to what is possible in this interval.
+        uint64_t delta = count > c->prev_count ? count - c->prev_count : 0;
+        if (delta > block_length) {
+            delta = block_length;
+        }
+        if (i == 0) {
+            Histogram__insert_scaled_infinite(&me->histogram, delta);
+        } else if (delta > older_delta) {
+            Histogram__insert_weighted_finite(&me->histogram,
+                                              older_count ? older_count - 1 : 0,
+                                              delta - older_delta);
+        }
+        c->prev_count = count;
+        // NOTE Newer counters should grow at least as much as older
+        //      ones, but the estimates are noisy.
+        older_delta = MAX(older_delta, delta);
+        older_count = count;
+    }
+    // Reuses of keys that were already seen since the newest counter
+    // was started.
+    if (block_length > older_delta) {
+        Histogram__insert_weighted_finite(&me->histogram,
+                                          older_count ? older_count - 1 : 0,
+                                          block_length - older_delta);
+    }
+
+    prune_counters(me);
+    me->num_unprocessed = 0;
+    return true;
+}
+
+bool
+CounterStacks__access_item(struct CounterStacks *const me,
+                           EntryType const entry)
+{
+    if (me == NULL || me->histogram.histogram == NULL) {
+        return false;
+    }
+    if (me->current_time_stamp % me->downsample_interval == 0) {
+        if (!process_counters(me)) {
+            return false;
+        }
+        if (!start_counter(me)) {
+            return false;
+        }
+    }
+
+    Hash64BitType const hash = Hash64Bit(entry);
+    uint64_t const index = hash >> (64 - me->precision);
+    // NOTE We set a sentinel bit so that the rank is bounded by the
+    //      number of non-index bits (and so clz(0) never occurs).
+    uint8_t const rank =
+        clz((hash << me->precision) | (UINT64_C(1) << (me->precision - 1))) +
+        1;
+    // NOTE Older counters have seen a superset of the keys that newer
+    //      counters have seen, so their registers are at least as large.
+    //      Once a counter's register doesn't change, we can stop.
+    for (size_t i = me->num_counters; i > 0; --i) {
+        if (!update_counter(&me->counters[i - 1], index, rank)) {
+            break;
+        }
+    }
+    ++me->current_time_stamp;
+    ++me->num_unprocessed;
+    return true;
+}
+
+bool
+CounterStacks__post_process(struct CounterStacks *const me)
+{
+    if (me == NULL) {
+        return false;
+    }
+    return process_counters(me);
+}
+
+bool
+CounterStacks__to_mrc(struct CounterStacks const *const me,
+                      struct MissRateCurve *const mrc)
+{
+    if (me == NULL) {
+        return false;
+    }
+    return MissRateCurve__init_from_histogram(mrc, &me->histogram);
+}
+
+void
+CounterStacks__print_histogram_as_json(struct CounterStacks *const me)
+{
+    if (me == NULL) {
+        // Just pass on the NULL value and let the histogram deal with it.
+        Histogram__print_as_json(NULL);
+        return;
+    }
+    Histogram__print_as_json(&me->histogram);
+}
+
+void
+CounterStacks__destroy(struct CounterStacks *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < me->num_counters; ++i) {
+        destroy_counter(&me->counters[i]);
+    }
+    free(me->counters);
+    Histogram__destroy(&me->histogram);
+    *me = (struct CounterStacks){0};
+}
+
+bool
+CounterStacks__get_histogram(struct CounterStacks const *const me,
+                             struct Histogram const **const histogram)
+{
+    if (me == NULL || histogram == NULL) {
+        return false;
+    }
+    *histogram = &me->histogram;
+    return true;
+}
+
+/// @note   This must follow the same order as 'read_fields'.
+static bool
+write_fields(FILE *const fp, struct CounterStacks const *const me)
+{
+    assert(fp != NULL && me != NULL);
+    struct Histogram const *const h = &me->histogram;
+    // NOTE We store the raw bins, which we cannot reinterpret as a
+    //      logarithmic histogram when we read them back.
+    if (h->out_of_bounds_mode == HistogramOutOfBoundsMode__log) {
+        LOGGER_ERROR("cannot save logarithmic histogram bins");
+        return false;
+    }
+    uint64_t const fields[] = {
+        me->downsample_interval,
+        me->precision,
+        me->current_time_stamp,
+        me->num_unprocessed,
+        me->num_counters,
+        h->num_bins,
+        h->bin_size,
+        h->false_infinity,
+        h->infinity,
+        h->running_sum,
+    };
+    if (fwrite(fields, sizeof(*fields), 10, fp) != 10 ||
+        fwrite(&me->pruning_delta, sizeof(me->pruning_delta), 1, fp) != 1) {
+        LOGGER_ERROR("failed to write counter stack parameters");
+        return false;
+    }
+    if (fwrite(h->histogram, sizeof(*h->histogram), h->num_bins, fp) !=
+        h->num_bins) {
+        LOGGER_ERROR("failed to write histogram");
+        return false;
+    }
+    for (size_t i = 0; i < me->num_counters; ++i) {
+        struct CounterStacksCounter const *const c = &me->counters[i];
+        if (fwrite(&c->start_time_stamp, sizeof(c->start_time_stamp), 1, fp) !=
+                1 ||
+            fwrite(&c->prev_count, sizeof(c->prev_count), 1, fp) != 1 ||
+            fwrite(&c->num_zero_registers,
+                   sizeof(c->num_zero_registers),
+                   1,
+                   fp) != 1 ||
+            fwrite(&c->inv_z, sizeof(c->inv_z), 1, fp) != 1 ||
+            fwrite(c->registers, sizeof(*c->registers), me->num_registers, fp) !=
+                me->num_registers) {
+            LOGGER_ERROR("failed to write counter %zu", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @note   This must follow the same order as 'write_fields'.
+static bool
+read_fields(FILE *const fp,
+            struct CounterStacks *const me,
+            enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+{
+    assert(fp != NULL && me != NULL);
+    uint64_t fields[10] = {0};
+    double pruning_delta = 0.0;
+    if (out_of_bounds_mode == HistogramOutOfBoundsMode__log) {
+        LOGGER_ERROR("cannot load logarithmic histogram bins");
+        return false;
+    }
+    if (fread(fields, sizeof(*fields), 10, fp) != 10 ||
+        fread(&pruning_delta, sizeof(pruning_delta), 1, fp) != 1) {
+        LOGGER_ERROR("failed to read counter stack parameters");
+        return false;
+    }
+    if (!initialize(me,
+                    fields[0],
+                    pruning_delta,
+                    fields[1],
+                    fields[5],
+                    fields[6],
+                    out_of_bounds_mode)) {
+        LOGGER_ERROR("failed to initialize counter stack");
+        return false;
+    }
+    struct Histogram *const h = &me->histogram;
+    if (fread(h->histogram, sizeof(*h->histogram), h->num_bins, fp) !=
+        h->num_bins) {
+        LOGGER_ERROR("failed to read histogram");
+        return false;
+    }
+    h->false_infinity = fields[7];
+    h->infinity = fields[8];
+    h->running_sum = fields[9];
+
+    me->current_time_stamp = fields[2];
+    for (size_t i = 0; i < fields[4]; ++i) {
+        TimeStampType start_time_stamp = 0;
+        uint64_t prev_count = 0, num_zero_registers = 0;
+        double inv_z = 0.0;
+        if (fread(&start_time_stamp, sizeof(start_time_stamp), 1, fp) != 1 ||
+            fread(&prev_count, sizeof(prev_count), 1, fp) != 1 ||
+            fread(&num_zero_registers, sizeof(num_zero_registers), 1, fp) !=
+                1 ||
+            fread(&inv_z, sizeof(inv_z), 1, fp) != 1) {
+            LOGGER_ERROR("failed to read counter %zu", i);
+            return false;
+        }
+        // NOTE We temporarily set the time stamp so that the counter is
+        //      started with the correct value.
+        me->current_time_stamp = start_time_stamp;
+        if (!start_counter(me)) {
+            return false;
+        }
+        struct CounterStacksCounter *const c = &me->counters[i];
+        if (fread(c->registers, sizeof(*c->registers), me->num_registers, fp) !=
+            me->num_registers) {
+            LOGGER_ERROR("failed to read counter %zu", i);
+            return false;
+        }
+        // NOTE We store the running sum rather than recomputing it from
+        //      the registers so that the floating-point rounding (and
+        //      thus the estimates) are identical to before saving.
+        c->prev_count = prev_count;
+        c->num_zero_registers = num_zero_registers;
+        c->inv_z = inv_z;
+    }
+    me->current_time_stamp = fields[2];
+    me->num_unprocessed = fields[3];
+    return true;
+}
+
+bool
+CounterStacks__save(struct CounterStacks const *const me,
+                    char const *const path)
+{
+    if (me == NULL || me->histogram.histogram == NULL || path == NULL) {
+        return false;
+    }
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        LOGGER_ERROR("could not open '%s'", path);
+        return false;
+    }
+    // NOTE I am assuming the endianness of the writer and reader will
+    //      be the same.
+    if (!write_fields(fp, me)) {
+        LOGGER_ERROR("failed to write counter stack to '%s'", path);
+        fclose(fp);
+        return false;
+    }
+    if (fclose(fp) != 0) {
+        LOGGER_ERROR("failed to close '%s'", path);
+        return false;
+    }
+    return true;
+}
+
+bool
+CounterStacks__load(struct CounterStacks *const me,
+                    char const *const path,
+                    enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+{
+    if (me == NULL || path == NULL) {
+        return false;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        LOGGER_ERROR("could not open '%s'", path);
+        return false;
+    }
+    if (!read_fields(fp, me, out_of_bounds_mode)) {
+        LOGGER_ERROR("failed to read counter stack from '%s'", path);
+        fclose(fp);
+        CounterStacks__destroy(me);
+        return false;
+    }
+    if (fclose(fp) != 0) {
+        LOGGER_ERROR("failed to close '%s'", path);
+        CounterStacks__destroy(me);
+        return false;
+    }
+    return true;
+}
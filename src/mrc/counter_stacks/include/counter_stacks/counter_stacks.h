@@ -0,0 +1,143 @@
+/** @brief  An implementation of Wires et al.'s Counter Stacks.
+ *
+ *  Counter Stacks estimates reuse distances without tracking individual
+ *  keys. We start a new cardinality counter every 'downsample_interval'
+ *  accesses. Every counter counts the number of unique keys seen since
+ *  it was started. At the end of each interval, the difference between
+ *  how much neighbouring counters grew tells us how many accesses were
+ *  reuses of keys last seen between the two counters' start times, and
+ *  the value of the older counter tells us the reuse distance.
+ *
+ *  Source: Wires et al. "Characterizing Storage Workloads with Counter
+ *  Stacks" (OSDI '14).
+ *
+ * @note    The counters are HyperLogLogs, so the memory is sublinear in
+ *          the number of unique keys. We prune counters whose values
+ *          are within a factor of (1 - pruning_delta) of the next older
+ *          counter, so the number of counters is logarithmic in the
+ *          working set size.
+ * @note    We do not support merging two independently built summaries.
+ *          Combining them would need to know which of the second
+ *          summary's cold misses (and at what distance) were reuses of
+ *          keys from the first, but the pruned counters no longer
+ *          record when those keys were seen. To summarize a long trace
+ *          in pieces, chain them instead: save the summary of one
+ *          segment and load it before processing the next.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram/histogram.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "types/entry_type.h"
+#include "types/time_stamp_type.h"
+
+// NOTE These defaults were chosen to roughly match the accuracy of
+//      Fixed-Size SHARDS with 1 << 13 samples on Zipfian traces.
+#define COUNTER_STACKS_DEFAULT_DOWNSAMPLE_INTERVAL (UINT64_C(1) << 10)
+#define COUNTER_STACKS_DEFAULT_PRUNING_DELTA       0.02
+#define COUNTER_STACKS_DEFAULT_PRECISION           12
+
+struct CounterStacksCounter {
+    // The time stamp when we started this counter.
+    TimeStampType start_time_stamp;
+    // The cardinality estimate when we last processed the counters.
+    uint64_t prev_count;
+    // Number of registers that are still zero (for linear counting).
+    uint64_t num_zero_registers;
+    // The running sum of 2^-M[j] for all registers j.
+    double inv_z;
+    uint8_t *registers;
+};
+
+struct CounterStacks {
+    // The counters are ordered from oldest to newest. The oldest
+    // counter is never pruned, since it counts the cold misses.
+    struct CounterStacksCounter *counters;
+    size_t num_counters;
+    size_t capacity;
+
+    // Parameters
+    uint64_t downsample_interval;
+    double pruning_delta;
+    uint64_t precision;
+    uint64_t num_registers;
+    double hll_alpha_m;
+
+    struct Histogram histogram;
+    TimeStampType current_time_stamp;
+    // The number of accesses since we last processed the counters.
+    uint64_t num_unprocessed;
+};
+
+/// @param  downsample_interval: uint64_t const
+///         The number of accesses between starting new counters. This
+///         is also the granularity at which we process the counters.
+/// @param  pruning_delta: double const
+///         Prune a counter if its value is at least (1 - pruning_delta)
+///         of the value of the next older counter. Must be in [0, 1).
+/// @param  precision: uint64_t const
+///         The log2 of the number of registers per HyperLogLog counter.
+bool
+CounterStacks__init(struct CounterStacks *const me,
+                    uint64_t const downsample_interval,
+                    double const pruning_delta,
+                    uint64_t const precision,
+                    size_t const histogram_num_bins,
+                    size_t const histogram_bin_size);
+
+/// @brief  See 'CounterStacks__init'.
+/// @note   The interface is less stable than 'CounterStacks__init'.
+bool
+CounterStacks__init_full(
+    struct CounterStacks *const me,
+    uint64_t const downsample_interval,
+    double const pruning_delta,
+    uint64_t const precision,
+    size_t const histogram_num_bins,
+    size_t const histogram_bin_size,
+    enum HistogramOutOfBoundsMode const out_of_bounds_mode);
+
+bool
+CounterStacks__access_item(struct CounterStacks *const me,
+                           EntryType const entry);
+
+/// @brief  Process the final (partial) interval.
+/// @note   It is safe to continue accessing items after this.
+bool
+CounterStacks__post_process(struct CounterStacks *const me);
+
+bool
+CounterStacks__to_mrc(struct CounterStacks const *const me,
+                      struct MissRateCurve *const mrc);
+
+void
+CounterStacks__print_histogram_as_json(struct CounterStacks *const me);
+
+void
+CounterStacks__destroy(struct CounterStacks *const me);
+
+bool
+CounterStacks__get_histogram(struct CounterStacks const *const me,
+                             struct Histogram const **const histogram);
+
+/// @brief  Save the counter stack (i.e. parameters, live counters, and
+///         the histogram) to a file.
+/// @details    The summary is small because the number of live counters
+///             is logarithmic in the working set size. Loading a summary
+///             and continuing with the rest of a trace is equivalent to
+///             running over the concatenated trace, so summaries of
+///             consecutive trace segments can be chained together.
+bool
+CounterStacks__save(struct CounterStacks const *const me,
+                    char const *const path);
+
+/// @brief  Load a counter stack previously saved by 'CounterStacks__save'.
+/// @param  me: an uninitialized counter stack.
+bool
+CounterStacks__load(struct CounterStacks *const me,
+                    char const *const path,
+                    enum HistogramOutOfBoundsMode const out_of_bounds_mode);
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "checkpoint/checkpoint.h"
 #include "histogram/histogram.h"
 #ifdef INTERVAL_STATISTICS
 #include "interval_statistics/interval_statistics.h"
@@ -12,6 +13,7 @@
 #include "lookup/dictionary.h"
 #include "lookup/evicting_hash_table.h"
 #include "miss_rate_curve/miss_rate_curve.h"
+#include "profiler/profiler.h"
 #include "tree/basic_tree.h"
 #include "tree/sleator_tree.h"
 #include "types/entry_type.h"
@@ -143,9 +145,13 @@ handle_inserted(struct EvictingMap *me,
     bool r = false;
     MAYBE_UNUSED(r);
 
+    uint64_t start = Profiler__start();
     r = tree__sleator_insert(&me->tree, value);
     assert(r);
+    Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
+    start = Profiler__start();
     Histogram__insert_scaled_infinite(&me->histogram, scale == 0 ? 1 : scale);
+    Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
 #ifdef INTERVAL_STATISTICS
     IntervalStatistics__append_infinity(&me->istats);
 #endif
@@ -165,12 +171,16 @@ handle_replaced(struct EvictingMap *me,
     bool r = false;
     MAYBE_UNUSED(r);
 
+    uint64_t start = Profiler__start();
     r = tree__sleator_remove(&me->tree, s.old_value);
     assert(r);
     r = tree__sleator_insert(&me->tree, timestamp);
     assert(r);
+    Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
 
+    start = Profiler__start();
     Histogram__insert_scaled_infinite(&me->histogram, scale == 0 ? 1 : scale);
+    Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
 #ifdef INTERVAL_STATISTICS
     IntervalStatistics__append_infinity(&me->istats);
 #endif
@@ -190,15 +200,19 @@ handle_updated(struct EvictingMap *me,
     uint64_t distance = 0;
     MAYBE_UNUSED(r);
 
+    uint64_t start = Profiler__start();
     distance = tree__reverse_rank(&me->tree, (KeyType)s.old_value);
     r = tree__sleator_remove(&me->tree, s.old_value);
     assert(r);
     r = tree__sleator_insert(&me->tree, timestamp);
     assert(r);
+    Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
 
+    start = Profiler__start();
     Histogram__insert_scaled_finite(&me->histogram,
                                     distance,
                                     scale == 0 ? 1 : scale);
+    Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
 #ifdef INTERVAL_STATISTICS
     IntervalStatistics__append_scaled(&me->istats,
                                       (double)distance,
@@ -230,8 +244,12 @@ EvictingMap__access_item(struct EvictingMap *me, EntryType entry)
         Statistics__append_uint64(&me->stats, stats);
     }
 #endif
+    // NOTE The evicting hash table samples, looks up, and evicts all at
+    //      once, so we count all of it as the hash lookup.
+    uint64_t const prof_start = Profiler__start();
     struct SampledTryPutReturn r =
         EvictingHashTable__try_put(&me->hash_table, entry, timestamp);
+    Profiler__stop(PROFILER_SCOPE_HASH_LOOKUP, prof_start);
     switch (r.status) {
     case SAMPLED_IGNORED:
         /* Do no work -- this is like SHARDS */
@@ -289,6 +307,49 @@ EvictingMap__print_histogram_as_json(struct EvictingMap *me)
     Histogram__print_as_json(&me->histogram);
 }
 
+size_t
+EvictingMap__memory_usage(struct EvictingMap const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return tree__memory_usage(&me->tree) +
+           EvictingHashTable__memory_usage(&me->hash_table) +
+           Histogram__memory_usage(&me->histogram);
+}
+
+/// @note   We do not save the interval or threshold statistics, which
+///         are only for debugging.
+bool
+EvictingMap__save_checkpoint(struct EvictingMap const *const me,
+                             struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->current_time_stamp) &&
+           tree__save_checkpoint(&me->tree, writer) &&
+           EvictingHashTable__save_checkpoint(&me->hash_table, writer) &&
+           Histogram__save_checkpoint(&me->histogram, writer);
+}
+
+bool
+EvictingMap__load_checkpoint(struct EvictingMap *const me,
+                             struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    if (!CheckpointReader__read_u64(reader, &me->current_time_stamp) ||
+        !tree__load_checkpoint(&me->tree, reader) ||
+        !EvictingHashTable__load_checkpoint(&me->hash_table, reader) ||
+        !Histogram__load_checkpoint(&me->histogram, reader)) {
+        LOGGER_ERROR("failed to load Evicting Map");
+        return false;
+    }
+    return true;
+}
+
 void
 EvictingMap__destroy(struct EvictingMap *me)
 {
@@ -20,6 +20,9 @@
 #include "profile/profile.h"
 #endif
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct EvictingMap {
     struct Tree tree;
     struct EvictingHashTable hash_table;
@@ -72,6 +75,21 @@ EvictingMap__to_mrc(struct EvictingMap const *const me,
 void
 EvictingMap__print_histogram_as_json(struct EvictingMap *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+EvictingMap__memory_usage(struct EvictingMap const *const me);
+
+/// @brief  Append the full state to a checkpoint.
+bool
+EvictingMap__save_checkpoint(struct EvictingMap const *const me,
+                             struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+EvictingMap__load_checkpoint(struct EvictingMap *const me,
+                             struct CheckpointReader *const reader);
+
 void
 EvictingMap__destroy(struct EvictingMap *me);
 
@@ -204,6 +204,21 @@ EvictingQuickMRC__print_histogram_as_json(struct EvictingQuickMRC *me)
     Histogram__print_as_json(&me->histogram);
 }
 
+size_t
+EvictingQuickMRC__memory_usage(struct EvictingQuickMRC const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    size_t qmrc_bytes = me->qmrc.nr_buckets *
+                        (sizeof(*me->qmrc.epochs) + sizeof(*me->qmrc.counts));
+#ifdef STATS
+    qmrc_bytes += 3 * me->qmrc.nr_buckets * sizeof(size_t);
+#endif /* STATS */
+    return EvictingHashTable__memory_usage(&me->hash_table) + qmrc_bytes +
+           Histogram__memory_usage(&me->histogram);
+}
+
 void
 EvictingQuickMRC__destroy(struct EvictingQuickMRC *me)
 {
@@ -51,6 +51,10 @@ EvictingQuickMRC__to_mrc(struct EvictingQuickMRC const *const me,
 void
 EvictingQuickMRC__print_histogram_as_json(struct EvictingQuickMRC *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+EvictingQuickMRC__memory_usage(struct EvictingQuickMRC const *const me);
+
 void
 EvictingQuickMRC__destroy(struct EvictingQuickMRC *me);
 
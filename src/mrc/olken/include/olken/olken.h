@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <glib.h>
@@ -19,6 +20,9 @@
 #include "profile/profile.h"
 #endif
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct Olken {
     struct Tree tree;
     struct KHashTable hash_table;
@@ -47,6 +51,13 @@ Olken__init_full(struct Olken *const me,
 bool
 Olken__access_item(struct Olken *const me, EntryType const entry);
 
+/// @brief  Access entries in order, as if by 'Olken__access_item'.
+/// @note   We prefetch the hash table's buckets for the upcoming entries.
+bool
+Olken__access_batch(struct Olken *const me,
+                    EntryType const *const entries,
+                    size_t const num_entries);
+
 bool
 Olken__remove_item(struct Olken *me, EntryType entry);
 
@@ -76,6 +87,28 @@ Olken__to_mrc(struct Olken const *const me, struct MissRateCurve *const mrc);
 void
 Olken__print_histogram_as_json(struct Olken *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+Olken__memory_usage(struct Olken const *const me);
+
+/// @brief  Append the full state to a checkpoint.
+bool
+Olken__save_checkpoint(struct Olken const *const me,
+                       struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+Olken__load_checkpoint(struct Olken *const me,
+                       struct CheckpointReader *const reader);
+
+/// @brief  Like 'Olken__load_checkpoint' but without checking that every
+///         key in the hash table is in the tree.
+/// @note   This is for wrappers that keep some keys in their own tree.
+bool
+Olken__load_checkpoint_unchecked(struct Olken *const me,
+                                 struct CheckpointReader *const reader);
+
 void
 Olken__destroy(struct Olken *const me);
 
@@ -6,15 +6,40 @@
 #include <glib.h>
 
 #include "lookup/dictionary.h"
+#include "lookup/k_hash_table.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
 #include "priority_queue/heap.h"
+#include "shards/fixed_size_shards_sampler.h"
 #include "types/entry_type.h"
 
+enum OlkenWithTTLSampling {
+    // Track every key (i.e. the exact TTL-aware oracle).
+    OLKEN_WITH_TTL_SAMPLING_NONE,
+    // Track the keys whose hash is below a fixed threshold.
+    OLKEN_WITH_TTL_SAMPLING_FIXED_RATE,
+    // Track at most 'max_size' keys with the smallest hashes.
+    OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE,
+};
+
 struct OlkenWithTTL {
     struct Olken olken;
     struct Heap pq;
     struct Dictionary const *dictionary;
+
+    enum OlkenWithTTLSampling sampling;
+    // Fixed-rate SHARDS parameters. The fixed-size sampler keeps its own.
+    uint64_t threshold;
+    uint64_t scale;
+    // SHARDS adjustment parameters (only for fixed-rate SHARDS).
+    bool adjustment;
+    uint64_t num_entries_seen;
+    uint64_t num_entries_processed;
+    struct FixedSizeShardsSampler sampler;
+    // The keys that expired while they were still in the fixed-size
+    // sampler. If we see one again, then we must not insert it into the
+    // sampler a second time.
+    struct KHashTable expired;
 };
 
 bool
@@ -31,6 +56,34 @@ OlkenWithTTL__init_full(struct OlkenWithTTL *const me,
                         enum HistogramOutOfBoundsMode const out_of_bounds_mode,
                         struct Dictionary const *const dictionary);
 
+/// @brief  Initialize a SHARDS-sampled TTL-aware oracle.
+/// @details    We scale the histogram increments by the inverse of the
+///             sampling ratio, as in 'FixedRateShards' and
+///             'FixedSizeShards'. Expired keys are removed from the
+///             stack whether or not we have sampled them.
+/// @param  sampling_ratio: the (starting) ratio of keys to track.
+/// @param  max_size: the maximum number of keys to track. This is only
+///                   used for fixed-size SHARDS.
+/// @param  adjustment: whether to perform the SHARDS adjustment. This is
+///                     only supported for fixed-rate SHARDS.
+bool
+OlkenWithTTL__init_sampled(
+    struct OlkenWithTTL *const me,
+    size_t const histogram_num_bins,
+    size_t const histogram_bin_size,
+    enum HistogramOutOfBoundsMode const out_of_bounds_mode,
+    struct Dictionary const *const dictionary,
+    enum OlkenWithTTLSampling const sampling,
+    double const sampling_ratio,
+    size_t const max_size,
+    bool const adjustment);
+
+/// @brief  Parse the sampling mode string, i.e. "none", "fixed-rate",
+///         or "fixed-size".
+bool
+OlkenWithTTLSampling__parse(enum OlkenWithTTLSampling *const me,
+                            char const *const str);
+
 bool
 OlkenWithTTL__access_item(struct OlkenWithTTL *const me,
                           EntryType const entry,
@@ -47,6 +100,14 @@ OlkenWithTTL__to_mrc(struct OlkenWithTTL const *const me,
 void
 OlkenWithTTL__print_histogram_as_json(struct OlkenWithTTL *me);
 
+/// @brief  Get the current sampling ratio.
+double
+OlkenWithTTL__get_sampling_ratio(struct OlkenWithTTL const *const me);
+
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+OlkenWithTTL__memory_usage(struct OlkenWithTTL const *const me);
+
 void
 OlkenWithTTL__destroy(struct OlkenWithTTL *me);
 
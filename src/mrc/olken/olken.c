@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "checkpoint/checkpoint.h"
 #include "histogram/histogram.h"
 #include "logger/logger.h"
 #include "lookup/boost_hash_table.h"
@@ -12,6 +13,7 @@
 #include "lookup/lookup.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
+#include "profiler/profiler.h"
 #include "tree/basic_tree.h"
 #include "tree/sleator_tree.h"
 #include "types/entry_type.h"
@@ -163,24 +165,60 @@ Olken__access_item(struct Olken *const me, EntryType const entry)
     if (me == NULL) {
         return false;
     }
+    uint64_t start = Profiler__start();
     struct LookupReturn found = KHashTable__lookup(&me->hash_table, entry);
+    Profiler__stop(PROFILER_SCOPE_HASH_LOOKUP, start);
     if (found.success) {
+        start = Profiler__start();
         uint64_t distance = Olken__update_stack(me, entry, found.timestamp);
+        Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
         if (distance == UINT64_MAX) {
             return false;
         }
+        start = Profiler__start();
         // TODO(dchu): Maybe record the infinite distances for Parda!
         Histogram__insert_finite(&me->histogram, distance);
+        Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
     } else {
-        if (!Olken__insert_stack(me, entry)) {
+        start = Profiler__start();
+        bool const ok = Olken__insert_stack(me, entry);
+        Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
+        if (!ok) {
             return false;
         }
+        start = Profiler__start();
         Histogram__insert_infinite(&me->histogram);
+        Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
     }
 
     return true;
 }
 
+bool
+Olken__access_batch(struct Olken *const me,
+                    EntryType const *const entries,
+                    size_t const num_entries)
+{
+    bool ok = true;
+    if (me == NULL || (entries == NULL && num_entries != 0)) {
+        return false;
+    }
+    for (size_t i = 0; i < num_entries && i < KHASH_TABLE_PREFETCH_DISTANCE;
+         ++i) {
+        KHashTable__prefetch(&me->hash_table, entries[i]);
+    }
+    for (size_t i = 0; i < num_entries; ++i) {
+        if (i + KHASH_TABLE_PREFETCH_DISTANCE < num_entries) {
+            KHashTable__prefetch(&me->hash_table,
+                                 entries[i + KHASH_TABLE_PREFETCH_DISTANCE]);
+        }
+        if (!Olken__access_item(me, entries[i])) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
 bool
 Olken__post_process(struct Olken *const me)
 {
@@ -207,6 +245,61 @@ Olken__print_histogram_as_json(struct Olken *me)
     Histogram__print_as_json(&me->histogram);
 }
 
+size_t
+Olken__memory_usage(struct Olken const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return tree__memory_usage(&me->tree) +
+           KHashTable__memory_usage(&me->hash_table) +
+           Histogram__memory_usage(&me->histogram);
+}
+
+bool
+Olken__save_checkpoint(struct Olken const *const me,
+                       struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->current_time_stamp) &&
+           tree__save_checkpoint(&me->tree, writer) &&
+           KHashTable__save_checkpoint(&me->hash_table, writer) &&
+           Histogram__save_checkpoint(&me->histogram, writer);
+}
+
+bool
+Olken__load_checkpoint_unchecked(struct Olken *const me,
+                                 struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    if (!CheckpointReader__read_u64(reader, &me->current_time_stamp) ||
+        !tree__load_checkpoint(&me->tree, reader) ||
+        !KHashTable__load_checkpoint(&me->hash_table, reader) ||
+        !Histogram__load_checkpoint(&me->histogram, reader)) {
+        LOGGER_ERROR("failed to load Olken");
+        return false;
+    }
+    return true;
+}
+
+bool
+Olken__load_checkpoint(struct Olken *const me,
+                       struct CheckpointReader *const reader)
+{
+    if (!Olken__load_checkpoint_unchecked(me, reader)) {
+        return false;
+    }
+    if (me->tree.cardinality != KHashTable__get_size(&me->hash_table)) {
+        LOGGER_ERROR("tree and hash table sizes differ");
+        return false;
+    }
+    return true;
+}
+
 void
 Olken__destroy(struct Olken *const me)
 {
@@ -2,18 +2,23 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <glib.h>
 
+#include "hash/hash.h"
 #include "histogram/histogram.h"
 #include "logger/logger.h"
 #include "lookup/dictionary.h"
+#include "lookup/k_hash_table.h"
 #include "lookup/lookup.h"
+#include "math/ratio.h"
 #include "math/saturation_arithmetic.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
 #include "olken/olken_with_ttl.h"
 #include "priority_queue/heap.h"
+#include "shards/fixed_size_shards_sampler.h"
 #include "types/entry_type.h"
 #include "types/time_stamp_type.h"
 #include "unused/mark_unused.h"
@@ -25,12 +30,17 @@ initialize(struct OlkenWithTTL *const me,
            size_t const histogram_num_bins,
            size_t const histogram_bin_size,
            enum HistogramOutOfBoundsMode const out_of_bounds_mode,
-           struct Dictionary const *const dictionary)
+           struct Dictionary const *const dictionary,
+           enum OlkenWithTTLSampling const sampling,
+           double const sampling_ratio,
+           size_t const max_size,
+           bool const adjustment)
 {
-    if (me == NULL) {
+    if (me == NULL || sampling_ratio <= 0.0 || 1.0 < sampling_ratio) {
         LOGGER_WARN("bad input");
         return false;
     }
+    *me = (struct OlkenWithTTL){0};
 
     if (!Olken__init_full(&me->olken,
                           histogram_num_bins,
@@ -44,6 +54,37 @@ initialize(struct OlkenWithTTL *const me,
         goto cleanup;
     }
     me->dictionary = dictionary;
+    me->sampling = sampling;
+    switch (sampling) {
+    case OLKEN_WITH_TTL_SAMPLING_NONE:
+        me->threshold = UINT64_MAX;
+        me->scale = 1;
+        break;
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_RATE:
+        me->threshold = ratio_uint64(sampling_ratio);
+        me->scale = 1 / sampling_ratio;
+        me->adjustment = adjustment;
+        break;
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE:
+        if (!FixedSizeShardsSampler__init(&me->sampler,
+                                          sampling_ratio,
+                                          max_size,
+                                          false)) {
+            LOGGER_WARN("failed to initialize fixed-size SHARDS sampler");
+            goto cleanup;
+        }
+        if (adjustment) {
+            LOGGER_WARN("fixed-size SHARDS adjustment not supported yet");
+        }
+        if (!KHashTable__init(&me->expired)) {
+            LOGGER_WARN("failed to initialize expired keys");
+            goto cleanup;
+        }
+        break;
+    default:
+        LOGGER_WARN("unrecognized sampling mode %d", sampling);
+        goto cleanup;
+    }
     return true;
 cleanup:
     OlkenWithTTL__destroy(me);
@@ -59,7 +100,11 @@ OlkenWithTTL__init(struct OlkenWithTTL *const me,
                       histogram_num_bins,
                       histogram_bin_size,
                       HistogramOutOfBoundsMode__allow_overflow,
-                      NULL);
+                      NULL,
+                      OLKEN_WITH_TTL_SAMPLING_NONE,
+                      1.0,
+                      0,
+                      false);
 }
 
 bool
@@ -73,7 +118,70 @@ OlkenWithTTL__init_full(struct OlkenWithTTL *const me,
                       histogram_num_bins,
                       histogram_bin_size,
                       out_of_bounds_mode,
-                      dictionary);
+                      dictionary,
+                      OLKEN_WITH_TTL_SAMPLING_NONE,
+                      1.0,
+                      0,
+                      false);
+}
+
+bool
+OlkenWithTTL__init_sampled(
+    struct OlkenWithTTL *const me,
+    size_t const histogram_num_bins,
+    size_t const histogram_bin_size,
+    enum HistogramOutOfBoundsMode const out_of_bounds_mode,
+    struct Dictionary const *const dictionary,
+    enum OlkenWithTTLSampling const sampling,
+    double const sampling_ratio,
+    size_t const max_size,
+    bool const adjustment)
+{
+    return initialize(me,
+                      histogram_num_bins,
+                      histogram_bin_size,
+                      out_of_bounds_mode,
+                      dictionary,
+                      sampling,
+                      sampling_ratio,
+                      max_size,
+                      adjustment);
+}
+
+bool
+OlkenWithTTLSampling__parse(enum OlkenWithTTLSampling *const me,
+                            char const *const str)
+{
+    if (me == NULL || str == NULL) {
+        return false;
+    }
+    if (strcmp(str, "none") == 0) {
+        *me = OLKEN_WITH_TTL_SAMPLING_NONE;
+    } else if (strcmp(str, "fixed-rate") == 0) {
+        *me = OLKEN_WITH_TTL_SAMPLING_FIXED_RATE;
+    } else if (strcmp(str, "fixed-size") == 0) {
+        *me = OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE;
+    } else {
+        LOGGER_ERROR("unrecognized sampling mode '%s'", str);
+        return false;
+    }
+    return true;
+}
+
+static inline uint64_t
+get_threshold(struct OlkenWithTTL const *const me)
+{
+    return me->sampling == OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE
+               ? me->sampler.threshold
+               : me->threshold;
+}
+
+static inline uint64_t
+get_scale(struct OlkenWithTTL const *const me)
+{
+    return me->sampling == OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE
+               ? me->sampler.scale
+               : me->scale;
 }
 
 /// @brief  Evict all data that expires before current timestamp.
@@ -96,7 +204,12 @@ evict_expired_items(struct OlkenWithTTL *const me, TimeStampType current_time)
         //      no debug symbols (i.e. 'NDEBUG').
         assert(r);
         MAYBE_UNUSED(r);
-        Olken__remove_item(&me->olken, rm_entry);
+        // NOTE With fixed-size SHARDS, the sampler may have already
+        //      evicted this key, in which case Olken no longer has it.
+        if (Olken__remove_item(&me->olken, rm_entry) &&
+            me->sampling == OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE) {
+            KHashTable__put(&me->expired, rm_entry, 0);
+        }
     }
 }
 
@@ -107,15 +220,52 @@ update_item(struct OlkenWithTTL *me, EntryType entry, TimeStampType timestamp)
     if (distance == UINT64_MAX) {
         return false;
     }
-    Histogram__insert_finite(&me->olken.histogram, distance);
+    Histogram__insert_scaled_finite(&me->olken.histogram,
+                                    distance,
+                                    get_scale(me));
     return true;
 }
 
+/// @brief  Remove a key that the fixed-size sampler evicted.
+/// @note   The key may have expired already, in which case it is no
+///         longer in Olken. Its entry in the TTL heap remains until it
+///         expires, but that is harmless because the sampler will
+///         never accept this key again.
+static void
+evict_sampled_item(void *eviction_data, EntryType entry)
+{
+    struct OlkenWithTTL *const me = eviction_data;
+    if (!Olken__remove_item(&me->olken, entry)) {
+        KHashTable__remove(&me->expired, entry);
+    }
+}
+
+/// @brief  Insert the key into the fixed-size sampler unless it is
+///         already there (because it expired and was accessed again).
+static bool
+insert_sampled_item(struct OlkenWithTTL *const me, EntryType const entry)
+{
+    if (me->sampling != OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE) {
+        return true;
+    }
+    if (KHashTable__remove(&me->expired, entry).success) {
+        return true;
+    }
+    return FixedSizeShardsSampler__insert(&me->sampler,
+                                          entry,
+                                          evict_sampled_item,
+                                          me);
+}
+
 static bool
 insert_item(struct OlkenWithTTL *const me,
             EntryType const entry,
             TimeStampType const eviction_time_ms)
 {
+    if (!insert_sampled_item(me, entry)) {
+        LOGGER_ERROR("fixed-size SHARDS sampler insertion failed");
+        return false;
+    }
     if (!Heap__insert(&me->pq, eviction_time_ms, entry)) {
         LOGGER_ERROR("TTL heap insertion failed");
         return false;
@@ -124,7 +274,7 @@ insert_item(struct OlkenWithTTL *const me,
         LOGGER_ERROR("Olken insertion failed");
         return false;
     }
-    Histogram__insert_infinite(&me->olken.histogram);
+    Histogram__insert_scaled_infinite(&me->olken.histogram, get_scale(me));
     return true;
 }
 
@@ -140,6 +290,13 @@ OlkenWithTTL__access_item(struct OlkenWithTTL *const me,
         return false;
     }
     evict_expired_items(me, timestamp_ms);
+    ++me->num_entries_seen;
+    if (me->sampling != OLKEN_WITH_TTL_SAMPLING_NONE &&
+        Hash64Bit(entry) > get_threshold(me)) {
+        Olken__ignore_entry(&me->olken);
+        return true;
+    }
+    ++me->num_entries_processed;
     struct LookupReturn r = Olken__lookup(&me->olken, entry);
     if (r.success) {
         bool ok = update_item(me, entry, r.timestamp);
@@ -155,7 +312,22 @@ OlkenWithTTL__access_item(struct OlkenWithTTL *const me,
 bool
 OlkenWithTTL__post_process(struct OlkenWithTTL *me)
 {
-    UNUSED(me);
+    if (me == NULL) {
+        return false;
+    }
+    if (me->sampling != OLKEN_WITH_TTL_SAMPLING_FIXED_RATE ||
+        !me->adjustment) {
+        return true;
+    }
+    // NOTE See 'FixedRateShards__post_process'.
+    double const sampling_ratio = OlkenWithTTL__get_sampling_ratio(me);
+    int64_t const adjustment =
+        me->scale * (me->num_entries_seen * sampling_ratio -
+                     me->num_entries_processed);
+    if (!Histogram__adjust_first_buckets(&me->olken.histogram, adjustment)) {
+        LOGGER_WARN("error in adjusting buckets");
+        return false;
+    }
     return true;
 }
 
@@ -178,11 +350,40 @@ OlkenWithTTL__print_histogram_as_json(struct OlkenWithTTL *me)
     Histogram__print_as_json(&me->olken.histogram);
 }
 
+double
+OlkenWithTTL__get_sampling_ratio(struct OlkenWithTTL const *const me)
+{
+    if (me == NULL) {
+        return 0.0;
+    }
+    switch (me->sampling) {
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_RATE:
+        return (double)me->threshold / (double)UINT64_MAX;
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE:
+        return me->sampler.sampling_ratio;
+    default:
+        return 1.0;
+    }
+}
+
+size_t
+OlkenWithTTL__memory_usage(struct OlkenWithTTL const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return Olken__memory_usage(&me->olken) + Heap__memory_usage(&me->pq) +
+           FixedSizeShardsSampler__memory_usage(&me->sampler) +
+           KHashTable__memory_usage(&me->expired);
+}
+
 void
 OlkenWithTTL__destroy(struct OlkenWithTTL *me)
 {
     Olken__destroy(&me->olken);
     Heap__destroy(&me->pq);
+    FixedSizeShardsSampler__destroy(&me->sampler);
+    KHashTable__destroy(&me->expired);
     *me = (struct OlkenWithTTL){0};
 }
 
@@ -0,0 +1,165 @@
+/** @brief  A thread-safe wrapper to embed an MRC algorithm in a server.
+ *
+ *  The MRC algorithms are single-threaded, so calling them from many
+ *  request threads would require a global lock on the request path.
+ *  Instead, each thread that calls 'OnlineMRC__record' gets its own
+ *  single-producer, single-consumer ring. A background aggregator thread
+ *  drains the rings into the algorithm, so recording an access is only a
+ *  couple of stores into a thread-local buffer.
+ *
+ *  Usage:
+ *      struct OnlineMRCConfig config = {0};
+ *      OnlineMRCConfig__init(&config, ONLINE_MRC_ALGORITHM_FIXED_SIZE_SHARDS);
+ *      config.max_size = 1 << 13;
+ *      struct OnlineMRC me = {0};
+ *      OnlineMRC__init(&me, &config);
+ *      ...
+ *      // From any thread.
+ *      OnlineMRC__record(&me, key, size);
+ *      ...
+ *      struct MissRateCurve mrc = {0};
+ *      OnlineMRC__get_mrc(&me, &mrc);
+ *      ...
+ *      OnlineMRC__destroy(&me);
+ *
+ *  @note   The order in which we process accesses from different threads
+ *          is not the order in which they were recorded. We only preserve
+ *          the order of the accesses within each thread.
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram/histogram.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+
+#define ONLINE_MRC_DEFAULT_RING_CAPACITY (1 << 14)
+#define ONLINE_MRC_DEFAULT_MAX_THREADS   256
+#define ONLINE_MRC_DEFAULT_IDLE_SLEEP_US 100
+
+enum OnlineMRCAlgorithm {
+    ONLINE_MRC_ALGORITHM_INVALID,
+    ONLINE_MRC_ALGORITHM_OLKEN,
+    ONLINE_MRC_ALGORITHM_FIXED_RATE_SHARDS,
+    ONLINE_MRC_ALGORITHM_FIXED_SIZE_SHARDS,
+    ONLINE_MRC_ALGORITHM_EVICTING_MAP,
+};
+
+static char const *const ONLINE_MRC_ALGORITHM_STRINGS[] = {
+    "INVALID",
+    "Olken",
+    "Fixed-Rate-SHARDS",
+    "Fixed-Size-SHARDS",
+    "Evicting-Map",
+};
+
+/// @return ONLINE_MRC_ALGORITHM_INVALID if the string is unrecognized.
+enum OnlineMRCAlgorithm
+OnlineMRCAlgorithm__parse(char const *const str);
+
+struct OnlineMRCConfig {
+    enum OnlineMRCAlgorithm algorithm;
+    // The parameters of the algorithm (as in the trace runner).
+    double sampling_rate;
+    size_t max_size;
+    size_t num_bins;
+    size_t bin_size;
+    enum HistogramOutOfBoundsMode out_of_bounds_mode;
+    // The number of accesses that each thread may buffer. This is
+    // rounded up to a power of two.
+    size_t ring_capacity;
+    // The maximum number of threads that may record at once. A thread
+    // returns its ring when it exits.
+    size_t max_threads;
+    // If the ring is full, drop the access rather than wait for the
+    // aggregator. Dropping keeps the latency of the request path
+    // bounded at the cost of a less accurate MRC.
+    bool drop_when_full;
+    // How long the aggregator sleeps when all rings are empty.
+    uint64_t idle_sleep_us;
+};
+
+/// @brief  Set the defaults for the algorithm.
+bool
+OnlineMRCConfig__init(struct OnlineMRCConfig *const me,
+                      enum OnlineMRCAlgorithm const algorithm);
+
+/// @brief  A single-producer, single-consumer ring of accesses.
+/// @note   We keep the producer's and the consumer's indices on separate
+///         cache lines, since they are written by different threads.
+struct OnlineMRCRing;
+
+struct OnlineMRCStatistics {
+    uint64_t num_recorded;
+    uint64_t num_dropped;
+    uint64_t num_processed;
+    uint64_t num_bytes_processed;
+    size_t num_threads;
+};
+
+struct OnlineMRC {
+    struct OnlineMRCConfig config;
+    // A unique ID so that threads can tell whether their cached ring
+    // belongs to this instance (and not to a destroyed one at the same
+    // address).
+    uint64_t id;
+    pthread_key_t thread_key;
+
+    // The algorithm's instance and the functions to operate upon it.
+    // It is protected by 'lock', since the aggregator and
+    // 'OnlineMRC__get_mrc' both consume the rings.
+    void *instance;
+    bool (*access_func)(void *const, uint64_t const);
+    bool (*hist_func)(void *const, struct Histogram const **const);
+    void (*destroy_func)(void *const);
+    pthread_mutex_t lock;
+    uint64_t num_processed;
+    uint64_t num_bytes_processed;
+
+    // The rings are allocated upon registration and only freed when we
+    // destroy this instance. 'num_rings' only grows.
+    struct OnlineMRCRing **rings;
+    size_t num_rings;
+    pthread_mutex_t rings_lock;
+
+    pthread_t aggregator;
+    bool shutdown;
+};
+
+bool
+OnlineMRC__init(struct OnlineMRC *const me,
+                struct OnlineMRCConfig const *const config);
+
+/// @brief  Record an access from any thread.
+/// @param  size: the object's size [B]. The current algorithms count
+///               objects, so we only use this in the statistics.
+/// @return false if we dropped the access.
+bool
+OnlineMRC__record(struct OnlineMRC *const me,
+                  uint64_t const key,
+                  uint64_t const size);
+
+/// @brief  Drain the rings and snapshot the MRC.
+/// @note   The MRC includes every access that was recorded before this
+///         call by the calling thread (or by threads that synchronized
+///         with it).
+bool
+OnlineMRC__get_mrc(struct OnlineMRC *const me, struct MissRateCurve *const mrc);
+
+void
+OnlineMRC__get_statistics(struct OnlineMRC *const me,
+                          struct OnlineMRCStatistics *const stats);
+
+/// @note   No thread may call 'OnlineMRC__record' during or after this.
+void
+OnlineMRC__destroy(struct OnlineMRC *const me);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
@@ -0,0 +1,465 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "evicting_map/evicting_map.h"
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "olken/olken.h"
+#include "online_mrc/online_mrc.h"
+#include "shards/fixed_rate_shards.h"
+#include "shards/fixed_size_shards.h"
+
+#define CACHE_LINE_SIZE 64
+
+struct OnlineMRCAccess {
+    uint64_t key;
+    uint64_t size;
+};
+
+struct OnlineMRCRing {
+    // Written by the producer.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;
+    // NOTE The producer's stale copy of the tail lets it skip reading
+    //      the consumer's cache line until the ring looks full.
+    uint64_t cached_tail;
+    _Atomic uint64_t num_dropped;
+    // Written by the consumer.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;
+    // Written upon registration and when the thread exits.
+    _Alignas(CACHE_LINE_SIZE) _Atomic bool in_use;
+    uint64_t mask;
+    struct OnlineMRCAccess *accesses;
+};
+
+/// @brief  The ring that the calling thread last recorded into.
+/// @note   This caches 'pthread_getspecific' for the common case of a
+///         single instance.
+struct OnlineMRCLocal {
+    uint64_t id;
+    struct OnlineMRCRing *ring;
+};
+
+static _Atomic uint64_t next_id = 1;
+static _Thread_local struct OnlineMRCLocal local = {0};
+
+enum OnlineMRCAlgorithm
+OnlineMRCAlgorithm__parse(char const *const str)
+{
+    if (str == NULL) {
+        return ONLINE_MRC_ALGORITHM_INVALID;
+    }
+    for (size_t i = 1; i < sizeof(ONLINE_MRC_ALGORITHM_STRINGS) /
+                               sizeof(*ONLINE_MRC_ALGORITHM_STRINGS);
+         ++i) {
+        if (strcmp(str, ONLINE_MRC_ALGORITHM_STRINGS[i]) == 0) {
+            return (enum OnlineMRCAlgorithm)i;
+        }
+    }
+    return ONLINE_MRC_ALGORITHM_INVALID;
+}
+
+bool
+OnlineMRCConfig__init(struct OnlineMRCConfig *const me,
+                      enum OnlineMRCAlgorithm const algorithm)
+{
+    if (me == NULL || algorithm == ONLINE_MRC_ALGORITHM_INVALID) {
+        return false;
+    }
+    // NOTE These match the trace runner's defaults, except that
+    //      Fixed-Rate SHARDS would not be worth running at 100%.
+    *me = (struct OnlineMRCConfig){
+        .algorithm = algorithm,
+        .sampling_rate = algorithm == ONLINE_MRC_ALGORITHM_FIXED_RATE_SHARDS
+                             ? 1e-3
+                             : 1.0,
+        .max_size = 1 << 13,
+        .num_bins = 1 << 20,
+        .bin_size = 1,
+        .out_of_bounds_mode = HistogramOutOfBoundsMode__realloc,
+        .ring_capacity = ONLINE_MRC_DEFAULT_RING_CAPACITY,
+        .max_threads = ONLINE_MRC_DEFAULT_MAX_THREADS,
+        .drop_when_full = false,
+        .idle_sleep_us = ONLINE_MRC_DEFAULT_IDLE_SLEEP_US,
+    };
+    return true;
+}
+
+static uint64_t
+round_up_to_power_of_two(uint64_t const x)
+{
+    uint64_t y = 1;
+    while (y < x) {
+        y <<= 1;
+    }
+    return y;
+}
+
+static struct OnlineMRCRing *
+OnlineMRCRing__new(size_t const capacity)
+{
+    struct OnlineMRCRing *me = aligned_alloc(CACHE_LINE_SIZE, sizeof(*me));
+    if (me == NULL) {
+        return NULL;
+    }
+    *me = (struct OnlineMRCRing){.mask = capacity - 1};
+    me->accesses = calloc(capacity, sizeof(*me->accesses));
+    if (me->accesses == NULL) {
+        free(me);
+        return NULL;
+    }
+    return me;
+}
+
+static void
+OnlineMRCRing__free(struct OnlineMRCRing *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    free(me->accesses);
+    free(me);
+}
+
+/// @brief  Feed the ring's accesses into the algorithm.
+/// @note   The caller must hold the instance's lock, which makes it the
+///         only consumer.
+static size_t
+drain_ring(struct OnlineMRC *const me, struct OnlineMRCRing *const ring)
+{
+    uint64_t const tail =
+        atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t const head =
+        atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (uint64_t i = tail; i < head; ++i) {
+        struct OnlineMRCAccess const a = ring->accesses[i & ring->mask];
+        me->access_func(me->instance, a.key);
+        me->num_bytes_processed += a.size;
+    }
+    // NOTE The release lets the producer overwrite these slots only
+    //      after we have read them.
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+    me->num_processed += head - tail;
+    return head - tail;
+}
+
+/// @note   The caller must hold the instance's lock.
+static size_t
+drain_all(struct OnlineMRC *const me)
+{
+    size_t num_processed = 0;
+    pthread_mutex_lock(&me->rings_lock);
+    size_t const num_rings = me->num_rings;
+    pthread_mutex_unlock(&me->rings_lock);
+    for (size_t i = 0; i < num_rings; ++i) {
+        num_processed += drain_ring(me, me->rings[i]);
+    }
+    return num_processed;
+}
+
+static void *
+aggregate(void *arg)
+{
+    struct OnlineMRC *const me = arg;
+    struct timespec const idle = {
+        .tv_sec = me->config.idle_sleep_us / 1000000,
+        .tv_nsec = me->config.idle_sleep_us % 1000000 * 1000,
+    };
+    while (true) {
+        pthread_mutex_lock(&me->lock);
+        if (me->shutdown) {
+            pthread_mutex_unlock(&me->lock);
+            break;
+        }
+        size_t const num_processed = drain_all(me);
+        pthread_mutex_unlock(&me->lock);
+        if (num_processed == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+/// @brief  Return the ring of a thread that exited.
+static void
+release_ring(void *arg)
+{
+    struct OnlineMRCRing *const ring = arg;
+    // NOTE Any accesses left in the ring will still be drained; the
+    //      next thread to take the ring appends after them.
+    atomic_store_explicit(&ring->in_use, false, memory_order_release);
+}
+
+static bool
+init_instance(struct OnlineMRC *const me)
+{
+    struct OnlineMRCConfig const *const c = &me->config;
+    bool ok = false;
+    switch (c->algorithm) {
+    case ONLINE_MRC_ALGORITHM_OLKEN:
+        me->instance = calloc(1, sizeof(struct Olken));
+        ok = me->instance != NULL &&
+             Olken__init_full(me->instance,
+                              c->num_bins,
+                              c->bin_size,
+                              c->out_of_bounds_mode);
+        me->access_func = (bool (*)(void *const, uint64_t const))
+            Olken__access_item;
+        me->hist_func = (bool (*)(void *const,
+                                  struct Histogram const **const))
+            Olken__get_histogram;
+        me->destroy_func = (void (*)(void *const))Olken__destroy;
+        break;
+    case ONLINE_MRC_ALGORITHM_FIXED_RATE_SHARDS:
+        // NOTE The SHARDS adjustment modifies the histogram in the
+        //      post-processing, so we cannot apply it to a live MRC.
+        me->instance = calloc(1, sizeof(struct FixedRateShards));
+        ok = me->instance != NULL &&
+             FixedRateShards__init_full(me->instance,
+                                        c->sampling_rate,
+                                        c->num_bins,
+                                        c->bin_size,
+                                        c->out_of_bounds_mode,
+                                        false);
+        me->access_func = (bool (*)(void *const, uint64_t const))
+            FixedRateShards__access_item;
+        me->hist_func = (bool (*)(void *const,
+                                  struct Histogram const **const))
+            FixedRateShards__get_histogram;
+        me->destroy_func = (void (*)(void *const))FixedRateShards__destroy;
+        break;
+    case ONLINE_MRC_ALGORITHM_FIXED_SIZE_SHARDS:
+        me->instance = calloc(1, sizeof(struct FixedSizeShards));
+        ok = me->instance != NULL &&
+             FixedSizeShards__init_full(me->instance,
+                                        c->sampling_rate,
+                                        c->max_size,
+                                        c->num_bins,
+                                        c->bin_size,
+                                        c->out_of_bounds_mode,
+                                        NULL);
+        me->access_func = (bool (*)(void *const, uint64_t const))
+            FixedSizeShards__access_item;
+        me->hist_func = (bool (*)(void *const,
+                                  struct Histogram const **const))
+            FixedSizeShards__get_histogram;
+        me->destroy_func = (void (*)(void *const))FixedSizeShards__destroy;
+        break;
+    case ONLINE_MRC_ALGORITHM_EVICTING_MAP:
+        me->instance = calloc(1, sizeof(struct EvictingMap));
+        ok = me->instance != NULL &&
+             EvictingMap__init_full(me->instance,
+                                    c->sampling_rate,
+                                    c->max_size,
+                                    c->num_bins,
+                                    c->bin_size,
+                                    c->out_of_bounds_mode,
+                                    NULL);
+        me->access_func = (bool (*)(void *const, uint64_t const))
+            EvictingMap__access_item;
+        me->hist_func = (bool (*)(void *const,
+                                  struct Histogram const **const))
+            EvictingMap__get_histogram;
+        me->destroy_func = (void (*)(void *const))EvictingMap__destroy;
+        break;
+    default:
+        LOGGER_ERROR("unsupported algorithm %d", c->algorithm);
+        return false;
+    }
+    if (!ok) {
+        LOGGER_ERROR("failed to initialize %s",
+                     ONLINE_MRC_ALGORITHM_STRINGS[c->algorithm]);
+        free(me->instance);
+        me->instance = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool
+OnlineMRC__init(struct OnlineMRC *const me,
+                struct OnlineMRCConfig const *const config)
+{
+    if (me == NULL || config == NULL || config->ring_capacity == 0 ||
+        config->max_threads == 0) {
+        LOGGER_ERROR("invalid input");
+        return false;
+    }
+    *me = (struct OnlineMRC){
+        .config = *config,
+        .id = atomic_fetch_add(&next_id, 1),
+    };
+    me->config.ring_capacity = round_up_to_power_of_two(config->ring_capacity);
+    if (!init_instance(me)) {
+        return false;
+    }
+    me->rings = calloc(me->config.max_threads, sizeof(*me->rings));
+    if (me->rings == NULL) {
+        LOGGER_ERROR("failed to allocate the rings");
+        goto destroy_instance;
+    }
+    if (pthread_key_create(&me->thread_key, release_ring) != 0) {
+        LOGGER_ERROR("failed to create the thread key");
+        goto free_rings;
+    }
+    pthread_mutex_init(&me->lock, NULL);
+    pthread_mutex_init(&me->rings_lock, NULL);
+    if (pthread_create(&me->aggregator, NULL, aggregate, me) != 0) {
+        LOGGER_ERROR("failed to start the aggregator");
+        goto delete_key;
+    }
+    return true;
+delete_key:
+    pthread_mutex_destroy(&me->lock);
+    pthread_mutex_destroy(&me->rings_lock);
+    pthread_key_delete(me->thread_key);
+free_rings:
+    free(me->rings);
+destroy_instance:
+    me->destroy_func(me->instance);
+    free(me->instance);
+    *me = (struct OnlineMRC){0};
+    return false;
+}
+
+/// @brief  Find or register the calling thread's ring.
+static struct OnlineMRCRing *
+get_ring_slow(struct OnlineMRC *const me)
+{
+    struct OnlineMRCRing *ring = pthread_getspecific(me->thread_key);
+    if (ring != NULL) {
+        local = (struct OnlineMRCLocal){.id = me->id, .ring = ring};
+        return ring;
+    }
+    pthread_mutex_lock(&me->rings_lock);
+    for (size_t i = 0; i < me->num_rings; ++i) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&me->rings[i]->in_use,
+                                           &expected,
+                                           true)) {
+            ring = me->rings[i];
+            break;
+        }
+    }
+    if (ring == NULL && me->num_rings < me->config.max_threads) {
+        ring = OnlineMRCRing__new(me->config.ring_capacity);
+        if (ring != NULL) {
+            atomic_store(&ring->in_use, true);
+            me->rings[me->num_rings++] = ring;
+        }
+    }
+    pthread_mutex_unlock(&me->rings_lock);
+    if (ring == NULL) {
+        LOGGER_WARN("no ring for this thread (max threads: %zu)",
+                    me->config.max_threads);
+        return NULL;
+    }
+    pthread_setspecific(me->thread_key, ring);
+    local = (struct OnlineMRCLocal){.id = me->id, .ring = ring};
+    return ring;
+}
+
+bool
+OnlineMRC__record(struct OnlineMRC *const me,
+                  uint64_t const key,
+                  uint64_t const size)
+{
+    struct OnlineMRCRing *ring = local.ring;
+    if (local.id != me->id) {
+        ring = get_ring_slow(me);
+        if (ring == NULL) {
+            return false;
+        }
+    }
+    uint64_t const head =
+        atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - ring->cached_tail > ring->mask) {
+        while (true) {
+            ring->cached_tail =
+                atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (head - ring->cached_tail <= ring->mask) {
+                break;
+            }
+            if (me->config.drop_when_full) {
+                atomic_fetch_add_explicit(&ring->num_dropped,
+                                          1,
+                                          memory_order_relaxed);
+                return false;
+            }
+            sched_yield();
+        }
+    }
+    ring->accesses[head & ring->mask] =
+        (struct OnlineMRCAccess){.key = key, .size = size};
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool
+OnlineMRC__get_mrc(struct OnlineMRC *const me, struct MissRateCurve *const mrc)
+{
+    struct Histogram const *hist = NULL;
+    if (me == NULL || me->instance == NULL || mrc == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&me->lock);
+    drain_all(me);
+    bool const ok = me->hist_func(me->instance, &hist) &&
+                    MissRateCurve__init_from_histogram(mrc, hist);
+    pthread_mutex_unlock(&me->lock);
+    return ok;
+}
+
+void
+OnlineMRC__get_statistics(struct OnlineMRC *const me,
+                          struct OnlineMRCStatistics *const stats)
+{
+    if (me == NULL || stats == NULL) {
+        return;
+    }
+    *stats = (struct OnlineMRCStatistics){0};
+    pthread_mutex_lock(&me->lock);
+    stats->num_processed = me->num_processed;
+    stats->num_bytes_processed = me->num_bytes_processed;
+    pthread_mutex_unlock(&me->lock);
+    pthread_mutex_lock(&me->rings_lock);
+    stats->num_threads = me->num_rings;
+    for (size_t i = 0; i < me->num_rings; ++i) {
+        stats->num_recorded += atomic_load_explicit(&me->rings[i]->head,
+                                                    memory_order_relaxed);
+        stats->num_dropped += atomic_load_explicit(&me->rings[i]->num_dropped,
+                                                   memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&me->rings_lock);
+}
+
+void
+OnlineMRC__destroy(struct OnlineMRC *const me)
+{
+    if (me == NULL || me->instance == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&me->lock);
+    me->shutdown = true;
+    pthread_mutex_unlock(&me->lock);
+    pthread_join(me->aggregator, NULL);
+    // NOTE Deleting the key means that the threads that are still alive
+    //      will not call 'release_ring' on the rings that we free.
+    pthread_key_delete(me->thread_key);
+    for (size_t i = 0; i < me->num_rings; ++i) {
+        OnlineMRCRing__free(me->rings[i]);
+    }
+    free(me->rings);
+    me->destroy_func(me->instance);
+    free(me->instance);
+    pthread_mutex_destroy(&me->lock);
+    pthread_mutex_destroy(&me->rings_lock);
+    *me = (struct OnlineMRC){0};
+}
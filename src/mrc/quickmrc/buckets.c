@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "checkpoint/checkpoint.h"
 #include "types/time_stamp_type.h"
 
 #include "quickmrc/buckets.h"
@@ -172,6 +173,44 @@ QuickMRCBuckets__decrement_old(struct QuickMRCBuckets *me,
     return stack_dist;
 }
 
+bool
+QuickMRCBuckets__save_checkpoint(struct QuickMRCBuckets const *const me,
+                                 struct CheckpointWriter *const writer)
+{
+    if (me == NULL || me->buckets == NULL || writer == NULL)
+        return false;
+    return CheckpointWriter__write_u64(writer, me->max_bucket_size) &&
+           CheckpointWriter__write_u64(writer, me->num_unique_entries) &&
+           CheckpointWriter__write_u64(writer, me->timestamp) &&
+           CheckpointWriter__write_array(writer,
+                                         me->buckets,
+                                         me->num_buckets,
+                                         sizeof(*me->buckets));
+}
+
+bool
+QuickMRCBuckets__load_checkpoint(struct QuickMRCBuckets *const me,
+                                 struct CheckpointReader *const reader)
+{
+    uint64_t max_bucket_size = 0, num_unique_entries = 0, timestamp = 0;
+    size_t num_buckets = 0;
+    if (me == NULL || me->buckets == NULL || reader == NULL)
+        return false;
+    if (!CheckpointReader__read_u64(reader, &max_bucket_size) ||
+        !CheckpointReader__read_u64(reader, &num_unique_entries) ||
+        !CheckpointReader__read_u64(reader, &timestamp))
+        return false;
+    struct TimestampRangeCount const *const buckets =
+        CheckpointReader__read_array(reader, &num_buckets, sizeof(*buckets));
+    if (buckets == NULL || num_buckets != me->num_buckets)
+        return false;
+    memcpy(me->buckets, buckets, num_buckets * sizeof(*buckets));
+    me->max_bucket_size = max_bucket_size;
+    me->num_unique_entries = num_unique_entries;
+    me->timestamp = timestamp;
+    return true;
+}
+
 void
 QuickMRCBuckets__print(struct QuickMRCBuckets *me)
 {
@@ -5,6 +5,9 @@
 
 #include "types/time_stamp_type.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 /// This structure is meant to count the number of entries whose timestamp falls
 /// within a given range [min_timestamp, max_timestamp]. The min_timestamp is
 /// implicitly provided by the next oldest bucket and is never required by our
@@ -49,6 +52,17 @@ bool
 QuickMRCBuckets__decrement_old(struct QuickMRCBuckets *me,
                                TimeStampType old_timestamp);
 
+/// Append the buckets to a checkpoint.
+bool
+QuickMRCBuckets__save_checkpoint(struct QuickMRCBuckets const *const me,
+                                 struct CheckpointWriter *const writer);
+
+/// Replace the buckets with the next ones in a checkpoint. The number of
+/// buckets must match.
+bool
+QuickMRCBuckets__load_checkpoint(struct QuickMRCBuckets *const me,
+                                 struct CheckpointReader *const reader);
+
 void
 QuickMRCBuckets__print(struct QuickMRCBuckets *me);
 
@@ -13,6 +13,9 @@
 #include "quickmrc/buckets.h"
 #include "types/entry_type.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct QuickMRC {
     struct HashTable hash_table;
     struct QuickMRCBuckets buckets;
@@ -53,5 +56,16 @@ QuickMRC__to_mrc(struct QuickMRC const *const me,
 void
 QuickMRC__print_histogram_as_json(struct QuickMRC *me);
 
+/// @brief  Append the full state to a checkpoint.
+bool
+QuickMRC__save_checkpoint(struct QuickMRC const *const me,
+                          struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+QuickMRC__load_checkpoint(struct QuickMRC *const me,
+                          struct CheckpointReader *const reader);
+
 void
 QuickMRC__destroy(struct QuickMRC *me);
@@ -7,6 +7,7 @@
 #include <glib.h>
 #include <pthread.h>
 
+#include "checkpoint/checkpoint.h"
 #include "hash/hash.h"
 #include "histogram/histogram.h"
 #include "logger/logger.h"
@@ -140,6 +141,34 @@ QuickMRC__print_histogram_as_json(struct QuickMRC *me)
     Histogram__print_as_json(&me->histogram);
 }
 
+bool
+QuickMRC__save_checkpoint(struct QuickMRC const *const me,
+                          struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->total_entries_seen) &&
+           CheckpointWriter__write_u64(writer, me->total_entries_processed) &&
+           HashTable__save_checkpoint(&me->hash_table, writer) &&
+           QuickMRCBuckets__save_checkpoint(&me->buckets, writer) &&
+           Histogram__save_checkpoint(&me->histogram, writer);
+}
+
+bool
+QuickMRC__load_checkpoint(struct QuickMRC *const me,
+                          struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    return CheckpointReader__read_u64(reader, &me->total_entries_seen) &&
+           CheckpointReader__read_u64(reader, &me->total_entries_processed) &&
+           HashTable__load_checkpoint(&me->hash_table, reader) &&
+           QuickMRCBuckets__load_checkpoint(&me->buckets, reader) &&
+           Histogram__load_checkpoint(&me->histogram, reader);
+}
+
 void
 QuickMRC__destroy(struct QuickMRC *me)
 {
@@ -1,9 +1,12 @@
 #include <assert.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "checkpoint/checkpoint.h"
 #include "hash/hash.h"
 #include "hash/types.h"
 #include "histogram/histogram.h"
@@ -12,14 +15,21 @@
 #endif
 #include "logger/logger.h"
 #include "lookup/hash_table.h"
+#include "lookup/k_hash_table.h"
 #include "lookup/lookup.h"
 #include "math/ratio.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
+#include "profiler/profiler.h"
+#include "sampler/sampling_controller.h"
 #include "shards/fixed_rate_shards.h"
 #include "tree/basic_tree.h"
 #include "tree/sleator_tree.h"
 #include "types/entry_type.h"
+#include "unused/mark_unused.h"
+
+/// The number of hashes that we compute ahead in a batch.
+#define FIXED_RATE_SHARDS_BATCH_SIZE 64
 
 static bool
 initialize(struct FixedRateShards *me,
@@ -57,6 +67,15 @@ initialize(struct FixedRateShards *me,
         .adjustment = adjustment,
         .num_entries_seen = 0,
         .num_entries_processed = 0,
+        .adjustment_carry = 0.0,
+        .period_entries_seen = 0,
+        .period_entries_processed = 0,
+
+        .tracking_ratio = sampling_ratio,
+        .tracking_threshold = ratio_uint64(sampling_ratio),
+        .warming_tree = {.root = NULL, .cardinality = 0},
+        .num_warming_left = 0,
+        .controller = NULL,
     };
     return true;
 cleanup:
@@ -100,30 +119,216 @@ FixedRateShards__init_full(
 }
 
 bool
-FixedRateShards__access_item(struct FixedRateShards *me, EntryType entry)
+FixedRateShards__enable_controller(
+    struct FixedRateShards *const me,
+    struct SamplingControllerConfig const *const config)
 {
-    bool r = false;
+    if (me == NULL || config == NULL || me->controller != NULL) {
+        LOGGER_ERROR("bad input");
+        return false;
+    }
+    me->controller = calloc(1, sizeof(*me->controller));
+    if (me->controller == NULL ||
+        !SamplingController__init(me->controller,
+                                  config,
+                                  me->sampling_ratio)) {
+        LOGGER_ERROR("failed to initialize the sampling controller");
+        free(me->controller);
+        me->controller = NULL;
+        return false;
+    }
+    // NOTE The controller may have clamped the ratio to its bounds.
+    return FixedRateShards__set_sampling_ratio(me, me->controller->rate);
+}
 
-    if (me == NULL) {
+/// @brief  Close the SHARDS adjustment of the current sampling ratio.
+static void
+close_adjustment_period(struct FixedRateShards *const me)
+{
+    me->adjustment_carry +=
+        me->scale *
+        ((me->num_entries_seen - me->period_entries_seen) * me->sampling_ratio -
+         (me->num_entries_processed - me->period_entries_processed));
+    me->period_entries_seen = me->num_entries_seen;
+    me->period_entries_processed = me->num_entries_processed;
+}
+
+static void
+switch_sampling_ratio(struct FixedRateShards *const me,
+                      double const sampling_ratio,
+                      uint64_t const threshold)
+{
+    close_adjustment_period(me);
+    me->sampling_ratio = sampling_ratio;
+    me->threshold = threshold;
+    me->scale = 1 / sampling_ratio;
+}
+
+/// @brief  Merge the warm band into the sampled keys.
+static void
+finish_warming(struct FixedRateShards *const me)
+{
+    while (me->warming_tree.root != NULL) {
+        KeyType const timestamp = me->warming_tree.root->key;
+        bool r = tree__sleator_remove(&me->warming_tree, timestamp);
+        assert(r && "remove should not fail");
+        r = tree__sleator_insert(&me->olken.tree, timestamp);
+        assert(r && "insert should not fail");
+        MAYBE_UNUSED(r);
+    }
+    me->num_warming_left = 0;
+    switch_sampling_ratio(me, me->tracking_ratio, me->tracking_threshold);
+}
+
+/// @brief  Decide how many more keys of the band to admit before we
+///         trust the distances at the tracking ratio.
+static void
+update_warming(struct FixedRateShards *const me)
+{
+    if (me->tracking_threshold == me->threshold) {
+        me->num_warming_left = 0;
+        return;
+    }
+    // NOTE The hashes are uniform, so we expect the band to hold keys in
+    //      proportion to its width. We stop a standard deviation early,
+    //      or else a band with fewer keys than expected would never warm.
+    double const expected = (double)me->olken.tree.cardinality *
+                            (double)(me->tracking_threshold - me->threshold) /
+                            (double)me->threshold;
+    double const target = expected - sqrt(expected);
+    if (target <= (double)me->warming_tree.cardinality) {
+        finish_warming(me);
+        return;
+    }
+    // NOTE We round up, or else a fractional target just above the
+    //      cardinality would leave no keys to warm and never finish.
+    me->num_warming_left =
+        (uint64_t)ceil(target) - (uint64_t)me->warming_tree.cardinality;
+}
+
+struct EvictionData {
+    struct FixedRateShards *me;
+    uint64_t threshold;
+};
+
+static bool
+evict_if_above_threshold(void *data, EntryType key, TimeStampType timestamp)
+{
+    struct EvictionData *const d = data;
+    Hash64BitType const hash = Hash64Bit(key);
+    if (hash <= d->threshold) {
         return false;
     }
+    struct Tree *const tree = hash > d->me->threshold ? &d->me->warming_tree
+                                                       : &d->me->olken.tree;
+    bool const r = tree__sleator_remove(tree, timestamp);
+    assert(r && "remove should not fail");
+    MAYBE_UNUSED(r);
+    return true;
+}
 
-    ++me->num_entries_seen;
-    Hash64BitType hash = Hash64Bit(entry);
-    // NOTE Taking the modulo of the hash by 1 << 24 reduces the accuracy
-    //      significantly. I tried dividing the threshold by 1 << 24 and also
-    //      leaving the threshold alone. Neither worked to improve accuracy.
-    if (hash > me->threshold) {
+static void
+evict_above_threshold(struct FixedRateShards *const me,
+                      uint64_t const threshold)
+{
+    struct EvictionData data = {.me = me, .threshold = threshold};
+    size_t const num_evicted = KHashTable__remove_if(&me->olken.hash_table,
+                                                     evict_if_above_threshold,
+                                                     &data);
+    LOGGER_TRACE("evicted %zu keys", num_evicted);
+}
+
+bool
+FixedRateShards__set_sampling_ratio(struct FixedRateShards *const me,
+                                    double const sampling_ratio)
+{
+    if (me == NULL || sampling_ratio <= 0.0 || 1.0 < sampling_ratio) {
+        return false;
+    }
+    uint64_t const new_threshold = ratio_uint64(sampling_ratio);
+    if (new_threshold < me->tracking_threshold) {
+        evict_above_threshold(me, new_threshold);
+    }
+    me->tracking_ratio = sampling_ratio;
+    me->tracking_threshold = new_threshold;
+    if (new_threshold <= me->threshold) {
+        // NOTE We have evicted the warm band along with everything else
+        //      above the new threshold.
+        me->num_warming_left = 0;
+        switch_sampling_ratio(me, sampling_ratio, new_threshold);
+        return true;
+    }
+    update_warming(me);
+    return true;
+}
+
+/// @brief  Track an access to the warm band without recording a distance.
+/// @note   We count the distances of the sampled keys as before, so the
+///         keys of the band must not be in their tree.
+static void
+access_warming_key(struct FixedRateShards *const me, EntryType const entry)
+{
+    bool r = false;
+    uint64_t const start = Profiler__start();
+    struct LookupReturn found = Olken__lookup(&me->olken, entry);
+    if (found.success) {
+        r = tree__sleator_remove(&me->warming_tree, (KeyType)found.timestamp);
+        assert(r && "remove should not fail");
+    }
+    r = tree__sleator_insert(&me->warming_tree,
+                             (KeyType)me->olken.current_time_stamp);
+    assert(r && "insert should not fail");
+    MAYBE_UNUSED(r);
+    Olken__put(&me->olken, entry, me->olken.current_time_stamp);
+    Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
+    ++me->olken.current_time_stamp;
+    // NOTE We check before decrementing so that we never wrap around.
+    if (!found.success) {
+        if (me->num_warming_left <= 1) {
+            finish_warming(me);
+        } else {
+            --me->num_warming_left;
+        }
+    }
+}
+
+static inline void
+access_unsampled(struct FixedRateShards *const me)
+{
 #ifdef INTERVAL_STATISTICS
-        IntervalStatistics__append_unsampled(&me->istats);
+    IntervalStatistics__append_unsampled(&me->istats);
 #endif
-        ++me->olken.current_time_stamp;
-        return true;
+    ++me->olken.current_time_stamp;
+}
+
+static inline void
+tick_controller(struct FixedRateShards *const me)
+{
+    if (me->controller != NULL && SamplingController__tick(me->controller)) {
+        FixedRateShards__set_sampling_ratio(me, me->controller->rate);
+    }
+}
+
+/// @brief  Process an access whose hash is below the tracking threshold.
+static inline void
+access_sampled(struct FixedRateShards *const me,
+               EntryType const entry,
+               Hash64BitType const hash)
+{
+    bool r = false;
+    uint64_t start = 0;
+
+    if (hash > me->threshold) {
+        access_warming_key(me, entry);
+        return;
     }
     ++me->num_entries_processed;
 
+    start = Profiler__start();
     struct LookupReturn found = Olken__lookup(&me->olken, entry);
+    Profiler__stop(PROFILER_SCOPE_HASH_LOOKUP, start);
     if (found.success) {
+        start = Profiler__start();
         uint64_t distance =
             tree__reverse_rank(&me->olken.tree, (KeyType)found.timestamp);
         r = tree__sleator_remove(&me->olken.tree, (KeyType)found.timestamp);
@@ -135,6 +340,7 @@ FixedRateShards__access_item(struct FixedRateShards *me, EntryType entry)
             Olken__put(&me->olken, entry, me->olken.current_time_stamp);
         assert(s == LOOKUP_PUTUNIQUE_REPLACE_VALUE &&
                "update should replace value");
+        Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
 #ifdef INTERVAL_STATISTICS
         IntervalStatistics__append_scaled(&me->istats,
                                           distance,
@@ -143,24 +349,89 @@ FixedRateShards__access_item(struct FixedRateShards *me, EntryType entry)
                                               found.timestamp - 1);
 #endif
         ++me->olken.current_time_stamp;
+        start = Profiler__start();
         // TODO(dchu): Maybe record the infinite distances for Parda!
         Histogram__insert_scaled_finite(&me->olken.histogram,
                                         distance,
                                         me->scale);
+        Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
     } else {
+        start = Profiler__start();
         enum PutUniqueStatus s =
             Olken__put(&me->olken, entry, me->olken.current_time_stamp);
         assert(s == LOOKUP_PUTUNIQUE_INSERT_KEY_VALUE &&
                "update should insert key/value");
         tree__sleator_insert(&me->olken.tree,
                              (KeyType)me->olken.current_time_stamp);
+        Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
+        ++me->olken.current_time_stamp;
 #ifdef INTERVAL_STATISTICS
         IntervalStatistics__append_infinity(&me->istats);
 #endif
-        ++me->olken.current_time_stamp;
+        start = Profiler__start();
         Histogram__insert_scaled_infinite(&me->olken.histogram, me->scale);
+        Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
+    }
+}
+
+bool
+FixedRateShards__access_item(struct FixedRateShards *me, EntryType entry)
+{
+    if (me == NULL) {
+        return false;
+    }
+
+    tick_controller(me);
+    ++me->num_entries_seen;
+    uint64_t start = Profiler__start();
+    Hash64BitType hash = Hash64Bit(entry);
+    // NOTE Taking the modulo of the hash by 1 << 24 reduces the accuracy
+    //      significantly. I tried dividing the threshold by 1 << 24 and also
+    //      leaving the threshold alone. Neither worked to improve accuracy.
+    bool const sampled = hash <= me->tracking_threshold;
+    Profiler__stop(PROFILER_SCOPE_SAMPLER, start);
+    if (!sampled) {
+        access_unsampled(me);
+        return true;
     }
+    access_sampled(me, entry, hash);
+    return true;
+}
 
+bool
+FixedRateShards__access_batch(struct FixedRateShards *const me,
+                              EntryType const *const entries,
+                              size_t const num_entries)
+{
+    Hash64BitType hashes[FIXED_RATE_SHARDS_BATCH_SIZE];
+
+    if (me == NULL || (entries == NULL && num_entries != 0)) {
+        return false;
+    }
+    for (size_t begin = 0; begin < num_entries;
+         begin += FIXED_RATE_SHARDS_BATCH_SIZE) {
+        size_t const n = num_entries - begin < FIXED_RATE_SHARDS_BATCH_SIZE
+                             ? num_entries - begin
+                             : FIXED_RATE_SHARDS_BATCH_SIZE;
+        // NOTE The hashes do not depend on each other, so the CPU can
+        //      overlap them rather than branch on each one in turn. We
+        //      also prefetch the buckets of the keys that we will sample.
+        for (size_t i = 0; i < n; ++i) {
+            hashes[i] = Hash64Bit(entries[begin + i]);
+            if (hashes[i] <= me->tracking_threshold) {
+                KHashTable__prefetch(&me->olken.hash_table, entries[begin + i]);
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            tick_controller(me);
+            ++me->num_entries_seen;
+            if (hashes[i] > me->tracking_threshold) {
+                access_unsampled(me);
+                continue;
+            }
+            access_sampled(me, entries[begin + i], hashes[i]);
+        }
+    }
     return true;
 }
 
@@ -171,6 +442,14 @@ FixedRateShards__post_process(struct FixedRateShards *me)
         me->olken.histogram.num_bins < 1)
         return false;
 
+    if (me->controller != NULL) {
+        LOGGER_INFO("changed the sampling rate %u times; final rate: %g "
+                    "(tracking %g)",
+                    me->controller->trajectory->len - 1,
+                    me->sampling_ratio,
+                    me->tracking_ratio);
+    }
+
     if (!me->adjustment)
         return true;
 
@@ -178,10 +457,15 @@ FixedRateShards__post_process(struct FixedRateShards *me)
     //      all values. Conversely, I could just not scale any values by the
     //      scale and I'd be equally well off (in fact, better probably,
     //      because a smaller chance of overflowing).
+    // NOTE If the sampling ratio changed, then each ratio has its own
+    //      expected number of samples and scale, so we add up their
+    //      adjustments.
     const int64_t adjustment =
+        me->adjustment_carry +
         me->scale *
-        (me->num_entries_seen * me->sampling_ratio - me->num_entries_processed);
-    ;
+            ((me->num_entries_seen - me->period_entries_seen) *
+                 me->sampling_ratio -
+             (me->num_entries_processed - me->period_entries_processed));
     if (!Histogram__adjust_first_buckets(&me->olken.histogram, adjustment)) {
         LOGGER_WARN("error in adjusting buckets");
         return false;
@@ -202,9 +486,85 @@ FixedRateShards__print_histogram_as_json(struct FixedRateShards *me)
     Olken__print_histogram_as_json(&me->olken);
 }
 
+size_t
+FixedRateShards__memory_usage(struct FixedRateShards const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return Olken__memory_usage(&me->olken) +
+           tree__memory_usage(&me->warming_tree);
+}
+
+/// @note   We do not save the interval statistics, which are only for
+///         debugging.
+bool
+FixedRateShards__save_checkpoint(struct FixedRateShards const *const me,
+                                 struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_u64(writer, me->num_entries_seen) &&
+           CheckpointWriter__write_u64(writer, me->num_entries_processed) &&
+           CheckpointWriter__write_f64(writer, me->sampling_ratio) &&
+           CheckpointWriter__write_u64(writer, me->threshold) &&
+           CheckpointWriter__write_u64(writer, me->scale) &&
+           CheckpointWriter__write_f64(writer, me->adjustment_carry) &&
+           CheckpointWriter__write_u64(writer, me->period_entries_seen) &&
+           CheckpointWriter__write_u64(writer,
+                                       me->period_entries_processed) &&
+           CheckpointWriter__write_f64(writer, me->tracking_ratio) &&
+           CheckpointWriter__write_u64(writer, me->tracking_threshold) &&
+           CheckpointWriter__write_u64(writer, me->num_warming_left) &&
+           tree__save_checkpoint(&me->warming_tree, writer) &&
+           Olken__save_checkpoint(&me->olken, writer);
+}
+
+bool
+FixedRateShards__load_checkpoint(struct FixedRateShards *const me,
+                                 struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    // NOTE The sampling ratio may have changed since the initialization.
+    if (!CheckpointReader__read_u64(reader, &me->num_entries_seen) ||
+        !CheckpointReader__read_u64(reader, &me->num_entries_processed) ||
+        !CheckpointReader__read_f64(reader, &me->sampling_ratio) ||
+        !CheckpointReader__read_u64(reader, &me->threshold) ||
+        !CheckpointReader__read_u64(reader, &me->scale) ||
+        !CheckpointReader__read_f64(reader, &me->adjustment_carry) ||
+        !CheckpointReader__read_u64(reader, &me->period_entries_seen) ||
+        !CheckpointReader__read_u64(reader, &me->period_entries_processed) ||
+        !CheckpointReader__read_f64(reader, &me->tracking_ratio) ||
+        !CheckpointReader__read_u64(reader, &me->tracking_threshold) ||
+        !CheckpointReader__read_u64(reader, &me->num_warming_left) ||
+        !tree__load_checkpoint(&me->warming_tree, reader) ||
+        !Olken__load_checkpoint_unchecked(&me->olken, reader)) {
+        return false;
+    }
+    // NOTE The keys that we are warming up are in Olken's hash table but
+    //      in our warming tree rather than Olken's tree.
+    if (me->olken.tree.cardinality + me->warming_tree.cardinality !=
+        KHashTable__get_size(&me->olken.hash_table)) {
+        LOGGER_ERROR("trees and hash table sizes differ");
+        return false;
+    }
+    if (me->controller != NULL) {
+        SamplingController__set_rate(me->controller, me->tracking_ratio);
+    }
+    return true;
+}
+
 void
 FixedRateShards__destroy(struct FixedRateShards *me)
 {
+    if (me->controller != NULL) {
+        SamplingController__destroy(me->controller);
+        free(me->controller);
+    }
+    tree__destroy(&me->warming_tree);
     Olken__destroy(&me->olken);
 #ifdef INTERVAL_STATISTICS
     IntervalStatistics__destroy(&me->istats);
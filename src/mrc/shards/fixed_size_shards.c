@@ -5,6 +5,7 @@
 
 #include <glib.h>
 
+#include "checkpoint/checkpoint.h"
 #include "histogram/histogram.h"
 #ifdef INTERVAL_STATISTICS
 #include "interval_statistics/interval_statistics.h"
@@ -14,6 +15,7 @@
 #include "lookup/lookup.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
+#include "profiler/profiler.h"
 #include "shards/fixed_size_shards.h"
 #include "shards/fixed_size_shards_sampler.h"
 #include "types/entry_type.h"
@@ -132,7 +134,9 @@ update_item(struct FixedSizeShards *me,
             EntryType entry,
             TimeStampType timestamp)
 {
+    uint64_t start = Profiler__start();
     uint64_t distance = Olken__update_stack(&me->olken, entry, timestamp);
+    Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
     if (distance == UINT64_MAX) {
         return false;
     }
@@ -143,37 +147,50 @@ update_item(struct FixedSizeShards *me,
                                       me->olken.current_time_stamp - timestamp -
                                           1);
 #endif
+    start = Profiler__start();
     Histogram__insert_scaled_finite(&me->olken.histogram,
                                     distance,
                                     me->sampler.scale);
+    Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
     return true;
 }
 
 static void
 evict_item(void *eviction_data, EntryType entry)
 {
+    uint64_t const start = Profiler__start();
     bool r = Olken__remove_item(eviction_data, entry);
+    Profiler__stop(PROFILER_SCOPE_EVICTION, start);
     assert(r);
 }
 
 static bool
 insert_item(struct FixedSizeShards *me, EntryType entry)
 {
-    if (!FixedSizeShardsSampler__insert(&me->sampler,
-                                        entry,
-                                        evict_item,
-                                        &me->olken)) {
+    // NOTE The sampler's time includes the time to evict.
+    uint64_t start = Profiler__start();
+    bool ok = FixedSizeShardsSampler__insert(&me->sampler,
+                                             entry,
+                                             evict_item,
+                                             &me->olken);
+    Profiler__stop(PROFILER_SCOPE_SAMPLER, start);
+    if (!ok) {
         LOGGER_ERROR("fixed-size SHARDS sampler insertion failed");
         return false;
     }
-    if (!Olken__insert_stack(&me->olken, entry)) {
+    start = Profiler__start();
+    ok = Olken__insert_stack(&me->olken, entry);
+    Profiler__stop(PROFILER_SCOPE_TREE_UPDATE, start);
+    if (!ok) {
         LOGGER_ERROR("Olken insertion failed");
         return false;
     }
 #ifdef INTERVAL_STATISTICS
     IntervalStatistics__append_infinity(&me->istats);
 #endif
+    start = Profiler__start();
     Histogram__insert_scaled_infinite(&me->olken.histogram, me->sampler.scale);
+    Profiler__stop(PROFILER_SCOPE_HISTOGRAM_INSERT, start);
     return true;
 }
 
@@ -193,13 +210,19 @@ FixedSizeShards__access_item(struct FixedSizeShards *me, EntryType entry)
         Statistics__append_uint64(&me->stats, data);
     }
 #endif
-    if (!FixedSizeShardsSampler__sample(&me->sampler, entry)) {
+    uint64_t prof_start = Profiler__start();
+    bool const sampled = FixedSizeShardsSampler__sample(&me->sampler, entry);
+    Profiler__stop(PROFILER_SCOPE_SAMPLER, prof_start);
+    if (!sampled) {
         unsampled_item(me);
         UPDATE_PROFILE_STATISTICS(&me->prof_stats_fast, start);
-        return false;
+        // NOTE Ignoring an unsampled item is not an error.
+        return true;
     }
 
+    prof_start = Profiler__start();
     struct LookupReturn r = Olken__lookup(&me->olken, entry);
+    Profiler__stop(PROFILER_SCOPE_HASH_LOOKUP, prof_start);
     if (r.success) {
         bool ok = update_item(me, entry, r.timestamp);
         UPDATE_PROFILE_STATISTICS(&me->prof_stats_slow, start);
@@ -237,6 +260,40 @@ FixedSizeShards__print_histogram_as_json(struct FixedSizeShards *me)
     Histogram__print_as_json(&me->olken.histogram);
 }
 
+size_t
+FixedSizeShards__memory_usage(struct FixedSizeShards const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return Olken__memory_usage(&me->olken) +
+           FixedSizeShardsSampler__memory_usage(&me->sampler);
+}
+
+/// @note   We do not save the interval or threshold statistics, which
+///         are only for debugging.
+bool
+FixedSizeShards__save_checkpoint(struct FixedSizeShards const *const me,
+                                 struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return FixedSizeShardsSampler__save_checkpoint(&me->sampler, writer) &&
+           Olken__save_checkpoint(&me->olken, writer);
+}
+
+bool
+FixedSizeShards__load_checkpoint(struct FixedSizeShards *const me,
+                                 struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    return FixedSizeShardsSampler__load_checkpoint(&me->sampler, reader) &&
+           Olken__load_checkpoint(&me->olken, reader);
+}
+
 void
 FixedSizeShards__destroy(struct FixedSizeShards *me)
 {
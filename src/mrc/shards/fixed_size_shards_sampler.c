@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "checkpoint/checkpoint.h"
 #include "hash/hash.h"
 #include "hash/types.h"
 #include "logger/logger.h"
@@ -43,6 +44,48 @@ cleanup:
     return false;
 }
 
+size_t
+FixedSizeShardsSampler__memory_usage(
+    struct FixedSizeShardsSampler const *const me)
+{
+    if (me == NULL) {
+        return 0;
+    }
+    return Heap__memory_usage(&me->pq);
+}
+
+bool
+FixedSizeShardsSampler__save_checkpoint(
+    struct FixedSizeShardsSampler const *const me,
+    struct CheckpointWriter *const writer)
+{
+    if (me == NULL || writer == NULL) {
+        return false;
+    }
+    return CheckpointWriter__write_f64(writer, me->sampling_ratio) &&
+           CheckpointWriter__write_u64(writer, me->threshold) &&
+           CheckpointWriter__write_u64(writer, me->scale) &&
+           CheckpointWriter__write_u64(writer, me->num_entries_seen) &&
+           CheckpointWriter__write_u64(writer, me->num_entries_processed) &&
+           Heap__save_checkpoint(&me->pq, writer);
+}
+
+bool
+FixedSizeShardsSampler__load_checkpoint(
+    struct FixedSizeShardsSampler *const me,
+    struct CheckpointReader *const reader)
+{
+    if (me == NULL || reader == NULL) {
+        return false;
+    }
+    return CheckpointReader__read_f64(reader, &me->sampling_ratio) &&
+           CheckpointReader__read_u64(reader, &me->threshold) &&
+           CheckpointReader__read_u64(reader, &me->scale) &&
+           CheckpointReader__read_u64(reader, &me->num_entries_seen) &&
+           CheckpointReader__read_u64(reader, &me->num_entries_processed) &&
+           Heap__load_checkpoint(&me->pq, reader);
+}
+
 void
 FixedSizeShardsSampler__destroy(struct FixedSizeShardsSampler *const me)
 {
@@ -0,0 +1,448 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hash/hash.h"
+#include "hash/types.h"
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "math/ratio.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "shards/fused_fixed_size_shards.h"
+#include "types/entry_type.h"
+#include "unused/mark_unused.h"
+
+#define EMPTY_TIMESTAMP UINT64_MAX
+
+static size_t
+next_power_of_two(size_t const x)
+{
+    size_t y = 1;
+    while (y < x) {
+        y <<= 1;
+    }
+    return y;
+}
+
+static bool
+initialize(struct FusedFixedSizeShards *const me,
+           double const starting_sampling_ratio,
+           size_t const max_size,
+           size_t const histogram_num_bins,
+           size_t const histogram_bin_size,
+           enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+{
+    if (me == NULL || starting_sampling_ratio <= 0.0 ||
+        1.0 < starting_sampling_ratio || max_size == 0 ||
+        max_size > SIZE_MAX / 4) {
+        LOGGER_WARN("bad input");
+        return false;
+    }
+    // NOTE We keep the load factor at or below 50% so that the linear
+    //      probes are short. We use the same length for the Fenwick
+    //      tree, which means that we renumber the timestamps at most
+    //      once every 'max_size' accesses.
+    size_t const table_length = next_power_of_two(2 * max_size);
+    *me = (struct FusedFixedSizeShards){
+        .table = malloc(table_length * sizeof(*me->table)),
+        .table_length = table_length,
+        .num_entries = 0,
+        .heap = malloc(max_size * sizeof(*me->heap)),
+        .max_size = max_size,
+        .fenwick = calloc(table_length + 1, sizeof(*me->fenwick)),
+        .num_timestamps = table_length,
+        .current_time_stamp = 0,
+        .sampling_ratio = starting_sampling_ratio,
+        .threshold = ratio_uint64(starting_sampling_ratio),
+        .scale = 1 / starting_sampling_ratio,
+    };
+    if (me->table == NULL || me->heap == NULL || me->fenwick == NULL) {
+        LOGGER_ERROR("failed to allocate");
+        goto cleanup;
+    }
+    for (size_t i = 0; i < table_length; ++i) {
+        me->table[i] = (struct FusedFixedSizeShardsEntry){
+            .hash = 0,
+            .timestamp = EMPTY_TIMESTAMP,
+            .heap_index = SIZE_MAX,
+        };
+    }
+    if (!Histogram__init(&me->histogram,
+                         histogram_num_bins,
+                         histogram_bin_size,
+                         out_of_bounds_mode)) {
+        LOGGER_ERROR("failed to initialize histogram");
+        goto cleanup;
+    }
+    return true;
+cleanup:
+    FusedFixedSizeShards__destroy(me);
+    return false;
+}
+
+bool
+FusedFixedSizeShards__init(struct FusedFixedSizeShards *const me,
+                           double const starting_sampling_ratio,
+                           size_t const max_size,
+                           size_t const histogram_num_bins,
+                           size_t const histogram_bin_size)
+{
+    return initialize(me,
+                      starting_sampling_ratio,
+                      max_size,
+                      histogram_num_bins,
+                      histogram_bin_size,
+                      HistogramOutOfBoundsMode__allow_overflow);
+}
+
+bool
+FusedFixedSizeShards__init_full(
+    struct FusedFixedSizeShards *const me,
+    double const starting_sampling_ratio,
+    size_t const max_size,
+    size_t const histogram_num_bins,
+    size_t const histogram_bin_size,
+    enum HistogramOutOfBoundsMode const out_of_bounds_mode)
+{
+    return initialize(me,
+                      starting_sampling_ratio,
+                      max_size,
+                      histogram_num_bins,
+                      histogram_bin_size,
+                      out_of_bounds_mode);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// FENWICK TREE OF LIVE TIMESTAMPS
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void
+fenwick_add(struct FusedFixedSizeShards *const me,
+            uint64_t const timestamp,
+            int64_t const delta)
+{
+    assert(timestamp < me->num_timestamps);
+    for (size_t i = timestamp + 1; i <= me->num_timestamps; i += i & -i) {
+        me->fenwick[i] += delta;
+    }
+}
+
+/// @brief  Count the live timestamps that are less than or equal to
+///         'timestamp'.
+static inline uint64_t
+fenwick_prefix_count(struct FusedFixedSizeShards const *const me,
+                     uint64_t const timestamp)
+{
+    uint64_t count = 0;
+    for (size_t i = timestamp + 1; i > 0; i -= i & -i) {
+        count += me->fenwick[i];
+    }
+    return count;
+}
+
+/// @brief  Renumber the live timestamps to 0..num_entries while
+///         preserving their order.
+/// @note   This is amortized O(1) per access because we do it at most
+///         once every 'num_timestamps - max_size >= max_size' accesses.
+static void
+compact_timestamps(struct FusedFixedSizeShards *const me)
+{
+    // NOTE The Fenwick tree is not modified until after we have read
+    //      all of the new timestamps, so we can update them in place.
+    for (size_t i = 0; i < me->table_length; ++i) {
+        struct FusedFixedSizeShardsEntry *const e = &me->table[i];
+        if (e->timestamp != EMPTY_TIMESTAMP) {
+            e->timestamp = fenwick_prefix_count(me, e->timestamp) - 1;
+        }
+    }
+    for (size_t i = 0; i <= me->num_timestamps; ++i) {
+        me->fenwick[i] = 0;
+    }
+    for (size_t i = 0; i < me->table_length; ++i) {
+        if (me->table[i].timestamp != EMPTY_TIMESTAMP) {
+            me->fenwick[me->table[i].timestamp + 1] = 1;
+        }
+    }
+    // Build the Fenwick tree in linear time.
+    for (size_t i = 1; i <= me->num_timestamps; ++i) {
+        size_t const parent = i + (i & -i);
+        if (parent <= me->num_timestamps) {
+            me->fenwick[parent] += me->fenwick[i];
+        }
+    }
+    me->current_time_stamp = me->num_entries;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// LOOKUP TABLE
+////////////////////////////////////////////////////////////////////////////////
+
+/// @note   The sampled hashes are all below the threshold, so we use the
+///         lower bits of the hash to find the home bucket.
+static inline size_t
+home_index(struct FusedFixedSizeShards const *const me,
+           Hash64BitType const hash)
+{
+    return hash & (me->table_length - 1);
+}
+
+/// @brief  Find the index of the hash in the table or the empty entry
+///         where it would be inserted.
+static inline size_t
+probe(struct FusedFixedSizeShards const *const me, Hash64BitType const hash)
+{
+    size_t const mask = me->table_length - 1;
+    for (size_t i = home_index(me, hash);; i = (i + 1) & mask) {
+        struct FusedFixedSizeShardsEntry const *const e = &me->table[i];
+        if (e->timestamp == EMPTY_TIMESTAMP || e->hash == hash) {
+            return i;
+        }
+    }
+}
+
+/// @brief  Remove the entry at 'index' with backward-shift deletion.
+static void
+remove_table_entry(struct FusedFixedSizeShards *const me, size_t index)
+{
+    size_t const mask = me->table_length - 1;
+    for (size_t j = (index + 1) & mask;
+         me->table[j].timestamp != EMPTY_TIMESTAMP;
+         j = (j + 1) & mask) {
+        // We can only move the entry at 'j' back into the hole if its
+        // home is not cyclically within (index, j].
+        size_t const home = home_index(me, me->table[j].hash);
+        if (((j - home) & mask) >= ((j - index) & mask)) {
+            me->table[index] = me->table[j];
+            me->heap[me->table[index].heap_index].table_index = index;
+            index = j;
+        }
+    }
+    me->table[index].timestamp = EMPTY_TIMESTAMP;
+    me->table[index].heap_index = SIZE_MAX;
+    --me->num_entries;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// MAX-HEAP OF HASHES
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void
+heap_set(struct FusedFixedSizeShards *const me,
+         size_t const heap_index,
+         struct FusedFixedSizeShardsHeapItem const item)
+{
+    me->heap[heap_index] = item;
+    me->table[item.table_index].heap_index = heap_index;
+}
+
+static void
+heap_sift_up(struct FusedFixedSizeShards *const me, size_t i)
+{
+    struct FusedFixedSizeShardsHeapItem const item = me->heap[i];
+    while (i > 0) {
+        size_t const parent = (i - 1) / 2;
+        if (me->heap[parent].hash >= item.hash) {
+            break;
+        }
+        heap_set(me, i, me->heap[parent]);
+        i = parent;
+    }
+    heap_set(me, i, item);
+}
+
+static void
+heap_sift_down(struct FusedFixedSizeShards *const me,
+               size_t const length,
+               size_t i)
+{
+    struct FusedFixedSizeShardsHeapItem const item = me->heap[i];
+    while (true) {
+        size_t largest = 2 * i + 1;
+        if (largest >= length) {
+            break;
+        }
+        if (largest + 1 < length &&
+            me->heap[largest + 1].hash > me->heap[largest].hash) {
+            ++largest;
+        }
+        if (item.hash >= me->heap[largest].hash) {
+            break;
+        }
+        heap_set(me, i, me->heap[largest]);
+        i = largest;
+    }
+    heap_set(me, i, item);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// SHARDS
+////////////////////////////////////////////////////////////////////////////////
+
+static void
+set_sampling_rate(struct FusedFixedSizeShards *const me,
+                  Hash64BitType const new_max_hash)
+{
+    // NOTE This matches 'FixedSizeShardsSampler' exactly, including the
+    //      rounding of UINT64_MAX to a double.
+    me->sampling_ratio = (double)new_max_hash / UINT64_MAX;
+    me->threshold = new_max_hash;
+    me->scale = UINT64_MAX / new_max_hash;
+}
+
+/// @brief  Evict the entry with the maximum hash and lower the threshold
+///         to the next largest hash.
+/// @param  hash: the hash that we are about to insert. We only use this
+///         if we evict the only tracked entry.
+static void
+make_room(struct FusedFixedSizeShards *const me, Hash64BitType const hash)
+{
+    size_t const length = me->num_entries;
+    struct FusedFixedSizeShardsHeapItem const top = me->heap[0];
+    uint64_t const timestamp = me->table[top.table_index].timestamp;
+
+    fenwick_add(me, timestamp, -1);
+    // NOTE We remove the item from the heap before the table because
+    //      removing from the table may move entries and so we want the
+    //      heap's references to be correct. The order does not matter
+    //      for the top item since we copied it above.
+    if (length > 1) {
+        me->heap[0] = me->heap[length - 1];
+        heap_sift_down(me, length - 1, 0);
+    }
+    remove_table_entry(me, top.table_index);
+    // NOTE The regular fixed-size SHARDS divides by zero if we evict the
+    //      only tracked entry, so we use the incoming hash instead.
+    set_sampling_rate(me, me->num_entries > 0 ? me->heap[0].hash : hash);
+}
+
+static bool
+insert_item(struct FusedFixedSizeShards *const me,
+            Hash64BitType const hash,
+            size_t index)
+{
+    if (me->num_entries == me->max_size) {
+        make_room(me, hash);
+        // NOTE Removing an entry may shift our insertion position.
+        index = probe(me, hash);
+    }
+    me->table[index] = (struct FusedFixedSizeShardsEntry){
+        .hash = hash,
+        .timestamp = me->current_time_stamp,
+        .heap_index = SIZE_MAX,
+    };
+    fenwick_add(me, me->current_time_stamp, 1);
+    ++me->current_time_stamp;
+    me->heap[me->num_entries] = (struct FusedFixedSizeShardsHeapItem){
+        .hash = hash,
+        .table_index = index,
+    };
+    heap_sift_up(me, me->num_entries);
+    ++me->num_entries;
+    return Histogram__insert_scaled_infinite(&me->histogram, me->scale);
+}
+
+static bool
+update_item(struct FusedFixedSizeShards *const me, size_t const index)
+{
+    struct FusedFixedSizeShardsEntry *const e = &me->table[index];
+    // The stack distance is the number of live timestamps after ours.
+    uint64_t const distance =
+        me->num_entries - fenwick_prefix_count(me, e->timestamp);
+    fenwick_add(me, e->timestamp, -1);
+    e->timestamp = me->current_time_stamp;
+    fenwick_add(me, e->timestamp, 1);
+    ++me->current_time_stamp;
+    return Histogram__insert_scaled_finite(&me->histogram,
+                                           distance,
+                                           me->scale);
+}
+
+bool
+FusedFixedSizeShards__access_item(struct FusedFixedSizeShards *const me,
+                                  EntryType const entry)
+{
+    if (me == NULL || me->table == NULL) {
+        return false;
+    }
+    Hash64BitType const hash = Hash64Bit(entry);
+    // Skip items above the threshold. Note that we accept items that are
+    // equal to the threshold because the maximum hash is the threshold.
+    if (hash > me->threshold) {
+        return true;
+    }
+    // NOTE We renumber before the lookup so that the timestamp of the
+    //      accessed entry stays consistent with the Fenwick tree.
+    if (me->current_time_stamp == me->num_timestamps) {
+        compact_timestamps(me);
+    }
+    size_t const index = probe(me, hash);
+    if (me->table[index].timestamp != EMPTY_TIMESTAMP) {
+        return update_item(me, index);
+    }
+    return insert_item(me, hash, index);
+}
+
+bool
+FusedFixedSizeShards__post_process(struct FusedFixedSizeShards *const me)
+{
+    UNUSED(me);
+    return true;
+}
+
+bool
+FusedFixedSizeShards__to_mrc(struct FusedFixedSizeShards const *const me,
+                             struct MissRateCurve *const mrc)
+{
+    return MissRateCurve__init_from_histogram(mrc, &me->histogram);
+}
+
+void
+FusedFixedSizeShards__print_histogram_as_json(
+    struct FusedFixedSizeShards *const me)
+{
+    if (me == NULL) {
+        Histogram__print_as_json(NULL);
+        return;
+    }
+    Histogram__print_as_json(&me->histogram);
+}
+
+size_t
+FusedFixedSizeShards__memory_usage(
+    struct FusedFixedSizeShards const *const me)
+{
+    if (me == NULL || me->table == NULL) {
+        return 0;
+    }
+    return me->table_length * sizeof(*me->table) +
+           me->max_size * sizeof(*me->heap) +
+           (me->table_length + 1) * sizeof(*me->fenwick) +
+           Histogram__memory_usage(&me->histogram);
+}
+
+void
+FusedFixedSizeShards__destroy(struct FusedFixedSizeShards *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    free(me->table);
+    free(me->heap);
+    free(me->fenwick);
+    Histogram__destroy(&me->histogram);
+    *me = (struct FusedFixedSizeShards){0};
+}
+
+bool
+FusedFixedSizeShards__get_histogram(
+    struct FusedFixedSizeShards *const me,
+    struct Histogram const **const histogram)
+{
+    if (me == NULL || histogram == NULL) {
+        return false;
+    }
+    *histogram = &me->histogram;
+    return true;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "histogram/histogram.h"
@@ -12,6 +13,11 @@
 #include "interval_statistics/interval_statistics.h"
 #endif
 
+struct CheckpointWriter;
+struct CheckpointReader;
+struct SamplingController;
+struct SamplingControllerConfig;
+
 struct FixedRateShards {
     struct Olken olken;
     // I cannot const qualify this because I need to set it and it is
@@ -30,6 +36,25 @@ struct FixedRateShards {
     bool adjustment;
     uint64_t num_entries_seen;
     uint64_t num_entries_processed;
+    // If the sampling ratio changes, then we accumulate the adjustment
+    // of each earlier ratio here and start counting afresh.
+    double adjustment_carry;
+    uint64_t period_entries_seen;
+    uint64_t period_entries_processed;
+
+    // After raising the ratio, we track the keys with hashes in the band
+    // (threshold, tracking_threshold] in their own tree, so they do not
+    // shorten the distances of the keys below the threshold, and we keep
+    // recording at the old ratio. Once we have seen about as many keys in
+    // the band as we expect, we merge the trees and switch ratios. The
+    // band is empty when we are not warming up.
+    double tracking_ratio;
+    uint64_t tracking_threshold;
+    struct Tree warming_tree;
+    uint64_t num_warming_left;
+
+    // Adapts the sampling ratio to a CPU budget (or NULL if static).
+    struct SamplingController *controller;
 
 #ifdef INTERVAL_STATISTICS
     struct IntervalStatistics istats;
@@ -60,9 +85,33 @@ FixedRateShards__init_full(
     enum HistogramOutOfBoundsMode const out_of_bounds_mode,
     bool const adjustment);
 
+/// @brief  Adapt the sampling ratio online to meet a CPU budget.
+/// @note   This starts from the current sampling ratio.
+bool
+FixedRateShards__enable_controller(
+    struct FixedRateShards *const me,
+    struct SamplingControllerConfig const *const config);
+
+/// @brief  Change the sampling ratio.
+/// @details    Lowering the ratio evicts the keys above the new threshold,
+///             as in fixed-size SHARDS. Raising it only takes effect for
+///             the histogram once we have warmed up the new keys; until
+///             then, we record at the old ratio. We keep the SHARDS
+///             adjustment of each ratio separately.
+bool
+FixedRateShards__set_sampling_ratio(struct FixedRateShards *const me,
+                                    double const sampling_ratio);
+
 bool
 FixedRateShards__access_item(struct FixedRateShards *me, EntryType entry);
 
+/// @brief  Access entries in order, as if by 'FixedRateShards__access_item'.
+/// @note   We hash a window of entries ahead of sampling them.
+bool
+FixedRateShards__access_batch(struct FixedRateShards *const me,
+                              EntryType const *const entries,
+                              size_t const num_entries);
+
 bool
 FixedRateShards__post_process(struct FixedRateShards *me);
 
@@ -73,6 +122,21 @@ FixedRateShards__to_mrc(struct FixedRateShards const *const me,
 void
 FixedRateShards__print_histogram_as_json(struct FixedRateShards *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+FixedRateShards__memory_usage(struct FixedRateShards const *const me);
+
+/// @brief  Append the full state to a checkpoint.
+bool
+FixedRateShards__save_checkpoint(struct FixedRateShards const *const me,
+                                 struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+FixedRateShards__load_checkpoint(struct FixedRateShards *const me,
+                                 struct CheckpointReader *const reader);
+
 void
 FixedRateShards__destroy(struct FixedRateShards *me);
 
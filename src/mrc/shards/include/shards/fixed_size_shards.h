@@ -13,6 +13,9 @@
 #include "shards/fixed_size_shards_sampler.h"
 #include "types/entry_type.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 #ifdef THRESHOLD_STATISTICS
 #include "statistics/statistics.h"
 #endif
@@ -61,6 +64,7 @@ FixedSizeShards__init_full(
     enum HistogramOutOfBoundsMode const out_of_bounds_mode,
     struct Dictionary const *const dictionary);
 
+/// @return false on error. Ignoring an unsampled item is not an error.
 bool
 FixedSizeShards__access_item(struct FixedSizeShards *me, EntryType entry);
 
@@ -74,6 +78,21 @@ FixedSizeShards__to_mrc(struct FixedSizeShards const *const me,
 void
 FixedSizeShards__print_histogram_as_json(struct FixedSizeShards *me);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+FixedSizeShards__memory_usage(struct FixedSizeShards const *const me);
+
+/// @brief  Append the full state to a checkpoint.
+bool
+FixedSizeShards__save_checkpoint(struct FixedSizeShards const *const me,
+                                 struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+FixedSizeShards__load_checkpoint(struct FixedSizeShards *const me,
+                                 struct CheckpointReader *const reader);
+
 void
 FixedSizeShards__destroy(struct FixedSizeShards *me);
 
@@ -6,6 +6,9 @@
 #include "priority_queue/heap.h"
 #include "types/entry_type.h"
 
+struct CheckpointWriter;
+struct CheckpointReader;
+
 struct FixedSizeShardsSampler {
     double sampling_ratio;
     uint64_t threshold;
@@ -27,6 +30,22 @@ FixedSizeShardsSampler__init(struct FixedSizeShardsSampler *const me,
                              const uint64_t max_size,
                              bool const adjustment);
 
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+FixedSizeShardsSampler__memory_usage(
+    struct FixedSizeShardsSampler const *const me);
+
+/// @brief  Append the full state to a checkpoint.
+bool
+FixedSizeShardsSampler__save_checkpoint(struct FixedSizeShardsSampler const *const me,
+                                        struct CheckpointWriter *const writer);
+
+/// @brief  Replace the state with the next one in a checkpoint.
+/// @note   This must be initialized with the checkpoint's parameters.
+bool
+FixedSizeShardsSampler__load_checkpoint(struct FixedSizeShardsSampler *const me,
+                                        struct CheckpointReader *const reader);
+
 void
 FixedSizeShardsSampler__destroy(struct FixedSizeShardsSampler *const me);
 
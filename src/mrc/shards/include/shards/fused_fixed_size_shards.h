@@ -0,0 +1,119 @@
+/** @brief  Fixed-size SHARDS where a single hash drives everything.
+ *
+ *  The regular fixed-size SHARDS hashes each key once to sample it, again
+ *  to insert it into the max-heap, and then Olken looks it up in its own
+ *  hash table (and again upon eviction). Here, we hash each key once and
+ *  use the hash for the sampling, the lookup, and the eviction order.
+ *
+ *  1. The lookup table is an open-addressing table keyed by the hash. Each
+ *     entry stores the timestamp of its last access and its position in
+ *     the max-heap so that we can evict directly from the heap.
+ *  2. The stack distances are counted with a Fenwick tree over the live
+ *     timestamps. We renumber the timestamps once they run past the end
+ *     of the tree (since only their order matters).
+ *
+ *  All memory is allocated upon initialization (except for the histogram
+ *  if it is allowed to grow), so accessing items never allocates.
+ *
+ *  @note   This produces identical histograms to 'FixedSizeShards' as long
+ *          as the hash function is a bijection (e.g. splitmix64), because
+ *          we identify keys by their hashes.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash/types.h"
+#include "histogram/histogram.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "types/entry_type.h"
+
+struct FusedFixedSizeShardsEntry {
+    Hash64BitType hash;
+    // The (renumbered) time of the last access. An empty entry has a
+    // timestamp of UINT64_MAX.
+    uint64_t timestamp;
+    // The index of this entry in the max-heap.
+    size_t heap_index;
+};
+
+struct FusedFixedSizeShardsHeapItem {
+    Hash64BitType hash;
+    // The index of this item's entry in the table.
+    size_t table_index;
+};
+
+struct FusedFixedSizeShards {
+    // The lookup table keyed by hash, with a power-of-two length.
+    struct FusedFixedSizeShardsEntry *table;
+    size_t table_length;
+    size_t num_entries;
+
+    // The max-heap of the tracked hashes.
+    struct FusedFixedSizeShardsHeapItem *heap;
+    size_t max_size;
+
+    // The Fenwick tree of live timestamps. It is 1-indexed, so it has
+    // 'num_timestamps + 1' elements.
+    uint64_t *fenwick;
+    size_t num_timestamps;
+    uint64_t current_time_stamp;
+
+    double sampling_ratio;
+    uint64_t threshold;
+    uint64_t scale;
+
+    struct Histogram histogram;
+};
+
+/// @brief  Initialize the fused fixed-size SHARDS data structure.
+/// @param  starting_sampling_ratio: the original ratio at which we sample.
+/// @param  max_size: the maximum number of elements that we will track.
+bool
+FusedFixedSizeShards__init(struct FusedFixedSizeShards *const me,
+                           double const starting_sampling_ratio,
+                           size_t const max_size,
+                           size_t const histogram_num_bins,
+                           size_t const histogram_bin_size);
+
+/// @brief  See 'FusedFixedSizeShards__init'.
+/// @note   The interface is less stable than 'FusedFixedSizeShards__init'.
+bool
+FusedFixedSizeShards__init_full(
+    struct FusedFixedSizeShards *const me,
+    double const starting_sampling_ratio,
+    size_t const max_size,
+    size_t const histogram_num_bins,
+    size_t const histogram_bin_size,
+    enum HistogramOutOfBoundsMode const out_of_bounds_mode);
+
+/// @return false on error. Ignoring an unsampled item is not an error.
+bool
+FusedFixedSizeShards__access_item(struct FusedFixedSizeShards *const me,
+                                  EntryType const entry);
+
+bool
+FusedFixedSizeShards__post_process(struct FusedFixedSizeShards *const me);
+
+bool
+FusedFixedSizeShards__to_mrc(struct FusedFixedSizeShards const *const me,
+                             struct MissRateCurve *const mrc);
+
+void
+FusedFixedSizeShards__print_histogram_as_json(
+    struct FusedFixedSizeShards *const me);
+
+/// @brief  Get the number of bytes that this owns on the heap.
+size_t
+FusedFixedSizeShards__memory_usage(
+    struct FusedFixedSizeShards const *const me);
+
+void
+FusedFixedSizeShards__destroy(struct FusedFixedSizeShards *const me);
+
+bool
+FusedFixedSizeShards__get_histogram(
+    struct FusedFixedSizeShards *const me,
+    struct Histogram const **const histogram);
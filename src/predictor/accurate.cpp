@@ -6,10 +6,13 @@
 #include "cpp_lib/cache_trace.hpp"
 #include "cpp_lib/cache_trace_format.hpp"
 #include "cpp_lib/duration.hpp"
-#include "cpp_lib/progress_bar.hpp"
 #include "cpp_lib/trace_cleaner.hpp"
 #include "cpp_lib/util.hpp"
+#include "memory/memory_placement.h"
+#include "profiler/profiler.h"
+#include "telemetry/telemetry.h"
 #include "shards/fixed_rate_shards_sampler.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
@@ -83,10 +86,6 @@ public:
     Policy policy;
     std::vector<uint64_t> cache_capacities;
     double shards_ratio;
-    // I hard-code this as false because I have everything print at the end so
-    // it doesn't make sense to include progress bars if they're not printed in
-    // real time.
-    bool const show_progress = false;
 };
 
 template <class T>
@@ -95,9 +94,13 @@ run_single_accurate_cache(std::promise<std::string> promise,
                           uint64_t id,
                           CacheAccessTrace &trace,
                           uint64_t const capacity_bytes,
-                          double const shards_ratio,
-                          bool const show_progress)
+                          double const shards_ratio)
 {
+    // NOTE We pin the thread before we allocate the simulator, so that
+    //      its state is on the thread's NUMA node (if so configured).
+    if (!MemoryPlacement__pin_worker(id)) {
+        LOGGER_WARN("failed to pin worker %d", (int)id);
+    }
     TraceCleaner cleaner{Duration::SECOND, 0};
     T cache{(uint64_t)(capacity_bytes * shards_ratio), shards_ratio};
     FixedRateShardsSampler sampler{shards_ratio, true};
@@ -108,21 +111,38 @@ run_single_accurate_cache(std::promise<std::string> promise,
                   capacity_bytes,
                   (size_t)(capacity_bytes * shards_ratio),
                   shards_ratio);
-    ProgressBar pbar{trace.size(), show_progress && id == 0};
+    TelemetryProgress progress{};
+    TelemetryProgress__init(&progress,
+                            ("accurate[" + std::to_string(id) + "]").c_str(),
+                            trace.size());
     cache.start_simulation();
-    for (size_t i = 0; i < trace.size(); ++i) {
-        pbar.tick();
-        auto const &access = trace.get_wait(i);
-        if (!cleaner.sample(access)) {
-            continue;
-        }
-        if (!sampler.sample(access.key)) {
-            continue;
-        }
-        if (access.is_read()) {
-            cache.access(access);
+    for (size_t begin = 0; begin < trace.size();
+         begin += TELEMETRY_CHUNK_SIZE) {
+        size_t const end = std::min(begin + TELEMETRY_CHUNK_SIZE, trace.size());
+        for (size_t i = begin; i < end; ++i) {
+            auto const &access = trace.get_wait(i);
+            if (!cleaner.sample(access)) {
+                continue;
+            }
+            Profiler__tick();
+            uint64_t const sampler_start = Profiler__start();
+            bool const sampled = sampler.sample(access.key);
+            Profiler__stop(PROFILER_SCOPE_SAMPLER, sampler_start);
+            if (!sampled) {
+                continue;
+            }
+            if (access.is_read()) {
+                uint64_t const access_start = Profiler__start();
+                cache.access(access);
+                Profiler__stop(PROFILER_SCOPE_ACCESS, access_start);
+            }
         }
+        TelemetryProgress__update(&progress,
+                                  end,
+                                  shards_ratio,
+                                  1.0 - cache.statistics().miss_ratio());
     }
+    TelemetryProgress__destroy(&progress);
     cache.end_simulation();
     LOGGER_TIMING("finished test_trace(trace: %s, cap: %zu, shards: %f)",
                   trace.path().c_str(),
@@ -153,8 +173,7 @@ run_cache(CommandLineArguments const &args)
                                  id++,
                                  std::ref(trace),
                                  c,
-                                 args.shards_ratio,
-                                 false);
+                                 args.shards_ratio);
             break;
         case Policy::LRU:
             hard_assert(false, "unimplemented");
@@ -165,8 +184,7 @@ run_cache(CommandLineArguments const &args)
                                  id++,
                                  std::ref(trace),
                                  c,
-                                 args.shards_ratio,
-                                 false);
+                                 args.shards_ratio);
             break;
         case Policy::Redis:
             workers.emplace_back(run_single_accurate_cache<RedisTTL>,
@@ -174,8 +192,7 @@ run_cache(CommandLineArguments const &args)
                                  id++,
                                  std::ref(trace),
                                  c,
-                                 args.shards_ratio,
-                                 false);
+                                 args.shards_ratio);
             break;
         case Policy::Memcached:
             workers.emplace_back(run_single_accurate_cache<MemcachedTTL>,
@@ -183,8 +200,7 @@ run_cache(CommandLineArguments const &args)
                                  id++,
                                  std::ref(trace),
                                  c,
-                                 args.shards_ratio,
-                                 false);
+                                 args.shards_ratio);
             break;
         case Policy::CacheLib:
             workers.emplace_back(run_single_accurate_cache<CacheLibTTL>,
@@ -192,8 +208,7 @@ run_cache(CommandLineArguments const &args)
                                  id++,
                                  std::ref(trace),
                                  c,
-                                 args.shards_ratio,
-                                 false);
+                                 args.shards_ratio);
             break;
         default:
             hard_assert(false, "unrecognized policy");
@@ -215,7 +230,12 @@ run_cache(CommandLineArguments const &args)
 int
 main(int argc, char *argv[])
 {
+    if (!Profiler__enable_from_env() || !Telemetry__start_from_env() ||
+        !MemoryPlacement__configure_from_env()) {
+        return 1;
+    }
     CommandLineArguments args{argc, argv};
     run_cache(args);
+    Telemetry__stop();
     return 0;
 }
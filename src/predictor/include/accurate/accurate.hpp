@@ -4,7 +4,9 @@
 #include "cpp_lib/cache_statistics.hpp"
 #include "cpp_lib/duration.hpp"
 #include "cpp_lib/util.hpp"
+#include "cpp_struct/memory_usage.hpp"
 #include "lib/eviction_cause.hpp"
+#include "memory/memory_footprint.h"
 #include "shards/fixed_rate_shards_sampler.h"
 #include <cassert>
 #include <cstdint>
@@ -54,6 +56,15 @@ protected:
         assert(0 && "unimplemented");
     }
 
+    /// @brief  Get the number of bytes that the cache's metadata owns on
+    ///         the heap.
+    /// @note   Children should add the memory of their own structures.
+    virtual uint64_t
+    memory_usage() const
+    {
+        return ::memory_usage(map_);
+    }
+
     bool
     accessed_is_expired(CacheAccess const &access) const
     {
@@ -81,6 +92,10 @@ protected:
             {"Expiry Cycles [#]", val2str(expiry_cycles_)},
             {"Expirations [#]", val2str(nr_expirations_)},
             {"Lazy Expirations [#]", val2str(nr_lazy_expirations_)},
+            {"Live Memory [B]",
+             val2str(format_memory_size(memory_.live_bytes))},
+            {"Peak Memory [B]",
+             val2str(format_memory_size(memory_.peak_bytes))},
         };
     }
 
@@ -100,6 +115,7 @@ public:
     void
     end_simulation()
     {
+        MemoryFootprint__update(&memory_, memory_usage());
         statistics_.end_simulation();
     }
 
@@ -115,6 +131,9 @@ public:
             CacheAccess pseudo_access{access};
             pseudo_access.timestamp_ms = current_time_ms_;
             remove_expired(pseudo_access);
+            // NOTE We sample the memory once per second of the trace
+            //      rather than on every access.
+            MemoryFootprint__update(&memory_, memory_usage());
         }
         remove_accessed_if_expired(access);
         if (map_.contains(access.key)) {
@@ -130,6 +149,12 @@ public:
         return map2str(p_json_vector(extras));
     }
 
+    CacheStatistics const &
+    statistics() const
+    {
+        return statistics_;
+    }
+
 protected:
     // Maximum number of bytes in the cache.
     size_t const capacity_bytes_;
@@ -147,4 +172,5 @@ protected:
     uint64_t expiration_work_ = 0;
     uint64_t nr_expirations_ = 0;
     uint64_t nr_lazy_expirations_ = 0;
+    MemoryFootprint memory_ = {0, 0};
 };
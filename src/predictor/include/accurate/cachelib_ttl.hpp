@@ -91,6 +91,12 @@ private:
         nr_expirations_ += victims.size();
     }
 
+    uint64_t
+    memory_usage() const override final
+    {
+        return Accurate::memory_usage() + ::memory_usage(ttl_queue_);
+    }
+
 public:
     /// @param  capacity: size_t - The capacity of the cache in bytes.
     CacheLibTTL(size_t const capacity_bytes, double const shards_sampling_ratio)
@@ -253,6 +253,19 @@ private:
         return true;
     }
 
+    uint64_t
+    memory_usage() const override final
+    {
+        uint64_t bytes = Accurate::memory_usage() +
+                         ::memory_usage(lifetime_thresholds_) +
+                         ::memory_usage(lfu_cache_) +
+                         ::memory_usage(ttl_cache_);
+        for (auto const &[frq, keys] : lfu_cache_) {
+            bytes += keys.memory_usage();
+        }
+        return bytes;
+    }
+
 public:
     /// @param  capacity: size_t - The capacity of the cache in bytes.
     LFU_TTL_Cache(size_t const capacity_bytes,
@@ -267,8 +280,11 @@ public:
         ok(true);
         assert(size_bytes_ == statistics_.size_);
         statistics_.time(access.timestamp_ms);
-        remove_accessed_if_expired(access);
+        // NOTE We remove the expired objects first (like 'Accurate'),
+        //      otherwise an expired accessed object would be removed
+        //      lazily, which we do not handle.
         remove_expired(access);
+        remove_accessed_if_expired(access);
         if (map_.count(access.key)) {
             hit(access);
         } else {
@@ -297,6 +313,10 @@ public:
             {"Statistics", statistics_.json()},
             {"Lifetime Thresholds", map2str(lifetime_thresholds_, lambda)},
             {"Extras", map2str(extras)},
+            {"Live Memory [B]",
+             val2str(format_memory_size(memory_.live_bytes))},
+            {"Peak Memory [B]",
+             val2str(format_memory_size(memory_.peak_bytes))},
         });
     }
 
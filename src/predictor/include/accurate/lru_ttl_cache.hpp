@@ -6,9 +6,11 @@
 #include "cpp_lib/format_measurement.hpp"
 #include "cpp_lib/util.hpp"
 #include "cpp_struct/hash_list.hpp"
+#include "cpp_struct/memory_usage.hpp"
 #include "lib/eviction_cause.hpp"
 #include "lib/lifetime_thresholds.hpp"
 #include "logger/logger.h"
+#include "memory/memory_footprint.h"
 #include "shards/fixed_rate_shards_sampler.h"
 #include <cassert>
 #include <cmath>
@@ -247,6 +249,9 @@ private:
             return false;
         }
         insert(access);
+        // NOTE The memory only grows upon an insertion, so this is
+        //      enough to track the peak.
+        MemoryFootprint__update(&memory_, memory_usage());
         return true;
     }
 
@@ -268,6 +273,7 @@ public:
     void
     end_simulation()
     {
+        MemoryFootprint__update(&memory_, memory_usage());
         statistics_.end_simulation();
     }
 
@@ -319,6 +325,15 @@ public:
         return statistics_;
     }
 
+    /// @brief  Get the number of bytes that the cache's metadata owns on
+    ///         the heap.
+    uint64_t
+    memory_usage() const
+    {
+        return ::memory_usage(map_) + lfu_cache_.memory_usage() +
+               ::memory_usage(ttl_queue_);
+    }
+
     void
     print() const
     {
@@ -352,6 +367,10 @@ public:
            << format_engineering(statistics_.update_ops_)
            << ", \"Miss Ratio\": " << statistics_.miss_ratio()
            << ", \"Lifetime Thresholds\": " << lifetime_thresholds_.json()
+           << ", \"Live Memory [B]\": "
+           << format_memory_size(memory_.live_bytes)
+           << ", \"Peak Memory [B]\": "
+           << format_memory_size(memory_.peak_bytes)
            << ", \"Statistics\": " << statistics_.json() << "}";
         return ss.str();
     }
@@ -377,4 +396,5 @@ private:
     CacheStatistics statistics_;
 
     LifeTimeThresholds lifetime_thresholds_;
+    MemoryFootprint memory_ = {0, 0};
 };
@@ -209,6 +209,13 @@ public:
         return keys_.size();
     }
 
+    /// @brief  Get the number of bytes that this owns on the heap.
+    uint64_t
+    memory_usage() const
+    {
+        return ::memory_usage(keys_) + ::memory_usage(ttl_queue_);
+    }
+
     std::string
     stats() const
     {
@@ -434,6 +441,18 @@ private:
         }
     }
 
+    uint64_t
+    memory_usage() const override final
+    {
+        uint64_t bytes = Accurate::memory_usage() + ::memory_usage(schedule_) +
+                         ::memory_usage(slab_classes_) +
+                         ::memory_usage(stats_);
+        for (auto const &cls : slab_classes_) {
+            bytes += cls.memory_usage();
+        }
+        return bytes;
+    }
+
 public:
     /// @param  capacity: size_t - The capacity of the cache in bytes.
     MemcachedTTL(uint64_t const capacity_bytes,
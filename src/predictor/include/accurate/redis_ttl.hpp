@@ -284,6 +284,13 @@ public:
         return rand_frq_.json();
     }
 
+    /// @brief  Get the number of bytes that this owns on the heap.
+    uint64_t
+    memory_usage() const
+    {
+        return ::memory_usage(table_);
+    }
+
 private:
     uint64_t size_ = 0;
     std::vector<std::pair<uint64_t, Validity>> table_;
@@ -459,6 +466,13 @@ private:
         statistics_.update_custom_metric(f, size_bytes_);
     }
 
+    uint64_t
+    memory_usage() const override final
+    {
+        return Accurate::memory_usage() + redis_sampler_.memory_usage() +
+               ::memory_usage(ttl_queue_);
+    }
+
 public:
     RedisTTL(uint64_t const capacity_bytes, double const shards_sampling_ratio)
         : Accurate{capacity_bytes, shards_sampling_ratio},
@@ -1,6 +1,7 @@
 /// TODO
 /// 1. Test with real trace (how to get TTLs?)
 /// 2. How to count miscounts?
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
@@ -21,10 +22,12 @@
 #include "cpp_lib/cache_access.hpp"
 #include "cpp_lib/cache_trace_format.hpp"
 #include "cpp_lib/format_measurement.hpp"
-#include "cpp_lib/progress_bar.hpp"
 #include "cpp_lib/util.hpp"
 #include "lib/predictive_lfu_ttl_cache.hpp"
 #include "logger/logger.h"
+#include "memory/memory_placement.h"
+#include "profiler/profiler.h"
+#include "telemetry/telemetry.h"
 
 #include "cpp_lib/cache_trace.hpp"
 #include "lib/predictive_lru_ttl_cache.hpp"
@@ -41,9 +44,13 @@ run_single_cache(std::promise<std::string> ret,
                  size_t const capacity_bytes,
                  double const lower_ratio,
                  double const upper_ratio,
-                 double const shards_ratio,
-                 bool const show_progress)
+                 double const shards_ratio)
 {
+    // NOTE We pin the thread before we allocate the simulator, so that
+    //      its state is on the thread's NUMA node (if so configured).
+    if (!MemoryPlacement__pin_worker(id)) {
+        LOGGER_WARN("failed to pin worker %d", id);
+    }
     P p(capacity_bytes * shards_ratio,
         lower_ratio,
         upper_ratio,
@@ -59,18 +66,36 @@ run_single_cache(std::promise<std::string> ret,
                   lower_ratio,
                   upper_ratio,
                   shards_ratio);
-    ProgressBar pbar{trace.size(), show_progress && id == 0};
+    TelemetryProgress progress{};
+    TelemetryProgress__init(
+        &progress,
+        ("predictor[" + std::to_string(id) + "]").c_str(),
+        trace.size());
     p.start_simulation();
-    for (size_t i = 0; i < trace.size(); ++i) {
-        pbar.tick();
-        auto const &access = trace.get_wait(i);
-        if (!sampler.sample(access.key)) {
-            continue;
-        }
-        if (access.is_read()) {
-            p.access(access);
+    for (size_t begin = 0; begin < trace.size();
+         begin += TELEMETRY_CHUNK_SIZE) {
+        size_t const end = std::min(begin + TELEMETRY_CHUNK_SIZE, trace.size());
+        for (size_t i = begin; i < end; ++i) {
+            auto const &access = trace.get_wait(i);
+            Profiler__tick();
+            uint64_t const sampler_start = Profiler__start();
+            bool const sampled = sampler.sample(access.key);
+            Profiler__stop(PROFILER_SCOPE_SAMPLER, sampler_start);
+            if (!sampled) {
+                continue;
+            }
+            if (access.is_read()) {
+                uint64_t const access_start = Profiler__start();
+                p.access(access);
+                Profiler__stop(PROFILER_SCOPE_ACCESS, access_start);
+            }
         }
+        TelemetryProgress__update(&progress,
+                                  end,
+                                  shards_ratio,
+                                  1.0 - p.statistics().miss_ratio());
     }
+    TelemetryProgress__destroy(&progress);
     p.end_simulation();
     LOGGER_TIMING("finished test_trace(trace: %s, cap: %zu, lt: %f, ut: "
                   "%f, shards: %f)",
@@ -102,8 +127,7 @@ run_caches(std::string const &path,
            std::vector<uint64_t> const &capacity_bytes,
            double const lower_ratio,
            double const upper_ratio,
-           double const shards_ratio,
-           bool const show_progress)
+           double const shards_ratio)
 {
     CacheAccessTrace trace{path, format, capacity_bytes.size()};
     std::vector<std::thread> workers;
@@ -120,8 +144,7 @@ run_caches(std::string const &path,
                              c,
                              lower_ratio,
                              upper_ratio,
-                             shards_ratio,
-                             show_progress);
+                             shards_ratio);
     }
     for (auto &w : workers) {
         w.join();
@@ -147,6 +170,11 @@ main(int argc, char *argv[])
         exit(1);
     }
 
+    if (!Profiler__enable_from_env() || !Telemetry__start_from_env() ||
+        !MemoryPlacement__configure_from_env()) {
+        exit(1);
+    }
+
     std::string const path{argv[1]};
     CacheTraceFormat const format{CacheTraceFormat__parse(argv[2])};
     double const lower_ratio{atof(argv[3])};
@@ -155,7 +183,6 @@ main(int argc, char *argv[])
     std::vector<uint64_t> capacity_bytes{parse_capacities(argv[5])};
     double const shards_ratio{atof(argv[6])};
     std::string const policy{argv[7]};
-    bool const show_progress{false};
     LOGGER_INFO("Running: %s %s with %s",
                 path.c_str(),
                 CacheTraceFormat__string(format).c_str(),
@@ -166,20 +193,20 @@ main(int argc, char *argv[])
                                     capacity_bytes,
                                     lower_ratio,
                                     upper_ratio,
-                                    shards_ratio,
-                                    show_progress);
+                                    shards_ratio);
     } else if (policy == "lfu") {
         run_caches<PredictiveLFUCache>(path,
                                        format,
                                        capacity_bytes,
                                        lower_ratio,
                                        upper_ratio,
-                                       shards_ratio,
-                                       show_progress);
+                                       shards_ratio);
     } else {
         LOGGER_ERROR("Unrecognized policy: '%s'", policy.c_str());
+        Telemetry__stop();
         return EXIT_FAILURE;
     }
+    Telemetry__stop();
     std::cout << "OK!" << std::endl;
     return 0;
 }
@@ -0,0 +1,30 @@
+#include "accurate/lfu_ttl_cache.hpp"
+#include "cpp_lib/cache_access.hpp"
+
+/// @brief  Reaccess an object after it expires.
+bool
+test_reaccess_expired()
+{
+    LFU_TTL_Cache p(2, /*shards_sampling_ratio=*/1.0);
+    CacheAccess accesses[] = {CacheAccess{0, 0, 1, 1},
+                              CacheAccess{1001, 0, 1, 10}};
+    // Test first state.
+    p.access(accesses[0]);
+    assert(p.get(0) != nullptr);
+    assert(p.statistics().resident_objs_ == 1);
+    // Test second state. The expired object is removed proactively and
+    // then reinserted as a miss.
+    p.access(accesses[1]);
+    assert(p.get(0) != nullptr);
+    assert(p.statistics().resident_objs_ == 1);
+    assert(p.statistics().ttl_expire_.ops() == 1);
+    assert(p.statistics().miss_ops_ == 2);
+    return true;
+}
+
+int
+main()
+{
+    test_reaccess_expired();
+    return 0;
+}
@@ -0,0 +1,104 @@
+/** @brief  Instantiate the batch access function of each algorithm.
+ *
+ *  Each algorithm's traits name its access functions at compile time, so
+ *  the compiler calls them directly rather than through a pointer.
+ */
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "counter_stacks/counter_stacks.h"
+#include "evicting_map/evicting_map.h"
+#include "evicting_quickmrc/evicting_quickmrc.h"
+#include "olken/olken.h"
+#include "shards/fixed_rate_shards.h"
+#include "shards/fixed_size_shards.h"
+#include "shards/fused_fixed_size_shards.h"
+}
+
+#include "run/batch_runner.h"
+#include "run/runner_arguments.h"
+
+static_assert(std::same_as<EntryType, uint64_t>,
+              "the runner passes the trace's keys as entries");
+
+/// @brief  The access functions of an algorithm's instance type.
+/// @note   Specializations may add a batch function named 'access_batch'.
+template <typename T> struct AlgorithmTraits;
+
+template <> struct AlgorithmTraits<Olken> {
+    static constexpr auto access = Olken__access_item;
+    static constexpr auto access_batch = Olken__access_batch;
+};
+
+template <> struct AlgorithmTraits<FixedRateShards> {
+    static constexpr auto access = FixedRateShards__access_item;
+    static constexpr auto access_batch = FixedRateShards__access_batch;
+};
+
+template <> struct AlgorithmTraits<FixedSizeShards> {
+    static constexpr auto access = FixedSizeShards__access_item;
+};
+
+template <> struct AlgorithmTraits<FusedFixedSizeShards> {
+    static constexpr auto access = FusedFixedSizeShards__access_item;
+};
+
+template <> struct AlgorithmTraits<EvictingMap> {
+    static constexpr auto access = EvictingMap__access_item;
+};
+
+template <> struct AlgorithmTraits<EvictingQuickMRC> {
+    static constexpr auto access = EvictingQuickMRC__access_item;
+};
+
+template <> struct AlgorithmTraits<CounterStacks> {
+    static constexpr auto access = CounterStacks__access_item;
+};
+
+template <typename T>
+concept HasAccessBatch =
+    requires(T *const me, EntryType const *const keys, size_t n) {
+        { AlgorithmTraits<T>::access_batch(me, keys, n) } -> std::same_as<bool>;
+    };
+
+template <typename T>
+static bool
+access_batch(void *const me, uint64_t const *const keys, size_t const n)
+{
+    T *const algorithm = static_cast<T *>(me);
+    if constexpr (HasAccessBatch<T>) {
+        return AlgorithmTraits<T>::access_batch(algorithm, keys, n);
+    } else {
+        // NOTE Like the unbatched loop, we do not stop on a failed
+        //      access.
+        for (size_t i = 0; i < n; ++i) {
+            AlgorithmTraits<T>::access(algorithm, keys[i]);
+        }
+        return true;
+    }
+}
+
+extern "C" BatchAccessFunction
+get_batch_access_function(enum MRCAlgorithm const algorithm)
+{
+    switch (algorithm) {
+    case MRC_ALGORITHM_OLKEN:
+        return access_batch<Olken>;
+    case MRC_ALGORITHM_FIXED_RATE_SHARDS:
+        return access_batch<FixedRateShards>;
+    case MRC_ALGORITHM_FIXED_SIZE_SHARDS:
+        return access_batch<FixedSizeShards>;
+    case MRC_ALGORITHM_FUSED_FIXED_SIZE_SHARDS:
+        return access_batch<FusedFixedSizeShards>;
+    case MRC_ALGORITHM_EVICTING_MAP:
+        return access_batch<EvictingMap>;
+    case MRC_ALGORITHM_EVICTING_QUICKMRC:
+        return access_batch<EvictingQuickMRC>;
+    case MRC_ALGORITHM_COUNTER_STACKS:
+        return access_batch<CounterStacks>;
+    default:
+        return nullptr;
+    }
+}
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -13,16 +14,22 @@
 #include "arrays/array_size.h"
 #include "file/file.h"
 #include "glib.h"
+#include "hash/hash.h"
+#include "hyperloglog/hyperloglog_plus_plus.h"
 #include "logger/logger.h"
 #include "lookup/dictionary.h"
 #include "lookup/lookup.h"
+#include "memory/memory_placement.h"
 #include "miss_rate_curve/miss_rate_curve.h"
+#include "profiler/profiler.h"
+#include "telemetry/telemetry.h"
 #include "timer/timer.h"
 #include "trace/generator.h"
 #include "trace/reader.h"
 #include "trace/trace.h"
 
 #include "run/helper.h"
+#include "run/memory_estimator.h"
 #include "run/run_oracle.h"
 #include "run/runner_arguments.h"
 #include "run/trace_runner.h"
@@ -57,6 +64,16 @@ struct CommandLineArguments {
     // NOTE The 'gboolean' and 'bool' sizes are different so if these
     //      are regular 'bool', then they can get clobbered!
     gboolean cleanup;
+
+    // NOTE The profiler is also enabled by the 'MRC_PROFILE' environment
+    //      variable. These arguments take precedence.
+    gchar *profile_path;
+    uint64_t profile_period;
+
+    // NOTE The telemetry is also enabled by the 'MRC_TELEMETRY'
+    //      environment variable. These arguments take precedence.
+    gchar *telemetry_path;
+    uint64_t telemetry_interval_ms;
 };
 
 /// @note   This should be a static check, but I do it dynamically
@@ -122,7 +139,11 @@ parse_command_line_arguments(int argc, char *argv[])
                                         .artificial_trace_length = 1 << 20,
                                         .run = NULL,
                                         .oracle = NULL,
-                                        .cleanup = FALSE};
+                                        .cleanup = FALSE,
+                                        .profile_path = NULL,
+                                        .profile_period = 1024,
+                                        .telemetry_path = NULL,
+                                        .telemetry_interval_ms = 1000};
     gchar *trace_format = NULL;
 
     // Command line options.
@@ -177,6 +198,34 @@ parse_command_line_arguments(int argc, char *argv[])
          &args.cleanup,
          "cleanup generated files afterward",
          NULL},
+        {"profile",
+         0,
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.profile_path,
+         "path to the profile (CSV if it ends in '.csv', otherwise JSON)",
+         NULL},
+        {"profile-period",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &args.profile_period,
+         "profile 1 in this many accesses. Default: 1024",
+         NULL},
+        {"telemetry",
+         0,
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.telemetry_path,
+         "path to the live status file (or 'unix:<path>' for a socket)",
+         NULL},
+        {"telemetry-interval",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &args.telemetry_interval_ms,
+         "milliseconds between status records. Default: 1000",
+         NULL},
         G_OPTION_ENTRY_NULL,
     };
 
@@ -224,6 +273,18 @@ parse_command_line_arguments(int argc, char *argv[])
         LOGGER_ERROR("expected at least some work!");
         goto cleanup;
     }
+    // NOTE GLib parses these as signed integers, so a negative value
+    //      would otherwise wrap around to a huge unsigned one.
+    if ((int64_t)args.profile_period <= 0) {
+        LOGGER_ERROR("profile period must be positive, not %" PRId64,
+                     (int64_t)args.profile_period);
+        goto cleanup;
+    }
+    if ((int64_t)args.telemetry_interval_ms <= 0) {
+        LOGGER_ERROR("telemetry interval must be positive, not %" PRId64,
+                     (int64_t)args.telemetry_interval_ms);
+        goto cleanup;
+    }
 
     g_option_context_free(context);
     return args;
@@ -243,6 +304,8 @@ free_command_line_arguments(struct CommandLineArguments *const args)
 {
     g_free(args->input_path);
     g_free(args->oracle);
+    g_free(args->profile_path);
+    g_free(args->telemetry_path);
     if (args->run) {
         for (size_t i = 0; args->run[i] != NULL; ++i) {
             g_free(args->run[i]);
@@ -294,7 +357,7 @@ print_trace_summary(struct CommandLineArguments const *args,
 ///         also maintain the constant-qualification of the members of struct
 ///         Trace.
 static struct Trace
-get_trace(struct CommandLineArguments args)
+get_trace(struct CommandLineArguments args, bool const with_timestamps)
 {
     if (strcmp(args.input_path, "zipf") == 0) {
         LOGGER_TRACE("Generating artificial Zipfian trace");
@@ -317,6 +380,10 @@ get_trace(struct CommandLineArguments args)
                                                    10);
     } else {
         LOGGER_TRACE("Reading trace from '%s'", args.input_path);
+        if (with_timestamps) {
+            return read_trace_keys_and_timestamps(args.input_path,
+                                                  args.trace_format);
+        }
         return read_trace_keys(args.input_path, args.trace_format);
     }
 }
@@ -531,9 +598,80 @@ run_cleanup(struct RunnerArguments const *const args)
     if (args->mrc_path != NULL && remove(args->mrc_path) != 0) {
         LOGGER_WARN("failed to remove '%s'", args->mrc_path);
     }
+    if (args->snapshot_path != NULL && remove(args->snapshot_path) != 0) {
+        LOGGER_WARN("failed to remove '%s'", args->snapshot_path);
+    }
     return true;
 }
 
+/// @brief  Log the predicted peak memory of each run before we start.
+/// @note   We estimate the number of unique keys with a HyperLogLog so
+///         that this takes one cheap pass over the trace.
+static void
+print_memory_estimates(struct RunnerArgumentsArray const *const work,
+                       struct Trace const *const trace)
+{
+    struct HyperLogLogPlusPlus hll = {0};
+    if (!HyperLogLogPlusPlus__init(&hll, 14)) {
+        LOGGER_WARN("failed to initialize HyperLogLog");
+        return;
+    }
+    for (size_t i = 0; i < trace->length; ++i) {
+        HyperLogLogPlusPlus__add_hash(&hll, Hash64Bit(trace->trace[i].key));
+    }
+    size_t const num_unique = HyperLogLogPlusPlus__count(&hll);
+    HyperLogLogPlusPlus__destroy(&hll);
+
+    LOGGER_INFO("estimated %zu unique keys", num_unique);
+    // NOTE The memory-conserving oracle has already run by now.
+    if (work->oracle_arg != NULL &&
+        work->oracle_arg->algorithm == MRC_ALGORITHM_OLKEN) {
+        LOGGER_INFO("%s -- Estimated Peak Memory: %zu B",
+                    algorithm_names[work->oracle_arg->algorithm],
+                    estimate_peak_memory(work->oracle_arg,
+                                         trace->length,
+                                         num_unique));
+    }
+    for (size_t i = 0; i < work->length; ++i) {
+        size_t const bytes =
+            estimate_peak_memory(&work->data[i], trace->length, num_unique);
+        if (bytes == 0) {
+            continue;
+        }
+        LOGGER_INFO("%s -- Estimated Peak Memory: %zu B",
+                    algorithm_names[work->data[i].algorithm],
+                    bytes);
+    }
+}
+
+/// @brief  Whether to run the TTL-oblivious and TTL-aware oracles in
+///         the same pass over the trace.
+static bool
+oracles_share_pass(struct RunnerArgumentsArray const *const work)
+{
+    return work->oracle_arg != NULL &&
+           work->oracle_arg->algorithm == MRC_ALGORITHM_ORACLE &&
+           work->ttl_oracle_arg != NULL;
+}
+
+/// @brief  Whether any run takes MRC snapshots by trace time, in which
+///         case we must read the timestamps too.
+static bool
+needs_timestamps(struct RunnerArgumentsArray const *const work)
+{
+    if (work->oracle_arg != NULL &&
+        work->oracle_arg->algorithm == MRC_ALGORITHM_OLKEN &&
+        work->oracle_arg->snapshot_interval_ms != 0) {
+        return true;
+    }
+    for (size_t i = 0; i < work->length; ++i) {
+        if (work->data[i].snapshot_interval_ms != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /// @brief  Run the non-TTL-aware uniform block-size simulators.
 static bool
 run_simple_simulation(struct CommandLineArguments args,
@@ -546,14 +684,19 @@ run_simple_simulation(struct CommandLineArguments args,
     // NOTE This may appear to be identical to the Olken runner below,
     //      but this runs the (probably... but I never benchmarked)
     //      slower (but less memory-intensive) oracle runner.
-    if (work.oracle_arg != NULL &&
-        work.oracle_arg->algorithm == MRC_ALGORITHM_ORACLE) {
+    if (oracles_share_pass(&work)) {
+        run_oracles(args.input_path,
+                    args.trace_format,
+                    work.oracle_arg,
+                    work.ttl_oracle_arg);
+    } else if (work.oracle_arg != NULL &&
+               work.oracle_arg->algorithm == MRC_ALGORITHM_ORACLE) {
         run_oracle(args.input_path, args.trace_format, work.oracle_arg);
     }
 
     // Read in trace. This can be a very slow process.
     double const t0 = get_wall_time_sec();
-    struct Trace trace = get_trace(args);
+    struct Trace trace = get_trace(args, needs_timestamps(&work));
     double const t1 = get_wall_time_sec();
     LOGGER_INFO("Trace Read Time: %f sec", t1 - t0);
     if (trace.trace == NULL || trace.length == 0) {
@@ -564,6 +707,7 @@ run_simple_simulation(struct CommandLineArguments args,
         goto cleanup;
     }
     print_trace_summary(&args, &trace);
+    print_memory_estimates(&work, &trace);
 
     // NOTE This may appear to be identical to the oracle runner above,
     //      but this runs the (probably... but I never benchmarked)
@@ -648,7 +792,9 @@ run_ttl_simulation(struct CommandLineArguments args,
     // indicate we didn't succeed.
     bool ok = true;
 
-    if (work.ttl_oracle_arg != NULL &&
+    // NOTE If we ran the TTL-aware oracle alongside the TTL-oblivious
+    //      oracle, then we do not need to run it again.
+    if (work.ttl_oracle_arg != NULL && !oracles_share_pass(&work) &&
         (work.ttl_oracle_arg->algorithm == MRC_ALGORITHM_ORACLE ||
          work.ttl_oracle_arg->algorithm == MRC_ALGORITHM_OLKEN)) {
         run_oracle_with_ttl(args.input_path,
@@ -677,6 +823,26 @@ main(int argc, char **argv)
     struct CommandLineArguments args = {0};
     args = parse_command_line_arguments(argc, argv);
     print_command_line_arguments(&args);
+    if (args.profile_path != NULL
+            ? !Profiler__enable(args.profile_path, args.profile_period)
+            : !Profiler__enable_from_env()) {
+        LOGGER_ERROR("failed to enable the profiler");
+        free_command_line_arguments(&args);
+        return EXIT_FAILURE;
+    }
+    if (args.telemetry_path != NULL
+            ? !Telemetry__start(args.telemetry_path,
+                                args.telemetry_interval_ms)
+            : !Telemetry__start_from_env()) {
+        LOGGER_ERROR("failed to start the telemetry");
+        free_command_line_arguments(&args);
+        return EXIT_FAILURE;
+    }
+    if (!MemoryPlacement__configure_from_env()) {
+        LOGGER_ERROR("failed to configure the memory placement");
+        free_command_line_arguments(&args);
+        return EXIT_FAILURE;
+    }
 
     // Parse work. This is above the trace reader because it should be
     // faster and thus a failure will fail faster.
@@ -700,6 +866,7 @@ main(int argc, char **argv)
         }
     }
 
+    Telemetry__stop();
     free_work_array(&work);
     free_command_line_arguments(&args);
     LOGGER_INFO("=== SUCCESS ===");
@@ -707,6 +874,7 @@ main(int argc, char **argv)
 cleanup_cmdln:
     free_command_line_arguments(&args);
 cleanup:
+    Telemetry__stop();
     free_work_array(&work);
     // NOTE I don't cleanup the memory because I count on the OS doing
     //      it and because some of the goto statements jump over
@@ -0,0 +1,336 @@
+/** @brief  Generate a synthetic trace in Kia's or Sari's format.
+ *
+ *  @example
+ *  ```bash
+ *  # Generate 100M accesses to 1M keys with Zipfian skew 0.99.
+ *  ./build/src/run/generate_trace_exe \
+ *      -o zipf.bin -f Kia -n 100000000 -k 1000000 -z 0.99 -t 8 \
+ *      --read-ratio 0.9 --size-distribution LogUniform \
+ *      --min-size 16 --max-size 65536
+ *  ```
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "logger/logger.h"
+#include "timer/timer.h"
+#include "trace/reader.h"
+#include "trace/workload_generator.h"
+
+struct CommandLineArguments {
+    char *executable;
+    gchar *output_path;
+    struct WorkloadConfig config;
+    gint num_threads;
+};
+
+static bool
+parse_distribution(char const *const name,
+                   gchar const *const str,
+                   enum WorkloadDistribution *const dist)
+{
+    if (str == NULL) {
+        // NOTE If 'str' is NULL, then we remain with the default.
+        return true;
+    }
+    *dist = parse_workload_distribution_string(str);
+    if (*dist == WORKLOAD_DISTRIBUTION_INVALID) {
+        LOGGER_ERROR("invalid %s distribution '%s'", name, str);
+        return false;
+    }
+    return true;
+}
+
+/// @note   Adapted from '//src/analysis/text/print_trace.c'.
+static struct CommandLineArguments
+parse_command_line_arguments(int argc, char *argv[])
+{
+    gchar *help_msg = NULL;
+    gchar *trace_format = NULL;
+    gchar *size_distribution = NULL;
+    gchar *ttl_distribution = NULL;
+    gint64 length = 1000000;
+    gint64 num_keys = 1000;
+    gint64 block_length = WORKLOAD_DEFAULT_BLOCK_LENGTH;
+    gint64 seed = 0;
+    gint64 min_size = 1, max_size = 1;
+    gint64 min_ttl_s = 0, max_ttl_s = 0;
+    gint64 reuse_window = 0;
+    gint64 drift_period = 0, drift_step = 0;
+    gint64 start_time_ms = 0;
+    gdouble zipf_skew = 0.99;
+    gdouble read_ratio = 1.0;
+    gdouble reuse_probability = 0.0;
+    gdouble accesses_per_second = 1000.0;
+
+    // Set defaults.
+    struct CommandLineArguments args = {.executable = argv[0],
+                                        .output_path = NULL,
+                                        .num_threads = 1};
+
+    // Command line options.
+    GOptionEntry entries[] = {
+        {"output",
+         'o',
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.output_path,
+         "path to the output trace",
+         NULL},
+        {"format",
+         'f',
+         0,
+         G_OPTION_ARG_STRING,
+         &trace_format,
+         "format of the output trace. Options: {Kia,Sari}. Default: Kia.",
+         NULL},
+        {"length",
+         'n',
+         0,
+         G_OPTION_ARG_INT64,
+         &length,
+         "number of accesses. Default: 1000000.",
+         NULL},
+        {"keys",
+         'k',
+         0,
+         G_OPTION_ARG_INT64,
+         &num_keys,
+         "number of distinct keys. Default: 1000.",
+         NULL},
+        {"skew",
+         'z',
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &zipf_skew,
+         "Zipfian skew of the keys' popularity. Default: 0.99.",
+         NULL},
+        {"seed",
+         's',
+         0,
+         G_OPTION_ARG_INT64,
+         &seed,
+         "random seed. Default: 0.",
+         NULL},
+        {"threads",
+         't',
+         0,
+         G_OPTION_ARG_INT,
+         &args.num_threads,
+         "number of threads. The output does not depend on this. Default: 1.",
+         NULL},
+        {"block-length",
+         'b',
+         0,
+         G_OPTION_ARG_INT64,
+         &block_length,
+         "number of accesses per independently seeded block. Default: 65536.",
+         NULL},
+        {"read-ratio",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &read_ratio,
+         "fraction of GET requests. Default: 1.0.",
+         NULL},
+        {"size-distribution",
+         0,
+         0,
+         G_OPTION_ARG_STRING,
+         &size_distribution,
+         "distribution of object sizes. Options: {Constant,Uniform,"
+         "LogUniform}. Default: Constant.",
+         NULL},
+        {"min-size",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &min_size,
+         "minimum object size [B]. Default: 1.",
+         NULL},
+        {"max-size",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &max_size,
+         "maximum object size [B]. Default: 1.",
+         NULL},
+        {"ttl-distribution",
+         0,
+         0,
+         G_OPTION_ARG_STRING,
+         &ttl_distribution,
+         "distribution of TTLs. Options: {Constant,Uniform,LogUniform}. "
+         "Default: Constant.",
+         NULL},
+        {"min-ttl",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &min_ttl_s,
+         "minimum TTL [s]. Default: 0 (i.e. no TTL).",
+         NULL},
+        {"max-ttl",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &max_ttl_s,
+         "maximum TTL [s]. Default: 0.",
+         NULL},
+        {"reuse-probability",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &reuse_probability,
+         "probability of re-referencing a recent key. Default: 0.",
+         NULL},
+        {"reuse-window",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &reuse_window,
+         "number of recent keys that we may re-reference. Default: 0.",
+         NULL},
+        {"drift-period",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &drift_period,
+         "number of accesses between shifts in popularity. Default: 0 "
+         "(i.e. static popularity).",
+         NULL},
+        {"drift-step",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &drift_step,
+         "number of ranks to shift the popularity by. Default: 0.",
+         NULL},
+        {"start-time",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &start_time_ms,
+         "timestamp of the first access [ms]. Default: 0.",
+         NULL},
+        {"rate",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &accesses_per_second,
+         "accesses per second. Default: 1000.",
+         NULL},
+        G_OPTION_ENTRY_NULL,
+    };
+
+    GError *error = NULL;
+    GOptionContext *context;
+    context = g_option_context_new("- generate a synthetic trace");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        goto cleanup;
+    }
+    // Come on, GLib! The 'g_option_context_parse' changes the errno to
+    // 2 and leaves it for me to clean up. Or maybe I'm using it wrong.
+    errno = 0;
+
+    // Check the arguments for correctness.
+    if (args.output_path == NULL) {
+        LOGGER_ERROR("must specify the output path");
+        goto cleanup;
+    }
+    enum TraceFormat format = TRACE_FORMAT_KIA;
+    if (trace_format != NULL) {
+        format = parse_trace_format_string(trace_format);
+        if (format == TRACE_FORMAT_INVALID) {
+            LOGGER_ERROR("invalid trace format '%s'", trace_format);
+            goto cleanup;
+        }
+    }
+    if (length <= 0 || num_keys <= 0 || block_length <= 0 ||
+        args.num_threads <= 0) {
+        LOGGER_ERROR("length, keys, block length, and threads must be "
+                     "positive");
+        goto cleanup;
+    }
+    if (min_size < 0 || max_size > UINT32_MAX || min_ttl_s < 0 ||
+        max_ttl_s > UINT32_MAX || reuse_window < 0 || drift_period < 0 ||
+        drift_step < 0 || start_time_ms < 0) {
+        LOGGER_ERROR("sizes and TTLs must fit in a u32 and the remaining "
+                     "parameters must be non-negative");
+        goto cleanup;
+    }
+    if (!WorkloadConfig__init(&args.config,
+                              format,
+                              length,
+                              num_keys,
+                              zipf_skew,
+                              seed)) {
+        LOGGER_ERROR("invalid workload");
+        goto cleanup;
+    }
+    args.config.block_length = block_length;
+    args.config.read_ratio = read_ratio;
+    args.config.min_size = min_size;
+    args.config.max_size = max_size;
+    args.config.min_ttl_s = min_ttl_s;
+    args.config.max_ttl_s = max_ttl_s;
+    args.config.reuse_probability = reuse_probability;
+    args.config.reuse_window = reuse_window;
+    args.config.drift_period = drift_period;
+    args.config.drift_step = drift_step;
+    args.config.start_time_ms = start_time_ms;
+    args.config.accesses_per_second = accesses_per_second;
+    if (!parse_distribution("size",
+                            size_distribution,
+                            &args.config.size_distribution) ||
+        !parse_distribution("ttl",
+                            ttl_distribution,
+                            &args.config.ttl_distribution) ||
+        !WorkloadConfig__validate(&args.config)) {
+        LOGGER_ERROR("invalid workload");
+        goto cleanup;
+    }
+
+    g_free(trace_format);
+    g_free(size_distribution);
+    g_free(ttl_distribution);
+    g_option_context_free(context);
+    return args;
+cleanup:
+    help_msg = g_option_context_get_help(context, FALSE, NULL);
+    g_print("%s", help_msg);
+    free(help_msg);
+    g_option_context_free(context);
+    exit(-1);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct CommandLineArguments args = parse_command_line_arguments(argc, argv);
+    WorkloadConfig__write_as_json(stdout, &args.config);
+
+    double const t0 = get_wall_time_sec();
+    if (!write_workload(&args.config, args.output_path, args.num_threads)) {
+        LOGGER_ERROR("failed to generate '%s'", args.output_path);
+        return EXIT_FAILURE;
+    }
+    double const t1 = get_wall_time_sec();
+    double const num_bytes = (double)args.config.length *
+                             get_bytes_per_trace_item(args.config.format);
+    LOGGER_INFO("wrote %zu accesses (%g GB) to '%s' in %g s (%g GB/s)",
+                args.config.length,
+                num_bytes / 1e9,
+                args.output_path,
+                t1 - t0,
+                num_bytes / 1e9 / (t1 - t0));
+    g_free(args.output_path);
+    return EXIT_SUCCESS;
+}
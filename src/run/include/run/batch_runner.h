@@ -0,0 +1,36 @@
+/** @brief  Statically dispatched batches of accesses for the trace runner.
+ *
+ *  The generic trace runner calls each algorithm through a function
+ *  pointer per access. Instead, we instantiate a C++ template for each
+ *  algorithm type, so the runner makes one indirect call per chunk of
+ *  the trace and the algorithm sees the whole chunk. Algorithms with a
+ *  batch entry point (e.g. 'FixedRateShards__access_batch') amortize
+ *  their per-call checks and overlap independent work within a batch;
+ *  the others get a direct call per access.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "run/runner_arguments.h"
+
+/// @brief  Access the keys in order.
+/// @param  me: the algorithm's instance.
+typedef bool (*BatchAccessFunction)(void *const me,
+                                    uint64_t const *const keys,
+                                    size_t const num_keys);
+
+/// @brief  Get the batch access function for an algorithm's instance type.
+/// @return the function or NULL if the algorithm has none.
+BatchAccessFunction
+get_batch_access_function(enum MRCAlgorithm const algorithm);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
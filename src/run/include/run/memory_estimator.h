@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+
+#include "run/runner_arguments.h"
+
+/// @brief  Predict the peak bytes of an algorithm's data structures
+///         before running it.
+/// @param  trace_length: the number of accesses in the trace.
+/// @param  num_unique: the number of unique keys in the trace (e.g. as
+///                     estimated by a HyperLogLog).
+/// @return the estimate or 0 if we do not know how to estimate the
+///         algorithm.
+/// @note   This mirrors the allocation policies of the data structures,
+///         so it must be updated if they change.
+size_t
+estimate_peak_memory(struct RunnerArguments const *const args,
+                     size_t const trace_length,
+                     size_t const num_unique);
@@ -18,6 +18,10 @@
 ///             -- may be up to twice as many values as the WSS.
 ///         5. MRC
 ///         where WSS is the (expected?) working set size.
+/// @note   Use the dictionary parameter 'shards={fixed-rate,fixed-size}'
+///         to sample the oracle with SHARDS (with the usual 'sampling'
+///         and 'max_size' parameters), e.g.
+///         "Oracle(mrc=a.bin,shards=fixed-size,sampling=1e-3,max_size=1024)".
 bool
 run_oracle(char const *const restrict trace_path,
            enum TraceFormat const format,
@@ -27,3 +31,14 @@ bool
 run_oracle_with_ttl(char const *const restrict trace_path,
                     enum TraceFormat const format,
                     struct RunnerArguments const *const args);
+
+/// @brief  Run the TTL-oblivious and TTL-aware oracles in a single,
+///         streaming pass over the trace.
+/// @param  args: the arguments of the TTL-oblivious oracle or NULL.
+/// @param  ttl_args: the arguments of the TTL-aware oracle or NULL.
+/// @note   Each oracle may be sampled independently (see 'run_oracle').
+bool
+run_oracles(char const *const restrict trace_path,
+            enum TraceFormat const format,
+            struct RunnerArguments const *const args,
+            struct RunnerArguments const *const ttl_args);
@@ -7,6 +7,7 @@
 
 #include "histogram/histogram.h"
 #include "lookup/dictionary.h"
+#include "mrc_snapshot/mrc_snapshot.h"
 
 enum RunnerMode {
     RUNNER_MODE_INVALID,
@@ -33,6 +34,8 @@ enum MRCAlgorithm {
     MRC_ALGORITHM_EVICTING_QUICKMRC,
     MRC_ALGORITHM_AVERAGE_EVICTION_TIME,
     MRC_ALGORITHM_THEIR_AVERAGE_EVICTION_TIME,
+    MRC_ALGORITHM_COUNTER_STACKS,
+    MRC_ALGORITHM_FUSED_FIXED_SIZE_SHARDS,
 };
 
 /// @note   Importers will not be able to see the size of this array!
@@ -57,6 +60,13 @@ print_available_algorithms(FILE *stream);
 ///     - Size of histogram bins [optional. Default = 1]
 ///     - Histogram overflow strategy [optional. Default = reallocate]
 ///     - SHARDS adjustment [optional. Default = true for Fixed-Rate SHARDS]
+///     - Checkpoint path [optional. Default = no checkpoints]
+///     - Checkpoint interval [optional. Default = 0, i.e. only at the end]
+///     - MRC snapshot path [optional. Default = no snapshots]
+///     - MRC snapshot interval in accesses or in milliseconds of trace
+///       time [optional. Default = 0, i.e. only at the end]
+///     - MRC snapshot mode [optional. Default = cumulative]
+///     - MRC snapshot decay [optional. Default = 0.5]
 ///     The oracle contains:
 ///     - MRC path [both input/output]
 ///     - Histogram path [both input/output]
@@ -92,13 +102,32 @@ struct RunnerArguments {
     bool shards_adj;
     // The number of buckets allotted to the QuickMRC buffers.
     size_t qmrc_size;
+    // The path to save the algorithm's state to (and resume from).
+    char *checkpoint_path;
+    // The number of accesses between checkpoints. We always checkpoint
+    // at the end of the trace; zero means that we only do that.
+    size_t checkpoint_interval;
+    // The path to stream MRC snapshots to during the run.
+    char *snapshot_path;
+    // The number of accesses between snapshots...
+    size_t snapshot_interval;
+    // ... or the milliseconds of trace time between them. We allow at
+    // most one of these.
+    size_t snapshot_interval_ms;
+    enum MRCSnapshotMode snapshot_mode;
+    // How much we scale down the earlier windows at each snapshot in
+    // the decayed mode.
+    double snapshot_decay;
 
     struct Dictionary dictionary;
 };
 
 /// @brief  Parse an initialization string.
 /// @details    My arbitrary format is thus:
-///     "Algorithm(mrc=A,hist=B,sampling=C,num_bins=D,bin_size=E,mode=F,adj=G)"
+///     "Algorithm(mrc=A,hist=B,sampling=C,num_bins=D,bin_size=E,mode=F,adj=G,
+///                checkpoint=H,checkpoint_interval=I,snapshot=J,
+///                snapshot_interval=K,snapshot_interval_ms=L,
+///                snapshot_mode=M,snapshot_decay=N)"
 /// @note   I do not allow spaces in case they are weirdly tokenized by
 ///         the shell.
 /// @note   I do not follow the standard POSIX convention of arguments
@@ -1,9 +1,35 @@
 #pragma once
 #include <stdbool.h>
 
+#include "memory/memory_footprint.h"
+#include "miss_rate_curve/miss_rate_curve.h"
 #include "run/runner_arguments.h"
 #include "trace/trace.h"
 
+/// @brief  The measurements of a single run.
+struct RunnerResults {
+    // Whether the algorithm ran to completion. This is false if we
+    // skipped running to read existing files.
+    bool ok;
+    double histogram_time_sec;
+    double post_process_time_sec;
+    double mrc_time_sec;
+    double total_time_sec;
+    // The live (at the end) and peak bytes of the algorithm's data
+    // structures, sampled once per chunk of accesses.
+    struct MemoryFootprint memory;
+    // The resultant MRC. The caller owns this and must destroy it.
+    struct MissRateCurve mrc;
+};
+
 bool
 run_runner(struct RunnerArguments const *const args,
            struct Trace const *const trace);
+
+/// @brief  Run an algorithm and return its timing and MRC.
+/// @param  results: the measurements of the run or NULL to ignore them.
+///                  These are only written if the run succeeds.
+bool
+run_runner_with_results(struct RunnerArguments const *const args,
+                        struct Trace const *const trace,
+                        struct RunnerResults *const results);
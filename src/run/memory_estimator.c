@@ -0,0 +1,165 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "hash/types.h"
+#include "histogram/histogram.h"
+#include "lookup/dictionary.h"
+#include "lookup/evicting_hash_table.h"
+#include "priority_queue/heap.h"
+#include "shards/fused_fixed_size_shards.h"
+#include "tree/types.h"
+#include "types/value_type.h"
+
+#include "run/memory_estimator.h"
+#include "run/runner_arguments.h"
+
+// NOTE These mirror klib's 'khash.h', which resizes to the next power
+//      of two once the table is 77% full.
+#define KHASH_UPPER_LOAD_FACTOR 0.77
+#define KHASH_MIN_BUCKETS       4
+
+static size_t
+next_power_of_two(size_t const x)
+{
+    size_t r = 1;
+    while (r < x) {
+        r *= 2;
+    }
+    return r;
+}
+
+static size_t
+estimate_khash(size_t const num_entries)
+{
+    size_t const num_buckets = MAX(
+        next_power_of_two((size_t)(num_entries / KHASH_UPPER_LOAD_FACTOR) + 1),
+        KHASH_MIN_BUCKETS);
+    // Each bucket has a 64-bit key and value, plus 2 bits of flags.
+    return num_buckets * (2 * sizeof(uint64_t)) + num_buckets / 4;
+}
+
+static size_t
+estimate_tree(size_t const num_entries)
+{
+    return num_entries * sizeof(struct Subtree);
+}
+
+/// @note   When we reallocate, the histogram grows to 1.5x the largest
+///         stack distance, which is at most the number of unique keys.
+static size_t
+estimate_histogram(struct RunnerArguments const *const args,
+                   size_t const num_unique)
+{
+    size_t num_bins = args->num_bins;
+    if (args->out_of_bounds_mode == HistogramOutOfBoundsMode__log) {
+        // NOTE This mirrors the doubling in the histogram's allocator.
+        size_t const sub_bins = next_power_of_two(
+            MIN(MAX(args->num_bins, 1), HISTOGRAM_LOG_MAX_SUB_BINS));
+        size_t const needed = Histogram__log_bin_index(sub_bins, num_unique);
+        num_bins = 2 * sub_bins;
+        while (num_bins <= needed) {
+            num_bins *= 2;
+        }
+        num_bins = MIN(num_bins,
+                       Histogram__log_bin_index(sub_bins, UINT64_MAX) + 1);
+    } else if (args->out_of_bounds_mode ==
+                   HistogramOutOfBoundsMode__realloc &&
+        args->bin_size != 0) {
+        num_bins = MAX(num_bins, (size_t)(1.5 * num_unique / args->bin_size));
+    }
+    return num_bins * sizeof(uint64_t);
+}
+
+static size_t
+estimate_evicting_hash_table(size_t const length)
+{
+    size_t const num_blocks = (length + EHT__BLOCK_SIZE - 1) / EHT__BLOCK_SIZE;
+    return length * (sizeof(Hash64BitType) + sizeof(ValueType)) +
+           2 * next_power_of_two(num_blocks) * sizeof(Hash64BitType);
+}
+
+static size_t
+estimate_olken(struct RunnerArguments const *const args,
+               size_t const num_tracked,
+               size_t const num_unique)
+{
+    return estimate_tree(num_tracked) + estimate_khash(num_tracked) +
+           estimate_histogram(args, num_unique);
+}
+
+static size_t
+estimate_instance(struct RunnerArguments const *const args,
+                  size_t const max_size,
+                  size_t const n)
+{
+    switch (args->algorithm) {
+    case MRC_ALGORITHM_ORACLE:
+    case MRC_ALGORITHM_OLKEN:
+        return estimate_olken(args, n, n);
+    case MRC_ALGORITHM_FIXED_RATE_SHARDS:
+        return estimate_olken(args, (size_t)(args->sampling_rate * n), n);
+    case MRC_ALGORITHM_FIXED_SIZE_SHARDS:
+        return estimate_olken(args, MIN(max_size, n), n) +
+               max_size * sizeof(struct HeapItem);
+    case MRC_ALGORITHM_FUSED_FIXED_SIZE_SHARDS: {
+        size_t const table_length = next_power_of_two(2 * max_size);
+        return table_length * sizeof(struct FusedFixedSizeShardsEntry) +
+               max_size * sizeof(struct FusedFixedSizeShardsHeapItem) +
+               (table_length + 1) * sizeof(uint64_t) +
+               estimate_histogram(args, n);
+    }
+    case MRC_ALGORITHM_EVICTING_MAP:
+        return estimate_evicting_hash_table(max_size) +
+               estimate_tree(MIN(max_size, n)) + estimate_histogram(args, n);
+    case MRC_ALGORITHM_EVICTING_QUICKMRC:
+        return estimate_evicting_hash_table(max_size) +
+               args->qmrc_size * (sizeof(int) + sizeof(size_t)) +
+               estimate_histogram(args, n);
+    default:
+        return 0;
+    }
+}
+
+/// @brief  Get the 'partitions=N' parameter or 1 if it is absent.
+static size_t
+get_num_partitions(struct RunnerArguments const *const args)
+{
+    char const *const str = Dictionary__get(&args->dictionary, "partitions");
+    if (str == NULL) {
+        return 1;
+    }
+    char *endptr = NULL;
+    unsigned long long const x = strtoull(str, &endptr, 10);
+    if (endptr == str || *endptr != '\0' || x == 0) {
+        return 1;
+    }
+    return x;
+}
+
+size_t
+estimate_peak_memory(struct RunnerArguments const *const args,
+                     size_t const trace_length,
+                     size_t const num_unique)
+{
+    if (args == NULL) {
+        return 0;
+    }
+    // NOTE The number of unique keys is an estimate, so we make sure
+    //      that it is consistent with the trace length.
+    size_t const n = MIN(num_unique, trace_length);
+    size_t const num_partitions = get_num_partitions(args);
+    if (num_partitions > 1 && args->algorithm != MRC_ALGORITHM_ORACLE &&
+        args->algorithm != MRC_ALGORITHM_OLKEN) {
+        // NOTE Each partition sees 1/N of the keys with 1/N of the
+        //      memory budget, but they all run at the same time. We
+        //      also copy the trace's keys to split them by partition.
+        size_t const max_size = MAX(args->max_size / num_partitions, 1);
+        return num_partitions *
+                   estimate_instance(args, max_size, n / num_partitions) +
+               trace_length * sizeof(uint64_t);
+    }
+    return estimate_instance(args, args->max_size, n);
+}
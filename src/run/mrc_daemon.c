@@ -0,0 +1,502 @@
+/** @brief  Generate MRCs continuously from a shared-memory access ring.
+ *
+ *  A producer (e.g. a cache proxy, or 'replay_trace_exe' as a stand-in)
+ *  writes its accesses into a POSIX shared-memory ring. This daemon reads
+ *  them in batches, feeds them to an online MRC algorithm, and publishes
+ *  the MRC periodically:
+ *  - to a file (in the same format as 'generate_mrc_exe'), which we
+ *    replace atomically so that readers never see a partial MRC; and/or
+ *  - to the clients of a Unix-domain stream socket, as one JSON object
+ *    per line.
+ *
+ *  The daemon exits when the producer closes the ring (after publishing
+ *  the final MRC), or upon SIGINT or SIGTERM.
+ *
+ *  @example
+ *  ```bash
+ *  ./build/src/run/mrc_daemon_exe -r /online_mrc -a Fixed-Size-SHARDS \
+ *      -o live-mrc.bin -s /tmp/live-mrc.sock --interval-ms 1000 &
+ *  ./build/src/run/replay_trace_exe -i trace.bin -f Kia -r /online_mrc
+ *  socat - UNIX-CONNECT:/tmp/live-mrc.sock
+ *  ```
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "access_ring/access_ring.h"
+#include "logger/logger.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "online_mrc/online_mrc.h"
+#include "timer/timer.h"
+#include "trace/trace.h"
+
+#define MAX_NUM_CLIENTS       16
+#define IDLE_SLEEP_MS         1
+#define CLIENT_SEND_TIMEOUT_S 1
+
+struct CommandLineArguments {
+    char *executable;
+    gchar *ring_name;
+    gchar *output_path;
+    gchar *socket_path;
+    struct OnlineMRCConfig config;
+    gint64 interval_ms;
+    gint64 batch_size;
+    gint64 attach_timeout_ms;
+};
+
+/// @brief  Where we publish the MRCs.
+struct Publisher {
+    char const *output_path;
+    gchar *tmp_path;
+    char const *socket_path;
+    int listen_fd;
+    int client_fds[MAX_NUM_CLIENTS];
+    size_t num_clients;
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void
+request_stop(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+/// @note   Adapted from '//src/run/generate_trace.c'.
+static struct CommandLineArguments
+parse_command_line_arguments(int argc, char *argv[])
+{
+    gchar *help_msg = NULL;
+    gchar *algorithm = NULL;
+    gchar *mode = NULL;
+    gdouble sampling_rate = NAN;
+    gint64 max_size = -1, num_bins = -1, bin_size = -1;
+    gint64 ring_capacity = -1;
+
+    // Set defaults.
+    struct CommandLineArguments args = {.executable = argv[0],
+                                        .interval_ms = 1000,
+                                        .batch_size = 4096,
+                                        .attach_timeout_ms = 10000};
+
+    // Command line options.
+    GOptionEntry entries[] = {
+        {"ring",
+         'r',
+         0,
+         G_OPTION_ARG_STRING,
+         &args.ring_name,
+         "name of the shared-memory access ring (e.g. '/online_mrc')",
+         NULL},
+        {"algorithm",
+         'a',
+         0,
+         G_OPTION_ARG_STRING,
+         &algorithm,
+         "MRC algorithm. Options: {Olken,Fixed-Rate-SHARDS,"
+         "Fixed-Size-SHARDS,Evicting-Map}. Default: Fixed-Size-SHARDS.",
+         NULL},
+        {"output",
+         'o',
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.output_path,
+         "path of the MRC file to replace upon each publication",
+         NULL},
+        {"socket",
+         's',
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.socket_path,
+         "path of a Unix-domain socket to publish JSON MRCs on",
+         NULL},
+        {"interval-ms",
+         'i',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.interval_ms,
+         "milliseconds between publications. Default: 1000.",
+         NULL},
+        {"batch",
+         'b',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.batch_size,
+         "maximum number of records per read. Default: 4096.",
+         NULL},
+        {"attach-timeout-ms",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &args.attach_timeout_ms,
+         "how long to wait for the producer to create the ring. "
+         "Default: 10000.",
+         NULL},
+        {"sampling",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &sampling_rate,
+         "(initial) sampling rate of the algorithm",
+         NULL},
+        {"max-size",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &max_size,
+         "maximum number of sampled objects for the fixed-size algorithms",
+         NULL},
+        {"num-bins",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &num_bins,
+         "number of histogram bins",
+         NULL},
+        {"bin-size",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &bin_size,
+         "size of each histogram bin",
+         NULL},
+        {"mode",
+         0,
+         0,
+         G_OPTION_ARG_STRING,
+         &mode,
+         "histogram out-of-bounds mode. Options: {allow_overflow,"
+         "merge_bins,realloc,log}. Default: realloc.",
+         NULL},
+        {"ring-capacity",
+         0,
+         0,
+         G_OPTION_ARG_INT64,
+         &ring_capacity,
+         "capacity of the aggregator's in-process ring",
+         NULL},
+        G_OPTION_ENTRY_NULL,
+    };
+
+    GError *error = NULL;
+    GOptionContext *context;
+    context = g_option_context_new("- generate MRCs from live accesses");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        goto cleanup;
+    }
+    // Come on, GLib! The 'g_option_context_parse' changes the errno to
+    // 2 and leaves it for me to clean up. Or maybe I'm using it wrong.
+    errno = 0;
+
+    // Check the arguments for correctness.
+    if (args.ring_name == NULL) {
+        LOGGER_ERROR("must specify the ring");
+        goto cleanup;
+    }
+    if (args.output_path == NULL && args.socket_path == NULL) {
+        LOGGER_ERROR("must specify an output file and/or a socket");
+        goto cleanup;
+    }
+    if (args.interval_ms <= 0 || args.batch_size <= 0 ||
+        args.attach_timeout_ms < 0) {
+        LOGGER_ERROR("interval and batch must be positive and the timeout "
+                     "non-negative");
+        goto cleanup;
+    }
+    enum OnlineMRCAlgorithm const alg =
+        algorithm == NULL ? ONLINE_MRC_ALGORITHM_FIXED_SIZE_SHARDS
+                          : OnlineMRCAlgorithm__parse(algorithm);
+    if (!OnlineMRCConfig__init(&args.config, alg)) {
+        LOGGER_ERROR("invalid algorithm '%s'", algorithm);
+        goto cleanup;
+    }
+    // NOTE If these are negative (or NAN), we keep the defaults.
+    if (sampling_rate >= 0.0 && sampling_rate <= 1.0) {
+        args.config.sampling_rate = sampling_rate;
+    }
+    if (max_size > 0) {
+        args.config.max_size = max_size;
+    }
+    if (num_bins > 0) {
+        args.config.num_bins = num_bins;
+    }
+    if (bin_size > 0) {
+        args.config.bin_size = bin_size;
+    }
+    if (ring_capacity > 0) {
+        args.config.ring_capacity = ring_capacity;
+    }
+    if (mode != NULL) {
+        if (!HistogramOutOfBoundsMode__parse(&args.config.out_of_bounds_mode,
+                                             mode)) {
+            LOGGER_ERROR("invalid histogram mode '%s'", mode);
+            goto cleanup;
+        }
+    }
+
+    g_free(algorithm);
+    g_free(mode);
+    g_option_context_free(context);
+    return args;
+cleanup:
+    help_msg = g_option_context_get_help(context, FALSE, NULL);
+    g_print("%s", help_msg);
+    free(help_msg);
+    g_option_context_free(context);
+    exit(-1);
+}
+
+static bool
+Publisher__init(struct Publisher *const me,
+                char const *const output_path,
+                char const *const socket_path)
+{
+    *me = (struct Publisher){.output_path = output_path,
+                             .socket_path = socket_path,
+                             .listen_fd = -1};
+    if (output_path != NULL) {
+        me->tmp_path = g_strdup_printf("%s.tmp", output_path);
+    }
+    if (socket_path == NULL) {
+        return true;
+    }
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        LOGGER_ERROR("socket path '%s' is too long", socket_path);
+        goto cleanup;
+    }
+    strcpy(addr.sun_path, socket_path);
+    me->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (me->listen_fd == -1) {
+        LOGGER_ERROR("failed to create a socket: %s", strerror(errno));
+        goto cleanup;
+    }
+    // NOTE We remove a stale socket from a previous run.
+    unlink(socket_path);
+    if (bind(me->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(me->listen_fd, MAX_NUM_CLIENTS) != 0) {
+        LOGGER_ERROR("failed to listen on '%s': %s",
+                     socket_path,
+                     strerror(errno));
+        close(me->listen_fd);
+        goto cleanup;
+    }
+    return true;
+cleanup:
+    g_free(me->tmp_path);
+    *me = (struct Publisher){.listen_fd = -1};
+    return false;
+}
+
+static void
+accept_clients(struct Publisher *const me)
+{
+    // NOTE We bound how long a slow client can stall the daemon. In the
+    //      meantime, the producer's accesses queue up in the ring.
+    struct timeval const timeout = {.tv_sec = CLIENT_SEND_TIMEOUT_S};
+    while (me->num_clients < MAX_NUM_CLIENTS) {
+        int const fd = accept(me->listen_fd, NULL, NULL);
+        if (fd == -1) {
+            // NOTE EAGAIN means that there are no more pending clients.
+            return;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        me->client_fds[me->num_clients++] = fd;
+    }
+}
+
+static bool
+send_all(int const fd, char const *const line, size_t const n)
+{
+    size_t num_sent = 0;
+    while (num_sent < n) {
+        ssize_t const r = send(fd, &line[num_sent], n - num_sent, MSG_NOSIGNAL);
+        if (r <= 0) {
+            return false;
+        }
+        num_sent += r;
+    }
+    return true;
+}
+
+/// @brief  Send the line to every client, disconnecting those that fail
+///         or cannot keep up.
+static void
+broadcast(struct Publisher *const me, char const *const line, size_t const n)
+{
+    size_t i = 0;
+    while (i < me->num_clients) {
+        if (!send_all(me->client_fds[i], line, n)) {
+            // NOTE After a partial write, the client's next line would be
+            //      broken, so we disconnect it.
+            LOGGER_INFO("disconnecting a client");
+            close(me->client_fds[i]);
+            me->client_fds[i] = me->client_fds[--me->num_clients];
+            continue;
+        }
+        ++i;
+    }
+}
+
+static bool
+Publisher__publish(struct Publisher *const me,
+                   struct MissRateCurve const *const mrc)
+{
+    bool ok = true;
+    if (me->output_path != NULL) {
+        if (!MissRateCurve__save(mrc, me->tmp_path) ||
+            rename(me->tmp_path, me->output_path) != 0) {
+            LOGGER_WARN("failed to publish to '%s'", me->output_path);
+            ok = false;
+        }
+    }
+    if (me->listen_fd != -1) {
+        char *line = NULL;
+        size_t n = 0;
+        FILE *stream = open_memstream(&line, &n);
+        if (stream == NULL) {
+            LOGGER_WARN("failed to open a memory stream");
+            return false;
+        }
+        MissRateCurve__write_as_json(stream, mrc);
+        fclose(stream);
+        accept_clients(me);
+        broadcast(me, line, n);
+        free(line);
+    }
+    return ok;
+}
+
+static void
+Publisher__destroy(struct Publisher *const me)
+{
+    for (size_t i = 0; i < me->num_clients; ++i) {
+        close(me->client_fds[i]);
+    }
+    if (me->listen_fd != -1) {
+        close(me->listen_fd);
+        unlink(me->socket_path);
+    }
+    g_free(me->tmp_path);
+    *me = (struct Publisher){.listen_fd = -1};
+}
+
+static bool
+publish(struct OnlineMRC *const online_mrc, struct Publisher *const publisher)
+{
+    struct MissRateCurve mrc = {0};
+    if (!OnlineMRC__get_mrc(online_mrc, &mrc)) {
+        LOGGER_WARN("failed to get the MRC");
+        return false;
+    }
+    bool const ok = Publisher__publish(publisher, &mrc);
+    MissRateCurve__destroy(&mrc);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct CommandLineArguments args = parse_command_line_arguments(argc, argv);
+    struct AccessRingConsumer ring = {0};
+    struct OnlineMRC online_mrc = {0};
+    struct Publisher publisher = {0};
+    struct OnlineMRCStatistics stats = {0};
+    struct FullTraceItem *items = NULL;
+    int status = EXIT_FAILURE;
+    uint64_t num_published = 0;
+
+    struct sigaction sa = {.sa_handler = request_stop};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (!Publisher__init(&publisher, args.output_path, args.socket_path)) {
+        LOGGER_ERROR("failed to initialize the publisher");
+        goto cleanup;
+    }
+    if (!AccessRingConsumer__init(&ring,
+                                  args.ring_name,
+                                  args.attach_timeout_ms)) {
+        LOGGER_ERROR("failed to attach to '%s'", args.ring_name);
+        goto cleanup;
+    }
+    if (!OnlineMRC__init(&online_mrc, &args.config)) {
+        LOGGER_ERROR("failed to initialize the online MRC");
+        goto cleanup;
+    }
+    items = calloc(args.batch_size, sizeof(*items));
+    if (items == NULL) {
+        LOGGER_ERROR("failed to allocate the batch");
+        goto cleanup;
+    }
+    LOGGER_INFO("consuming '%s' with %s",
+                args.ring_name,
+                ONLINE_MRC_ALGORITHM_STRINGS[args.config.algorithm]);
+
+    double next_publish_sec = get_wall_time_sec() + args.interval_ms / 1e3;
+    while (!stop_requested) {
+        size_t const n =
+            AccessRingConsumer__read(&ring, items, args.batch_size);
+        for (size_t i = 0; i < n; ++i) {
+            // NOTE Like the trace reader, we only model the gets.
+            if (items[i].command != 0) {
+                continue;
+            }
+            OnlineMRC__record(&online_mrc, items[i].key, items[i].size);
+        }
+        if (n == 0) {
+            if (AccessRingConsumer__is_done(&ring)) {
+                LOGGER_INFO("producer closed '%s'", args.ring_name);
+                break;
+            }
+            struct timespec const idle = {.tv_nsec = IDLE_SLEEP_MS * 1000000};
+            nanosleep(&idle, NULL);
+        }
+        double const now_sec = get_wall_time_sec();
+        if (now_sec >= next_publish_sec) {
+            publish(&online_mrc, &publisher);
+            ++num_published;
+            next_publish_sec = now_sec + args.interval_ms / 1e3;
+        }
+    }
+    if (!publish(&online_mrc, &publisher)) {
+        LOGGER_ERROR("failed to publish the final MRC");
+        goto cleanup;
+    }
+    ++num_published;
+    OnlineMRC__get_statistics(&online_mrc, &stats);
+    LOGGER_INFO("processed %" PRIu64 " accesses (%" PRIu64
+                " dropped by the producer) and published %" PRIu64 " MRCs",
+                stats.num_processed,
+                AccessRingConsumer__num_dropped(&ring),
+                num_published);
+    status = EXIT_SUCCESS;
+cleanup:
+    free(items);
+    Publisher__destroy(&publisher);
+    OnlineMRC__destroy(&online_mrc);
+    AccessRingConsumer__destroy(&ring);
+    g_free(args.ring_name);
+    g_free(args.output_path);
+    g_free(args.socket_path);
+    return status;
+}
@@ -0,0 +1,266 @@
+/** @brief  Replay a trace file into a shared-memory access ring.
+ *
+ *  This stands in for a live producer (e.g. a cache proxy) so that we can
+ *  drive 'mrc_daemon_exe' with a recorded trace.
+ *
+ *  @example
+ *  ```bash
+ *  # Replay at 10x the recorded speed.
+ *  ./build/src/run/replay_trace_exe \
+ *      -i ./data/src2.bin -f Kia -r /online_mrc --speedup 10
+ *  ```
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "access_ring/access_ring.h"
+#include "file/file.h"
+#include "io/io.h"
+#include "logger/logger.h"
+#include "timer/timer.h"
+#include "trace/reader.h"
+#include "trace/trace.h"
+
+struct CommandLineArguments {
+    char *executable;
+    gchar *input_path;
+    enum TraceFormat trace_format;
+    gchar *ring_name;
+    gint64 capacity;
+    gint64 batch_size;
+    gint64 wait_ms;
+    gdouble speedup;
+    gboolean drop_when_full;
+};
+
+/// @note   Adapted from '//src/analysis/text/print_trace.c'.
+static struct CommandLineArguments
+parse_command_line_arguments(int argc, char *argv[])
+{
+    gchar *help_msg = NULL;
+    gchar *trace_format = NULL;
+
+    // Set defaults.
+    struct CommandLineArguments args = {
+        .executable = argv[0],
+        .trace_format = TRACE_FORMAT_KIA,
+        .capacity = ACCESS_RING_DEFAULT_CAPACITY,
+        .batch_size = 1024,
+        .wait_ms = 0,
+        .speedup = 0.0,
+        .drop_when_full = FALSE,
+    };
+
+    // Command line options.
+    GOptionEntry entries[] = {
+        {"input",
+         'i',
+         0,
+         G_OPTION_ARG_FILENAME,
+         &args.input_path,
+         "path to the input trace",
+         NULL},
+        {"format",
+         'f',
+         0,
+         G_OPTION_ARG_STRING,
+         &trace_format,
+         "format of the input trace. Options: {Kia,Sari}. Default: Kia.",
+         NULL},
+        {"ring",
+         'r',
+         0,
+         G_OPTION_ARG_STRING,
+         &args.ring_name,
+         "name of the shared-memory access ring (e.g. '/online_mrc')",
+         NULL},
+        {"capacity",
+         'c',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.capacity,
+         "number of records in the ring. Default: 1048576.",
+         NULL},
+        {"batch",
+         'b',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.batch_size,
+         "number of records per push. Default: 1024.",
+         NULL},
+        {"wait-ms",
+         'w',
+         0,
+         G_OPTION_ARG_INT64,
+         &args.wait_ms,
+         "how long to wait for the consumer to attach before replaying. "
+         "Default: 0 (i.e. forever).",
+         NULL},
+        {"speedup",
+         0,
+         0,
+         G_OPTION_ARG_DOUBLE,
+         &args.speedup,
+         "replay at this multiple of the recorded speed. Default: 0 (i.e. "
+         "as fast as possible).",
+         NULL},
+        {"drop",
+         'd',
+         0,
+         G_OPTION_ARG_NONE,
+         &args.drop_when_full,
+         "drop records when the ring is full rather than wait",
+         NULL},
+        G_OPTION_ENTRY_NULL,
+    };
+
+    GError *error = NULL;
+    GOptionContext *context;
+    context = g_option_context_new("- replay a trace into an access ring");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        goto cleanup;
+    }
+    // Come on, GLib! The 'g_option_context_parse' changes the errno to
+    // 2 and leaves it for me to clean up. Or maybe I'm using it wrong.
+    errno = 0;
+
+    // Check the arguments for correctness.
+    if (args.input_path == NULL || !file_exists(args.input_path)) {
+        LOGGER_ERROR("input trace path '%s' DNE",
+                     args.input_path == NULL ? "(null)" : args.input_path);
+        goto cleanup;
+    }
+    if (trace_format != NULL) {
+        args.trace_format = parse_trace_format_string(trace_format);
+        if (args.trace_format == TRACE_FORMAT_INVALID) {
+            LOGGER_ERROR("invalid trace format '%s'", trace_format);
+            goto cleanup;
+        }
+    }
+    if (args.ring_name == NULL) {
+        LOGGER_ERROR("must specify the ring");
+        goto cleanup;
+    }
+    if (args.capacity <= 0 || args.batch_size <= 0 || args.wait_ms < 0 ||
+        args.speedup < 0.0) {
+        LOGGER_ERROR("capacity and batch must be positive; wait and speedup "
+                     "must be non-negative");
+        goto cleanup;
+    }
+
+    g_free(trace_format);
+    g_option_context_free(context);
+    return args;
+cleanup:
+    help_msg = g_option_context_get_help(context, FALSE, NULL);
+    g_print("%s", help_msg);
+    free(help_msg);
+    g_option_context_free(context);
+    exit(-1);
+}
+
+/// @brief  Sleep until the replay clock reaches the record's timestamp.
+/// @note   The traces are not always in timestamp order, so a record may
+///         precede the first one. We do not wait for such records.
+static void
+throttle(double const start_sec,
+         uint64_t const first_timestamp_ms,
+         uint64_t const timestamp_ms,
+         double const speedup)
+{
+    if (timestamp_ms <= first_timestamp_ms) {
+        return;
+    }
+    double const target_sec =
+        start_sec + (timestamp_ms - first_timestamp_ms) / 1e3 / speedup;
+    double const delay_sec = target_sec - get_wall_time_sec();
+    if (delay_sec > 0.0) {
+        struct timespec const ts = {
+            .tv_sec = (time_t)delay_sec,
+            .tv_nsec = (long)((delay_sec - (time_t)delay_sec) * 1e9)};
+        nanosleep(&ts, NULL);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    struct CommandLineArguments args = parse_command_line_arguments(argc, argv);
+    struct MemoryMap mm = {0};
+    struct AccessRingProducer ring = {0};
+    struct FullTraceItem *items = NULL;
+    uint64_t num_pushed = 0;
+    int status = EXIT_FAILURE;
+
+    size_t const bytes_per_item = get_bytes_per_trace_item(args.trace_format);
+    if (!MemoryMap__init(&mm, args.input_path, "rb")) {
+        LOGGER_ERROR("failed to mmap '%s'", args.input_path);
+        goto cleanup;
+    }
+    size_t const num_entries = mm.num_bytes / bytes_per_item;
+    items = calloc(args.batch_size, sizeof(*items));
+    if (items == NULL) {
+        LOGGER_ERROR("failed to allocate the batch");
+        goto cleanup;
+    }
+    if (!AccessRingProducer__init(&ring, args.ring_name, args.capacity)) {
+        LOGGER_ERROR("failed to create '%s'", args.ring_name);
+        goto cleanup;
+    }
+    ring.drop_when_full = args.drop_when_full;
+    LOGGER_INFO("waiting for a consumer on '%s'", args.ring_name);
+    if (!AccessRingProducer__wait_for_consumer(&ring, args.wait_ms)) {
+        LOGGER_ERROR("no consumer attached to '%s'", args.ring_name);
+        goto cleanup;
+    }
+
+    double const start_sec = get_wall_time_sec();
+    uint64_t first_timestamp_ms = 0;
+    for (size_t i = 0; i < num_entries;) {
+        size_t n = 0;
+        for (; n < (size_t)args.batch_size && i < num_entries; ++n, ++i) {
+            struct FullTraceItemResult r = construct_full_trace_item(
+                &((uint8_t *)mm.buffer)[i * bytes_per_item],
+                args.trace_format);
+            if (!r.valid) {
+                LOGGER_ERROR("invalid record %zu", i);
+                goto cleanup;
+            }
+            items[n] = r.item;
+        }
+        if (args.speedup > 0.0) {
+            if (i == n) {
+                first_timestamp_ms = items[0].timestamp_ms;
+            }
+            // NOTE We throttle once per batch, so a batch may arrive up
+            //      to its own duration early.
+            throttle(start_sec,
+                     first_timestamp_ms,
+                     items[0].timestamp_ms,
+                     args.speedup);
+        }
+        num_pushed += AccessRingProducer__push_batch(&ring, items, n);
+    }
+    double const end_sec = get_wall_time_sec();
+    LOGGER_INFO("pushed %" PRIu64 " of %zu records in %g seconds",
+                num_pushed,
+                num_entries,
+                end_sec - start_sec);
+    status = EXIT_SUCCESS;
+cleanup:
+    AccessRingProducer__destroy(&ring);
+    free(items);
+    MemoryMap__destroy(&mm);
+    g_free(args.input_path);
+    g_free(args.ring_name);
+    return status;
+}
@@ -2,20 +2,30 @@
  *
  *  Methods to save memory include:
  *  - Not reading the entire trace into memory at once
+ *  - Sampling the keys with SHARDS (optional)
  *
  * @note    This may drastically slow down our computation.
  */
 
+#include <assert.h>
+#include <math.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "file/file.h"
 #include "histogram/histogram.h"
 #include "io/io.h"
 #include "logger/logger.h"
+#include "lookup/dictionary.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
 #include "olken/olken_with_ttl.h"
+#include "profiler/profiler.h"
+#include "run/run_oracle.h"
 #include "run/runner_arguments.h"
+#include "shards/fixed_rate_shards.h"
+#include "shards/fixed_size_shards.h"
+#include "telemetry/telemetry.h"
 #include "trace/reader.h"
 #include "trace/trace.h"
 
@@ -67,62 +77,157 @@ check_output_paths(enum RunnerMode const mode,
     return true;
 }
 
-bool
-run_oracle(char const *const restrict trace_path,
-           enum TraceFormat const format,
-           struct RunnerArguments const *const args)
+/// @brief  Get the sampling mode from the dictionary parameter
+///         'shards={none,fixed-rate,fixed-size}'. The default is 'none'.
+static bool
+get_sampling(struct RunnerArguments const *const args,
+             enum OlkenWithTTLSampling *const sampling)
 {
-    LOGGER_TRACE("running 'run_oracle_with_ttl()");
-    size_t const bytes_per_trace_item = get_bytes_per_trace_item(format);
+    char const *const str = Dictionary__get(&args->dictionary, "shards");
+    if (str == NULL) {
+        *sampling = OLKEN_WITH_TTL_SAMPLING_NONE;
+        return true;
+    }
+    return OlkenWithTTLSampling__parse(sampling, str);
+}
 
-    struct MemoryMap mm = {0};
-    struct Olken olken = {0};
-    struct MissRateCurve mrc = {0};
-    size_t num_entries = 0;
+/// @brief  The TTL-oblivious oracle, which we may sample with SHARDS.
+struct Oracle {
+    enum OlkenWithTTLSampling sampling;
+    struct Olken olken;
+    struct FixedRateShards fixed_rate;
+    struct FixedSizeShards fixed_size;
+};
 
-    if (trace_path == NULL || args == NULL || bytes_per_trace_item == 0) {
-        LOGGER_ERROR("invalid input", format);
-        goto cleanup_error;
+static bool
+Oracle__init(struct Oracle *const me, struct RunnerArguments const *const args)
+{
+    *me = (struct Oracle){0};
+    if (!get_sampling(args, &me->sampling)) {
+        return false;
     }
-    if (!check_output_paths(args->run_mode, args->hist_path, args->mrc_path)) {
-        LOGGER_ERROR("error with output path, aborting!");
-        goto cleanup_error;
+    switch (me->sampling) {
+    case OLKEN_WITH_TTL_SAMPLING_NONE:
+        return Olken__init_full(&me->olken,
+                                args->num_bins,
+                                args->bin_size,
+                                HistogramOutOfBoundsMode__realloc);
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_RATE:
+        return FixedRateShards__init_full(&me->fixed_rate,
+                                          args->sampling_rate,
+                                          args->num_bins,
+                                          args->bin_size,
+                                          HistogramOutOfBoundsMode__realloc,
+                                          args->shards_adj);
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE:
+        return FixedSizeShards__init_full(&me->fixed_size,
+                                          args->sampling_rate,
+                                          args->max_size,
+                                          args->num_bins,
+                                          args->bin_size,
+                                          HistogramOutOfBoundsMode__realloc,
+                                          &args->dictionary);
+    default:
+        return false;
     }
+}
 
-    // Memory map the input trace file
-    if (!MemoryMap__init(&mm, trace_path, "rb")) {
-        LOGGER_ERROR("failed to mmap '%s'", trace_path);
-        goto cleanup_error;
+static inline void
+Oracle__access_item(struct Oracle *const me, EntryType const entry)
+{
+    switch (me->sampling) {
+    case OLKEN_WITH_TTL_SAMPLING_NONE:
+        Olken__access_item(&me->olken, entry);
+        break;
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_RATE:
+        FixedRateShards__access_item(&me->fixed_rate, entry);
+        break;
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE:
+        FixedSizeShards__access_item(&me->fixed_size, entry);
+        break;
+    default:
+        assert(0 && "impossible");
     }
-    num_entries = mm.num_bytes / bytes_per_trace_item;
+}
 
-    // Run trace
-    if (!Olken__init_full(&olken,
-                          args->num_bins,
-                          args->bin_size,
-                          HistogramOutOfBoundsMode__realloc)) {
-        LOGGER_ERROR("failed to initialize Olken");
-        goto cleanup_error;
+static double
+Oracle__get_sampling_ratio(struct Oracle const *const me)
+{
+    switch (me->sampling) {
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_RATE:
+        return me->fixed_rate.sampling_ratio;
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE:
+        return me->fixed_size.sampler.sampling_ratio;
+    default:
+        return 1.0;
     }
-    for (size_t i = 0; i < num_entries; ++i) {
-        if (i % 1000000 == 0) {
-            LOGGER_TRACE("Finished %zu / %zu", i, num_entries);
-        }
-        struct TraceItemResult r = construct_trace_item(
-            &((uint8_t *)mm.buffer)[i * bytes_per_trace_item],
-            format);
-        if (!r.valid) {
-            continue;
-        }
-        Olken__access_item(&olken, r.item.key);
+}
+
+/// @brief  Post-process (e.g. the SHARDS adjustment) and get the
+///         histogram.
+static bool
+Oracle__finish(struct Oracle *const me, struct Histogram const **const hist)
+{
+    switch (me->sampling) {
+    case OLKEN_WITH_TTL_SAMPLING_NONE:
+        return Olken__get_histogram(&me->olken, hist);
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_RATE:
+        return FixedRateShards__post_process(&me->fixed_rate) &&
+               FixedRateShards__get_histogram(&me->fixed_rate, hist);
+    case OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE:
+        return FixedSizeShards__post_process(&me->fixed_size) &&
+               FixedSizeShards__get_histogram(&me->fixed_size, hist);
+    default:
+        return false;
+    }
+}
+
+static size_t
+Oracle__memory_usage(struct Oracle const *const me)
+{
+    return Olken__memory_usage(&me->olken) +
+           FixedRateShards__memory_usage(&me->fixed_rate) +
+           FixedSizeShards__memory_usage(&me->fixed_size);
+}
+
+static void
+Oracle__destroy(struct Oracle *const me)
+{
+    Olken__destroy(&me->olken);
+    FixedRateShards__destroy(&me->fixed_rate);
+    FixedSizeShards__destroy(&me->fixed_size);
+    *me = (struct Oracle){0};
+}
+
+static bool
+init_oracle_with_ttl(struct OlkenWithTTL *const me,
+                     struct RunnerArguments const *const args)
+{
+    enum OlkenWithTTLSampling sampling = OLKEN_WITH_TTL_SAMPLING_NONE;
+    if (!get_sampling(args, &sampling)) {
+        return false;
     }
+    return OlkenWithTTL__init_sampled(me,
+                                      args->num_bins,
+                                      args->bin_size,
+                                      HistogramOutOfBoundsMode__realloc,
+                                      NULL,
+                                      sampling,
+                                      args->sampling_rate,
+                                      args->max_size,
+                                      args->shards_adj);
+}
 
-    // Save histogram and MRC
-    if (!MissRateCurve__init_from_histogram(&mrc, &olken.histogram)) {
+static bool
+save_histogram_and_mrc(struct Histogram const *const hist,
+                       struct RunnerArguments const *const args)
+{
+    struct MissRateCurve mrc = {0};
+    if (!MissRateCurve__init_from_histogram(&mrc, hist)) {
         LOGGER_ERROR("failed to initialize MRC");
         goto cleanup_error;
     }
-    if (!Histogram__save(&olken.histogram, args->hist_path)) {
+    if (!Histogram__save(hist, args->hist_path)) {
         LOGGER_ERROR("failed to save histogram to '%s'", args->hist_path);
         goto cleanup_error;
     }
@@ -130,39 +235,45 @@ run_oracle(char const *const restrict trace_path,
         LOGGER_ERROR("failed to save MRC to '%s'", args->mrc_path);
         goto cleanup_error;
     }
-
-    MemoryMap__destroy(&mm);
-    Olken__destroy(&olken);
     MissRateCurve__destroy(&mrc);
     return true;
 cleanup_error:
-    MemoryMap__destroy(&mm);
-    Olken__destroy(&olken);
     MissRateCurve__destroy(&mrc);
     return false;
 }
 
 bool
-run_oracle_with_ttl(char const *const restrict trace_path,
-                    enum TraceFormat const format,
-                    struct RunnerArguments const *const args)
+run_oracles(char const *const restrict trace_path,
+            enum TraceFormat const format,
+            struct RunnerArguments const *const args,
+            struct RunnerArguments const *const ttl_args)
 {
-    LOGGER_TRACE("running 'run_oracle_with_ttl()");
+    LOGGER_TRACE("running 'run_oracles()'");
     size_t const bytes_per_trace_item = get_bytes_per_trace_item(format);
 
     struct MemoryMap mm = {0};
-    struct OlkenWithTTL olken = {0};
-    struct MissRateCurve mrc = {0};
+    struct Oracle oracle = {0};
+    struct OlkenWithTTL ttl_oracle = {0};
+    struct TelemetryProgress progress = {0}, ttl_progress = {0};
+    struct Histogram const *hist = NULL;
     size_t num_entries = 0;
 
-    if (trace_path == NULL || args == NULL || bytes_per_trace_item == 0) {
-        LOGGER_ERROR("invalid input", format);
+    if (trace_path == NULL || (args == NULL && ttl_args == NULL) ||
+        bytes_per_trace_item == 0) {
+        LOGGER_ERROR("invalid input");
         goto cleanup_error;
     }
-    if (!check_output_paths(args->run_mode, args->hist_path, args->mrc_path)) {
+    if (args != NULL &&
+        !check_output_paths(args->run_mode, args->hist_path, args->mrc_path)) {
         LOGGER_ERROR("error with output path, aborting!");
         goto cleanup_error;
     }
+    if (ttl_args != NULL && !check_output_paths(ttl_args->run_mode,
+                                                ttl_args->hist_path,
+                                                ttl_args->mrc_path)) {
+        LOGGER_ERROR("error with TTL output path, aborting!");
+        goto cleanup_error;
+    }
 
     // Memory map the input trace file
     if (!MemoryMap__init(&mm, trace_path, "rb")) {
@@ -171,50 +282,111 @@ run_oracle_with_ttl(char const *const restrict trace_path,
     }
     num_entries = mm.num_bytes / bytes_per_trace_item;
 
-    // Run trace
-    if (!OlkenWithTTL__init_full(&olken,
-                                 args->num_bins,
-                                 args->bin_size,
-                                 HistogramOutOfBoundsMode__realloc,
-                                 NULL)) {
+    if (args != NULL && !Oracle__init(&oracle, args)) {
+        LOGGER_ERROR("failed to initialize the oracle");
+        goto cleanup_error;
+    }
+    if (ttl_args != NULL && !init_oracle_with_ttl(&ttl_oracle, ttl_args)) {
         LOGGER_ERROR("failed to initialize Olken-with-TTL");
         goto cleanup_error;
     }
-    for (size_t i = 0; i < num_entries; ++i) {
-        if (i % 1000000 == 0) {
-            LOGGER_TRACE("Finished %zu / %zu", i, num_entries);
+
+    // Run trace. We run both oracles in the same pass so that we only
+    // read (and page in) the trace once.
+    if (args != NULL) {
+        TelemetryProgress__init(&progress, "Oracle", num_entries);
+    }
+    if (ttl_args != NULL) {
+        TelemetryProgress__init(&ttl_progress, "Oracle-with-TTL", num_entries);
+    }
+    for (size_t begin = 0; begin < num_entries;
+         begin += TELEMETRY_CHUNK_SIZE) {
+        size_t const end = MIN(begin + TELEMETRY_CHUNK_SIZE, num_entries);
+        for (size_t i = begin; i < end; ++i) {
+            uint8_t const *const bytes =
+                &((uint8_t *)mm.buffer)[i * bytes_per_trace_item];
+            if (args != NULL) {
+                struct TraceItemResult r = construct_trace_item(bytes, format);
+                if (r.valid) {
+                    Profiler__tick();
+                    uint64_t const start = Profiler__start();
+                    Oracle__access_item(&oracle, r.item.key);
+                    Profiler__stop(PROFILER_SCOPE_ACCESS, start);
+                }
+            }
+            if (ttl_args != NULL) {
+                struct FullTraceItemResult r =
+                    construct_full_trace_item(bytes, format);
+                assert(r.valid);
+                Profiler__tick();
+                uint64_t const start = Profiler__start();
+                OlkenWithTTL__access_item(&ttl_oracle,
+                                          r.item.key,
+                                          r.item.timestamp_ms,
+                                          r.item.ttl_s);
+                Profiler__stop(PROFILER_SCOPE_ACCESS, start);
+            }
+        }
+        if (args != NULL) {
+            TelemetryProgress__update(&progress,
+                                      end,
+                                      Oracle__get_sampling_ratio(&oracle),
+                                      NAN);
+        }
+        if (ttl_args != NULL) {
+            TelemetryProgress__update(
+                &ttl_progress,
+                end,
+                OlkenWithTTL__get_sampling_ratio(&ttl_oracle),
+                NAN);
         }
-        struct FullTraceItemResult r = construct_full_trace_item(
-            &((uint8_t *)mm.buffer)[i * bytes_per_trace_item],
-            format);
-        assert(r.valid);
-        OlkenWithTTL__access_item(&olken,
-                                  r.item.key,
-                                  r.item.timestamp_ms,
-                                  r.item.ttl_s);
-    }
-
-    // Save histogram and MRC
-    if (!MissRateCurve__init_from_histogram(&mrc, &olken.olken.histogram)) {
-        LOGGER_ERROR("failed to initialize MRC");
-        goto cleanup_error;
     }
-    if (!Histogram__save(&olken.olken.histogram, args->hist_path)) {
-        LOGGER_ERROR("failed to save histogram to '%s'", args->hist_path);
-        goto cleanup_error;
+    TelemetryProgress__destroy(&progress);
+    TelemetryProgress__destroy(&ttl_progress);
+
+    // Save histograms and MRCs
+    if (args != NULL) {
+        LOGGER_INFO("Oracle -- Memory: %zu B", Oracle__memory_usage(&oracle));
+        if (!Oracle__finish(&oracle, &hist) ||
+            !save_histogram_and_mrc(hist, args)) {
+            goto cleanup_error;
+        }
     }
-    if (!MissRateCurve__save(&mrc, args->mrc_path)) {
-        LOGGER_ERROR("failed to save MRC to '%s'", args->mrc_path);
-        goto cleanup_error;
+    if (ttl_args != NULL) {
+        LOGGER_INFO("Oracle-with-TTL -- Memory: %zu B",
+                    OlkenWithTTL__memory_usage(&ttl_oracle));
+        if (!OlkenWithTTL__post_process(&ttl_oracle) ||
+            !OlkenWithTTL__get_histogram(&ttl_oracle, &hist) ||
+            !save_histogram_and_mrc(hist, ttl_args)) {
+            goto cleanup_error;
+        }
     }
 
     MemoryMap__destroy(&mm);
-    OlkenWithTTL__destroy(&olken);
-    MissRateCurve__destroy(&mrc);
+    Oracle__destroy(&oracle);
+    OlkenWithTTL__destroy(&ttl_oracle);
     return true;
 cleanup_error:
+    TelemetryProgress__destroy(&progress);
+    TelemetryProgress__destroy(&ttl_progress);
     MemoryMap__destroy(&mm);
-    OlkenWithTTL__destroy(&olken);
-    MissRateCurve__destroy(&mrc);
+    Oracle__destroy(&oracle);
+    OlkenWithTTL__destroy(&ttl_oracle);
     return false;
 }
+
+bool
+run_oracle(char const *const restrict trace_path,
+           enum TraceFormat const format,
+           struct RunnerArguments const *const args)
+{
+    return run_oracles(trace_path, format, args, NULL);
+}
+
+bool
+run_oracle_with_ttl(char const *const restrict trace_path,
+                    enum TraceFormat const format,
+                    struct RunnerArguments const *const args)
+{
+    return run_oracles(trace_path, format, NULL, args);
+}
@@ -39,6 +39,8 @@ char *algorithm_names[] = {
     "Evicting-QuickMRC",
     "Average-Eviction-Time",
     "Their-Average-Eviction-Time",
+    "Counter-Stacks",
+    "Fused-Fixed-Size-SHARDS",
 };
 
 static bool
@@ -162,17 +164,25 @@ print_help(void)
             "<Algorithm>(runmode={run,tryread,onlyread},mrc=<file>,hist=<file>,"
             "sampling=<float64-in-[0,1]>,num_bins=<positive-int>,bin_size=<"
             "positive-int>,max_size=<positive-int>,mode={allow_overflow,merge_"
-            "bins,realloc},adj={true,false},qmrc_size=<positive-int>)\n");
+            "bins,realloc},adj={true,false},qmrc_size=<positive-int>,"
+            "checkpoint=<file>,checkpoint_interval=<positive-int>,snapshot=<"
+            "file>,snapshot_interval=<positive-int>,snapshot_interval_ms=<"
+            "positive-int>,snapshot_mode={cumulative,tumbling,decayed},"
+            "snapshot_decay=<float64-in-[0,1)>)\n");
     fprintf(LOGGER_STREAM,
             "    Example: "
             "Olken(runmode=run,mrc=olken-mrc.bin,hist=olken-hist.bin,sampling="
             "1.0,num_bins=100,bin_size=100,max_size=8000,mode=realloc,adj="
-            "false,qmrc_size=1)\n");
+            "false,qmrc_size=1,checkpoint=olken.ckpt,checkpoint_interval="
+            "100000000,snapshot=olken-snapshots.bin,snapshot_interval=1000000,"
+            "snapshot_mode=decayed,snapshot_decay=0.5)\n");
     fprintf(LOGGER_STREAM,
             "    Default: "
             "<INVALID>(runmode=run,mrc=(null),hist=(null),sampling=1.0,num_"
             "bins=1048576,bin_size=1,max_size=8192,mode=realloc,adj=true,qmrc_"
-            "size=128)\n");
+            "size=128,checkpoint=(null),checkpoint_interval=0,snapshot=(null),"
+            "snapshot_interval=0,snapshot_interval_ms=0,snapshot_mode="
+            "cumulative,snapshot_decay=0.5)\n");
     fprintf(LOGGER_STREAM,
             "    Notes: we reserve the use of the characters '(),='. "
             "White spaces are not stripped.\n");
@@ -259,6 +269,50 @@ parse_argument_string(struct RunnerArguments *const me, bool *no_more_args)
             return false;
         }
         return parse_positive_size(&me->qmrc_size, value);
+    } else if (strcmp(param, "checkpoint") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        me->checkpoint_path = strdup(value);
+        return true;
+    } else if (strcmp(param, "checkpoint_interval") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        return parse_positive_size(&me->checkpoint_interval, value);
+    } else if (strcmp(param, "snapshot") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        me->snapshot_path = strdup(value);
+        return true;
+    } else if (strcmp(param, "snapshot_interval") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        return parse_positive_size(&me->snapshot_interval, value);
+    } else if (strcmp(param, "snapshot_interval_ms") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        return parse_positive_size(&me->snapshot_interval_ms, value);
+    } else if (strcmp(param, "snapshot_mode") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        return MRCSnapshotMode__parse(&me->snapshot_mode, value);
+    } else if (strcmp(param, "snapshot_decay") == 0) {
+        if ((value = strtok(NULL, ",)")) == NULL) {
+            LOGGER_ERROR("invalid value for parameter '%s'", param);
+            return false;
+        }
+        return parse_positive_double(&me->snapshot_decay, value);
     } else if (strcmp(param, "help") == 0) {
         print_help();
         return false;
@@ -302,6 +356,13 @@ RunnerArguments__init(struct RunnerArguments *const me, char const *const str)
         .shards_adj = true,
         // NOTE This should give us approximately 1% error.
         .qmrc_size = 128,
+        .checkpoint_path = NULL,
+        .checkpoint_interval = 0,
+        .snapshot_path = NULL,
+        .snapshot_interval = 0,
+        .snapshot_interval_ms = 0,
+        .snapshot_mode = MRC_SNAPSHOT_MODE_CUMULATIVE,
+        .snapshot_decay = 0.5,
         .dictionary = (struct Dictionary){0},
     };
 
@@ -362,7 +423,9 @@ RunnerArguments__println(struct RunnerArguments const *const me, FILE *const fp)
     fprintf(fp,
             "RunnerArguments(algorithm=%s, mrc=%s, hist=%s, sampling=%g, "
             "num_bins=%zu, bin_size=%zu, max_size=%zu, mode=%s, adj=%s, "
-            "qmrc_size=%zu, dictionary=",
+            "qmrc_size=%zu, checkpoint=%s, checkpoint_interval=%zu, "
+            "snapshot=%s, snapshot_interval=%zu, snapshot_interval_ms=%zu, "
+            "snapshot_mode=%s, snapshot_decay=%g, dictionary=",
             algorithm_names[me->algorithm],
             maybe_string(me->mrc_path),
             maybe_string(me->hist_path),
@@ -372,7 +435,14 @@ RunnerArguments__println(struct RunnerArguments const *const me, FILE *const fp)
             me->max_size,
             HISTOGRAM_MODE_STRINGS[me->out_of_bounds_mode],
             bool_to_string(me->shards_adj),
-            me->qmrc_size);
+            me->qmrc_size,
+            maybe_string(me->checkpoint_path),
+            me->checkpoint_interval,
+            maybe_string(me->snapshot_path),
+            me->snapshot_interval,
+            me->snapshot_interval_ms,
+            MRC_SNAPSHOT_MODE_STRINGS[me->snapshot_mode],
+            me->snapshot_decay);
     Dictionary__write(&me->dictionary, fp, false);
     fprintf(fp, ")\n");
     return true;
@@ -386,6 +456,8 @@ RunnerArguments__destroy(struct RunnerArguments *const me)
     }
     free(me->mrc_path);
     free(me->hist_path);
+    free(me->checkpoint_path);
+    free(me->snapshot_path);
     Dictionary__destroy(&me->dictionary);
     *me = (struct RunnerArguments){0};
 }
@@ -1,23 +1,409 @@
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <glib.h>
+
+#include "checkpoint/checkpoint.h"
+#include "counter_stacks/counter_stacks.h"
 #include "evicting_map/evicting_map.h"
 #include "evicting_quickmrc/evicting_quickmrc.h"
 #include "file/file.h"
+#include "hash/hash.h"
 #include "histogram/histogram.h"
 #include "logger/logger.h"
+#include "lookup/dictionary.h"
 #include "miss_rate_curve/miss_rate_curve.h"
+#include "mrc_snapshot/mrc_snapshot.h"
 #include "olken/olken.h"
+#include "profiler/profiler.h"
+#include "sampler/sampling_controller.h"
 #include "shards/fixed_rate_shards.h"
 #include "shards/fixed_size_shards.h"
+#include "shards/fused_fixed_size_shards.h"
+#include "telemetry/telemetry.h"
 #include "timer/timer.h"
 #include "trace/trace.h"
+#include "unused/mark_unused.h"
 
+#include "run/batch_runner.h"
 #include "run/runner_arguments.h"
+#include "run/trace_runner.h"
+
+/// @brief  Check whether we can reuse the existing output files.
+/// @param  skip: set to true if we should skip running the algorithm.
+/// @return false if the outputs must exist (read-only) but do not.
+static bool
+check_existing_outputs(struct RunnerArguments const *const args,
+                       bool *const skip)
+{
+    *skip = false;
+    if (args->run_mode == RUNNER_MODE_TRY_READ ||
+        args->run_mode == RUNNER_MODE_ONLY_READ) {
+        if (file_exists(args->mrc_path) && file_exists(args->hist_path)) {
+            LOGGER_INFO("skipping %s to read existing files",
+                        algorithm_names[args->algorithm]);
+            *skip = true;
+        } else if (args->run_mode == RUNNER_MODE_TRY_READ) {
+            LOGGER_INFO("MRC and/or histogram files don't exist, so running "
+                        "normally (try-read)");
+        } else if (args->run_mode == RUNNER_MODE_ONLY_READ) {
+            LOGGER_ERROR("MRC and/or histogram files don't exist, so aborting "
+                         "(read-only)");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+save_outputs(struct RunnerArguments const *const args,
+             struct Histogram const *const hist,
+             struct MissRateCurve const *const mrc)
+{
+    if (args->hist_path != NULL) {
+        bool save_hist = true;
+        if (file_exists(args->hist_path)) {
+            LOGGER_WARN("file '%s' already exists!", args->hist_path);
+        }
+        if (save_hist && !Histogram__save(hist, args->hist_path)) {
+            LOGGER_WARN("failed to save histogram in '%s'", args->hist_path);
+        }
+    }
+    if (args->mrc_path != NULL) {
+        bool save_mrc = true;
+        if (file_exists(args->mrc_path)) {
+            LOGGER_WARN("file '%s' already exists!", args->mrc_path);
+        }
+        if (save_mrc && !MissRateCurve__save(mrc, args->mrc_path)) {
+            LOGGER_WARN("failed to save MRC in '%s'", args->mrc_path);
+        }
+    }
+}
+
+/// @brief  Save the algorithm's state after the first 'position' accesses.
+/// @note   We also store the last key that we processed so that we can
+///         detect resuming on a different trace.
+static bool
+save_checkpoint(void const *const runner_data,
+                struct RunnerArguments const *const args,
+                struct Trace const *const trace,
+                size_t const position,
+                bool (*save_func)(void const *const,
+                                  struct CheckpointWriter *const))
+{
+    struct CheckpointWriter writer = {0};
+    double const t0 = get_wall_time_sec();
+    uint64_t const last_key =
+        position == 0 ? 0 : trace->trace[position - 1].key;
+    if (!CheckpointWriter__init(&writer,
+                                args->checkpoint_path,
+                                algorithm_names[args->algorithm],
+                                position) ||
+        !CheckpointWriter__write_u64(&writer, last_key) ||
+        !save_func(runner_data, &writer) ||
+        !CheckpointWriter__commit(&writer)) {
+        LOGGER_ERROR("failed to checkpoint to '%s'", args->checkpoint_path);
+        CheckpointWriter__destroy(&writer);
+        return false;
+    }
+    LOGGER_INFO("checkpointed %s after %zu accesses (%zu B) in %f s",
+                algorithm_names[args->algorithm],
+                position,
+                writer.num_bytes,
+                get_wall_time_sec() - t0);
+    CheckpointWriter__destroy(&writer);
+    return true;
+}
+
+/// @brief  Restore the algorithm's state if a checkpoint exists.
+/// @param  position: the number of accesses that the checkpoint covers
+///                   (or 0 if there is no checkpoint).
+/// @note   The trace may have grown since the checkpoint, in which case
+///         we only process the new accesses.
+static bool
+load_checkpoint(void *const runner_data,
+                struct RunnerArguments const *const args,
+                struct Trace const *const trace,
+                size_t *const position,
+                bool (*load_func)(void *const,
+                                  struct CheckpointReader *const))
+{
+    struct CheckpointReader reader = {0};
+    uint64_t last_key = 0;
+    *position = 0;
+    if (!file_exists(args->checkpoint_path)) {
+        LOGGER_INFO("no checkpoint '%s', so starting from the beginning",
+                    args->checkpoint_path);
+        return true;
+    }
+    double const t0 = get_wall_time_sec();
+    if (!CheckpointReader__init(&reader,
+                                args->checkpoint_path,
+                                algorithm_names[args->algorithm])) {
+        LOGGER_ERROR("invalid checkpoint '%s'", args->checkpoint_path);
+        return false;
+    }
+    if (reader.position > trace->length ||
+        !CheckpointReader__read_u64(&reader, &last_key) ||
+        (reader.position != 0 &&
+         trace->trace[reader.position - 1].key != last_key)) {
+        LOGGER_ERROR("checkpoint '%s' (at %" PRIu64 ") does not match the "
+                     "trace (of length %zu)",
+                     args->checkpoint_path,
+                     reader.position,
+                     trace->length);
+        goto cleanup;
+    }
+    if (!load_func(runner_data, &reader) ||
+        !CheckpointReader__is_done(&reader)) {
+        LOGGER_ERROR("failed to load checkpoint '%s'", args->checkpoint_path);
+        goto cleanup;
+    }
+    *position = reader.position;
+    LOGGER_INFO("resuming %s after %zu accesses (loaded in %f s)",
+                algorithm_names[args->algorithm],
+                *position,
+                get_wall_time_sec() - t0);
+    CheckpointReader__destroy(&reader);
+    return true;
+cleanup:
+    CheckpointReader__destroy(&reader);
+    return false;
+}
+
+/// @brief  When to take the next MRC snapshot.
+struct SnapshotSchedule {
+    struct MRCSnapshotStream stream;
+    // The position of the previous snapshot.
+    size_t last_position;
+    // Take a snapshot once we have processed this many accesses...
+    size_t next_position;
+    // ... or before the first access at or after this time.
+    uint64_t next_time_ms;
+};
+
+/// @param  position: the number of accesses that we resumed from (or 0).
+static bool
+SnapshotSchedule__init(struct SnapshotSchedule *const me,
+                       struct RunnerArguments const *const args,
+                       struct Trace const *const trace,
+                       size_t const position,
+                       void *const runner_data,
+                       bool (*hist_func)(void *const,
+                                         struct Histogram const **const))
+{
+    struct Histogram const *restored = NULL;
+
+    *me = (struct SnapshotSchedule){.last_position = position};
+    if (args->snapshot_interval != 0 && args->snapshot_interval_ms != 0) {
+        LOGGER_ERROR("snapshots may be every N accesses or every T ms, but "
+                     "not both");
+        return false;
+    }
+    if (args->snapshot_interval_ms != 0 && trace->timestamps_ms == NULL) {
+        LOGGER_ERROR("snapshots every T ms need the trace's timestamps");
+        return false;
+    }
+    // NOTE When we resume from a checkpoint, we keep the snapshots that
+    //      we took before it and continue from the restored histogram.
+    if (position != 0 && !hist_func(runner_data, &restored)) {
+        LOGGER_ERROR("histogram getter failed");
+        return false;
+    }
+    bool const ok =
+        restored != NULL
+            ? MRCSnapshotStream__init_resumed(&me->stream,
+                                              args->snapshot_path,
+                                              args->snapshot_mode,
+                                              args->snapshot_decay,
+                                              restored,
+                                              position)
+            : MRCSnapshotStream__init(&me->stream,
+                                      args->snapshot_path,
+                                      args->snapshot_mode,
+                                      args->snapshot_decay);
+    if (!ok) {
+        LOGGER_ERROR("failed to open snapshot stream '%s'",
+                     args->snapshot_path);
+        return false;
+    }
+    // NOTE Zero means that we only take the final snapshot.
+    me->next_position = args->snapshot_interval != 0
+                            ? position + args->snapshot_interval
+                            : SIZE_MAX;
+    me->next_time_ms =
+        args->snapshot_interval_ms != 0 && position < trace->length
+            ? trace->timestamps_ms[position] + args->snapshot_interval_ms
+            : UINT64_MAX;
+    return true;
+}
+
+/// @brief  Shorten the chunk [begin, end) so that it stops at the next
+///         snapshot. This keeps the check out of the hot loop.
+static size_t
+SnapshotSchedule__get_chunk_end(struct SnapshotSchedule const *const me,
+                                struct Trace const *const trace,
+                                size_t const begin,
+                                size_t end)
+{
+    end = MIN(end, me->next_position);
+    if (me->next_time_ms != UINT64_MAX) {
+        // NOTE We took any snapshot that was due before 'begin', so the
+        //      chunk has at least one access.
+        for (size_t i = begin + 1; i < end; ++i) {
+            if (trace->timestamps_ms[i] >= me->next_time_ms) {
+                return i;
+            }
+        }
+    }
+    return end;
+}
+
+/// @brief  Take a snapshot if one is due before the access at 'position'
+///         (or if this is the end of the trace).
+static bool
+SnapshotSchedule__update(struct SnapshotSchedule *const me,
+                         struct RunnerArguments const *const args,
+                         struct Trace const *const trace,
+                         size_t const position,
+                         void *const runner_data,
+                         bool (*hist_func)(void *const,
+                                           struct Histogram const **const))
+{
+    bool const at_end = position == trace->length;
+    bool const due =
+        position >= me->next_position ||
+        (!at_end && trace->timestamps_ms != NULL &&
+         trace->timestamps_ms[position] >= me->next_time_ms) ||
+        (at_end && position != me->last_position);
+    if (!due) {
+        return true;
+    }
+    struct Histogram const *hist = NULL;
+    if (!hist_func(runner_data, &hist)) {
+        LOGGER_ERROR("histogram getter failed");
+        return false;
+    }
+    struct MRCSnapshotHeader const header = {
+        .position = position,
+        .timestamp_ms = trace->timestamps_ms != NULL && position != 0
+                            ? trace->timestamps_ms[position - 1]
+                            : 0,
+    };
+    me->last_position = position;
+    if (me->next_position != SIZE_MAX) {
+        me->next_position = position + args->snapshot_interval;
+    }
+    if (me->next_time_ms != UINT64_MAX && !at_end) {
+        // NOTE We skip the empty windows in gaps in the trace.
+        uint64_t const t = trace->timestamps_ms[position];
+        me->next_time_ms +=
+            ((t - me->next_time_ms) / args->snapshot_interval_ms + 1) *
+            args->snapshot_interval_ms;
+    }
+    return MRCSnapshotStream__take(&me->stream, hist, header);
+}
+
+/// @brief  Get an unsigned integer from the dictionary or return the
+///         default if it is not present.
+static bool
+get_dictionary_uint64(struct Dictionary const *const dict,
+                      char const *const key,
+                      uint64_t const default_value,
+                      uint64_t *const value)
+{
+    char const *str = Dictionary__get(dict, key);
+    if (str == NULL) {
+        *value = default_value;
+        return true;
+    }
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long const x = strtoull(str, &endptr, 10);
+    if (errno != 0 || endptr == str || *endptr != '\0') {
+        LOGGER_ERROR("invalid value '%s' for parameter '%s'", str, key);
+        return false;
+    }
+    *value = x;
+    return true;
+}
+
+/// @brief  Get a double from the dictionary or return the default if
+///         it is not present.
+static bool
+get_dictionary_double(struct Dictionary const *const dict,
+                      char const *const key,
+                      double const default_value,
+                      double *const value)
+{
+    char const *str = Dictionary__get(dict, key);
+    if (str == NULL) {
+        *value = default_value;
+        return true;
+    }
+    char *endptr = NULL;
+    errno = 0;
+    double const x = strtod(str, &endptr);
+    if (errno != 0 || endptr == str || *endptr != '\0') {
+        LOGGER_ERROR("invalid value '%s' for parameter '%s'", str, key);
+        return false;
+    }
+    *value = x;
+    return true;
+}
+
+/// @brief  Get a boolean ('true' or 'false') from the dictionary or
+///         return the default if it is not present.
+static bool
+get_dictionary_bool(struct Dictionary const *const dict,
+                    char const *const key,
+                    bool const default_value,
+                    bool *const value)
+{
+    char const *str = Dictionary__get(dict, key);
+    if (str == NULL) {
+        *value = default_value;
+        return true;
+    }
+    if (strcmp(str, "true") == 0) {
+        *value = true;
+    } else if (strcmp(str, "false") == 0) {
+        *value = false;
+    } else {
+        LOGGER_ERROR("invalid value '%s' for parameter '%s'", str, key);
+        return false;
+    }
+    return true;
+}
+
+// NOTE We pass the trace to the batch functions as an array of keys.
+_Static_assert(sizeof(struct TraceItem) == sizeof(uint64_t),
+               "a trace item must be just its key");
+
+/// @brief  Get the batch access function unless the user disabled it
+///         (with 'batch=false') or we are profiling each access.
+static bool
+get_batch_access(struct RunnerArguments const *const args,
+                 BatchAccessFunction *const batch_func)
+{
+    bool batch = true;
+    if (!get_dictionary_bool(&args->dictionary, "batch", true, &batch)) {
+        return false;
+    }
+    *batch_func = batch && !profiler_is_enabled
+                      ? get_batch_access_function(args->algorithm)
+                      : NULL;
+    return true;
+}
 
 /// @note   The keyword 'inline' prevents a compiler warning as per:
 ///         https://stackoverflow.com/questions/32432596/warning-always-inline-function-might-not-be-inlinable-wattributes
@@ -31,13 +417,22 @@ static forceinline bool
 trace_runner(void *const runner_data,
              struct RunnerArguments const *const args,
              struct Trace const *const trace,
+             struct RunnerResults *const results,
              bool (*access_func)(void *const, uint64_t const),
              bool (*postprocess_func)(void *const),
              bool (*hist_func)(void *const, struct Histogram const **const),
-             void (*destroy_func)(void *const))
+             void (*destroy_func)(void *const),
+             double (*sampling_func)(void const *const),
+             size_t (*memory_func)(void const *const),
+             bool (*save_func)(void const *const,
+                               struct CheckpointWriter *const),
+             bool (*load_func)(void *const, struct CheckpointReader *const))
 {
     struct MissRateCurve mrc = {0};
     struct Histogram const *hist = NULL;
+    struct TelemetryProgress progress = {0};
+    struct MemoryFootprint memory = {0};
+    struct SnapshotSchedule snapshots = {0};
 
     if (runner_data == NULL || args == NULL || trace == NULL ||
         access_func == NULL || postprocess_func == NULL || hist_func == NULL ||
@@ -46,32 +441,117 @@ trace_runner(void *const runner_data,
         return false;
     }
 
-    if (args->run_mode == RUNNER_MODE_TRY_READ ||
-        args->run_mode == RUNNER_MODE_ONLY_READ) {
-        if (file_exists(args->mrc_path) && file_exists(args->hist_path)) {
-            LOGGER_INFO("skipping %s to read existing files",
-                        algorithm_names[args->algorithm]);
-            goto ok_cleanup;
-        } else if (args->run_mode == RUNNER_MODE_TRY_READ) {
-            LOGGER_INFO("MRC and/or histogram files don't exist, so running "
-                        "normally (try-read)");
-        } else if (args->run_mode == RUNNER_MODE_ONLY_READ) {
-            LOGGER_ERROR("MRC and/or histogram files don't exist, so aborting "
-                         "(read-only)");
-            return false;
-        }
+    bool skip = false;
+    if (!check_existing_outputs(args, &skip)) {
+        return false;
+    }
+    if (skip) {
+        goto ok_cleanup;
+    }
+    BatchAccessFunction batch_func = NULL;
+    if (!get_batch_access(args, &batch_func)) {
+        goto error_cleanup;
+    }
+    // NOTE Algorithms that do not support checkpoints pass NULL.
+    bool const checkpoint = args->checkpoint_path != NULL &&
+                            save_func != NULL && load_func != NULL;
+    if (args->checkpoint_path != NULL && !checkpoint) {
+        LOGGER_WARN("%s does not support checkpoints",
+                    algorithm_names[args->algorithm]);
+    }
+    size_t position = 0;
+    if (checkpoint &&
+        !load_checkpoint(runner_data, args, trace, &position, load_func)) {
+        goto error_cleanup;
+    }
+    size_t last_checkpoint = position;
+    bool const snapshot = args->snapshot_path != NULL;
+    if (snapshot &&
+        !SnapshotSchedule__init(&snapshots,
+                                args,
+                                trace,
+                                position,
+                                runner_data,
+                                hist_func)) {
+        goto error_cleanup;
     }
 
+    TelemetryProgress__init(&progress,
+                            algorithm_names[args->algorithm],
+                            trace->length);
     double const t0 = get_wall_time_sec();
-    for (size_t i = 0; i < trace->length; ++i) {
-        // NOTE I really, really, really hope that the compiler is smart
-        //      enough to inline this function!!!
-        access_func(runner_data, trace->trace[i].key);
-        if (i % 1000000 == 0) {
-            LOGGER_TRACE("Finished %zu / %zu", i, trace->length);
+    // NOTE We publish the progress once per chunk rather than checking
+    //      whether to report on every access.
+    for (size_t begin = position, end = 0; begin < trace->length;
+         begin = end) {
+        end = MIN(begin + TELEMETRY_CHUNK_SIZE, trace->length);
+        if (snapshot) {
+            end = SnapshotSchedule__get_chunk_end(&snapshots,
+                                                  trace,
+                                                  begin,
+                                                  end);
+        }
+        if (batch_func != NULL) {
+            batch_func(runner_data, &trace->trace[begin].key, end - begin);
+        } else {
+            for (size_t i = begin; i < end; ++i) {
+                Profiler__tick();
+                uint64_t const start = Profiler__start();
+                // NOTE I really, really, really hope that the compiler is
+                //      smart enough to inline this function!!!
+                access_func(runner_data, trace->trace[i].key);
+                Profiler__stop(PROFILER_SCOPE_ACCESS, start);
+            }
+        }
+        TelemetryProgress__update(
+            &progress,
+            end,
+            sampling_func != NULL ? sampling_func(runner_data) : NAN,
+            NAN);
+        if (memory_func != NULL) {
+            MemoryFootprint__update(&memory, memory_func(runner_data));
+        }
+        // NOTE The snapshots are of the live histogram, so they do not
+        //      include any post-processing (e.g. the SHARDS adjustment).
+        if (snapshot && !SnapshotSchedule__update(&snapshots,
+                                                  args,
+                                                  trace,
+                                                  end,
+                                                  runner_data,
+                                                  hist_func)) {
+            LOGGER_ERROR("failed to take MRC snapshot");
+            goto error_cleanup;
+        }
+        // NOTE We only checkpoint between chunks so that the hot loop
+        //      is unchanged.
+        if (checkpoint && args->checkpoint_interval != 0 &&
+            end < trace->length &&
+            end - last_checkpoint >= args->checkpoint_interval) {
+            if (!save_checkpoint(runner_data, args, trace, end, save_func)) {
+                LOGGER_WARN("continuing without this checkpoint");
+            }
+            last_checkpoint = end;
+        }
+    }
+    // NOTE We checkpoint before post-processing, which may modify the
+    //      state (e.g. the SHARDS adjustment), so that we can resume on
+    //      a longer trace.
+    if (checkpoint && last_checkpoint != trace->length &&
+        !save_checkpoint(runner_data, args, trace, trace->length, save_func)) {
+        LOGGER_WARN("failed to save the final checkpoint");
+    }
+    if (snapshot) {
+        LOGGER_INFO("%s -- wrote %zu MRC snapshots to '%s'",
+                    algorithm_names[args->algorithm],
+                    snapshots.stream.num_snapshots,
+                    args->snapshot_path);
+        if (!MRCSnapshotStream__finish(&snapshots.stream)) {
+            LOGGER_ERROR("failed to write MRC snapshots");
+            goto error_cleanup;
         }
     }
     double const t1 = get_wall_time_sec();
+    TelemetryProgress__destroy(&progress);
     // NOTE In the future, we will not require users to create a post-
     //      process function, but rather let it be NULL.
     if (postprocess_func != NULL) {
@@ -96,37 +576,189 @@ trace_runner(void *const runner_data,
                 t2 - t1,
                 t3 - t2,
                 t3 - t0);
-    if (args->hist_path != NULL) {
-        bool save_hist = true;
-        if (file_exists(args->hist_path)) {
-            LOGGER_WARN("file '%s' already exists!", args->hist_path);
-        }
-        if (save_hist && !Histogram__save(hist, args->hist_path)) {
-            LOGGER_WARN("failed to save histogram in '%s'", args->hist_path);
-        }
+    if (memory_func != NULL) {
+        LOGGER_INFO("%s -- Live Memory: %zu B | Peak Memory: %zu B",
+                    algorithm_names[args->algorithm],
+                    memory.live_bytes,
+                    memory.peak_bytes);
     }
-    if (args->mrc_path != NULL) {
-        bool save_mrc = true;
-        if (file_exists(args->mrc_path)) {
-            LOGGER_WARN("file '%s' already exists!", args->mrc_path);
-        }
-        if (save_mrc && !MissRateCurve__save(&mrc, args->mrc_path)) {
-            LOGGER_WARN("failed to save MRC in '%s'", args->mrc_path);
-        }
+    save_outputs(args, hist, &mrc);
+    if (results != NULL) {
+        // NOTE We move the MRC into the results, so the caller owns it.
+        *results = (struct RunnerResults){
+            .ok = true,
+            .histogram_time_sec = t1 - t0,
+            .post_process_time_sec = t2 - t1,
+            .mrc_time_sec = t3 - t2,
+            .total_time_sec = t3 - t0,
+            .memory = memory,
+            .mrc = mrc,
+        };
+        mrc = (struct MissRateCurve){0};
     }
 ok_cleanup:
+    MRCSnapshotStream__destroy(&snapshots.stream);
     destroy_func(runner_data);
     MissRateCurve__destroy(&mrc);
     return true;
 error_cleanup:
+    TelemetryProgress__destroy(&progress);
+    MRCSnapshotStream__destroy(&snapshots.stream);
     destroy_func(runner_data);
     MissRateCurve__destroy(&mrc);
     return false;
 }
 
+/// @note   The sampling algorithms take the maximum size as a parameter
+///         so that the partitioned runner can split the memory budget.
+static bool
+init_fixed_rate_shards(struct FixedRateShards *const me,
+                       struct RunnerArguments const *const args,
+                       size_t const max_size)
+{
+    struct SamplingControllerConfig config = {0};
+    double budget_ns = 0.0;
+    // NOTE Fixed-rate SHARDS has no memory bound.
+    UNUSED(max_size);
+    if (!get_dictionary_double(&args->dictionary,
+                               "cpu_budget_ns",
+                               0.0,
+                               &budget_ns)) {
+        LOGGER_ERROR("bad Fixed-Rate SHARDS parameters");
+        return false;
+    }
+    if (!FixedRateShards__init_full(me,
+                                    args->sampling_rate,
+                                    args->num_bins,
+                                    args->bin_size,
+                                    args->out_of_bounds_mode,
+                                    args->shards_adj)) {
+        return false;
+    }
+    // NOTE A budget of zero keeps the sampling rate static.
+    if (budget_ns == 0.0) {
+        return true;
+    }
+    if (!SamplingControllerConfig__init(&config, budget_ns) ||
+        !get_dictionary_double(&args->dictionary,
+                               "min_sampling",
+                               config.min_rate,
+                               &config.min_rate) ||
+        !get_dictionary_double(&args->dictionary,
+                               "max_sampling",
+                               config.max_rate,
+                               &config.max_rate) ||
+        !FixedRateShards__enable_controller(me, &config)) {
+        LOGGER_ERROR("bad sampling controller parameters");
+        FixedRateShards__destroy(me);
+        return false;
+    }
+    return true;
+}
+
+static bool
+init_fixed_size_shards(struct FixedSizeShards *const me,
+                       struct RunnerArguments const *const args,
+                       size_t const max_size)
+{
+    return FixedSizeShards__init_full(me,
+                                      args->sampling_rate,
+                                      max_size,
+                                      args->num_bins,
+                                      args->bin_size,
+                                      args->out_of_bounds_mode,
+                                      &args->dictionary);
+}
+
+static bool
+init_fused_fixed_size_shards(struct FusedFixedSizeShards *const me,
+                             struct RunnerArguments const *const args,
+                             size_t const max_size)
+{
+    return FusedFixedSizeShards__init_full(me,
+                                           args->sampling_rate,
+                                           max_size,
+                                           args->num_bins,
+                                           args->bin_size,
+                                           args->out_of_bounds_mode);
+}
+
+static bool
+init_evicting_map(struct EvictingMap *const me,
+                  struct RunnerArguments const *const args,
+                  size_t const max_size)
+{
+    return EvictingMap__init_full(me,
+                                  args->sampling_rate,
+                                  max_size,
+                                  args->num_bins,
+                                  args->bin_size,
+                                  args->out_of_bounds_mode,
+                                  &args->dictionary);
+}
+
+static bool
+init_evicting_quickmrc(struct EvictingQuickMRC *const me,
+                       struct RunnerArguments const *const args,
+                       size_t const max_size)
+{
+    return EvictingQuickMRC__init(me,
+                                  args->sampling_rate,
+                                  max_size,
+                                  args->qmrc_size,
+                                  args->num_bins,
+                                  args->bin_size,
+                                  args->out_of_bounds_mode);
+}
+
+/// @brief  Get the current sampling ratio to report in the telemetry.
+/// @note   We call these from the runner's thread, so they may read the
+///         instance without synchronization.
+static double
+get_olken_sampling(void const *const me)
+{
+    UNUSED(me);
+    return 1.0;
+}
+
+static double
+get_fixed_rate_shards_sampling(void const *const me)
+{
+    return ((struct FixedRateShards const *)me)->sampling_ratio;
+}
+
+static double
+get_fixed_size_shards_sampling(void const *const me)
+{
+    return ((struct FixedSizeShards const *)me)->sampler.sampling_ratio;
+}
+
+static double
+get_fused_fixed_size_shards_sampling(void const *const me)
+{
+    return ((struct FusedFixedSizeShards const *)me)->sampling_ratio;
+}
+
+static double
+get_evicting_map_sampling(void const *const me)
+{
+    return (double)((struct EvictingMap const *)me)
+               ->hash_table.global_threshold /
+           UINT64_MAX;
+}
+
+static double
+get_evicting_quickmrc_sampling(void const *const me)
+{
+    return (double)((struct EvictingQuickMRC const *)me)
+               ->hash_table.global_threshold /
+           UINT64_MAX;
+}
+
 static bool
 run_olken(struct RunnerArguments const *const args,
-          struct Trace const *const trace)
+          struct Trace const *const trace,
+          struct RunnerResults *const results)
 {
     struct Olken me = {0};
     if (!Olken__init_full(&me,
@@ -141,24 +773,27 @@ run_olken(struct RunnerArguments const *const args,
         &me,
         args,
         trace,
+        results,
         (bool (*)(void *const, uint64_t const))Olken__access_item,
         (bool (*)(void *const))Olken__post_process,
         (bool (*)(void *const,
                   struct Histogram const **const))Olken__get_histogram,
-        (void (*)(void *const))Olken__destroy);
+        (void (*)(void *const))Olken__destroy,
+        get_olken_sampling,
+        (size_t (*)(void const *const))Olken__memory_usage,
+        (bool (*)(void const *const, struct CheckpointWriter *const))
+            Olken__save_checkpoint,
+        (bool (*)(void *const, struct CheckpointReader *const))
+            Olken__load_checkpoint);
 }
 
 static bool
 run_fixed_rate_shards(struct RunnerArguments const *const args,
-                      struct Trace const *const trace)
+                      struct Trace const *const trace,
+                      struct RunnerResults *const results)
 {
     struct FixedRateShards me = {0};
-    if (!FixedRateShards__init_full(&me,
-                                    args->sampling_rate,
-                                    args->num_bins,
-                                    args->bin_size,
-                                    args->out_of_bounds_mode,
-                                    args->shards_adj)) {
+    if (!init_fixed_rate_shards(&me, args, args->max_size)) {
         LOGGER_ERROR("initialization failed!");
         return false;
     }
@@ -167,25 +802,27 @@ run_fixed_rate_shards(struct RunnerArguments const *const args,
         &me,
         args,
         trace,
+        results,
         (bool (*)(void *const, uint64_t const))FixedRateShards__access_item,
         (bool (*)(void *const))FixedRateShards__post_process,
         (bool (*)(void *const, struct Histogram const **const))
             FixedRateShards__get_histogram,
-        (void (*)(void *const))FixedRateShards__destroy);
+        (void (*)(void *const))FixedRateShards__destroy,
+        get_fixed_rate_shards_sampling,
+        (size_t (*)(void const *const))FixedRateShards__memory_usage,
+        (bool (*)(void const *const, struct CheckpointWriter *const))
+            FixedRateShards__save_checkpoint,
+        (bool (*)(void *const, struct CheckpointReader *const))
+            FixedRateShards__load_checkpoint);
 }
 
 static bool
 run_fixed_size_shards(struct RunnerArguments const *const args,
-                      struct Trace const *const trace)
+                      struct Trace const *const trace,
+                      struct RunnerResults *const results)
 {
     struct FixedSizeShards me = {0};
-    if (!FixedSizeShards__init_full(&me,
-                                    args->sampling_rate,
-                                    args->max_size,
-                                    args->num_bins,
-                                    args->bin_size,
-                                    args->out_of_bounds_mode,
-                                    &args->dictionary)) {
+    if (!init_fixed_size_shards(&me, args, args->max_size)) {
         LOGGER_ERROR("initialization failed!");
         return false;
     }
@@ -194,25 +831,55 @@ run_fixed_size_shards(struct RunnerArguments const *const args,
         &me,
         args,
         trace,
+        results,
         (bool (*)(void *const, uint64_t const))FixedSizeShards__access_item,
         (bool (*)(void *const))FixedSizeShards__post_process,
         (bool (*)(void *const, struct Histogram const **const))
             FixedSizeShards__get_histogram,
-        (void (*)(void *const))FixedSizeShards__destroy);
+        (void (*)(void *const))FixedSizeShards__destroy,
+        get_fixed_size_shards_sampling,
+        (size_t (*)(void const *const))FixedSizeShards__memory_usage,
+        (bool (*)(void const *const, struct CheckpointWriter *const))
+            FixedSizeShards__save_checkpoint,
+        (bool (*)(void *const, struct CheckpointReader *const))
+            FixedSizeShards__load_checkpoint);
+}
+
+static bool
+run_fused_fixed_size_shards(struct RunnerArguments const *const args,
+                            struct Trace const *const trace,
+                            struct RunnerResults *const results)
+{
+    struct FusedFixedSizeShards me = {0};
+    if (!init_fused_fixed_size_shards(&me, args, args->max_size)) {
+        LOGGER_ERROR("initialization failed!");
+        return false;
+    }
+
+    return trace_runner(
+        &me,
+        args,
+        trace,
+        results,
+        (bool (*)(void *const,
+                  uint64_t const))FusedFixedSizeShards__access_item,
+        (bool (*)(void *const))FusedFixedSizeShards__post_process,
+        (bool (*)(void *const, struct Histogram const **const))
+            FusedFixedSizeShards__get_histogram,
+        (void (*)(void *const))FusedFixedSizeShards__destroy,
+        get_fused_fixed_size_shards_sampling,
+        (size_t (*)(void const *const))FusedFixedSizeShards__memory_usage,
+        NULL,
+        NULL);
 }
 
 static bool
 run_evicting_map(struct RunnerArguments const *const args,
-                 struct Trace const *const trace)
+                 struct Trace const *const trace,
+                 struct RunnerResults *const results)
 {
     struct EvictingMap me = {0};
-    if (!EvictingMap__init_full(&me,
-                                args->sampling_rate,
-                                args->max_size,
-                                args->num_bins,
-                                args->bin_size,
-                                args->out_of_bounds_mode,
-                                &args->dictionary)) {
+    if (!init_evicting_map(&me, args, args->max_size)) {
         LOGGER_ERROR("initialization failed!");
         return false;
     }
@@ -221,25 +888,27 @@ run_evicting_map(struct RunnerArguments const *const args,
         &me,
         args,
         trace,
+        results,
         (bool (*)(void *const, uint64_t const))EvictingMap__access_item,
         (bool (*)(void *const))EvictingMap__post_process,
         (bool (*)(void *const,
                   struct Histogram const **const))EvictingMap__get_histogram,
-        (void (*)(void *const))EvictingMap__destroy);
+        (void (*)(void *const))EvictingMap__destroy,
+        get_evicting_map_sampling,
+        (size_t (*)(void const *const))EvictingMap__memory_usage,
+        (bool (*)(void const *const, struct CheckpointWriter *const))
+            EvictingMap__save_checkpoint,
+        (bool (*)(void *const, struct CheckpointReader *const))
+            EvictingMap__load_checkpoint);
 }
 
 static bool
 run_evicting_quickmrc(struct RunnerArguments const *const args,
-                      struct Trace const *const trace)
+                      struct Trace const *const trace,
+                      struct RunnerResults *const results)
 {
     struct EvictingQuickMRC me = {0};
-    if (!EvictingQuickMRC__init(&me,
-                                args->sampling_rate,
-                                args->max_size,
-                                args->qmrc_size,
-                                args->num_bins,
-                                args->bin_size,
-                                args->out_of_bounds_mode)) {
+    if (!init_evicting_quickmrc(&me, args, args->max_size)) {
         LOGGER_ERROR("initialization failed!");
         return false;
     }
@@ -248,16 +917,564 @@ run_evicting_quickmrc(struct RunnerArguments const *const args,
         &me,
         args,
         trace,
+        results,
         (bool (*)(void *const, uint64_t const))EvictingQuickMRC__access_item,
         (bool (*)(void *const))EvictingQuickMRC__post_process,
         (bool (*)(void *const, struct Histogram const **const))
             EvictingQuickMRC__get_histogram,
-        (void (*)(void *const))EvictingQuickMRC__destroy);
+        (void (*)(void *const))EvictingQuickMRC__destroy,
+        get_evicting_quickmrc_sampling,
+        (size_t (*)(void const *const))EvictingQuickMRC__memory_usage,
+        NULL,
+        NULL);
+}
+
+static bool
+run_counter_stacks(struct RunnerArguments const *const args,
+                   struct Trace const *const trace,
+                   struct RunnerResults *const results)
+{
+    struct CounterStacks me = {0};
+    uint64_t downsample_interval = 0;
+    double pruning_delta = 0.0;
+    uint64_t precision = 0;
+    if (!get_dictionary_uint64(&args->dictionary,
+                               "downsample",
+                               COUNTER_STACKS_DEFAULT_DOWNSAMPLE_INTERVAL,
+                               &downsample_interval) ||
+        !get_dictionary_double(&args->dictionary,
+                               "prune",
+                               COUNTER_STACKS_DEFAULT_PRUNING_DELTA,
+                               &pruning_delta) ||
+        !get_dictionary_uint64(&args->dictionary,
+                               "precision",
+                               COUNTER_STACKS_DEFAULT_PRECISION,
+                               &precision)) {
+        LOGGER_ERROR("bad Counter Stacks parameters");
+        return false;
+    }
+    if (!CounterStacks__init_full(&me,
+                                  downsample_interval,
+                                  pruning_delta,
+                                  precision,
+                                  args->num_bins,
+                                  args->bin_size,
+                                  args->out_of_bounds_mode)) {
+        LOGGER_ERROR("initialization failed!");
+        return false;
+    }
+
+    return trace_runner(
+        &me,
+        args,
+        trace,
+        results,
+        (bool (*)(void *const, uint64_t const))CounterStacks__access_item,
+        (bool (*)(void *const))CounterStacks__post_process,
+        (bool (*)(void *const, struct Histogram const **const))
+            CounterStacks__get_histogram,
+        (void (*)(void *const))CounterStacks__destroy,
+        NULL,
+        NULL,
+        NULL,
+        NULL);
+}
+
+/// @brief  The operations needed to run a sampling algorithm on one
+///         partition of the key space.
+struct PartitionedOps {
+    size_t instance_size;
+    bool (*init_func)(void *const,
+                      struct RunnerArguments const *const,
+                      size_t const);
+    bool (*access_func)(void *const, uint64_t const);
+    bool (*postprocess_func)(void *const);
+    bool (*hist_func)(void *const, struct Histogram const **const);
+    void (*destroy_func)(void *const);
+    size_t (*memory_func)(void const *const);
+};
+
+static struct PartitionedOps const FIXED_RATE_SHARDS_OPS = {
+    .instance_size = sizeof(struct FixedRateShards),
+    .init_func = (bool (*)(void *const,
+                           struct RunnerArguments const *const,
+                           size_t const))init_fixed_rate_shards,
+    .access_func =
+        (bool (*)(void *const, uint64_t const))FixedRateShards__access_item,
+    .postprocess_func = (bool (*)(void *const))FixedRateShards__post_process,
+    .hist_func = (bool (*)(void *const, struct Histogram const **const))
+        FixedRateShards__get_histogram,
+    .destroy_func = (void (*)(void *const))FixedRateShards__destroy,
+    .memory_func = (size_t (*)(void const *const))FixedRateShards__memory_usage,
+};
+
+static struct PartitionedOps const FIXED_SIZE_SHARDS_OPS = {
+    .instance_size = sizeof(struct FixedSizeShards),
+    .init_func = (bool (*)(void *const,
+                           struct RunnerArguments const *const,
+                           size_t const))init_fixed_size_shards,
+    .access_func =
+        (bool (*)(void *const, uint64_t const))FixedSizeShards__access_item,
+    .postprocess_func = (bool (*)(void *const))FixedSizeShards__post_process,
+    .hist_func = (bool (*)(void *const, struct Histogram const **const))
+        FixedSizeShards__get_histogram,
+    .destroy_func = (void (*)(void *const))FixedSizeShards__destroy,
+    .memory_func = (size_t (*)(void const *const))FixedSizeShards__memory_usage,
+};
+
+static struct PartitionedOps const FUSED_FIXED_SIZE_SHARDS_OPS = {
+    .instance_size = sizeof(struct FusedFixedSizeShards),
+    .init_func = (bool (*)(void *const,
+                           struct RunnerArguments const *const,
+                           size_t const))init_fused_fixed_size_shards,
+    .access_func = (bool (*)(void *const,
+                             uint64_t const))FusedFixedSizeShards__access_item,
+    .postprocess_func =
+        (bool (*)(void *const))FusedFixedSizeShards__post_process,
+    .hist_func = (bool (*)(void *const, struct Histogram const **const))
+        FusedFixedSizeShards__get_histogram,
+    .destroy_func = (void (*)(void *const))FusedFixedSizeShards__destroy,
+    .memory_func = (size_t (*)(void const *const))FusedFixedSizeShards__memory_usage,
+};
+
+static struct PartitionedOps const EVICTING_MAP_OPS = {
+    .instance_size = sizeof(struct EvictingMap),
+    .init_func = (bool (*)(void *const,
+                           struct RunnerArguments const *const,
+                           size_t const))init_evicting_map,
+    .access_func =
+        (bool (*)(void *const, uint64_t const))EvictingMap__access_item,
+    .postprocess_func = (bool (*)(void *const))EvictingMap__post_process,
+    .hist_func = (bool (*)(void *const, struct Histogram const **const))
+        EvictingMap__get_histogram,
+    .destroy_func = (void (*)(void *const))EvictingMap__destroy,
+    .memory_func = (size_t (*)(void const *const))EvictingMap__memory_usage,
+};
+
+static struct PartitionedOps const EVICTING_QUICKMRC_OPS = {
+    .instance_size = sizeof(struct EvictingQuickMRC),
+    .init_func = (bool (*)(void *const,
+                           struct RunnerArguments const *const,
+                           size_t const))init_evicting_quickmrc,
+    .access_func =
+        (bool (*)(void *const, uint64_t const))EvictingQuickMRC__access_item,
+    .postprocess_func = (bool (*)(void *const))EvictingQuickMRC__post_process,
+    .hist_func = (bool (*)(void *const, struct Histogram const **const))
+        EvictingQuickMRC__get_histogram,
+    .destroy_func = (void (*)(void *const))EvictingQuickMRC__destroy,
+    .memory_func = (size_t (*)(void const *const))EvictingQuickMRC__memory_usage,
+};
+
+/// @brief  Get the partitioned operations for an algorithm or NULL if
+///         the algorithm does not sample by hash.
+static struct PartitionedOps const *
+get_partitioned_ops(enum MRCAlgorithm const algorithm)
+{
+    switch (algorithm) {
+    case MRC_ALGORITHM_FIXED_RATE_SHARDS:
+        return &FIXED_RATE_SHARDS_OPS;
+    case MRC_ALGORITHM_FIXED_SIZE_SHARDS:
+        return &FIXED_SIZE_SHARDS_OPS;
+    case MRC_ALGORITHM_FUSED_FIXED_SIZE_SHARDS:
+        return &FUSED_FIXED_SIZE_SHARDS_OPS;
+    case MRC_ALGORITHM_EVICTING_MAP:
+        return &EVICTING_MAP_OPS;
+    case MRC_ALGORITHM_EVICTING_QUICKMRC:
+        return &EVICTING_QUICKMRC_OPS;
+    default:
+        return NULL;
+    }
+}
+
+/// @brief  Map a key's hash to its partition.
+/// @note   We scramble the hash (with Fibonacci hashing) so that the
+///         partition is independent of the bits that the algorithms use
+///         for sampling (the high bits) and bucketing (the low bits).
+///         This is much cheaper than hashing the hash again.
+static inline uint64_t
+get_partition(Hash64BitType const hash, uint64_t const num_partitions)
+{
+    return ((hash * UINT64_C(0x9E3779B97F4A7C15)) >> 32) % num_partitions;
+}
+
+/// @brief  The keys of one slice of the trace that belong to one
+///         partition, in trace order.
+struct PartitionKeys {
+    uint64_t *keys;
+    size_t length;
+    size_t capacity;
+};
+
+struct PartitionWorker {
+    struct PartitionedOps const *ops;
+    struct RunnerArguments const *args;
+    struct Trace const *trace;
+    // NOTE The workers read each other's buckets once the split is done.
+    struct PartitionWorker const *workers;
+    // The keys of this worker's slice of the trace, by partition.
+    struct PartitionKeys *buckets;
+    uint64_t partition;
+    uint64_t num_partitions;
+    // NOTE We allocate the instance on the heap because we don't know
+    //      its type statically.
+    void *instance;
+    struct MemoryFootprint memory;
+    bool initialized;
+    bool ok;
+};
+
+static bool
+PartitionKeys__append(struct PartitionKeys *const me, uint64_t const key)
+{
+    if (me->length == me->capacity) {
+        size_t const capacity = 2 * me->capacity;
+        uint64_t *const keys = realloc(me->keys, capacity * sizeof(*keys));
+        if (keys == NULL) {
+            return false;
+        }
+        me->keys = keys;
+        me->capacity = capacity;
+    }
+    me->keys[me->length++] = key;
+    return true;
+}
+
+/// @brief  Split this worker's slice of the trace among the partitions.
+/// @note   Each worker scans a disjoint slice, so together they read the
+///         trace and hash each key only once. We append to each bucket
+///         rather than count the partitions first, so that we only make
+///         a single pass.
+static void *
+split_worker(void *arg)
+{
+    struct PartitionWorker *const w = arg;
+    uint64_t const n = w->num_partitions;
+    size_t const begin = w->trace->length * w->partition / n;
+    size_t const end = w->trace->length * (w->partition + 1) / n;
+    // NOTE The partitions are about equal, so we rarely need to grow.
+    size_t const expected = (end - begin) / n;
+
+    w->ok = false;
+    for (uint64_t p = 0; p < n; ++p) {
+        struct PartitionKeys *const b = &w->buckets[p];
+        b->capacity = expected + expected / 8 + 1024;
+        b->keys = malloc(b->capacity * sizeof(*b->keys));
+        if (b->keys == NULL) {
+            LOGGER_ERROR("failed to allocate bucket %" PRIu64, p);
+            return NULL;
+        }
+    }
+    for (size_t i = begin; i < end; ++i) {
+        uint64_t const key = w->trace->trace[i].key;
+        uint64_t const p = get_partition(Hash64Bit(key), n);
+        if (!PartitionKeys__append(&w->buckets[p], key)) {
+            LOGGER_ERROR("failed to grow bucket %" PRIu64, p);
+            return NULL;
+        }
+    }
+    w->ok = true;
+    return NULL;
+}
+
+static void *
+partition_worker(void *arg)
+{
+    struct PartitionWorker *const w = arg;
+    struct PartitionedOps const *const ops = w->ops;
+    size_t const max_size = MAX(w->args->max_size / w->num_partitions, 1);
+    size_t num_keys = 0, num_done = 0;
+
+    w->ok = false;
+    if (!ops->init_func(w->instance, w->args, max_size)) {
+        LOGGER_ERROR("initialization of partition %" PRIu64 " failed!",
+                     w->partition);
+        return NULL;
+    }
+    w->initialized = true;
+    for (uint64_t s = 0; s < w->num_partitions; ++s) {
+        num_keys += w->workers[s].buckets[w->partition].length;
+    }
+    struct TelemetryProgress progress = {0};
+    char name[sizeof(progress.name)] = {0};
+    snprintf(name,
+             sizeof(name),
+             "%s[%" PRIu64 "]",
+             algorithm_names[w->args->algorithm],
+             w->partition);
+    TelemetryProgress__init(&progress, name, num_keys);
+    // NOTE We process the slices in order, so that the partition sees its
+    //      keys in trace order.
+    for (uint64_t s = 0; s < w->num_partitions; ++s) {
+        struct PartitionKeys const *const b =
+            &w->workers[s].buckets[w->partition];
+        for (size_t begin = 0; begin < b->length;
+             begin += TELEMETRY_CHUNK_SIZE) {
+            size_t const end = MIN(begin + TELEMETRY_CHUNK_SIZE, b->length);
+            for (size_t i = begin; i < end; ++i) {
+                Profiler__tick();
+                uint64_t const start = Profiler__start();
+                bool const ok = ops->access_func(w->instance, b->keys[i]);
+                Profiler__stop(PROFILER_SCOPE_ACCESS, start);
+                if (!ok) {
+                    LOGGER_ERROR("access %zu of partition %" PRIu64
+                                 " failed!",
+                                 num_done + i - begin,
+                                 w->partition);
+                    TelemetryProgress__destroy(&progress);
+                    return NULL;
+                }
+            }
+            num_done += end - begin;
+            TelemetryProgress__update(&progress, num_done, NAN, NAN);
+            MemoryFootprint__update(&w->memory,
+                                    ops->memory_func(w->instance));
+        }
+    }
+    TelemetryProgress__destroy(&progress);
+    w->ok = ops->postprocess_func(w->instance);
+    return NULL;
+}
+
+/// @brief  Run 'func' on every worker in its own thread.
+/// @return false if we failed to create a thread or any worker failed.
+static bool
+run_workers(struct PartitionWorker *const workers,
+            pthread_t *const threads,
+            uint64_t const num_partitions,
+            void *(*func)(void *))
+{
+    uint64_t num_threads = 0;
+    bool ok = true;
+    for (; num_threads < num_partitions; ++num_threads) {
+        if (pthread_create(&threads[num_threads],
+                           NULL,
+                           func,
+                           &workers[num_threads]) != 0) {
+            LOGGER_ERROR("failed to create thread %" PRIu64, num_threads);
+            ok = false;
+            break;
+        }
+    }
+    for (uint64_t t = 0; t < num_threads; ++t) {
+        pthread_join(threads[t], NULL);
+        ok = ok && workers[t].ok;
+    }
+    return ok;
+}
+
+/// @brief  Run a single, unpartitioned instance to compare against.
+static bool
+run_unpartitioned(struct PartitionedOps const *const ops,
+                  struct RunnerArguments const *const args,
+                  struct Trace const *const trace,
+                  struct MissRateCurve *const mrc,
+                  double *const time)
+{
+    struct Histogram const *hist = NULL;
+    void *instance = calloc(1, ops->instance_size);
+    if (instance == NULL) {
+        LOGGER_ERROR("calloc failed");
+        return false;
+    }
+    if (!ops->init_func(instance, args, args->max_size)) {
+        LOGGER_ERROR("initialization failed!");
+        free(instance);
+        return false;
+    }
+    double const t0 = get_wall_time_sec();
+    bool ok = true;
+    for (size_t i = 0; i < trace->length && ok; ++i) {
+        ok = ops->access_func(instance, trace->trace[i].key);
+    }
+    if (!ok) {
+        LOGGER_ERROR("access failed!");
+    }
+    ok = ok && ops->postprocess_func(instance);
+    *time = get_wall_time_sec() - t0;
+    ok = ok && ops->hist_func(instance, &hist) &&
+         MissRateCurve__init_from_histogram(mrc, hist);
+    ops->destroy_func(instance);
+    free(instance);
+    return ok;
+}
+
+/// @brief  Run a sampling algorithm on independent partitions of the
+///         key space in parallel and combine the results.
+/// @details    Since the algorithms sample by hash, the partitions are
+///             statistically independent sub-traces. Each partition
+///             gets 1/N of the memory budget and sees reuse distances
+///             that are about 1/N of the full trace's, so we stretch
+///             each partition's histogram by N before adding it.
+/// @note   Use the dictionary parameter 'partitions=N' to enable this
+///         and 'compare=true' to also run the single-threaded version
+///         and report the difference between the two.
+static bool
+run_partitioned(struct RunnerArguments const *const args,
+                struct Trace const *const trace,
+                uint64_t const num_partitions,
+                struct RunnerResults *const results)
+{
+    struct PartitionedOps const *const ops =
+        get_partitioned_ops(args->algorithm);
+    struct PartitionWorker *workers = NULL;
+    pthread_t *threads = NULL;
+    struct Histogram hist = {0};
+    struct MissRateCurve mrc = {0}, single_mrc = {0};
+    bool ok = false;
+
+    assert(ops != NULL && num_partitions > 1);
+    bool skip = false;
+    if (!check_existing_outputs(args, &skip)) {
+        return false;
+    }
+    if (skip) {
+        return true;
+    }
+    workers = calloc(num_partitions, sizeof(*workers));
+    threads = calloc(num_partitions, sizeof(*threads));
+    if (workers == NULL || threads == NULL) {
+        LOGGER_ERROR("calloc failed");
+        goto cleanup;
+    }
+    for (uint64_t p = 0; p < num_partitions; ++p) {
+        workers[p] = (struct PartitionWorker){
+            .ops = ops,
+            .args = args,
+            .trace = trace,
+            .workers = workers,
+            .buckets = calloc(num_partitions, sizeof(struct PartitionKeys)),
+            .partition = p,
+            .num_partitions = num_partitions,
+            .instance = calloc(1, ops->instance_size),
+            .memory = {0},
+            .initialized = false,
+            .ok = false,
+        };
+        if (workers[p].instance == NULL || workers[p].buckets == NULL) {
+            LOGGER_ERROR("calloc failed");
+            goto cleanup;
+        }
+    }
+
+    // NOTE We split the trace up front, rather than have each thread scan
+    //      the whole trace for its own keys, so that the partitions
+    //      divide the work rather than repeat it.
+    double const t0 = get_wall_time_sec();
+    if (!run_workers(workers, threads, num_partitions, split_worker)) {
+        LOGGER_ERROR("failed to split the trace");
+        goto cleanup;
+    }
+    if (!run_workers(workers, threads, num_partitions, partition_worker)) {
+        LOGGER_ERROR("failed to run the partitions");
+        goto cleanup;
+    }
+    double const t1 = get_wall_time_sec();
+
+    if (!Histogram__init(&hist,
+                         args->num_bins,
+                         args->bin_size,
+                         args->out_of_bounds_mode)) {
+        LOGGER_ERROR("histogram initialization failed");
+        goto cleanup;
+    }
+    for (uint64_t p = 0; p < num_partitions; ++p) {
+        struct Histogram const *partition_hist = NULL;
+        if (!ops->hist_func(workers[p].instance, &partition_hist) ||
+            !Histogram__iadd_stretched(&hist, partition_hist, num_partitions)) {
+            LOGGER_ERROR("partition %" PRIu64 " failed", p);
+            goto cleanup;
+        }
+    }
+    if (!MissRateCurve__init_from_histogram(&mrc, &hist)) {
+        LOGGER_ERROR("MRC initialization failed");
+        goto cleanup;
+    }
+    double const t2 = get_wall_time_sec();
+    LOGGER_INFO("%s with %" PRIu64 " partitions -- Histogram Time: %f | "
+                "Combine Time: %f | Total Time: %f",
+                algorithm_names[args->algorithm],
+                num_partitions,
+                t1 - t0,
+                t2 - t1,
+                t2 - t0);
+    // NOTE The sum of the partitions' peaks is an upper bound, since
+    //      they need not peak at the same time.
+    struct MemoryFootprint memory = {0};
+    for (uint64_t p = 0; p < num_partitions; ++p) {
+        memory.live_bytes += workers[p].memory.live_bytes;
+        memory.peak_bytes += workers[p].memory.peak_bytes;
+    }
+    LOGGER_INFO("%s with %" PRIu64 " partitions -- Live Memory: %zu B | "
+                "Peak Memory: %zu B",
+                algorithm_names[args->algorithm],
+                num_partitions,
+                memory.live_bytes,
+                memory.peak_bytes);
+
+    char const *compare = Dictionary__get(&args->dictionary, "compare");
+    if (compare != NULL && strcmp(compare, "true") == 0) {
+        double single_time = 0.0;
+        if (!run_unpartitioned(ops, args, trace, &single_mrc, &single_time)) {
+            LOGGER_ERROR("unpartitioned run failed");
+            goto cleanup;
+        }
+        LOGGER_INFO("%s partitioned vs unpartitioned -- MAE: %f | MSE: %f | "
+                    "Unpartitioned Time: %f | Speedup: %f",
+                    algorithm_names[args->algorithm],
+                    MissRateCurve__mean_absolute_error(&mrc, &single_mrc),
+                    MissRateCurve__mean_squared_error(&mrc, &single_mrc),
+                    single_time,
+                    single_time / (t2 - t0));
+    }
+    save_outputs(args, &hist, &mrc);
+    if (results != NULL) {
+        // NOTE The combine time includes creating the MRC.
+        *results = (struct RunnerResults){
+            .ok = true,
+            .histogram_time_sec = t1 - t0,
+            .post_process_time_sec = t2 - t1,
+            .mrc_time_sec = 0.0,
+            .total_time_sec = t2 - t0,
+            .memory = memory,
+            .mrc = mrc,
+        };
+        mrc = (struct MissRateCurve){0};
+    }
+    ok = true;
+cleanup:
+    if (workers != NULL) {
+        for (uint64_t p = 0; p < num_partitions; ++p) {
+            if (workers[p].initialized) {
+                ops->destroy_func(workers[p].instance);
+            }
+            free(workers[p].instance);
+            if (workers[p].buckets != NULL) {
+                for (uint64_t q = 0; q < num_partitions; ++q) {
+                    free(workers[p].buckets[q].keys);
+                }
+            }
+            free(workers[p].buckets);
+        }
+    }
+    free(workers);
+    free(threads);
+    Histogram__destroy(&hist);
+    MissRateCurve__destroy(&mrc);
+    MissRateCurve__destroy(&single_mrc);
+    return ok;
 }
 
 bool
 run_runner(struct RunnerArguments const *const args,
            struct Trace const *const trace)
+{
+    return run_runner_with_results(args, trace, NULL);
+}
+
+bool
+run_runner_with_results(struct RunnerArguments const *const args,
+                        struct Trace const *const trace,
+                        struct RunnerResults *const results)
 {
     if (!args->ok) {
         // NOTE I have a bunch of checks in place so this shouldn't
@@ -267,32 +1484,67 @@ run_runner(struct RunnerArguments const *const args,
         return false;
     }
     RunnerArguments__println(args, LOGGER_STREAM);
+    uint64_t num_partitions = 0;
+    if (!get_dictionary_uint64(&args->dictionary,
+                               "partitions",
+                               1,
+                               &num_partitions)) {
+        return false;
+    }
+    if (num_partitions > 1) {
+        if (get_partitioned_ops(args->algorithm) != NULL) {
+            if (args->checkpoint_path != NULL) {
+                LOGGER_WARN("checkpoints are not supported with partitions");
+            }
+            if (args->snapshot_path != NULL) {
+                LOGGER_WARN("MRC snapshots are not supported with "
+                            "partitions");
+            }
+            if (!run_partitioned(args, trace, num_partitions, results)) {
+                LOGGER_WARN("partitioned %s failed. Continuing...",
+                            algorithm_names[args->algorithm]);
+            }
+            return true;
+        }
+        LOGGER_WARN("%s does not support partitions, so running normally",
+                    algorithm_names[args->algorithm]);
+    }
     switch (args->algorithm) {
     case MRC_ALGORITHM_OLKEN:
-        if (!run_olken(args, trace)) {
+        if (!run_olken(args, trace, results)) {
             LOGGER_WARN("Olken failed. Continuing...");
         }
         return true;
     case MRC_ALGORITHM_FIXED_RATE_SHARDS:
-        if (!run_fixed_rate_shards(args, trace)) {
+        if (!run_fixed_rate_shards(args, trace, results)) {
             LOGGER_WARN("Fixed-Rate SHARDS failed. Continuing...");
         }
         return true;
     case MRC_ALGORITHM_FIXED_SIZE_SHARDS:
-        if (!run_fixed_size_shards(args, trace)) {
+        if (!run_fixed_size_shards(args, trace, results)) {
             LOGGER_WARN("Fixed-Size SHARDS failed. Continuing...");
         }
         return true;
+    case MRC_ALGORITHM_FUSED_FIXED_SIZE_SHARDS:
+        if (!run_fused_fixed_size_shards(args, trace, results)) {
+            LOGGER_WARN("Fused Fixed-Size SHARDS failed. Continuing...");
+        }
+        return true;
     case MRC_ALGORITHM_EVICTING_MAP:
-        if (!run_evicting_map(args, trace)) {
+        if (!run_evicting_map(args, trace, results)) {
             LOGGER_WARN("Evicting Map failed. Continuing...");
         }
         return true;
     case MRC_ALGORITHM_EVICTING_QUICKMRC:
-        if (!run_evicting_quickmrc(args, trace)) {
+        if (!run_evicting_quickmrc(args, trace, results)) {
             LOGGER_WARN("Evicting QuickMRC failed. Continuing...");
         }
         return true;
+    case MRC_ALGORITHM_COUNTER_STACKS:
+        if (!run_counter_stacks(args, trace, results)) {
+            LOGGER_WARN("Counter Stacks failed. Continuing...");
+        }
+        return true;
     case MRC_ALGORITHM_QUICKMRC:
     case MRC_ALGORITHM_GOEL_QUICKMRC:
     case MRC_ALGORITHM_AVERAGE_EVICTION_TIME:
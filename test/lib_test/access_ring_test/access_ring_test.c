@@ -0,0 +1,150 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "access_ring/access_ring.h"
+#include "test/mytester.h"
+#include "trace/trace.h"
+#include "unused/mark_unused.h"
+
+#define RING_CAPACITY 64
+#define BATCH_SIZE    24
+#define NUM_RECORDS   100000
+
+struct ProducerArgs {
+    char const *name;
+    bool drop_when_full;
+    uint64_t num_pushed;
+};
+
+static void *
+produce(void *arg)
+{
+    struct ProducerArgs *const args = arg;
+    struct AccessRingProducer me = {0};
+    struct FullTraceItem items[BATCH_SIZE] = {0};
+
+    g_assert_true(AccessRingProducer__init(&me, args->name, RING_CAPACITY));
+    me.drop_when_full = args->drop_when_full;
+    g_assert_true(AccessRingProducer__wait_for_consumer(&me, 0));
+    for (uint64_t i = 0; i < NUM_RECORDS;) {
+        size_t n = 0;
+        for (; n < BATCH_SIZE && i < NUM_RECORDS; ++n, ++i) {
+            items[n] = (struct FullTraceItem){.timestamp_ms = i,
+                                              .key = i,
+                                              .size = i % 1000};
+        }
+        args->num_pushed += AccessRingProducer__push_batch(&me, items, n);
+    }
+    AccessRingProducer__destroy(&me);
+    return NULL;
+}
+
+/// @brief  Read everything that a producer in another thread pushes.
+/// @param  drop_when_full: whether the producer drops rather than waits.
+static bool
+test_producer_consumer(bool const drop_when_full)
+{
+    char name[64] = {0};
+    pthread_t thread;
+    struct ProducerArgs args = {.name = name,
+                                .drop_when_full = drop_when_full};
+    struct AccessRingConsumer me = {0};
+    struct FullTraceItem items[BATCH_SIZE] = {0};
+    uint64_t num_read = 0, prev_key = 0;
+
+    snprintf(name, sizeof(name), "/access_ring_test_%d", (int)getpid());
+    g_assert_cmpint(pthread_create(&thread, NULL, produce, &args), ==, 0);
+    g_assert_true(AccessRingConsumer__init(&me, name, 10000));
+    while (!AccessRingConsumer__is_done(&me)) {
+        size_t const n = AccessRingConsumer__read(&me, items, BATCH_SIZE);
+        for (size_t i = 0; i < n; ++i) {
+            // NOTE We preserve the producer's order, so the keys strictly
+            //      increase (and are contiguous unless we dropped some).
+            if (num_read != 0) {
+                g_assert_cmpuint(items[i].key, >, prev_key);
+            }
+            if (!drop_when_full) {
+                g_assert_cmpuint(items[i].key, ==, num_read);
+            }
+            g_assert_cmpuint(items[i].timestamp_ms, ==, items[i].key);
+            g_assert_cmpuint(items[i].size, ==, items[i].key % 1000);
+            prev_key = items[i].key;
+            ++num_read;
+        }
+        if (drop_when_full) {
+            // NOTE A slow consumer makes the producer drop records.
+            usleep(100);
+        } else if (n == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    g_assert_cmpuint(num_read, ==, args.num_pushed);
+    g_assert_cmpuint(num_read + AccessRingConsumer__num_dropped(&me),
+                     ==,
+                     NUM_RECORDS);
+    if (drop_when_full) {
+        g_assert_cmpuint(AccessRingConsumer__num_dropped(&me), >, 0);
+    } else {
+        g_assert_cmpuint(AccessRingConsumer__num_dropped(&me), ==, 0);
+    }
+    AccessRingConsumer__destroy(&me);
+    return true;
+}
+
+/// @brief  Check that we refuse missing rings and second consumers.
+static bool
+test_attach(void)
+{
+    char name[64] = {0};
+    struct AccessRingProducer producer = {0};
+    struct AccessRingConsumer consumer = {0}, other = {0};
+
+    snprintf(name, sizeof(name), "/access_ring_test_attach_%d", (int)getpid());
+    g_assert_false(AccessRingConsumer__init(&consumer, name, 0));
+    g_assert_true(AccessRingProducer__init(&producer, name, 3));
+    g_assert_false(AccessRingProducer__wait_for_consumer(&producer, 1));
+    g_assert_true(AccessRingConsumer__init(&consumer, name, 0));
+    g_assert_false(AccessRingConsumer__init(&other, name, 0));
+    g_assert_true(AccessRingProducer__wait_for_consumer(&producer, 1));
+
+    // NOTE We rounded the capacity of 3 up to 4.
+    for (uint64_t i = 0; i < 4; ++i) {
+        g_assert_true(AccessRingProducer__push(
+            &producer,
+            &(struct FullTraceItem){.key = i}));
+    }
+    producer.drop_when_full = true;
+    g_assert_false(AccessRingProducer__push(&producer,
+                                            &(struct FullTraceItem){.key = 4}));
+    g_assert_false(AccessRingConsumer__is_done(&consumer));
+    AccessRingProducer__destroy(&producer);
+    // NOTE The consumer still drains the records after the producer
+    //      closes the ring.
+    g_assert_false(AccessRingConsumer__is_done(&consumer));
+    struct FullTraceItem items[8] = {0};
+    g_assert_cmpuint(AccessRingConsumer__read(&consumer, items, 8), ==, 4);
+    g_assert_cmpuint(items[3].key, ==, 3);
+    g_assert_true(AccessRingConsumer__is_done(&consumer));
+    g_assert_cmpuint(AccessRingConsumer__num_dropped(&consumer), ==, 1);
+    AccessRingConsumer__destroy(&consumer);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(test_attach());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_producer_consumer(false));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_producer_consumer(true));
+    return EXIT_SUCCESS;
+}
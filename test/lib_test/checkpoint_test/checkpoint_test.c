@@ -0,0 +1,487 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "average_eviction_time/average_eviction_time.h"
+#include "checkpoint/checkpoint.h"
+#include "evicting_map/evicting_map.h"
+#include "histogram/histogram.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "olken/olken.h"
+#include "priority_queue/heap.h"
+#include "quickmrc/quickmrc.h"
+#include "sampler/phase_sampler.h"
+#include "random/zipfian_random.h"
+#include "shards/fixed_rate_shards.h"
+#include "shards/fixed_size_shards.h"
+#include "test/mytester.h"
+#include "unused/mark_unused.h"
+
+#define PATH        "checkpoint_test.ckpt"
+#define TAG         "checkpoint_test"
+#define LENGTH      100000
+#define NUM_KEYS    10000
+#define NUM_BINS    1000
+#define HEAP_LENGTH 100
+#define MAX_SIZE    1000
+// NOTE This is small enough that every bucket fills up.
+#define NUM_BUCKETS 128
+// NOTE These are small enough that QuickMRC ages its buckets.
+#define NUM_QMRC_BUCKETS 16
+#define QMRC_BUCKET_SIZE (1 << 8)
+// NOTE This does not divide the checkpoint's position, so we checkpoint
+//      in the middle of a phase.
+#define PHASE_EPOCH (LENGTH / 7)
+
+typedef bool (*SaveFunction)(void const *const,
+                             struct CheckpointWriter *const);
+typedef bool (*LoadFunction)(void *const, struct CheckpointReader *const);
+
+static bool
+test_bad_files(void)
+{
+    struct CheckpointWriter w = {0};
+    struct CheckpointReader r = {0};
+    uint64_t const values[] = {1, 2, 3};
+    size_t nmemb = 0;
+    gchar *contents = NULL;
+    gsize length = 0;
+
+    // NOTE We ignore the error, since there is usually no stale file
+    //      from an earlier (aborted) run.
+    remove(PATH);
+    g_assert_true(CheckpointWriter__init(&w, PATH, TAG, 42));
+    g_assert_true(CheckpointWriter__write_u64(&w, 7));
+    g_assert_true(CheckpointWriter__write_array(&w, values, 3, sizeof(*values)));
+    // Until we commit, the checkpoint does not exist.
+    g_assert_false(CheckpointReader__init(&r, PATH, TAG));
+    g_assert_true(CheckpointWriter__commit(&w));
+    CheckpointWriter__destroy(&w);
+
+    g_assert_true(CheckpointReader__init(&r, PATH, TAG));
+    g_assert_cmpuint(r.position, ==, 42);
+    uint64_t x = 0;
+    g_assert_true(CheckpointReader__read_u64(&r, &x));
+    g_assert_cmpuint(x, ==, 7);
+    uint64_t const *const array =
+        CheckpointReader__read_array(&r, &nmemb, sizeof(*array));
+    g_assert_nonnull(array);
+    g_assert_cmpuint(nmemb, ==, 3);
+    g_assert_cmpuint(array[2], ==, 3);
+    g_assert_true(CheckpointReader__is_done(&r));
+    // We may not read past the footer.
+    g_assert_false(CheckpointReader__read_u64(&r, &x));
+    CheckpointReader__destroy(&r);
+
+    // The wrong tag.
+    g_assert_false(CheckpointReader__init(&r, PATH, "other"));
+
+    // A truncated file.
+    g_assert_true(g_file_get_contents(PATH, &contents, &length, NULL));
+    g_assert_true(g_file_set_contents(PATH, contents, length - 1, NULL));
+    g_assert_false(CheckpointReader__init(&r, PATH, TAG));
+
+    g_free(contents);
+    g_assert_true(remove(PATH) == 0);
+    return true;
+}
+
+static bool
+test_heap(void)
+{
+    struct Heap me = {0}, other = {0};
+    struct CheckpointWriter w = {0};
+    struct CheckpointReader r = {0};
+
+    g_assert_true(Heap__init_max_heap(&me, HEAP_LENGTH));
+    g_assert_true(Heap__init_max_heap(&other, HEAP_LENGTH));
+    for (size_t i = 0; i < HEAP_LENGTH; ++i) {
+        // NOTE The max-heap reserves the key 0 for its empty slots.
+        g_assert_true(Heap__insert(&me, 1 + (i * 37) % HEAP_LENGTH, i));
+    }
+
+    g_assert_true(CheckpointWriter__init(&w, PATH, TAG, 0));
+    g_assert_true(Heap__save_checkpoint(&me, &w));
+    g_assert_true(CheckpointWriter__commit(&w));
+    CheckpointWriter__destroy(&w);
+    g_assert_true(CheckpointReader__init(&r, PATH, TAG));
+    g_assert_true(Heap__load_checkpoint(&other, &r));
+    g_assert_true(CheckpointReader__is_done(&r));
+    CheckpointReader__destroy(&r);
+
+    g_assert_cmpuint(other.length, ==, me.length);
+    for (size_t i = 0; i < HEAP_LENGTH; ++i) {
+        g_assert_cmpuint(Heap__get_top_key(&other), ==, Heap__get_top_key(&me));
+        ValueType a = 0, b = 0;
+        g_assert_true(Heap__remove(&me, Heap__get_top_key(&me), &a));
+        g_assert_true(Heap__remove(&other, Heap__get_top_key(&other), &b));
+        g_assert_cmpuint(a, ==, b);
+    }
+
+    Heap__destroy(&me);
+    Heap__destroy(&other);
+    g_assert_true(remove(PATH) == 0);
+    return true;
+}
+
+static EntryType *
+generate_trace(void)
+{
+    struct ZipfianRandom zrng = {0};
+    EntryType *trace = malloc(LENGTH * sizeof(*trace));
+
+    g_assert_nonnull(trace);
+    g_assert_true(ZipfianRandom__init(&zrng, NUM_KEYS, 0.99, 0));
+    for (size_t i = 0; i < LENGTH; ++i) {
+        trace[i] = ZipfianRandom__next(&zrng);
+    }
+    ZipfianRandom__destroy(&zrng);
+    return trace;
+}
+
+/// @brief  Save 'first' after 'position' accesses and load it into the
+///         freshly initialized 'second'.
+static bool
+save_and_load(void const *const first,
+              void *const second,
+              size_t const position,
+              SaveFunction save_func,
+              LoadFunction load_func)
+{
+    struct CheckpointWriter w = {0};
+    struct CheckpointReader r = {0};
+
+    g_assert_true(CheckpointWriter__init(&w, PATH, TAG, position));
+    g_assert_true(save_func(first, &w));
+    g_assert_true(CheckpointWriter__commit(&w));
+    CheckpointWriter__destroy(&w);
+
+    g_assert_true(CheckpointReader__init(&r, PATH, TAG));
+    g_assert_cmpuint(r.position, ==, position);
+    g_assert_true(load_func(second, &r));
+    g_assert_true(CheckpointReader__is_done(&r));
+    CheckpointReader__destroy(&r);
+    g_assert_true(remove(PATH) == 0);
+    return true;
+}
+
+/// @brief  Check that resuming Olken from a checkpoint half-way through
+///         gives the same histogram as an uninterrupted run.
+static bool
+test_olken_resume(void)
+{
+    struct Olken full = {0}, first = {0}, second = {0};
+    EntryType *trace = generate_trace();
+
+    g_assert_true(Olken__init(&full, NUM_BINS, 1));
+    g_assert_true(Olken__init(&first, NUM_BINS, 1));
+    g_assert_true(Olken__init(&second, NUM_BINS, 1));
+    for (size_t i = 0; i < LENGTH; ++i) {
+        Olken__access_item(&full, trace[i]);
+    }
+    for (size_t i = 0; i < LENGTH / 2; ++i) {
+        Olken__access_item(&first, trace[i]);
+    }
+    g_assert_true(save_and_load(&first,
+                                &second,
+                                LENGTH / 2,
+                                (SaveFunction)Olken__save_checkpoint,
+                                (LoadFunction)Olken__load_checkpoint));
+    Olken__destroy(&first);
+    for (size_t i = LENGTH / 2; i < LENGTH; ++i) {
+        Olken__access_item(&second, trace[i]);
+    }
+
+    g_assert_cmpuint(Olken__get_cardinality(&second),
+                     ==,
+                     Olken__get_cardinality(&full));
+    g_assert_true(
+        Histogram__exactly_equal(&second.histogram, &full.histogram));
+
+    Olken__destroy(&full);
+    Olken__destroy(&second);
+    free(trace);
+    return true;
+}
+
+/// @brief  Check that resuming Fixed-Rate SHARDS restores the sampling
+///         ratio, threshold, and scale after the ratio has changed.
+static bool
+test_fixed_rate_shards_resume(void)
+{
+    struct FixedRateShards full = {0}, first = {0}, second = {0};
+    EntryType *trace = generate_trace();
+
+    g_assert_true(FixedRateShards__init(&full, 0.1, NUM_BINS, 1, true));
+    g_assert_true(FixedRateShards__init(&first, 0.1, NUM_BINS, 1, true));
+    g_assert_true(FixedRateShards__init(&second, 0.1, NUM_BINS, 1, true));
+    for (size_t i = 0; i < LENGTH / 2; ++i) {
+        // NOTE We lower the ratio and then raise it again (which starts
+        //      warming up the new keys) before we checkpoint.
+        if (i == LENGTH / 4) {
+            g_assert_true(FixedRateShards__set_sampling_ratio(&full, 0.05));
+            g_assert_true(FixedRateShards__set_sampling_ratio(&first, 0.05));
+        } else if (i == 3 * LENGTH / 8) {
+            g_assert_true(FixedRateShards__set_sampling_ratio(&full, 0.2));
+            g_assert_true(FixedRateShards__set_sampling_ratio(&first, 0.2));
+        }
+        g_assert_true(FixedRateShards__access_item(&full, trace[i]));
+        g_assert_true(FixedRateShards__access_item(&first, trace[i]));
+    }
+    g_assert_true(
+        save_and_load(&first,
+                      &second,
+                      LENGTH / 2,
+                      (SaveFunction)FixedRateShards__save_checkpoint,
+                      (LoadFunction)FixedRateShards__load_checkpoint));
+    FixedRateShards__destroy(&first);
+    g_assert_cmpfloat(second.sampling_ratio, ==, full.sampling_ratio);
+    g_assert_cmpuint(second.threshold, ==, full.threshold);
+    g_assert_cmpuint(second.scale, ==, full.scale);
+    for (size_t i = LENGTH / 2; i < LENGTH; ++i) {
+        g_assert_true(FixedRateShards__access_item(&full, trace[i]));
+        g_assert_true(FixedRateShards__access_item(&second, trace[i]));
+    }
+    g_assert_true(FixedRateShards__post_process(&full));
+    g_assert_true(FixedRateShards__post_process(&second));
+
+    g_assert_cmpuint(second.num_entries_seen, ==, full.num_entries_seen);
+    g_assert_cmpuint(second.num_entries_processed,
+                     ==,
+                     full.num_entries_processed);
+    g_assert_true(Histogram__exactly_equal(&second.olken.histogram,
+                                           &full.olken.histogram));
+
+    FixedRateShards__destroy(&full);
+    FixedRateShards__destroy(&second);
+    free(trace);
+    return true;
+}
+
+/// @brief  Check that resuming Fixed-Size SHARDS restores the priority
+///         queue and the threshold that it has lowered.
+static bool
+test_fixed_size_shards_resume(void)
+{
+    struct FixedSizeShards full = {0}, first = {0}, second = {0};
+    EntryType *trace = generate_trace();
+
+    g_assert_true(FixedSizeShards__init(&full, 1.0, MAX_SIZE, NUM_BINS, 1));
+    g_assert_true(FixedSizeShards__init(&first, 1.0, MAX_SIZE, NUM_BINS, 1));
+    g_assert_true(FixedSizeShards__init(&second, 1.0, MAX_SIZE, NUM_BINS, 1));
+    for (size_t i = 0; i < LENGTH / 2; ++i) {
+        g_assert_true(FixedSizeShards__access_item(&full, trace[i]));
+        g_assert_true(FixedSizeShards__access_item(&first, trace[i]));
+    }
+    // NOTE There are more keys than fit, so the threshold has dropped.
+    g_assert_cmpuint(first.sampler.threshold, <, UINT64_MAX);
+    g_assert_true(
+        save_and_load(&first,
+                      &second,
+                      LENGTH / 2,
+                      (SaveFunction)FixedSizeShards__save_checkpoint,
+                      (LoadFunction)FixedSizeShards__load_checkpoint));
+    FixedSizeShards__destroy(&first);
+    g_assert_cmpuint(second.sampler.threshold, ==, full.sampler.threshold);
+    g_assert_cmpuint(second.sampler.pq.length, ==, full.sampler.pq.length);
+    for (size_t i = LENGTH / 2; i < LENGTH; ++i) {
+        g_assert_true(FixedSizeShards__access_item(&full, trace[i]));
+        g_assert_true(FixedSizeShards__access_item(&second, trace[i]));
+    }
+    g_assert_true(FixedSizeShards__post_process(&full));
+    g_assert_true(FixedSizeShards__post_process(&second));
+
+    g_assert_cmpuint(second.sampler.threshold, ==, full.sampler.threshold);
+    g_assert_cmpfloat(second.sampler.sampling_ratio,
+                      ==,
+                      full.sampler.sampling_ratio);
+    g_assert_true(Histogram__exactly_equal(&second.olken.histogram,
+                                           &full.olken.histogram));
+
+    FixedSizeShards__destroy(&full);
+    FixedSizeShards__destroy(&second);
+    free(trace);
+    return true;
+}
+
+/// @brief  Check that resuming Evicting Map rebuilds the hash table's
+///         maximum-hash tree, so that it evicts the same keys.
+static bool
+test_evicting_map_resume(void)
+{
+    struct EvictingMap full = {0}, first = {0}, second = {0};
+    EntryType *trace = generate_trace();
+
+    g_assert_true(EvictingMap__init(&full, 1.0, NUM_BUCKETS, NUM_BINS, 1));
+    g_assert_true(EvictingMap__init(&first, 1.0, NUM_BUCKETS, NUM_BINS, 1));
+    g_assert_true(EvictingMap__init(&second, 1.0, NUM_BUCKETS, NUM_BINS, 1));
+    for (size_t i = 0; i < LENGTH / 2; ++i) {
+        g_assert_true(EvictingMap__access_item(&full, trace[i]));
+        g_assert_true(EvictingMap__access_item(&first, trace[i]));
+    }
+    g_assert_true(save_and_load(&first,
+                                &second,
+                                LENGTH / 2,
+                                (SaveFunction)EvictingMap__save_checkpoint,
+                                (LoadFunction)EvictingMap__load_checkpoint));
+    EvictingMap__destroy(&first);
+    // NOTE Otherwise, the threshold would not change after it resumes.
+    g_assert_cmpuint(full.hash_table.global_threshold, <, UINT64_MAX);
+    for (size_t i = LENGTH / 2; i < LENGTH; ++i) {
+        // NOTE Refreshing the threshold reads the root of the max tree,
+        //      so this checks that we rebuilt it.
+        if (i % (LENGTH / 8) == 0) {
+            EvictingMap__refresh_threshold(&full);
+            EvictingMap__refresh_threshold(&second);
+            g_assert_cmpuint(second.hash_table.global_threshold,
+                             ==,
+                             full.hash_table.global_threshold);
+        }
+        g_assert_true(EvictingMap__access_item(&full, trace[i]));
+        g_assert_true(EvictingMap__access_item(&second, trace[i]));
+    }
+    g_assert_true(EvictingMap__post_process(&full));
+    g_assert_true(EvictingMap__post_process(&second));
+
+    g_assert_cmpuint(second.hash_table.global_threshold,
+                     ==,
+                     full.hash_table.global_threshold);
+    g_assert_cmpuint(second.hash_table.num_inserted,
+                     ==,
+                     full.hash_table.num_inserted);
+    g_assert_true(Histogram__exactly_equal(&second.histogram, &full.histogram));
+
+    EvictingMap__destroy(&full);
+    EvictingMap__destroy(&second);
+    free(trace);
+    return true;
+}
+
+/// @brief  Check that resuming QuickMRC restores its buckets, so that it
+///         gives the same histogram as an uninterrupted run.
+static bool
+test_quickmrc_resume(void)
+{
+    struct QuickMRC full = {0}, first = {0}, second = {0};
+    EntryType *trace = generate_trace();
+
+    g_assert_true(QuickMRC__init(&full,
+                                 1.0,
+                                 NUM_QMRC_BUCKETS,
+                                 QMRC_BUCKET_SIZE,
+                                 NUM_BINS,
+                                 1));
+    g_assert_true(QuickMRC__init(&first,
+                                 1.0,
+                                 NUM_QMRC_BUCKETS,
+                                 QMRC_BUCKET_SIZE,
+                                 NUM_BINS,
+                                 1));
+    g_assert_true(QuickMRC__init(&second,
+                                 1.0,
+                                 NUM_QMRC_BUCKETS,
+                                 QMRC_BUCKET_SIZE,
+                                 NUM_BINS,
+                                 1));
+    for (size_t i = 0; i < LENGTH / 2; ++i) {
+        g_assert_true(QuickMRC__access_item(&full, trace[i]));
+        g_assert_true(QuickMRC__access_item(&first, trace[i]));
+    }
+    g_assert_true(save_and_load(&first,
+                                &second,
+                                LENGTH / 2,
+                                (SaveFunction)QuickMRC__save_checkpoint,
+                                (LoadFunction)QuickMRC__load_checkpoint));
+    QuickMRC__destroy(&first);
+    for (size_t i = LENGTH / 2; i < LENGTH; ++i) {
+        g_assert_true(QuickMRC__access_item(&full, trace[i]));
+        g_assert_true(QuickMRC__access_item(&second, trace[i]));
+    }
+    QuickMRC__post_process(&full);
+    QuickMRC__post_process(&second);
+
+    g_assert_cmpuint(second.total_entries_seen, ==, full.total_entries_seen);
+    g_assert_cmpuint(second.total_entries_processed,
+                     ==,
+                     full.total_entries_processed);
+    g_assert_true(Histogram__exactly_equal(&second.histogram, &full.histogram));
+
+    QuickMRC__destroy(&full);
+    QuickMRC__destroy(&second);
+    free(trace);
+    return true;
+}
+
+/// @brief  Check that resuming Average Eviction Time mid-phase restores
+///         the phase sampler, so that it gives the same MRC.
+static bool
+test_average_eviction_time_resume(void)
+{
+    struct AverageEvictionTime full = {0}, first = {0}, second = {0};
+    struct MissRateCurve full_mrc = {0}, second_mrc = {0};
+    EntryType *trace = generate_trace();
+
+    g_assert_true(
+        AverageEvictionTime__init(&full, NUM_BINS, 1, PHASE_EPOCH));
+    g_assert_true(
+        AverageEvictionTime__init(&first, NUM_BINS, 1, PHASE_EPOCH));
+    g_assert_true(
+        AverageEvictionTime__init(&second, NUM_BINS, 1, PHASE_EPOCH));
+    for (size_t i = 0; i < LENGTH / 2; ++i) {
+        g_assert_true(AverageEvictionTime__access_item(&full, trace[i]));
+        g_assert_true(AverageEvictionTime__access_item(&first, trace[i]));
+    }
+    g_assert_cmpuint(PhaseSampler__num_phases(&first.phase_sampler), >, 0);
+    g_assert_true(
+        save_and_load(&first,
+                      &second,
+                      LENGTH / 2,
+                      (SaveFunction)AverageEvictionTime__save_checkpoint,
+                      (LoadFunction)AverageEvictionTime__load_checkpoint));
+    AverageEvictionTime__destroy(&first);
+    for (size_t i = LENGTH / 2; i < LENGTH; ++i) {
+        g_assert_true(AverageEvictionTime__access_item(&full, trace[i]));
+        g_assert_true(AverageEvictionTime__access_item(&second, trace[i]));
+    }
+    g_assert_true(AverageEvictionTime__post_process(&full));
+    g_assert_true(AverageEvictionTime__post_process(&second));
+
+    g_assert_cmpuint(second.current_time_stamp, ==, full.current_time_stamp);
+    g_assert_cmpuint(PhaseSampler__num_phases(&second.phase_sampler),
+                     ==,
+                     PhaseSampler__num_phases(&full.phase_sampler));
+    g_assert_true(Histogram__exactly_equal(&second.histogram, &full.histogram));
+    g_assert_true(AverageEvictionTime__to_mrc(&full, &full_mrc));
+    g_assert_true(AverageEvictionTime__to_mrc(&second, &second_mrc));
+    g_assert_cmpfloat(
+        MissRateCurve__mean_absolute_error(&second_mrc, &full_mrc),
+        ==,
+        0.0);
+
+    MissRateCurve__destroy(&full_mrc);
+    MissRateCurve__destroy(&second_mrc);
+    AverageEvictionTime__destroy(&full);
+    AverageEvictionTime__destroy(&second);
+    free(trace);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(test_bad_files());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_heap());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_olken_resume());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_fixed_rate_shards_resume());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_fixed_size_shards_resume());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_evicting_map_resume());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_quickmrc_resume());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_average_eviction_time_resume());
+    return EXIT_SUCCESS;
+}
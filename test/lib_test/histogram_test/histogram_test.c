@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include <glib.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -176,6 +177,49 @@ test_fractional_histogram(void)
     return true;
 }
 
+/// @brief  Check the lazy range insertions against spreading each range
+///         one distance at a time.
+static bool
+test_fractional_histogram_ranges(void)
+{
+    struct FractionalHistogram me = {0};
+    double oracle[20] = {0.0};
+    double false_infinity_oracle = 0.0;
+    g_assert_true(FractionalHistogram__init(&me, 20, 3));
+
+    for (uint64_t i = 0; i < 100; ++i) {
+        uint64_t const start = 5 * random_values_0_to_11[i];
+        uint64_t const range = 1 + 3 * random_values_0_to_11[99 - i];
+        uint64_t const scale = 1 + i % 2;
+        g_assert_true(
+            FractionalHistogram__insert_scaled_finite(&me, start, range, scale));
+        if (scale * start >= 20 * 3) {
+            false_infinity_oracle += scale;
+            continue;
+        }
+        for (uint64_t d = scale * start; d < scale * (start + range); ++d) {
+            if (d < 20 * 3) {
+                oracle[d / 3] += (double)scale / range;
+            } else {
+                false_infinity_oracle += (double)scale / range;
+            }
+        }
+    }
+    FractionalHistogram__materialize(&me);
+    for (size_t i = 0; i < 20; ++i) {
+        g_assert_cmpfloat(fabs(me.histogram[i] - oracle[i]), <, 1e-9);
+    }
+    g_assert_cmpfloat(fabs(me.false_infinity - false_infinity_oracle),
+                      <,
+                      1e-9);
+    // Materializing is idempotent.
+    FractionalHistogram__materialize(&me);
+    g_assert_cmpfloat(fabs(me.histogram[0] - oracle[0]), <, 1e-9);
+
+    FractionalHistogram__destroy(&me);
+    return true;
+}
+
 static bool
 test_histogram_save(void)
 {
@@ -304,6 +348,171 @@ test_histogram_with_realloc_on_outofbounds(void)
     return true;
 }
 
+static bool
+test_histogram_iadd(void)
+{
+    struct Histogram me = {0}, other = {0};
+    g_assert_true(
+        Histogram__init(&me, 8, 2, HistogramOutOfBoundsMode__allow_overflow));
+    g_assert_true(Histogram__init(&other,
+                                  4,
+                                  1,
+                                  HistogramOutOfBoundsMode__allow_overflow));
+    for (size_t i = 0; i < 4; ++i) {
+        Histogram__insert_scaled_finite(&other, i, 1);
+    }
+    Histogram__insert_scaled_finite(&other, 2, 1);
+    Histogram__insert_infinite(&other);
+    // Distance 100 is out of bounds.
+    Histogram__insert_finite(&other, 100);
+
+    // The other's distances are 3x smaller, so its bin 'i' covers the
+    // distances [3i, 3i + 3). With a bin size of 2, these straddle our
+    // bins, so the counts are split in proportion to the overlap and
+    // rounded to the nearest.
+    g_assert_true(Histogram__iadd_stretched(&me, &other, 3));
+    uint64_t const expected[8] = {1, 0, 1, 1, 1, 1, 0, 0};
+    for (size_t i = 0; i < 8; ++i) {
+        g_assert_cmpuint(me.histogram[i], ==, expected[i]);
+    }
+    g_assert_cmpuint(me.false_infinity, ==, 1);
+    g_assert_cmpuint(me.infinity, ==, 1);
+    g_assert_cmpuint(me.running_sum, ==, other.running_sum);
+    g_assert_cmpuint(me.running_sum, ==, Histogram__calculate_running_sum(&me));
+
+    // Adding a histogram with the same shape also updates the sum.
+    g_assert_true(Histogram__iadd(&me, &me));
+    g_assert_cmpuint(me.running_sum, ==, 2 * other.running_sum);
+    g_assert_cmpuint(me.running_sum, ==, Histogram__calculate_running_sum(&me));
+
+    Histogram__destroy(&me);
+    Histogram__destroy(&other);
+    return true;
+}
+
+static bool
+test_histogram_difference(void)
+{
+    struct Histogram me = {0}, older = {0}, diff = {0};
+    g_assert_true(
+        Histogram__init(&me, 4, 1, HistogramOutOfBoundsMode__merge_bins));
+    for (size_t i = 0; i < 4; ++i) {
+        Histogram__insert_finite(&me, i);
+    }
+    g_assert_true(Histogram__init_reshaped(&older, &me, &me));
+    // Distance 5 merges the bins, so the older copy has the wrong shape.
+    Histogram__insert_finite(&me, 5);
+    Histogram__insert_infinite(&me);
+    g_assert_cmpuint(me.bin_size, ==, 2);
+    g_assert_true(Histogram__init_difference(&diff, &me, &older));
+    uint64_t const expected[4] = {0, 0, 1, 0};
+    for (size_t i = 0; i < 4; ++i) {
+        g_assert_cmpuint(diff.histogram[i], ==, expected[i]);
+    }
+    g_assert_cmpuint(diff.bin_size, ==, 2);
+    g_assert_cmpuint(diff.infinity, ==, 1);
+    g_assert_cmpuint(diff.running_sum, ==, 2);
+    Histogram__destroy(&me);
+    Histogram__destroy(&older);
+    Histogram__destroy(&diff);
+
+    // Reallocating appends bins.
+    g_assert_true(Histogram__init(&me, 2, 1, HistogramOutOfBoundsMode__realloc));
+    Histogram__insert_finite(&me, 1);
+    g_assert_true(Histogram__init_reshaped(&older, &me, &me));
+    Histogram__insert_finite(&me, 1);
+    Histogram__insert_finite(&me, 10);
+    g_assert_cmpuint(me.num_bins, >, older.num_bins);
+    g_assert_true(Histogram__init_difference(&diff, &me, &older));
+    g_assert_cmpuint(diff.num_bins, ==, me.num_bins);
+    g_assert_cmpuint(diff.histogram[1], ==, 1);
+    g_assert_cmpuint(diff.histogram[10], ==, 1);
+    g_assert_cmpuint(diff.running_sum, ==, 2);
+    g_assert_cmpuint(diff.running_sum,
+                     ==,
+                     Histogram__calculate_running_sum(&diff));
+
+    Histogram__destroy(&me);
+    Histogram__destroy(&older);
+    Histogram__destroy(&diff);
+    return true;
+}
+
+static bool
+test_histogram_with_log_bins(void)
+{
+    struct Histogram me = {0}, other = {0};
+    // NOTE We round the 3 sub-bins up to 4 per power of two.
+    g_assert_true(Histogram__init(&me, 3, 1, HistogramOutOfBoundsMode__log));
+    g_assert_cmpuint(me.log_sub_bins, ==, 4);
+    g_assert_cmpuint(me.num_bins, ==, 8);
+    for (size_t i = 0; i < 100; ++i) {
+        g_assert_true(Histogram__insert_finite(&me, i));
+    }
+    g_assert_true(Histogram__insert_scaled_finite(&me, UINT64_C(1) << 39, 2));
+    g_assert_true(Histogram__insert_infinite(&me));
+
+    // The first two powers of two are exact; then each power of two is
+    // split into 4 bins (e.g. [8, 10), [10, 12), ...).
+    for (size_t i = 0; i < 8; ++i) {
+        g_assert_cmpuint(me.histogram[i], ==, 1);
+        g_assert_cmpuint(Histogram__get_bin_start(&me, i), ==, i);
+    }
+    for (size_t i = 8; i < 12; ++i) {
+        g_assert_cmpuint(me.histogram[i], ==, 2);
+        g_assert_cmpuint(Histogram__get_bin_start(&me, i), ==, 2 * i - 8);
+    }
+    // Each value lies in its bin and each bin is either exact or at most
+    // 1/4 as wide as the values that it holds.
+    for (uint64_t v = 1; v < UINT64_C(1) << 20; v = v * 3 + 1) {
+        size_t const i = Histogram__log_bin_index(me.log_sub_bins, v);
+        uint64_t const start = Histogram__get_bin_start(&me, i);
+        uint64_t const end = Histogram__get_bin_start(&me, i + 1);
+        g_assert_true(start <= v && v < end);
+        g_assert_true(end - start == 1 || 4 * (end - start) <= start);
+    }
+    // NOTE The scaled insertion was at a distance of 2 * 2^39.
+    size_t const big = Histogram__log_bin_index(4, UINT64_C(1) << 40);
+    g_assert_cmpuint(me.histogram[big], ==, 2);
+    g_assert_cmpuint(me.num_bins, <=, 2 * (big + 1));
+    g_assert_cmpuint(me.false_infinity, ==, 0);
+    g_assert_cmpuint(me.infinity, ==, 1);
+    g_assert_cmpuint(me.running_sum, ==, 100 + 2 + 1);
+    g_assert_true(Histogram__validate(&me));
+
+    // The sparse file stores the start of each non-empty bin.
+    g_assert_true(Histogram__save(&me, "./histogram_log_test.bin"));
+    g_assert_true(Histogram__load(&other, "./histogram_log_test.bin"));
+    g_assert_cmpint(remove("./histogram_log_test.bin"), ==, 0);
+    g_assert_true(Histogram__exactly_equal(&me, &other));
+    Histogram__destroy(&other);
+
+    // A short histogram grows to fit the longer one that we add to it.
+    g_assert_true(Histogram__init(&other, 4, 1, HistogramOutOfBoundsMode__log));
+    g_assert_true(Histogram__insert_finite(&other, 1));
+    g_assert_true(Histogram__iadd(&other, &me));
+    g_assert_cmpuint(other.num_bins, ==, me.num_bins);
+    g_assert_cmpuint(other.histogram[1], ==, 2);
+    g_assert_cmpuint(other.running_sum, ==, me.running_sum + 1);
+    Histogram__destroy(&other);
+
+    // Stretching by 2 moves the exact distance 3 to distance 6 and
+    // spreads [8, 10) over [16, 20), which is the single bin [16, 20).
+    g_assert_true(Histogram__init(&other, 4, 1, HistogramOutOfBoundsMode__log));
+    g_assert_true(Histogram__iadd_stretched(&other, &me, 2));
+    g_assert_cmpuint(other.histogram[6], ==, 1);
+    g_assert_cmpuint(other.histogram[7], ==, 0);
+    g_assert_cmpuint(other.histogram[Histogram__log_bin_index(4, 16)], ==, 2);
+    g_assert_cmpuint(other.running_sum, ==, me.running_sum);
+    g_assert_cmpuint(other.running_sum,
+                     ==,
+                     Histogram__calculate_running_sum(&other));
+
+    Histogram__destroy(&me);
+    Histogram__destroy(&other);
+    return true;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -312,10 +521,14 @@ main(int argc, char **argv)
     ASSERT_FUNCTION_RETURNS_TRUE(test_histogram());
     ASSERT_FUNCTION_RETURNS_TRUE(test_binned_histogram());
     ASSERT_FUNCTION_RETURNS_TRUE(test_fractional_histogram());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_fractional_histogram_ranges());
     ASSERT_FUNCTION_RETURNS_TRUE(test_histogram_save());
     ASSERT_FUNCTION_RETURNS_TRUE(
         test_histogram_with_false_infinity_on_outofbounds());
     ASSERT_FUNCTION_RETURNS_TRUE(test_histogram_with_merge_on_outofbounds());
     ASSERT_FUNCTION_RETURNS_TRUE(test_histogram_with_realloc_on_outofbounds());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_histogram_iadd());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_histogram_difference());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_histogram_with_log_bins());
     return 0;
 }
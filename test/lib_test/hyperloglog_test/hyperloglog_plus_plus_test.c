@@ -0,0 +1,128 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "hash/hash.h"
+#include "hyperloglog/hyperloglog_plus_plus.h"
+#include "logger/logger.h"
+#include "math/doubles_are_equal.h"
+#include "test/mytester.h"
+#include "unused/mark_unused.h"
+
+static uint64_t const PRECISION = 12;
+
+static bool
+analyze(uint64_t const expected, uint64_t const got, double const error)
+{
+    LOGGER_INFO("expected: %" PRIu64 ", got: %" PRIu64, expected, got);
+    return doubles_are_close(expected, got, error * expected);
+}
+
+/// @brief  Test the accuracy across the sparse, linear counting, and
+///         bias-corrected regimes.
+static bool
+test_accuracy(void)
+{
+    uint64_t const checkpoints[] = {
+        10, 100, 1000, 3000, 10000, 30000, 100000, 1000000};
+    struct HyperLogLogPlusPlus hll = {0};
+    g_assert_true(HyperLogLogPlusPlus__init(&hll, PRECISION));
+    uint64_t n = 0;
+    for (size_t i = 0; i < sizeof(checkpoints) / sizeof(*checkpoints); ++i) {
+        for (; n < checkpoints[i]; ++n) {
+            // NOTE Adding every key twice should not change anything.
+            HyperLogLogPlusPlus__add_hash(&hll, Hash64Bit(n));
+            HyperLogLogPlusPlus__add_hash(&hll, Hash64Bit(n));
+        }
+        // NOTE The sparse representation is much more accurate.
+        double const error = hll.is_sparse ? 0.001 : 0.05;
+        g_assert_true(analyze(n, HyperLogLogPlusPlus__count(&hll), error));
+    }
+    g_assert_false(hll.is_sparse);
+    HyperLogLogPlusPlus__destroy(&hll);
+    return true;
+}
+
+/// @brief  Test that merging gives exactly the same registers as adding
+///         the union of the streams, regardless of the representations.
+static bool
+test_merge(uint64_t const nr_a, uint64_t const nr_b)
+{
+    struct HyperLogLogPlusPlus a = {0}, b = {0}, expected = {0};
+    g_assert_true(HyperLogLogPlusPlus__init(&a, PRECISION));
+    g_assert_true(HyperLogLogPlusPlus__init(&b, PRECISION));
+    g_assert_true(HyperLogLogPlusPlus__init(&expected, PRECISION));
+    for (uint64_t i = 0; i < nr_a; ++i) {
+        HyperLogLogPlusPlus__add_hash(&a, Hash64Bit(i));
+        HyperLogLogPlusPlus__add_hash(&expected, Hash64Bit(i));
+    }
+    // NOTE The streams overlap by half of the smaller stream.
+    for (uint64_t i = nr_a / 2; i < nr_a / 2 + nr_b; ++i) {
+        HyperLogLogPlusPlus__add_hash(&b, Hash64Bit(i));
+        HyperLogLogPlusPlus__add_hash(&expected, Hash64Bit(i));
+    }
+    g_assert_true(HyperLogLogPlusPlus__merge(&a, &b));
+    g_assert_cmpuint(HyperLogLogPlusPlus__count(&a),
+                     ==,
+                     HyperLogLogPlusPlus__count(&expected));
+    g_assert_cmpuint(a.is_sparse, ==, expected.is_sparse);
+    if (!a.is_sparse) {
+        g_assert_cmpint(
+            memcmp(a.registers, expected.registers, a.num_registers),
+            ==,
+            0);
+    }
+    HyperLogLogPlusPlus__destroy(&a);
+    HyperLogLogPlusPlus__destroy(&b);
+    HyperLogLogPlusPlus__destroy(&expected);
+    return true;
+}
+
+static bool
+test_write_and_read(uint64_t const nr_keys)
+{
+    struct HyperLogLogPlusPlus hll = {0}, copy = {0};
+    g_assert_true(HyperLogLogPlusPlus__init(&hll, PRECISION));
+    for (uint64_t i = 0; i < nr_keys; ++i) {
+        HyperLogLogPlusPlus__add_hash(&hll, Hash64Bit(i));
+    }
+    FILE *fp = tmpfile();
+    g_assert_nonnull(fp);
+    // NOTE We write the sketch twice to check that back-to-back sketches
+    //      can be read from the same stream.
+    g_assert_true(HyperLogLogPlusPlus__write(&hll, fp));
+    g_assert_true(HyperLogLogPlusPlus__write(&hll, fp));
+    rewind(fp);
+    for (int i = 0; i < 2; ++i) {
+        g_assert_true(HyperLogLogPlusPlus__read(&copy, fp));
+        g_assert_cmpuint(copy.is_sparse, ==, hll.is_sparse);
+        g_assert_cmpuint(HyperLogLogPlusPlus__count(&copy),
+                         ==,
+                         HyperLogLogPlusPlus__count(&hll));
+        HyperLogLogPlusPlus__destroy(&copy);
+    }
+    fclose(fp);
+    HyperLogLogPlusPlus__destroy(&hll);
+    return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(test_accuracy());
+    // Sparse-sparse, sparse-dense, dense-sparse, and dense-dense.
+    ASSERT_FUNCTION_RETURNS_TRUE(test_merge(100, 100));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_merge(100, 100000));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_merge(100000, 100));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_merge(100000, 100000));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_write_and_read(100));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_write_and_read(100000));
+    return EXIT_SUCCESS;
+}
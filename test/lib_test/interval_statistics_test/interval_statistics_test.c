@@ -0,0 +1,155 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "histogram/histogram.h"
+#include "interval_statistics/interval_statistics.h"
+#include "logger/logger.h"
+#include "test/mytester.h"
+
+#define NUM_ITEMS 1000
+
+/// @brief  Generate an item that exercises every encoding (i.e. unsampled,
+///         infinite, integers with positive and negative deltas, and
+///         non-integers).
+static struct IntervalStatisticsItem
+generate_item(size_t const i)
+{
+    switch (i % 7) {
+    case 0:
+        return (struct IntervalStatisticsItem){NAN, NAN};
+    case 1:
+        return (struct IntervalStatisticsItem){INFINITY, INFINITY};
+    case 2:
+        return (struct IntervalStatisticsItem){i * 1.5, i + 0.25};
+    case 3:
+        return (struct IntervalStatisticsItem){(double)((uint64_t)1 << 53),
+                                               0.0};
+    case 4:
+        return (struct IntervalStatisticsItem){-1.0, -INFINITY};
+    default:
+        return (struct IntervalStatisticsItem){(double)(NUM_ITEMS - i),
+                                               (double)(i * i)};
+    }
+}
+
+static bool
+items_are_equal(struct IntervalStatisticsItem const a,
+                struct IntervalStatisticsItem const b)
+{
+    // NOTE The bits must match exactly, including the NANs.
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool
+append_items(struct IntervalStatistics *const me)
+{
+    for (size_t i = 0; i < NUM_ITEMS; ++i) {
+        struct IntervalStatisticsItem const item = generate_item(i);
+        g_assert_true(IntervalStatistics__append(me,
+                                                 item.reuse_distance,
+                                                 item.reuse_time));
+    }
+    g_assert_cmpuint(IntervalStatistics__num_items(me), ==, NUM_ITEMS);
+    return true;
+}
+
+static bool
+check_file(char const *const path)
+{
+    struct IntervalStatisticsReader reader = {0};
+    struct IntervalStatisticsItem item = {0};
+    g_assert_true(IntervalStatisticsReader__init(&reader, path));
+    size_t n = 0;
+    for (; IntervalStatisticsReader__next(&reader, &item); ++n) {
+        g_assert_true(items_are_equal(item, generate_item(n)));
+    }
+    g_assert_cmpuint(n, ==, NUM_ITEMS);
+    IntervalStatisticsReader__destroy(&reader);
+    return true;
+}
+
+static bool
+test_raw_round_trip(char const *const path)
+{
+    struct IntervalStatistics me = {0};
+    g_assert_true(IntervalStatistics__init(&me, 1));
+    g_assert_true(append_items(&me));
+    g_assert_true(IntervalStatistics__save(&me, path));
+    IntervalStatistics__destroy(&me);
+
+    g_assert_true(check_file(path));
+    g_assert_true(remove(path) == 0);
+    return true;
+}
+
+static bool
+test_streaming_round_trip(char const *const path, size_t const block_length)
+{
+    struct IntervalStatistics me = {0};
+    g_assert_true(IntervalStatistics__init(&me, NUM_ITEMS));
+    g_assert_true(IntervalStatistics__stream_to(&me, path, block_length));
+    g_assert_true(append_items(&me));
+    // NOTE We only keep one block in memory.
+    g_assert_cmpuint(me.capacity, ==, block_length);
+    g_assert_false(IntervalStatistics__save(&me, "wrong-path.bin"));
+    g_assert_true(IntervalStatistics__save(&me, path));
+    // Appending to a closed stream is an error.
+    g_assert_false(IntervalStatistics__append_infinity(&me));
+    IntervalStatistics__destroy(&me);
+
+    g_assert_true(check_file(path));
+    g_assert_true(remove(path) == 0);
+    return true;
+}
+
+/// @brief  Check that streaming produces the same histogram as keeping
+///         everything in memory.
+static bool
+test_streaming_histogram(char const *const path)
+{
+    struct IntervalStatistics oracle = {0}, me = {0};
+    struct Histogram oracle_hist = {0}, hist = {0};
+    g_assert_true(IntervalStatistics__init(&oracle, 1));
+    g_assert_true(IntervalStatistics__init(&me, 1));
+    g_assert_true(IntervalStatistics__stream_to(&me, path, 16));
+    for (size_t i = 0; i < NUM_ITEMS; ++i) {
+        double const reuse = (i % 3 == 0) ? INFINITY : (double)(i % 100);
+        g_assert_true(IntervalStatistics__append(&oracle, reuse, reuse));
+        g_assert_true(IntervalStatistics__append(&me, reuse, reuse));
+    }
+    g_assert_true(IntervalStatistics__append_unsampled(&oracle));
+    g_assert_true(IntervalStatistics__append_unsampled(&me));
+
+    g_assert_true(
+        IntervalStatistics__to_histogram(&oracle, &oracle_hist, 64, 2));
+    g_assert_true(IntervalStatistics__to_histogram(&me, &hist, 64, 2));
+    g_assert_true(Histogram__exactly_equal(&hist, &oracle_hist));
+
+    IntervalStatistics__destroy(&oracle);
+    IntervalStatistics__destroy(&me);
+    Histogram__destroy(&oracle_hist);
+    Histogram__destroy(&hist);
+    g_assert_true(remove(path) == 0);
+    return true;
+}
+
+int
+main(void)
+{
+    char const *const path = "interval_statistics_test.bin";
+    ASSERT_FUNCTION_RETURNS_TRUE(test_raw_round_trip(path));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_streaming_round_trip(path, 1));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_streaming_round_trip(path, 7));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_streaming_round_trip(path, NUM_ITEMS));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_streaming_round_trip(
+        path,
+        INTERVAL_STATISTICS_DEFAULT_BLOCK_LENGTH));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_streaming_histogram(path));
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdlib.h>
 
 #include <glib.h>
 
@@ -116,10 +117,85 @@ sampled_try_put_test(void)
     return true;
 }
 
+/// @brief  Test that the incrementally maintained threshold matches a
+///         full scan of the hashes.
+static bool
+global_threshold_test(size_t const length)
+{
+    struct EvictingHashTable me = {0};
+    g_assert_true(EvictingHashTable__init(&me, length, 1.0));
+    for (size_t i = 0; i < 64 * length; ++i) {
+        // NOTE We reaccess keys so that we also exercise the updates.
+        EvictingHashTable__try_put(&me, i % (16 * length), i);
+        Hash64BitType max_hash = 0;
+        for (size_t j = 0; j < me.length; ++j) {
+            max_hash = MAX(max_hash, me.hashes[j]);
+        }
+        g_assert_cmpuint(me.max_tree[1], ==, max_hash);
+        if (me.num_inserted == me.length) {
+            g_assert_cmpuint(me.global_threshold, ==, max_hash);
+        }
+    }
+    g_assert_cmpuint(me.num_inserted, ==, me.length);
+    EvictingHashTable__destroy(&me);
+    return true;
+}
+
+/// @brief  Test that the batch try-put matches the sequential one.
+static bool
+try_put_batch_test(size_t const length)
+{
+    size_t const n = 64 * length;
+    struct EvictingHashTable seq = {0}, batch = {0};
+    KeyType *keys = malloc(n * sizeof(*keys));
+    ValueType *values = malloc(n * sizeof(*values));
+    struct SampledTryPutReturn *results = malloc(n * sizeof(*results));
+    g_assert_nonnull(keys);
+    g_assert_nonnull(values);
+    g_assert_nonnull(results);
+    g_assert_true(EvictingHashTable__init(&seq, length, 1.0));
+    g_assert_true(EvictingHashTable__init(&batch, length, 1.0));
+
+    // NOTE We reaccess keys so that some repeat within a batch.
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = i % (16 * length);
+        values[i] = i;
+    }
+    g_assert_true(
+        EvictingHashTable__try_put_batch(&batch, keys, values, n, results));
+    for (size_t i = 0; i < n; ++i) {
+        struct SampledTryPutReturn r =
+            EvictingHashTable__try_put(&seq, keys[i], values[i]);
+        g_assert_cmpint(results[i].status, ==, r.status);
+        g_assert_cmpuint(results[i].new_hash, ==, r.new_hash);
+        g_assert_cmpuint(results[i].old_hash, ==, r.old_hash);
+        g_assert_cmpuint(results[i].old_value, ==, r.old_value);
+    }
+    for (size_t j = 0; j < length; ++j) {
+        g_assert_cmpuint(batch.hashes[j], ==, seq.hashes[j]);
+        g_assert_cmpuint(batch.values[j], ==, seq.values[j]);
+    }
+    g_assert_cmpuint(batch.global_threshold, ==, seq.global_threshold);
+
+    EvictingHashTable__destroy(&seq);
+    EvictingHashTable__destroy(&batch);
+    free(keys);
+    free(values);
+    free(results);
+    return true;
+}
+
 int
 main(void)
 {
     ASSERT_FUNCTION_RETURNS_TRUE(sampled_test());
     ASSERT_FUNCTION_RETURNS_TRUE(sampled_try_put_test());
+    // NOTE We test lengths that are smaller than, equal to, and not a
+    //      multiple of the block size.
+    ASSERT_FUNCTION_RETURNS_TRUE(global_threshold_test(LENGTH));
+    ASSERT_FUNCTION_RETURNS_TRUE(global_threshold_test(EHT__BLOCK_SIZE));
+    ASSERT_FUNCTION_RETURNS_TRUE(global_threshold_test(1000));
+    ASSERT_FUNCTION_RETURNS_TRUE(try_put_batch_test(LENGTH));
+    ASSERT_FUNCTION_RETURNS_TRUE(try_put_batch_test(1000));
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <glib.h>
 
@@ -79,6 +80,60 @@ test_khash(void)
     return true;
 }
 
+/// @brief  Test that the batch operations match the sequential ones,
+///         including for keys that repeat within a batch.
+static bool
+test_khash_batch(void)
+{
+    size_t const n = 10000;
+    struct KHashTable seq = {0}, batch = {0};
+    EntryType *keys = malloc(n * sizeof(*keys));
+    TimeStampType *values = malloc(n * sizeof(*values));
+    enum PutUniqueStatus *statuses = malloc(n * sizeof(*statuses));
+    struct LookupReturn *results = malloc(n * sizeof(*results));
+    g_assert_nonnull(keys);
+    g_assert_nonnull(values);
+    g_assert_nonnull(statuses);
+    g_assert_nonnull(results);
+    g_assert_true(KHashTable__init(&seq));
+    g_assert_true(KHashTable__init(&batch));
+
+    // Lookups in an empty table must all miss.
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = i % (n / 4);
+        values[i] = i;
+    }
+    g_assert_true(KHashTable__lookup_batch(&batch, keys, n, results));
+    for (size_t i = 0; i < n; ++i) {
+        g_assert_false(results[i].success);
+    }
+
+    g_assert_true(KHashTable__put_batch(&batch, keys, values, n, statuses));
+    for (size_t i = 0; i < n; ++i) {
+        enum PutUniqueStatus r = KHashTable__put(&seq, keys[i], values[i]);
+        g_assert_cmpint(statuses[i], ==, r);
+    }
+
+    // Look up both present and absent keys.
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = n - i;
+    }
+    g_assert_true(KHashTable__lookup_batch(&batch, keys, n, results));
+    for (size_t i = 0; i < n; ++i) {
+        struct LookupReturn r = KHashTable__lookup(&seq, keys[i]);
+        g_assert_cmpint(results[i].success, ==, r.success);
+        g_assert_cmpuint(results[i].timestamp, ==, r.timestamp);
+    }
+
+    KHashTable__destroy(&seq);
+    KHashTable__destroy(&batch);
+    free(keys);
+    free(values);
+    free(statuses);
+    free(results);
+    return true;
+}
+
 /// @brief  Test the ability to store more than 4 billion elements.
 static bool
 test_large_khash(void)
@@ -99,6 +154,7 @@ int
 main(void)
 {
     ASSERT_FUNCTION_RETURNS_TRUE(test_khash());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_khash_batch());
     UNUSED(test_large_khash);
     return EXIT_SUCCESS;
 }
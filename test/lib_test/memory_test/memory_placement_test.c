@@ -0,0 +1,110 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "memory/memory_placement.h"
+#include "test/mytester.h"
+
+#define NUM_BYTES ((size_t)8 << 20)
+
+static bool
+configure_test(void)
+{
+    g_assert_cmpint(memory_placement.huge_pages, ==, HUGE_PAGE_MODE_OFF);
+    g_assert_cmpint(memory_placement.numa, ==, NUMA_MODE_OFF);
+    g_assert_false(MemoryPlacement__configure(HUGE_PAGE_MODE_HUGETLB + 1,
+                                              NUMA_MODE_OFF));
+
+    g_assert_true(setenv("MRC_HUGE_PAGES", "gigantic", 1) == 0);
+    g_assert_false(MemoryPlacement__configure_from_env());
+    g_assert_true(setenv("MRC_HUGE_PAGES", "madvise", 1) == 0);
+    g_assert_true(setenv("MRC_NUMA", "replicate", 1) == 0);
+    g_assert_true(MemoryPlacement__configure_from_env());
+    g_assert_cmpint(memory_placement.huge_pages, ==, HUGE_PAGE_MODE_MADVISE);
+    g_assert_cmpint(memory_placement.numa, ==, NUMA_MODE_REPLICATE);
+
+    g_assert_true(unsetenv("MRC_HUGE_PAGES") == 0);
+    g_assert_true(unsetenv("MRC_NUMA") == 0);
+    g_assert_true(MemoryPlacement__configure_from_env());
+    g_assert_cmpint(memory_placement.huge_pages, ==, HUGE_PAGE_MODE_OFF);
+    g_assert_cmpint(memory_placement.numa, ==, NUMA_MODE_OFF);
+    return true;
+}
+
+/// @brief  Test that the memory works in every mode, whether or not the
+///         system has huge pages or NUMA.
+static bool
+alloc_test(enum HugePageMode const mode, int const node)
+{
+    g_assert_true(MemoryPlacement__configure(mode, NUMA_MODE_OFF));
+    // NOTE This size is not a multiple of the huge page size.
+    size_t const num_bytes = NUM_BYTES + 1;
+    uint8_t *const buffer = MemoryPlacement__alloc(num_bytes, node);
+    g_assert_nonnull(buffer);
+    for (size_t i = 0; i < num_bytes; ++i) {
+        g_assert_cmpuint(buffer[i], ==, 0);
+    }
+    memset(buffer, 0xFF, num_bytes);
+    MemoryPlacement__free(buffer, num_bytes);
+
+    // Advising memory that we did not map ourselves must be harmless.
+    uint8_t *const heap = malloc(num_bytes);
+    g_assert_nonnull(heap);
+    MemoryPlacement__advise(heap, num_bytes);
+    MemoryPlacement__advise(heap, 1);
+    MemoryPlacement__advise(NULL, num_bytes);
+    memset(heap, 0xFF, num_bytes);
+    free(heap);
+
+    g_assert_null(MemoryPlacement__alloc(0, node));
+    g_assert_true(
+        MemoryPlacement__configure(HUGE_PAGE_MODE_OFF, NUMA_MODE_OFF));
+    return true;
+}
+
+static bool
+pin_test(void)
+{
+    int const num_nodes = MemoryPlacement__get_num_nodes();
+    int const first_node = MemoryPlacement__get_node(0);
+    g_assert_cmpint(num_nodes, >=, 1);
+    g_assert_cmpint(first_node, >=, 0);
+    g_assert_cmpint(MemoryPlacement__get_node(-1), ==, -1);
+    g_assert_cmpint(MemoryPlacement__get_node(num_nodes), ==, first_node);
+    g_assert_cmpint(MemoryPlacement__get_thread_node(), ==, -1);
+    g_assert_cmpint(MemoryPlacement__get_thread_node_index(), ==, -1);
+
+    // We do not pin unless we are configured to.
+    g_assert_true(MemoryPlacement__pin_worker(0));
+    g_assert_cmpint(MemoryPlacement__get_thread_node(), ==, -1);
+
+    g_assert_true(
+        MemoryPlacement__configure(HUGE_PAGE_MODE_OFF, NUMA_MODE_PIN));
+    g_assert_false(MemoryPlacement__pin_worker(-1));
+    // NOTE The workers wrap around the nodes.
+    g_assert_true(MemoryPlacement__pin_worker(num_nodes));
+    g_assert_cmpint(MemoryPlacement__get_thread_node(), ==, first_node);
+    g_assert_cmpint(MemoryPlacement__get_thread_node_index(), ==, 0);
+    // NOTE No system has this many nodes.
+    g_assert_false(MemoryPlacement__pin_thread_to_node(1 << 20));
+    g_assert_cmpint(MemoryPlacement__get_thread_node(), ==, first_node);
+    g_assert_true(
+        MemoryPlacement__configure(HUGE_PAGE_MODE_OFF, NUMA_MODE_OFF));
+    return true;
+}
+
+int
+main(void)
+{
+    ASSERT_FUNCTION_RETURNS_TRUE(configure_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(alloc_test(HUGE_PAGE_MODE_OFF, -1));
+    ASSERT_FUNCTION_RETURNS_TRUE(alloc_test(HUGE_PAGE_MODE_MADVISE, -1));
+    ASSERT_FUNCTION_RETURNS_TRUE(alloc_test(HUGE_PAGE_MODE_HUGETLB, -1));
+    ASSERT_FUNCTION_RETURNS_TRUE(alloc_test(HUGE_PAGE_MODE_MADVISE, 0));
+    ASSERT_FUNCTION_RETURNS_TRUE(pin_test());
+    return EXIT_SUCCESS;
+}
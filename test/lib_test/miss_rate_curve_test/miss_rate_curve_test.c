@@ -1,4 +1,5 @@
 #include <inttypes.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -100,6 +101,47 @@ test_miss_rate_curve_from_histogram(struct Histogram *hist)
     return true;
 }
 
+/// @brief  Check that an MRC from logarithmic bins approximates the MRC
+///         from exact bins.
+static bool
+test_miss_rate_curve_from_log_histogram(void)
+{
+    struct Histogram exact = {0}, log = {0};
+    struct MissRateCurve exact_mrc = {0}, log_mrc = {0};
+    g_assert_true(Histogram__init(&exact,
+                                  1 << 12,
+                                  1,
+                                  HistogramOutOfBoundsMode__allow_overflow));
+    g_assert_true(Histogram__init(&log, 16, 1, HistogramOutOfBoundsMode__log));
+    // NOTE A geometric-ish spread of reuse distances.
+    for (uint64_t i = 1; i < 4000; ++i) {
+        uint64_t const distance = (i * i) % 4000;
+        g_assert_true(Histogram__insert_finite(&exact, distance));
+        g_assert_true(Histogram__insert_finite(&log, distance));
+    }
+    g_assert_true(Histogram__insert_scaled_infinite(&exact, 100));
+    g_assert_true(Histogram__insert_scaled_infinite(&log, 100));
+
+    g_assert_true(MissRateCurve__init_from_histogram(&exact_mrc, &exact));
+    g_assert_true(MissRateCurve__init_from_histogram(&log_mrc, &log));
+    g_assert_true(MissRateCurve__validate(&log_mrc));
+    g_assert_cmpuint(log_mrc.bin_size, ==, 1);
+    for (size_t i = 0; i < MIN(exact_mrc.num_bins, log_mrc.num_bins) - 2;
+         ++i) {
+        g_assert_cmpfloat(
+            fabs(exact_mrc.miss_rate[i] - log_mrc.miss_rate[i]), <, 0.02);
+    }
+    g_assert_cmpfloat(log_mrc.miss_rate[log_mrc.num_bins - 1],
+                      ==,
+                      exact_mrc.miss_rate[exact_mrc.num_bins - 1]);
+
+    MissRateCurve__destroy(&exact_mrc);
+    MissRateCurve__destroy(&log_mrc);
+    Histogram__destroy(&exact);
+    Histogram__destroy(&log);
+    return true;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -111,5 +153,6 @@ main(int argc, char **argv)
         test_miss_rate_curve_from_histogram(&SPARSE_HIST));
     ASSERT_FUNCTION_RETURNS_TRUE(
         test_miss_rate_curve_from_histogram(&VERY_SPARSE_HIST));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_miss_rate_curve_from_log_histogram());
     return 0;
 }
@@ -0,0 +1,231 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "histogram/histogram.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "mrc_snapshot/mrc_snapshot.h"
+#include "test/mytester.h"
+#include "unused/mark_unused.h"
+
+#define PATH     "mrc_snapshot_test.bin"
+#define NUM_BINS 16
+
+/// @brief  Insert 'n' accesses with reuse distance 'distance'.
+static void
+insert(struct Histogram *const me, uint64_t const distance, size_t const n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        Histogram__insert_finite(me, distance);
+    }
+}
+
+/// @brief  Check that the MRC matches the one of the histogram.
+static void
+assert_mrc_matches(struct MissRateCurve const *const mrc,
+                   struct Histogram const *const expected_hist)
+{
+    struct MissRateCurve expected = {0};
+    g_assert_true(MissRateCurve__init_from_histogram(&expected, expected_hist));
+    g_assert_true(MissRateCurve__all_close(mrc, &expected, 1e-9));
+    MissRateCurve__destroy(&expected);
+}
+
+/// @brief  Take two snapshots: one of the accesses at distance 1, then
+///         one after adding accesses at distance 2 (and growing).
+static void
+take_two_snapshots(enum MRCSnapshotMode const mode, double const decay)
+{
+    struct MRCSnapshotStream me = {0};
+    struct Histogram live = {0};
+    g_assert_true(MRCSnapshotStream__init(&me, PATH, mode, decay));
+    g_assert_true(
+        Histogram__init(&live, NUM_BINS, 1, HistogramOutOfBoundsMode__realloc));
+    insert(&live, 1, 100);
+    g_assert_true(MRCSnapshotStream__take(
+        &me,
+        &live,
+        (struct MRCSnapshotHeader){.position = 100, .timestamp_ms = 1}));
+    // Growing the histogram changes its shape between the snapshots.
+    insert(&live, 2, 50);
+    insert(&live, 2 * NUM_BINS, 50);
+    g_assert_true(MRCSnapshotStream__take(
+        &me,
+        &live,
+        (struct MRCSnapshotHeader){.position = 200, .timestamp_ms = 2}));
+    // NOTE We skip empty windows in the tumbling and decayed modes.
+    g_assert_true(MRCSnapshotStream__take(
+        &me,
+        &live,
+        (struct MRCSnapshotHeader){.position = 200, .timestamp_ms = 3}));
+    g_assert_true(MRCSnapshotStream__finish(&me));
+    MRCSnapshotStream__destroy(&me);
+    Histogram__destroy(&live);
+}
+
+static bool
+test_modes(void)
+{
+    struct MRCSnapshotReader reader = {0};
+    struct MRCSnapshotHeader header = {0};
+    struct MissRateCurve mrc = {0};
+    struct Histogram expected = {0};
+    bool done = false;
+
+    // Cumulative: everything so far.
+    take_two_snapshots(MRC_SNAPSHOT_MODE_CUMULATIVE, 0.5);
+    g_assert_true(MRCSnapshotReader__init(&reader, PATH));
+    g_assert_cmpuint(reader.mode, ==, MRC_SNAPSHOT_MODE_CUMULATIVE);
+    g_assert_true(Histogram__init(&expected,
+                                  NUM_BINS,
+                                  1,
+                                  HistogramOutOfBoundsMode__realloc));
+    insert(&expected, 1, 100);
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_false(done);
+    g_assert_cmpuint(header.position, ==, 100);
+    g_assert_cmpfloat(header.weight, ==, 100);
+    assert_mrc_matches(&mrc, &expected);
+    MissRateCurve__destroy(&mrc);
+    insert(&expected, 2, 50);
+    insert(&expected, 2 * NUM_BINS, 50);
+    for (size_t i = 0; i < 2; ++i) {
+        g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+        g_assert_false(done);
+        g_assert_cmpfloat(header.weight, ==, 200);
+        assert_mrc_matches(&mrc, &expected);
+        MissRateCurve__destroy(&mrc);
+    }
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_true(done);
+    MRCSnapshotReader__destroy(&reader);
+    Histogram__destroy(&expected);
+
+    // Tumbling: only the accesses since the previous snapshot.
+    take_two_snapshots(MRC_SNAPSHOT_MODE_TUMBLING, 0.5);
+    g_assert_true(MRCSnapshotReader__init(&reader, PATH));
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    MissRateCurve__destroy(&mrc);
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_cmpuint(header.position, ==, 200);
+    g_assert_cmpuint(header.timestamp_ms, ==, 2);
+    g_assert_cmpfloat(header.weight, ==, 100);
+    // NOTE The MRC ends at the last bin that the live histogram has.
+    g_assert_cmpfloat(mrc.miss_rate[0], ==, 1.0);
+    g_assert_cmpfloat(mrc.miss_rate[2], ==, 1.0);
+    g_assert_cmpfloat(mrc.miss_rate[3], ==, 0.5);
+    g_assert_cmpfloat(mrc.miss_rate[2 * NUM_BINS + 1], ==, 0.0);
+    MissRateCurve__destroy(&mrc);
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_true(done);
+    MRCSnapshotReader__destroy(&reader);
+
+    // Decayed: the earlier window counts for 'decay' as much.
+    take_two_snapshots(MRC_SNAPSHOT_MODE_DECAYED, 0.5);
+    g_assert_true(MRCSnapshotReader__init(&reader, PATH));
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_cmpfloat(header.weight, ==, 100);
+    MissRateCurve__destroy(&mrc);
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_cmpfloat(header.weight, ==, 0.5 * 100 + 100);
+    // 50 decayed accesses at distance 1 and 50 at distance 2 out of 150.
+    g_assert_cmpfloat_with_epsilon(mrc.miss_rate[2], 100.0 / 150, 1e-9);
+    g_assert_cmpfloat_with_epsilon(mrc.miss_rate[3], 50.0 / 150, 1e-9);
+    MissRateCurve__destroy(&mrc);
+    MRCSnapshotReader__destroy(&reader);
+
+    g_assert_true(remove(PATH) == 0);
+    return true;
+}
+
+/// @brief  Check that resuming from a checkpoint at position 100 keeps
+///         the earlier snapshot, drops the later one, and only includes
+///         the new accesses in the next window.
+static bool
+test_resume(void)
+{
+    struct MRCSnapshotStream me = {0};
+    struct MRCSnapshotReader reader = {0};
+    struct MRCSnapshotHeader header = {0};
+    struct MissRateCurve mrc = {0};
+    struct Histogram live = {0}, restored = {0};
+    bool done = false;
+
+    take_two_snapshots(MRC_SNAPSHOT_MODE_TUMBLING, 0.5);
+    g_assert_true(Histogram__init(&restored,
+                                  NUM_BINS,
+                                  1,
+                                  HistogramOutOfBoundsMode__realloc));
+    insert(&restored, 1, 100);
+    // The file has tumbling snapshots, so we cannot resume another mode.
+    g_assert_false(MRCSnapshotStream__init_resumed(&me,
+                                                   PATH,
+                                                   MRC_SNAPSHOT_MODE_DECAYED,
+                                                   0.5,
+                                                   &restored,
+                                                   100));
+    g_assert_true(MRCSnapshotStream__init_resumed(&me,
+                                                  PATH,
+                                                  MRC_SNAPSHOT_MODE_TUMBLING,
+                                                  0.5,
+                                                  &restored,
+                                                  100));
+    g_assert_true(Histogram__init_reshaped(&live, &restored, &restored));
+    insert(&live, 3, 50);
+    g_assert_true(MRCSnapshotStream__take(
+        &me,
+        &live,
+        (struct MRCSnapshotHeader){.position = 150, .timestamp_ms = 4}));
+    g_assert_true(MRCSnapshotStream__finish(&me));
+    MRCSnapshotStream__destroy(&me);
+
+    g_assert_true(MRCSnapshotReader__init(&reader, PATH));
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_cmpuint(header.position, ==, 100);
+    g_assert_cmpfloat(header.weight, ==, 100);
+    MissRateCurve__destroy(&mrc);
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_cmpuint(header.position, ==, 150);
+    g_assert_cmpfloat(header.weight, ==, 50);
+    g_assert_cmpfloat(mrc.miss_rate[3], ==, 1.0);
+    g_assert_cmpfloat(mrc.miss_rate[4], ==, 0.0);
+    MissRateCurve__destroy(&mrc);
+    g_assert_true(MRCSnapshotReader__next(&reader, &header, &mrc, &done));
+    g_assert_true(done);
+    MRCSnapshotReader__destroy(&reader);
+
+    Histogram__destroy(&live);
+    Histogram__destroy(&restored);
+    g_assert_true(remove(PATH) == 0);
+    return true;
+}
+
+static bool
+test_invalid(void)
+{
+    struct MRCSnapshotStream me = {0};
+    enum MRCSnapshotMode mode = MRC_SNAPSHOT_MODE_INVALID;
+    g_assert_false(
+        MRCSnapshotStream__init(&me, PATH, MRC_SNAPSHOT_MODE_DECAYED, 1.0));
+    g_assert_false(
+        MRCSnapshotStream__init(&me, PATH, MRC_SNAPSHOT_MODE_INVALID, 0.5));
+    g_assert_true(MRCSnapshotMode__parse(&mode, "tumbling"));
+    g_assert_cmpuint(mode, ==, MRC_SNAPSHOT_MODE_TUMBLING);
+    g_assert_false(MRCSnapshotMode__parse(&mode, "sliding"));
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(test_modes());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_resume());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_invalid());
+    return EXIT_SUCCESS;
+}
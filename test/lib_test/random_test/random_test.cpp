@@ -1,13 +1,16 @@
 #include "unused/mark_unused.h"
 #include <cassert>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
+#include <vector>
 
 // HACK This is a complete hack just to get the C++ linker to work. AHHH!
 extern "C" {
 // TODO(dchu)   Test the Uniform Random function directly
 // I don't test the uniform random function directly... yet.
+#include "random/rejection_inversion_zipfian_random.h"
 #include "random/uniform_random.h"
 #include "random/zipfian_random.h"
 }
@@ -138,11 +141,83 @@ test_zipfian(void)
     return true;
 }
 
+/// @brief  Compare the frequencies of the rejection-inversion sampler's
+///         outputs against the exact Zipfian distribution.
+/// @note   We have no oracle that produces the exact same sequence, so we
+///         test the distribution instead.
+static bool
+test_rejection_inversion_zipfian_for_theta(const uint64_t items,
+                                           const double theta,
+                                           const uint64_t seed,
+                                           const uint64_t trace_length)
+{
+    RejectionInversionZipfianRandom zrng;
+    std::vector<uint64_t> counts(items, 0);
+    double normalization = 0.0;
+
+    if (!RejectionInversionZipfianRandom__init(&zrng, items, theta, seed)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < trace_length; ++i) {
+        uint64_t x = RejectionInversionZipfianRandom__next(&zrng);
+        if (x >= items) {
+            return false;
+        }
+        ++counts[x];
+    }
+    RejectionInversionZipfianRandom__destroy(&zrng);
+
+    for (uint64_t k = 0; k < items; ++k) {
+        normalization += std::pow(k + 1, -theta);
+    }
+    for (uint64_t k = 0; k < items; ++k) {
+        double expected = trace_length * std::pow(k + 1, -theta) /
+                          normalization;
+        // NOTE We allow 6 standard deviations so that this test is
+        //      (practically) never flaky.
+        if (std::abs(counts[k] - expected) > 6 * std::sqrt(expected) + 1) {
+            printf("[ERROR] %s:%d - for theta %g, rank %" PRIu64
+                   " occurred %" PRIu64 " times, expected %g\n",
+                   __FILE__,
+                   __LINE__,
+                   theta,
+                   k,
+                   counts[k],
+                   expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+test_rejection_inversion_zipfian(void)
+{
+    const double thetas[] = {0.0, 0.5, 0.99, 1.0, 1.5};
+    RejectionInversionZipfianRandom zrng;
+    if (RejectionInversionZipfianRandom__init(&zrng, 0, 0.5, 0) ||
+        RejectionInversionZipfianRandom__init(&zrng, 10, -1.0, 0)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < ARRAY_SIZE(thetas); ++i) {
+        const uint64_t seed = randomly_generated_seeds[i];
+        ASSERT_FUNCTION_RETURNS_TRUE(
+            test_rejection_inversion_zipfian_for_theta(1, thetas[i], 0, 1000));
+        ASSERT_FUNCTION_RETURNS_TRUE(
+            test_rejection_inversion_zipfian_for_theta(20,
+                                                       thetas[i],
+                                                       seed,
+                                                       1000000));
+    }
+    return true;
+}
+
 int
 main(int argc, char **argv)
 {
     UNUSED(argc);
     UNUSED(argv);
     ASSERT_FUNCTION_RETURNS_TRUE(test_zipfian());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_rejection_inversion_zipfian());
     return 0;
 }
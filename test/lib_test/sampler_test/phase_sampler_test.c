@@ -59,11 +59,15 @@ init_random_histogram(uint64_t const seed,
     return hist;
 }
 
+/// @param  spill_threshold: the number of in-memory bytes at which to
+///         spill the phases to disk (where 1 spills every phase).
 static bool
-test_phase_sampler(void)
+test_phase_sampler(size_t const spill_threshold)
 {
     struct PhaseSampler me = {0};
-    PhaseSampler__init(&me);
+    // NOTE The random histograms' running sums overflow, so we do not
+    //      try to convert them into MRCs.
+    g_assert_true(PhaseSampler__init_full(&me, NULL, spill_threshold));
 
     // I use a random num_bins and bin_size to ensure that it truly is
     // saving the num_bins and bin_size properly.
@@ -81,9 +85,7 @@ test_phase_sampler(void)
             init_random_histogram(i, rand_get(), rand_get());
         struct Histogram hist = {0};
 
-        LOGGER_TRACE("reading from '%s'",
-                     g_ptr_array_index(me.saved_histograms, i));
-        Histogram__load(&hist, g_ptr_array_index(me.saved_histograms, i));
+        g_assert_true(PhaseSampler__load_phase(&me, i, &hist));
         g_assert_true(Histogram__exactly_equal(&oracle, &hist));
         Histogram__destroy(&oracle);
         Histogram__destroy(&hist);
@@ -166,7 +168,10 @@ test_phase_sampler_mrc_generation(void)
 int
 main(void)
 {
-    ASSERT_FUNCTION_RETURNS_TRUE(test_phase_sampler());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_phase_sampler(0));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_phase_sampler(1));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        test_phase_sampler(PHASE_SAMPLER_DEFAULT_SPILL_THRESHOLD));
     ASSERT_FUNCTION_RETURNS_TRUE(test_phase_sampler_mrc_generation());
     return 0;
 }
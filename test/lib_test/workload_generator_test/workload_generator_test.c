@@ -0,0 +1,187 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "test/mytester.h"
+#include "trace/reader.h"
+#include "trace/trace.h"
+#include "trace/workload_generator.h"
+
+#define LENGTH       100000
+#define NUM_KEYS     1000
+#define BLOCK_LENGTH 4096
+
+static bool
+test_item_round_trip(void)
+{
+    struct FullTraceItem const item = {.timestamp_ms = 123456789000,
+                                       .command = 1,
+                                       .key = 0xDEADBEEFCAFEBABE,
+                                       .size = 4096,
+                                       .ttl_s = 3600};
+    uint8_t bytes[32] = {0};
+
+    g_assert_true(write_full_trace_item(bytes, TRACE_FORMAT_KIA, &item));
+    struct FullTraceItemResult r =
+        construct_full_trace_item(bytes, TRACE_FORMAT_KIA);
+    g_assert_true(r.valid);
+    g_assert_true(memcmp(&r.item, &item, sizeof(item)) == 0);
+
+    // Sari's format drops the command and the milliseconds.
+    g_assert_true(write_full_trace_item(bytes, TRACE_FORMAT_SARI, &item));
+    r = construct_full_trace_item(bytes, TRACE_FORMAT_SARI);
+    g_assert_true(r.valid);
+    g_assert_cmpuint(r.item.timestamp_ms, ==, item.timestamp_ms);
+    g_assert_cmpuint(r.item.command, ==, 0);
+    g_assert_cmpuint(r.item.key, ==, item.key);
+    g_assert_cmpuint(r.item.size, ==, item.size);
+    g_assert_cmpuint(r.item.ttl_s, ==, item.ttl_s);
+
+    g_assert_false(write_full_trace_item(bytes, TRACE_FORMAT_INVALID, &item));
+    return true;
+}
+
+static struct WorkloadConfig
+create_config(enum TraceFormat const format)
+{
+    struct WorkloadConfig config = {0};
+    g_assert_true(
+        WorkloadConfig__init(&config, format, LENGTH, NUM_KEYS, 0.99, 42));
+    config.block_length = BLOCK_LENGTH;
+    config.read_ratio = 0.75;
+    config.size_distribution = WORKLOAD_DISTRIBUTION_LOG_UNIFORM;
+    config.min_size = 10;
+    config.max_size = 10000;
+    config.ttl_distribution = WORKLOAD_DISTRIBUTION_UNIFORM;
+    config.min_ttl_s = 60;
+    config.max_ttl_s = 600;
+    config.reuse_probability = 0.25;
+    config.reuse_window = 16;
+    config.drift_period = 10000;
+    config.drift_step = 100;
+    g_assert_true(WorkloadConfig__validate(&config));
+    return config;
+}
+
+static bool
+test_invalid_config(void)
+{
+    struct WorkloadConfig config = create_config(TRACE_FORMAT_KIA);
+    config.min_size = 0;
+    g_assert_false(WorkloadConfig__validate(&config));
+    config = create_config(TRACE_FORMAT_KIA);
+    config.reuse_window = 0;
+    g_assert_false(WorkloadConfig__validate(&config));
+    config = create_config(TRACE_FORMAT_KIA);
+    g_assert_false(write_workload(&config, "unused.bin", 0));
+    return true;
+}
+
+/// @brief  The output must not depend on the number of threads and must
+///         match the concatenation of the blocks.
+static bool
+test_determinism(enum TraceFormat const format)
+{
+    struct WorkloadConfig const config = create_config(format);
+    char const *const paths[] = {"workload_generator_test-1.bin",
+                                 "workload_generator_test-3.bin"};
+    gchar *contents[2] = {NULL};
+    gsize lengths[2] = {0};
+    size_t const bytes_per_item = get_bytes_per_trace_item(format);
+    uint8_t *buffer = malloc(BLOCK_LENGTH * bytes_per_item);
+    g_assert_nonnull(buffer);
+
+    g_assert_true(write_workload(&config, paths[0], 1));
+    g_assert_true(write_workload(&config, paths[1], 3));
+    for (size_t i = 0; i < 2; ++i) {
+        g_assert_true(
+            g_file_get_contents(paths[i], &contents[i], &lengths[i], NULL));
+        g_assert_cmpuint(lengths[i], ==, LENGTH * bytes_per_item);
+        g_assert_true(remove(paths[i]) == 0);
+    }
+    g_assert_true(memcmp(contents[0], contents[1], lengths[0]) == 0);
+
+    for (size_t b = 0; b < WorkloadConfig__num_blocks(&config); ++b) {
+        size_t num_bytes = 0;
+        g_assert_true(
+            generate_workload_block(&config, b, buffer, &num_bytes));
+        g_assert_true(memcmp(&contents[0][b * BLOCK_LENGTH * bytes_per_item],
+                             buffer,
+                             num_bytes) == 0);
+    }
+
+    free(buffer);
+    g_free(contents[0]);
+    g_free(contents[1]);
+    return true;
+}
+
+/// @brief  Check the keys, sizes, TTLs, commands, and timestamps.
+static bool
+test_properties(void)
+{
+    struct WorkloadConfig const config = create_config(TRACE_FORMAT_KIA);
+    size_t const bytes_per_item = get_bytes_per_trace_item(config.format);
+    uint8_t *buffer = malloc(BLOCK_LENGTH * bytes_per_item);
+    GHashTable *sizes = g_hash_table_new(g_direct_hash, g_direct_equal);
+    size_t num_reads = 0;
+    uint64_t prev_timestamp_ms = 0;
+    g_assert_nonnull(buffer);
+
+    for (size_t b = 0; b < WorkloadConfig__num_blocks(&config); ++b) {
+        size_t num_bytes = 0;
+        g_assert_true(
+            generate_workload_block(&config, b, buffer, &num_bytes));
+        for (size_t i = 0; i < num_bytes / bytes_per_item; ++i) {
+            struct FullTraceItemResult r =
+                construct_full_trace_item(&buffer[i * bytes_per_item],
+                                          config.format);
+            g_assert_true(r.valid);
+            g_assert_cmpuint(r.item.timestamp_ms, >=, prev_timestamp_ms);
+            prev_timestamp_ms = r.item.timestamp_ms;
+            g_assert_cmpuint(r.item.size, >=, config.min_size);
+            g_assert_cmpuint(r.item.size, <=, config.max_size);
+            g_assert_cmpuint(r.item.ttl_s, >=, config.min_ttl_s);
+            g_assert_cmpuint(r.item.ttl_s, <=, config.max_ttl_s);
+            num_reads += r.item.command == 0;
+
+            // Each key always has the same size.
+            gpointer const key = GSIZE_TO_POINTER(r.item.key);
+            gpointer const size = g_hash_table_lookup(sizes, key);
+            if (size == NULL) {
+                g_hash_table_insert(sizes, key, GSIZE_TO_POINTER(r.item.size));
+            } else {
+                g_assert_cmpuint(GPOINTER_TO_SIZE(size), ==, r.item.size);
+            }
+        }
+    }
+    // NOTE The popularity drifts, so we may touch more than NUM_KEYS keys,
+    //      but never more than the keys that the drift can reach.
+    g_assert_cmpuint(g_hash_table_size(sizes),
+                     <=,
+                     NUM_KEYS + LENGTH / config.drift_period *
+                                    config.drift_step);
+    g_assert_cmpuint(g_hash_table_size(sizes), >, NUM_KEYS / 2);
+    g_assert_cmpfloat((double)num_reads / LENGTH, >, 0.7);
+    g_assert_cmpfloat((double)num_reads / LENGTH, <, 0.8);
+
+    g_hash_table_destroy(sizes);
+    free(buffer);
+    return true;
+}
+
+int
+main(void)
+{
+    ASSERT_FUNCTION_RETURNS_TRUE(test_item_round_trip());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_invalid_config());
+    ASSERT_FUNCTION_RETURNS_TRUE(test_determinism(TRACE_FORMAT_KIA));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_determinism(TRACE_FORMAT_SARI));
+    ASSERT_FUNCTION_RETURNS_TRUE(test_properties());
+    return 0;
+}
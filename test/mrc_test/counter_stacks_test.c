@@ -0,0 +1,166 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arrays/array_size.h"
+#include "counter_stacks/counter_stacks.h"
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "olken/olken.h"
+#include "random/zipfian_random.h"
+#include "test/mytester.h"
+#include "types/entry_type.h"
+#include "unused/mark_unused.h"
+
+const uint64_t MAX_NUM_UNIQUE_ENTRIES = 1 << 20;
+const uint64_t TRACE_LENGTH = 1 << 20;
+const double ZIPFIAN_RANDOM_SKEW = 0.99;
+
+static char const *const SAVE_PATH = "counter_stacks_test_state.bin";
+
+/// @brief  Test a deterministic trace against Mattson's histogram.
+/// @note   With a new counter per access and no pruning, Counter Stacks
+///         is exact except for the error in the cardinality estimates,
+///         which is negligible for this few unique items.
+static bool
+small_exact_trace_test(void)
+{
+    // NOTE These are 100 random integers in the range 0..=10. Generated with
+    // Python script:
+    // import random; x = [random.randint(0, 10) for _ in range(100)]; print(x)
+    EntryType entries[100] = {
+        2, 3,  2, 5,  0, 1, 7, 9, 4, 2,  10, 3, 1,  10, 10, 5, 10, 6,  5, 0,
+        6, 4,  2, 9,  7, 2, 2, 5, 3, 9,  6,  0, 1,  1,  6,  1, 6,  7,  5, 0,
+        0, 10, 8, 3,  1, 2, 6, 7, 3, 10, 8,  6, 10, 6,  6,  2, 6,  0,  7, 9,
+        6, 10, 1, 10, 2, 6, 2, 7, 8, 8,  6,  0, 7,  3,  1,  1, 2,  10, 3, 10,
+        5, 5,  0, 7,  9, 8, 0, 7, 6, 9,  4,  9, 4,  8,  3,  6, 5,  3,  2, 9};
+    uint64_t histogram_oracle_array[11] = {8, 11, 7, 7, 6, 4, 13, 11, 9, 12, 1};
+    struct Histogram histogram_oracle = {
+        .histogram = histogram_oracle_array,
+        .num_bins = ARRAY_SIZE(histogram_oracle_array),
+        .bin_size = 1,
+        .false_infinity = 0,
+        .infinity = 11,
+        .running_sum = ARRAY_SIZE(entries),
+    };
+
+    struct CounterStacks me = {0};
+    g_assert_true(
+        CounterStacks__init(&me, 1, 0.0, 12, histogram_oracle.num_bins, 1));
+    for (uint64_t i = 0; i < ARRAY_SIZE(entries); ++i) {
+        g_assert_true(CounterStacks__access_item(&me, entries[i]));
+    }
+    g_assert_true(CounterStacks__post_process(&me));
+    CounterStacks__print_histogram_as_json(&me);
+    Histogram__print_as_json(&histogram_oracle);
+    g_assert_true(Histogram__exactly_equal(&me.histogram, &histogram_oracle));
+    // There are only ever as many distinct counters as unique items.
+    g_assert_cmpuint(me.num_counters, <=, 11);
+    CounterStacks__destroy(&me);
+    return true;
+}
+
+static bool
+long_accuracy_trace_test(void)
+{
+    struct ZipfianRandom zrng = {0};
+    struct Olken oracle = {0};
+    struct CounterStacks me = {0};
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    // The maximum trace length is obviously the number of possible unique items
+    g_assert_true(Olken__init(&oracle, MAX_NUM_UNIQUE_ENTRIES, 1));
+    g_assert_true(
+        CounterStacks__init(&me,
+                            COUNTER_STACKS_DEFAULT_DOWNSAMPLE_INTERVAL,
+                            COUNTER_STACKS_DEFAULT_PRUNING_DELTA,
+                            COUNTER_STACKS_DEFAULT_PRECISION,
+                            MAX_NUM_UNIQUE_ENTRIES,
+                            1));
+
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        uint64_t entry = ZipfianRandom__next(&zrng);
+        Olken__access_item(&oracle, entry);
+        CounterStacks__access_item(&me, entry);
+    }
+    g_assert_true(CounterStacks__post_process(&me));
+    LOGGER_INFO("Number of live counters: %zu", me.num_counters);
+    struct MissRateCurve oracle_mrc = {0}, mrc = {0};
+    MissRateCurve__init_from_histogram(&oracle_mrc, &oracle.histogram);
+    MissRateCurve__init_from_histogram(&mrc, &me.histogram);
+    double mse = MissRateCurve__mean_squared_error(&oracle_mrc, &mrc);
+    LOGGER_INFO("Mean-Squared Error: %lf", mse);
+    // NOTE This is the same bound as Fixed-Size SHARDS with splitmix64.
+    g_assert_cmpfloat(mse, <=, 0.018);
+
+    ZipfianRandom__destroy(&zrng);
+    Olken__destroy(&oracle);
+    CounterStacks__destroy(&me);
+    MissRateCurve__destroy(&oracle_mrc);
+    MissRateCurve__destroy(&mrc);
+    return true;
+}
+
+/// @brief  Check that saving and loading partway through a trace gives
+///         exactly the same result as processing the whole trace.
+static bool
+save_and_load_test(void)
+{
+    struct ZipfianRandom zrng = {0};
+    struct CounterStacks full = {0}, first = {0}, second = {0};
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(CounterStacks__init(&full, 1 << 8, 0.02, 10, 1 << 16, 1));
+    g_assert_true(CounterStacks__init(&first, 1 << 8, 0.02, 10, 1 << 16, 1));
+
+    // NOTE We save at a time that is not a multiple of the downsampling
+    //      interval to make sure the partial interval is preserved.
+    uint64_t const save_time = TRACE_LENGTH / 4 + 123;
+    for (uint64_t i = 0; i < TRACE_LENGTH / 2; ++i) {
+        uint64_t entry = ZipfianRandom__next(&zrng);
+        CounterStacks__access_item(&full, entry);
+        if (i < save_time) {
+            CounterStacks__access_item(&first, entry);
+        } else {
+            if (i == save_time) {
+                g_assert_true(CounterStacks__save(&first, SAVE_PATH));
+                g_assert_true(CounterStacks__load(
+                    &second,
+                    SAVE_PATH,
+                    HistogramOutOfBoundsMode__allow_overflow));
+            }
+            CounterStacks__access_item(&second, entry);
+        }
+    }
+    g_assert_true(CounterStacks__post_process(&full));
+    g_assert_true(CounterStacks__post_process(&second));
+    g_assert_cmpuint(full.num_counters, ==, second.num_counters);
+    g_assert_true(Histogram__exactly_equal(&full.histogram, &second.histogram));
+
+    if (remove(SAVE_PATH) != 0) {
+        LOGGER_ERROR("failed to remove '%s'", SAVE_PATH);
+    }
+    ZipfianRandom__destroy(&zrng);
+    CounterStacks__destroy(&full);
+    CounterStacks__destroy(&first);
+    CounterStacks__destroy(&second);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(small_exact_trace_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(long_accuracy_trace_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(save_and_load_test());
+    return EXIT_SUCCESS;
+}
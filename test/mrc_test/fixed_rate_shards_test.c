@@ -3,12 +3,15 @@
 #include <stdlib.h>
 
 #include "arrays/array_size.h"
+#include "hash/hash.h"
+#include "lookup/k_hash_table.h"
 #include "logger/logger.h"
 #include "miss_rate_curve/miss_rate_curve.h"
 #include "olken/olken.h"
 #include "parda.h"
 #include "parda_shards/parda_fixed_rate_shards.h"
 #include "random/zipfian_random.h"
+#include "sampler/sampling_controller.h"
 #include "shards/fixed_rate_shards.h"
 #include "test/mytester.h"
 #include "unused/mark_unused.h"
@@ -180,6 +183,203 @@ long_parda_matching_trace_test(void)
     return true;
 }
 
+struct CheckData {
+    uint64_t threshold;
+    uint64_t num_keys;
+};
+
+static bool
+check_below_threshold(void *data, EntryType key, TimeStampType timestamp)
+{
+    struct CheckData *const d = data;
+    UNUSED(timestamp);
+    g_assert_cmpuint(Hash64Bit(key), <=, d->threshold);
+    ++d->num_keys;
+    return false;
+}
+
+/// @brief  Check that we only track keys below the tracking threshold and
+///         that the trees and the hash table agree.
+static void
+check_tracked_keys(struct FixedRateShards *const me)
+{
+    struct CheckData d = {.threshold = me->tracking_threshold};
+    KHashTable__remove_if(&me->olken.hash_table, check_below_threshold, &d);
+    g_assert_cmpuint(d.num_keys,
+                     ==,
+                     me->olken.tree.cardinality + me->warming_tree.cardinality);
+}
+
+/// @brief  Lower and then raise the sampling ratio mid-trace.
+static bool
+change_sampling_ratio_test(void)
+{
+    struct ZipfianRandom zrng = {0};
+    struct Olken oracle = {0};
+    struct FixedRateShards me = {0};
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(Olken__init(&oracle, MAX_NUM_UNIQUE_ENTRIES, 1));
+    g_assert_true(
+        FixedRateShards__init(&me, 1e-2, MAX_NUM_UNIQUE_ENTRIES, 1, true));
+    g_assert_false(FixedRateShards__set_sampling_ratio(&me, 0.0));
+    g_assert_false(FixedRateShards__set_sampling_ratio(&me, 1.5));
+
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        uint64_t entry = ZipfianRandom__next(&zrng);
+        if (i == TRACE_LENGTH / 4) {
+            g_assert_true(FixedRateShards__set_sampling_ratio(&me, 1e-3));
+            check_tracked_keys(&me);
+        } else if (i == TRACE_LENGTH / 2) {
+            g_assert_true(FixedRateShards__set_sampling_ratio(&me, 4e-3));
+            // NOTE We record at the old ratio until the new keys warm up.
+            g_assert_cmpfloat(me.sampling_ratio, ==, 1e-3);
+            g_assert_cmpuint(me.num_warming_left, >, 0);
+        }
+        Olken__access_item(&oracle, entry);
+        FixedRateShards__access_item(&me, entry);
+    }
+    check_tracked_keys(&me);
+    g_assert_cmpfloat(me.sampling_ratio, ==, 4e-3);
+    FixedRateShards__post_process(&me);
+
+    struct MissRateCurve oracle_mrc = {0}, mrc = {0};
+    MissRateCurve__init_from_histogram(&oracle_mrc, &oracle.histogram);
+    MissRateCurve__init_from_histogram(&mrc, &me.olken.histogram);
+    double mse = MissRateCurve__mean_squared_error(&oracle_mrc, &mrc);
+    LOGGER_INFO("Mean-Squared Error: %lf", mse);
+    g_assert_cmpfloat(mse, <=, 0.04);
+    FixedRateShards__destroy(&me);
+
+    // NOTE Raising the ratio with only a couple of sampled keys gives a
+    //      fractional warming target just above the band's cardinality.
+    g_assert_true(
+        FixedRateShards__init(&me, 1e-2, MAX_NUM_UNIQUE_ENTRIES, 1, true));
+    uint64_t key = 0;
+    for (; me.olken.tree.cardinality < 2; ++key) {
+        FixedRateShards__access_item(&me, key);
+    }
+    g_assert_true(FixedRateShards__set_sampling_ratio(&me, 2e-2));
+    g_assert_cmpfloat(me.sampling_ratio, ==, 1e-2);
+    g_assert_cmpuint(me.num_warming_left, >, 0);
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i, ++key) {
+        FixedRateShards__access_item(&me, key);
+    }
+    check_tracked_keys(&me);
+    g_assert_cmpfloat(me.sampling_ratio, ==, 2e-2);
+    g_assert_cmpuint(me.warming_tree.cardinality, ==, 0);
+
+    ZipfianRandom__destroy(&zrng);
+    Olken__destroy(&oracle);
+    FixedRateShards__destroy(&me);
+    MissRateCurve__destroy(&oracle_mrc);
+    MissRateCurve__destroy(&mrc);
+    return true;
+}
+
+/// @brief  Check that the controller moves the sampling ratio toward an
+///         unattainably low and a trivially high CPU budget.
+static bool
+cpu_budget_test(double const budget_ns)
+{
+    struct ZipfianRandom zrng = {0};
+    struct Olken oracle = {0};
+    struct FixedRateShards me = {0};
+    struct SamplingControllerConfig config = {0};
+    double const initial_ratio = 1e-2;
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(Olken__init(&oracle, MAX_NUM_UNIQUE_ENTRIES, 1));
+    g_assert_true(FixedRateShards__init(&me,
+                                        initial_ratio,
+                                        MAX_NUM_UNIQUE_ENTRIES,
+                                        1,
+                                        true));
+    g_assert_true(SamplingControllerConfig__init(&config, budget_ns));
+    config.min_rate = 1e-3;
+    config.period = 1 << 10;
+    config.window = 4;
+    g_assert_true(FixedRateShards__enable_controller(&me, &config));
+
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        uint64_t entry = ZipfianRandom__next(&zrng);
+        Olken__access_item(&oracle, entry);
+        FixedRateShards__access_item(&me, entry);
+    }
+    check_tracked_keys(&me);
+    g_assert_cmpuint(me.controller->trajectory->len, >, 1);
+    if (budget_ns < 1.0) {
+        g_assert_cmpfloat(me.sampling_ratio, ==, config.min_rate);
+    } else {
+        g_assert_cmpfloat(me.tracking_ratio, ==, config.max_rate);
+    }
+    SamplingController__write_trajectory_as_json(stdout, me.controller);
+    FixedRateShards__post_process(&me);
+
+    struct MissRateCurve oracle_mrc = {0}, mrc = {0};
+    MissRateCurve__init_from_histogram(&oracle_mrc, &oracle.histogram);
+    MissRateCurve__init_from_histogram(&mrc, &me.olken.histogram);
+    double mse = MissRateCurve__mean_squared_error(&oracle_mrc, &mrc);
+    LOGGER_INFO("Mean-Squared Error: %lf", mse);
+    g_assert_cmpfloat(mse, <=, 0.04);
+
+    ZipfianRandom__destroy(&zrng);
+    Olken__destroy(&oracle);
+    FixedRateShards__destroy(&me);
+    MissRateCurve__destroy(&oracle_mrc);
+    MissRateCurve__destroy(&mrc);
+    return true;
+}
+
+/// @brief  Check that accessing in batches matches accessing one by one.
+static bool
+access_batch_test(void)
+{
+    struct ZipfianRandom zrng = {0};
+    struct FixedRateShards oracle = {0};
+    struct FixedRateShards me = {0};
+    // NOTE This is not a multiple of the internal batch size.
+    EntryType entries[1000] = {0};
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(
+        FixedRateShards__init(&oracle, 1e-2, MAX_NUM_UNIQUE_ENTRIES, 1, true));
+    g_assert_true(
+        FixedRateShards__init(&me, 1e-2, MAX_NUM_UNIQUE_ENTRIES, 1, true));
+    g_assert_false(FixedRateShards__access_batch(NULL, entries, 1));
+
+    for (uint64_t i = 0; i < TRACE_LENGTH; i += ARRAY_SIZE(entries)) {
+        size_t const n = MIN(ARRAY_SIZE(entries), TRACE_LENGTH - i);
+        for (size_t j = 0; j < n; ++j) {
+            entries[j] = ZipfianRandom__next(&zrng);
+            FixedRateShards__access_item(&oracle, entries[j]);
+        }
+        g_assert_true(FixedRateShards__access_batch(&me, entries, n));
+    }
+    FixedRateShards__post_process(&oracle);
+    FixedRateShards__post_process(&me);
+    g_assert_cmpuint(me.num_entries_seen, ==, oracle.num_entries_seen);
+    g_assert_cmpuint(me.num_entries_processed,
+                     ==,
+                     oracle.num_entries_processed);
+    g_assert_true(
+        Histogram__exactly_equal(&me.olken.histogram, &oracle.olken.histogram));
+
+    ZipfianRandom__destroy(&zrng);
+    FixedRateShards__destroy(&oracle);
+    FixedRateShards__destroy(&me);
+    return true;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -189,5 +389,11 @@ main(int argc, char **argv)
     ASSERT_FUNCTION_RETURNS_TRUE(small_exact_trace_test());
     ASSERT_FUNCTION_RETURNS_TRUE(long_accuracy_trace_test());
     ASSERT_FUNCTION_RETURNS_TRUE(long_parda_matching_trace_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(access_batch_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(change_sampling_ratio_test());
+    // NOTE No ratio is cheap enough for 0.1 ns per access, but every
+    //      ratio is for 1 ms per access.
+    ASSERT_FUNCTION_RETURNS_TRUE(cpu_budget_test(0.1));
+    ASSERT_FUNCTION_RETURNS_TRUE(cpu_budget_test(1e6));
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,114 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arrays/array_size.h"
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "random/uniform_random.h"
+#include "random/zipfian_random.h"
+#include "shards/fixed_size_shards.h"
+#include "shards/fused_fixed_size_shards.h"
+#include "test/mytester.h"
+#include "types/entry_type.h"
+#include "unused/mark_unused.h"
+
+const uint64_t MAX_NUM_UNIQUE_ENTRIES = 1 << 20;
+const uint64_t TRACE_LENGTH = 1 << 20;
+const double ZIPFIAN_RANDOM_SKEW = 0.99;
+
+/// @brief  Test a deterministic trace against Mattson's histogram.
+static bool
+small_exact_trace_test(void)
+{
+    // NOTE These are 100 random integers in the range 0..=10. Generated with
+    // Python script:
+    // import random; x = [random.randint(0, 10) for _ in range(100)]; print(x)
+    EntryType entries[100] = {
+        2, 3,  2, 5,  0, 1, 7, 9, 4, 2,  10, 3, 1,  10, 10, 5, 10, 6,  5, 0,
+        6, 4,  2, 9,  7, 2, 2, 5, 3, 9,  6,  0, 1,  1,  6,  1, 6,  7,  5, 0,
+        0, 10, 8, 3,  1, 2, 6, 7, 3, 10, 8,  6, 10, 6,  6,  2, 6,  0,  7, 9,
+        6, 10, 1, 10, 2, 6, 2, 7, 8, 8,  6,  0, 7,  3,  1,  1, 2,  10, 3, 10,
+        5, 5,  0, 7,  9, 8, 0, 7, 6, 9,  4,  9, 4,  8,  3,  6, 5,  3,  2, 9};
+    uint64_t histogram_oracle_array[11] = {8, 11, 7, 7, 6, 4, 13, 11, 9, 12, 1};
+    struct Histogram histogram_oracle = {
+        .histogram = histogram_oracle_array,
+        .num_bins = ARRAY_SIZE(histogram_oracle_array),
+        .bin_size = 1,
+        .false_infinity = 0,
+        .infinity = 11,
+        .running_sum = ARRAY_SIZE(entries),
+    };
+
+    struct FusedFixedSizeShards me = {0};
+    // NOTE We use a tiny maximum size so that the timestamps are
+    //      renumbered many times.
+    g_assert_true(
+        FusedFixedSizeShards__init(&me, 1.0, 11, histogram_oracle.num_bins, 1));
+    for (uint64_t i = 0; i < ARRAY_SIZE(entries); ++i) {
+        FusedFixedSizeShards__access_item(&me, entries[i]);
+    }
+    FusedFixedSizeShards__print_histogram_as_json(&me);
+    Histogram__print_as_json(&histogram_oracle);
+    g_assert_true(Histogram__exactly_equal(&me.histogram, &histogram_oracle));
+    FusedFixedSizeShards__destroy(&me);
+    return true;
+}
+
+/// @brief  Check that we produce exactly the same histogram as the
+///         regular fixed-size SHARDS.
+static bool
+same_as_fixed_size_shards_test(bool const zipfian, size_t const max_size)
+{
+    struct ZipfianRandom zrng = {0};
+    struct UniformRandom urng = {0};
+    struct FixedSizeShards oracle = {0};
+    struct FusedFixedSizeShards me = {0};
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(UniformRandom__init(&urng, 0));
+    g_assert_true(FixedSizeShards__init(&oracle,
+                                        1e-1,
+                                        max_size,
+                                        MAX_NUM_UNIQUE_ENTRIES,
+                                        1));
+    g_assert_true(FusedFixedSizeShards__init(&me,
+                                             1e-1,
+                                             max_size,
+                                             MAX_NUM_UNIQUE_ENTRIES,
+                                             1));
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        uint64_t const entry = zipfian
+                                   ? ZipfianRandom__next(&zrng)
+                                   : UniformRandom__next_uint64(&urng) %
+                                         MAX_NUM_UNIQUE_ENTRIES;
+        FixedSizeShards__access_item(&oracle, entry);
+        FusedFixedSizeShards__access_item(&me, entry);
+        g_assert_cmpuint(me.num_entries, <=, max_size);
+    }
+    g_assert_cmpuint(me.threshold, ==, oracle.sampler.threshold);
+    g_assert_cmpuint(me.scale, ==, oracle.sampler.scale);
+    g_assert_true(
+        Histogram__exactly_equal(&me.histogram, &oracle.olken.histogram));
+
+    ZipfianRandom__destroy(&zrng);
+    UniformRandom__destroy(&urng);
+    FixedSizeShards__destroy(&oracle);
+    FusedFixedSizeShards__destroy(&me);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(small_exact_trace_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(same_as_fixed_size_shards_test(true, 1 << 13));
+    ASSERT_FUNCTION_RETURNS_TRUE(same_as_fixed_size_shards_test(true, 100));
+    ASSERT_FUNCTION_RETURNS_TRUE(same_as_fixed_size_shards_test(false, 1 << 13));
+    return EXIT_SUCCESS;
+}
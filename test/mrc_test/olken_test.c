@@ -141,6 +141,41 @@ long_trace_test(void)
     return true;
 }
 
+/// @brief  Test that batches of accesses match individual accesses.
+static bool
+access_batch_test(void)
+{
+    const uint64_t trace_length = 1 << 16;
+    struct ZipfianRandom zrng = {0};
+    struct Olken oracle = {0};
+    struct Olken me = {0};
+    // NOTE This is not a multiple of the prefetch distance.
+    EntryType entries[1000] = {0};
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(Olken__init(&oracle, MAX_NUM_UNIQUE_ENTRIES, 1));
+    g_assert_true(Olken__init(&me, MAX_NUM_UNIQUE_ENTRIES, 1));
+    g_assert_false(Olken__access_batch(NULL, entries, 1));
+
+    for (uint64_t i = 0; i < trace_length; i += ARRAY_SIZE(entries)) {
+        size_t const n = MIN(ARRAY_SIZE(entries), trace_length - i);
+        for (size_t j = 0; j < n; ++j) {
+            entries[j] = ZipfianRandom__next(&zrng);
+            Olken__access_item(&oracle, entries[j]);
+        }
+        g_assert_true(Olken__access_batch(&me, entries, n));
+    }
+    g_assert_true(Histogram__exactly_equal(&me.histogram, &oracle.histogram));
+
+    ZipfianRandom__destroy(&zrng);
+    Olken__destroy(&oracle);
+    Olken__destroy(&me);
+    return true;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -150,5 +185,6 @@ main(int argc, char **argv)
     ASSERT_FUNCTION_RETURNS_TRUE(small_exact_trace_test());
     ASSERT_FUNCTION_RETURNS_TRUE(small_inexact_trace_test());
     ASSERT_FUNCTION_RETURNS_TRUE(long_trace_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(access_batch_test());
     return EXIT_SUCCESS;
 }
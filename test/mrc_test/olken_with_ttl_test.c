@@ -7,8 +7,11 @@
 
 #include "arrays/array_size.h"
 #include "histogram/histogram.h"
+#include "lookup/k_hash_table.h"
 #include "olken/olken_with_ttl.h"
 #include "random/zipfian_random.h"
+#include "shards/fixed_rate_shards.h"
+#include "shards/fixed_size_shards.h"
 #include "test/mytester.h"
 #include "types/entry_type.h"
 #include "unused/mark_unused.h"
@@ -152,6 +155,154 @@ long_trace_test(void)
     return true;
 }
 
+/// @brief  Test that sampling every key is identical to not sampling.
+static bool
+sample_everything_test(enum OlkenWithTTLSampling const sampling)
+{
+    const uint64_t trace_length = 1 << 18;
+    struct ZipfianRandom zrng = {0};
+    struct OlkenWithTTL oracle = {0}, me = {0};
+
+    ASSERT_FUNCTION_RETURNS_TRUE(ZipfianRandom__init(&zrng,
+                                                     MAX_NUM_UNIQUE_ENTRIES,
+                                                     ZIPFIAN_RANDOM_SKEW,
+                                                     0));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        OlkenWithTTL__init(&oracle, MAX_NUM_UNIQUE_ENTRIES, 1));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        OlkenWithTTL__init_sampled(&me,
+                                   MAX_NUM_UNIQUE_ENTRIES,
+                                   1,
+                                   HistogramOutOfBoundsMode__allow_overflow,
+                                   NULL,
+                                   sampling,
+                                   1.0,
+                                   MAX_NUM_UNIQUE_ENTRIES,
+                                   false));
+    for (uint64_t i = 0; i < trace_length; ++i) {
+        uint64_t key = ZipfianRandom__next(&zrng);
+        uint64_t ttl = ZipfianRandom__next(&zrng) % (1 << 10);
+        OlkenWithTTL__access_item(&oracle, key, i, ttl);
+        OlkenWithTTL__access_item(&me, key, i, ttl);
+    }
+    g_assert_true(Histogram__exactly_equal(&me.olken.histogram,
+                                           &oracle.olken.histogram));
+
+    ZipfianRandom__destroy(&zrng);
+    OlkenWithTTL__destroy(&oracle);
+    OlkenWithTTL__destroy(&me);
+    return true;
+}
+
+/// @brief  Test that without expirations, we match the SHARDS modules.
+static bool
+shards_without_expiry_test(void)
+{
+    const uint64_t trace_length = 1 << 18;
+    const double sampling_ratio = 0.1;
+    const size_t max_size = 1 << 10;
+    struct ZipfianRandom zrng = {0};
+    struct FixedRateShards fixed_rate = {0};
+    struct FixedSizeShards fixed_size = {0};
+    struct OlkenWithTTL me_fixed_rate = {0}, me_fixed_size = {0};
+
+    ASSERT_FUNCTION_RETURNS_TRUE(ZipfianRandom__init(&zrng,
+                                                     MAX_NUM_UNIQUE_ENTRIES,
+                                                     ZIPFIAN_RANDOM_SKEW,
+                                                     0));
+    ASSERT_FUNCTION_RETURNS_TRUE(FixedRateShards__init(&fixed_rate,
+                                                       sampling_ratio,
+                                                       MAX_NUM_UNIQUE_ENTRIES,
+                                                       1,
+                                                       false));
+    ASSERT_FUNCTION_RETURNS_TRUE(FixedSizeShards__init(&fixed_size,
+                                                       sampling_ratio,
+                                                       max_size,
+                                                       MAX_NUM_UNIQUE_ENTRIES,
+                                                       1));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        OlkenWithTTL__init_sampled(&me_fixed_rate,
+                                   MAX_NUM_UNIQUE_ENTRIES,
+                                   1,
+                                   HistogramOutOfBoundsMode__allow_overflow,
+                                   NULL,
+                                   OLKEN_WITH_TTL_SAMPLING_FIXED_RATE,
+                                   sampling_ratio,
+                                   0,
+                                   false));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        OlkenWithTTL__init_sampled(&me_fixed_size,
+                                   MAX_NUM_UNIQUE_ENTRIES,
+                                   1,
+                                   HistogramOutOfBoundsMode__allow_overflow,
+                                   NULL,
+                                   OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE,
+                                   sampling_ratio,
+                                   max_size,
+                                   false));
+    for (uint64_t i = 0; i < trace_length; ++i) {
+        uint64_t key = ZipfianRandom__next(&zrng);
+        FixedRateShards__access_item(&fixed_rate, key);
+        FixedSizeShards__access_item(&fixed_size, key);
+        OlkenWithTTL__access_item(&me_fixed_rate, key, i, DO_NOT_EXPIRE);
+        OlkenWithTTL__access_item(&me_fixed_size, key, i, DO_NOT_EXPIRE);
+    }
+    g_assert_true(Histogram__exactly_equal(&me_fixed_rate.olken.histogram,
+                                           &fixed_rate.olken.histogram));
+    g_assert_true(Histogram__exactly_equal(&me_fixed_size.olken.histogram,
+                                           &fixed_size.olken.histogram));
+
+    ZipfianRandom__destroy(&zrng);
+    FixedRateShards__destroy(&fixed_rate);
+    FixedSizeShards__destroy(&fixed_size);
+    OlkenWithTTL__destroy(&me_fixed_rate);
+    OlkenWithTTL__destroy(&me_fixed_size);
+    return true;
+}
+
+/// @brief  Test that the fixed-size sampler holds every live and every
+///         expired sampled key exactly once, even when keys expire and
+///         come back.
+static bool
+fixed_size_expiry_test(void)
+{
+    const uint64_t trace_length = 1 << 18;
+    const size_t max_size = 1 << 10;
+    struct ZipfianRandom zrng = {0};
+    struct OlkenWithTTL me = {0};
+
+    ASSERT_FUNCTION_RETURNS_TRUE(ZipfianRandom__init(&zrng,
+                                                     MAX_NUM_UNIQUE_ENTRIES,
+                                                     ZIPFIAN_RANDOM_SKEW,
+                                                     0));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        OlkenWithTTL__init_sampled(&me,
+                                   MAX_NUM_UNIQUE_ENTRIES,
+                                   1,
+                                   HistogramOutOfBoundsMode__allow_overflow,
+                                   NULL,
+                                   OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE,
+                                   1.0,
+                                   max_size,
+                                   false));
+    for (uint64_t i = 0; i < trace_length; ++i) {
+        uint64_t key = ZipfianRandom__next(&zrng);
+        // NOTE These TTLs are in seconds, so keys expire after up to
+        //      16 thousand accesses.
+        uint64_t ttl = ZipfianRandom__next(&zrng) % (1 << 4);
+        g_assert_true(OlkenWithTTL__access_item(&me, key, i, ttl));
+        g_assert_cmpuint(me.sampler.pq.length, <=, max_size);
+        g_assert_cmpuint(KHashTable__get_size(&me.olken.hash_table) +
+                             KHashTable__get_size(&me.expired),
+                         ==,
+                         me.sampler.pq.length);
+    }
+
+    ZipfianRandom__destroy(&zrng);
+    OlkenWithTTL__destroy(&me);
+    return true;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -161,5 +312,11 @@ main(int argc, char **argv)
     ASSERT_FUNCTION_RETURNS_TRUE(small_exact_trace_test());
     ASSERT_FUNCTION_RETURNS_TRUE(small_inexact_trace_test());
     ASSERT_FUNCTION_RETURNS_TRUE(long_trace_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        sample_everything_test(OLKEN_WITH_TTL_SAMPLING_FIXED_RATE));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        sample_everything_test(OLKEN_WITH_TTL_SAMPLING_FIXED_SIZE));
+    ASSERT_FUNCTION_RETURNS_TRUE(shards_without_expiry_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(fixed_size_expiry_test());
     return EXIT_SUCCESS;
 }
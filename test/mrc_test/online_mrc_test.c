@@ -0,0 +1,224 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "histogram/histogram.h"
+#include "logger/logger.h"
+#include "miss_rate_curve/miss_rate_curve.h"
+#include "olken/olken.h"
+#include "online_mrc/online_mrc.h"
+#include "random/zipfian_random.h"
+#include "shards/fixed_size_shards.h"
+#include "test/mytester.h"
+#include "timer/timer.h"
+#include "unused/mark_unused.h"
+
+#define NUM_THREADS 8
+
+const uint64_t MAX_NUM_UNIQUE_ENTRIES = 1 << 16;
+const uint64_t TRACE_LENGTH = 1 << 20;
+const double ZIPFIAN_RANDOM_SKEW = 0.99;
+
+/// @brief  With a single thread, the accesses are processed in order, so
+///         we should get exactly the same MRC as running the algorithm.
+static bool
+single_thread_test(enum OnlineMRCAlgorithm const algorithm)
+{
+    struct ZipfianRandom zrng = {0};
+    struct OnlineMRCConfig config = {0};
+    struct OnlineMRC me = {0};
+    struct OnlineMRCStatistics stats = {0};
+    struct MissRateCurve mrc = {0}, oracle_mrc = {0};
+    struct Olken olken = {0};
+    struct FixedSizeShards fss = {0};
+
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      0));
+    g_assert_true(OnlineMRCConfig__init(&config, algorithm));
+    config.sampling_rate = 1e-1;
+    config.num_bins = MAX_NUM_UNIQUE_ENTRIES;
+    // NOTE We use a small ring so that the producer waits on the
+    //      aggregator.
+    config.ring_capacity = 1 << 10;
+    g_assert_true(OnlineMRC__init(&me, &config));
+    if (algorithm == ONLINE_MRC_ALGORITHM_OLKEN) {
+        g_assert_true(Olken__init(&olken, config.num_bins, 1));
+    } else {
+        g_assert_true(FixedSizeShards__init(&fss,
+                                            config.sampling_rate,
+                                            config.max_size,
+                                            config.num_bins,
+                                            1));
+    }
+
+    uint64_t *const keys = calloc(TRACE_LENGTH, sizeof(*keys));
+    g_assert_nonnull(keys);
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        keys[i] = ZipfianRandom__next(&zrng);
+    }
+    double const t0 = get_wall_time_sec();
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        g_assert_true(OnlineMRC__record(&me, keys[i], 1));
+    }
+    double const t1 = get_wall_time_sec();
+    LOGGER_INFO("%s: %g ns per record (including waiting on a full ring)",
+                ONLINE_MRC_ALGORITHM_STRINGS[algorithm],
+                (t1 - t0) * 1e9 / TRACE_LENGTH);
+    for (uint64_t i = 0; i < TRACE_LENGTH; ++i) {
+        if (algorithm == ONLINE_MRC_ALGORITHM_OLKEN) {
+            Olken__access_item(&olken, keys[i]);
+        } else {
+            FixedSizeShards__access_item(&fss, keys[i]);
+        }
+    }
+
+    g_assert_true(OnlineMRC__get_mrc(&me, &mrc));
+    if (algorithm == ONLINE_MRC_ALGORITHM_OLKEN) {
+        g_assert_true(Olken__to_mrc(&olken, &oracle_mrc));
+    } else {
+        g_assert_true(FixedSizeShards__to_mrc(&fss, &oracle_mrc));
+    }
+    g_assert_true(MissRateCurve__all_close(&mrc, &oracle_mrc, 1e-9));
+    OnlineMRC__get_statistics(&me, &stats);
+    g_assert_cmpuint(stats.num_recorded, ==, TRACE_LENGTH);
+    g_assert_cmpuint(stats.num_processed, ==, TRACE_LENGTH);
+    g_assert_cmpuint(stats.num_bytes_processed, ==, TRACE_LENGTH);
+    g_assert_cmpuint(stats.num_dropped, ==, 0);
+    g_assert_cmpuint(stats.num_threads, ==, 1);
+
+    free(keys);
+    ZipfianRandom__destroy(&zrng);
+    MissRateCurve__destroy(&mrc);
+    MissRateCurve__destroy(&oracle_mrc);
+    OnlineMRC__destroy(&me);
+    if (algorithm == ONLINE_MRC_ALGORITHM_OLKEN) {
+        Olken__destroy(&olken);
+    } else {
+        FixedSizeShards__destroy(&fss);
+    }
+    return true;
+}
+
+struct ProducerArgs {
+    struct OnlineMRC *online_mrc;
+    uint64_t seed;
+    uint64_t length;
+    uint64_t num_recorded;
+};
+
+static void *
+produce(void *arg)
+{
+    struct ProducerArgs *const args = arg;
+    struct ZipfianRandom zrng = {0};
+    g_assert_true(ZipfianRandom__init(&zrng,
+                                      MAX_NUM_UNIQUE_ENTRIES,
+                                      ZIPFIAN_RANDOM_SKEW,
+                                      args->seed));
+    for (uint64_t i = 0; i < args->length; ++i) {
+        if (OnlineMRC__record(args->online_mrc,
+                              ZipfianRandom__next(&zrng),
+                              args->seed)) {
+            ++args->num_recorded;
+        }
+    }
+    ZipfianRandom__destroy(&zrng);
+    return NULL;
+}
+
+/// @brief  Record from many threads at once and check that we account
+///         for every access.
+static bool
+multi_thread_test(void)
+{
+    pthread_t threads[NUM_THREADS];
+    struct ProducerArgs args[NUM_THREADS];
+    struct OnlineMRCConfig config = {0};
+    struct OnlineMRC me = {0};
+    struct OnlineMRCStatistics stats = {0};
+    struct MissRateCurve mrc = {0};
+    uint64_t expected_bytes = 0;
+
+    g_assert_true(
+        OnlineMRCConfig__init(&config, ONLINE_MRC_ALGORITHM_EVICTING_MAP));
+    config.num_bins = MAX_NUM_UNIQUE_ENTRIES;
+    g_assert_true(OnlineMRC__init(&me, &config));
+    for (size_t i = 0; i < NUM_THREADS; ++i) {
+        args[i] = (struct ProducerArgs){.online_mrc = &me,
+                                        .seed = i + 1,
+                                        .length = TRACE_LENGTH / NUM_THREADS};
+        g_assert_cmpint(pthread_create(&threads[i], NULL, produce, &args[i]),
+                        ==,
+                        0);
+    }
+    for (size_t i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        g_assert_cmpuint(args[i].num_recorded, ==, args[i].length);
+        expected_bytes += args[i].seed * args[i].length;
+    }
+    g_assert_true(OnlineMRC__get_mrc(&me, &mrc));
+    g_assert_cmpfloat(mrc.miss_rate[0], ==, 1.0);
+    OnlineMRC__get_statistics(&me, &stats);
+    g_assert_cmpuint(stats.num_recorded, ==, TRACE_LENGTH);
+    g_assert_cmpuint(stats.num_processed, ==, TRACE_LENGTH);
+    g_assert_cmpuint(stats.num_bytes_processed, ==, expected_bytes);
+    g_assert_cmpuint(stats.num_threads, <=, NUM_THREADS);
+
+    MissRateCurve__destroy(&mrc);
+    OnlineMRC__destroy(&me);
+    return true;
+}
+
+/// @brief  Check that the threads that exit return their rings and that
+///         we drop accesses (rather than wait) if the user asks us to.
+static bool
+ring_reuse_and_drop_test(void)
+{
+    pthread_t thread;
+    struct ProducerArgs args = {0};
+    struct OnlineMRCConfig config = {0};
+    struct OnlineMRC me = {0};
+    struct OnlineMRCStatistics stats = {0};
+    uint64_t num_recorded = 0;
+
+    g_assert_true(OnlineMRCConfig__init(&config, ONLINE_MRC_ALGORITHM_OLKEN));
+    config.num_bins = MAX_NUM_UNIQUE_ENTRIES;
+    config.ring_capacity = 16;
+    config.max_threads = 1;
+    config.drop_when_full = true;
+    // NOTE A slow aggregator guarantees that the tiny ring fills up.
+    config.idle_sleep_us = 100000;
+    g_assert_true(OnlineMRC__init(&me, &config));
+    for (size_t i = 0; i < 4; ++i) {
+        args = (struct ProducerArgs){.online_mrc = &me,
+                                     .seed = i + 1,
+                                     .length = 1000};
+        g_assert_cmpint(pthread_create(&thread, NULL, produce, &args), ==, 0);
+        pthread_join(thread, NULL);
+        num_recorded += args.num_recorded;
+    }
+    OnlineMRC__get_statistics(&me, &stats);
+    g_assert_cmpuint(stats.num_threads, ==, 1);
+    g_assert_cmpuint(stats.num_recorded, ==, num_recorded);
+    g_assert_cmpuint(stats.num_recorded + stats.num_dropped, ==, 4 * 1000);
+    g_assert_cmpuint(stats.num_dropped, >, 0);
+    OnlineMRC__destroy(&me);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        single_thread_test(ONLINE_MRC_ALGORITHM_OLKEN));
+    ASSERT_FUNCTION_RETURNS_TRUE(
+        single_thread_test(ONLINE_MRC_ALGORITHM_FIXED_SIZE_SHARDS));
+    ASSERT_FUNCTION_RETURNS_TRUE(multi_thread_test());
+    ASSERT_FUNCTION_RETURNS_TRUE(ring_reuse_and_drop_test());
+    return EXIT_SUCCESS;
+}